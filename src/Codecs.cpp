@@ -0,0 +1,372 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+  Original Pascal unit (c) Martijn Coppoolse <https://github.com/vor0nwe>
+*/
+#include <cstdio>
+#include <cstdlib>
+#include <type_traits>
+#include "Utf8.h"
+#include "Entities.h"
+#include "Unicode.h"
+
+using namespace HtmlTag;
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+template <typename Str_T>
+int doEncodeEntities(Str_T &text, Entities::EntityList const &entities, bool includeLineBreaks);
+template <typename Str_T>
+int doDecodeEntities(Str_T &target, Entities::EntityList const &entities);
+template <typename Str_T>
+bool parseEntity(Str_T const &target, size_t charIndex, Entities::EntityList const &entities, char32_t &codePoint,
+    size_t &nextIndex);
+template <typename Str_T>
+int doEncodeEscapes(Str_T &text, Str_T const &prefix);
+template <typename Str_T>
+int doDecodeEscapes(Str_T &text, Str_T const &prefix);
+template <typename Str_T>
+size_t parseEscape(Str_T const &text, size_t pos, size_t maxDigits, char32_t &value) noexcept;
+char32_t toCodePoint(std::string const &digits, int base);
+}
+
+// --------------------------------------------------------------------------------------
+// HtmlTag::Entities
+// --------------------------------------------------------------------------------------
+int Entities::encodeText(std::string &text, EntityList const &entities, bool includeLineBreaks) {
+	return doEncodeEntities(text, entities, includeLineBreaks);
+}
+// --------------------------------------------------------------------------------------
+int Entities::encodeText(std::wstring &text, EntityList const &entities, bool includeLineBreaks) {
+	return doEncodeEntities(text, entities, includeLineBreaks);
+}
+// --------------------------------------------------------------------------------------
+int Entities::decodeText(std::string &text, EntityList const &entities) {
+	return doDecodeEntities(text, entities);
+}
+// --------------------------------------------------------------------------------------
+int Entities::decodeText(std::wstring &text, EntityList const &entities) {
+	return doDecodeEntities(text, entities);
+}
+// --------------------------------------------------------------------------------------
+bool Entities::splitsReference(std::string_view text, size_t cut, EntityList const &entities) {
+	if (cut == 0 || cut >= text.length() || text[cut] != '&')
+		return false;
+	const size_t refIndex = text.rfind('&', cut - 1);
+	char32_t codePoint = 0, lowSurrogate = 0;
+	size_t nextIndex = 0, afterLowSurrogate = 0;
+	if (refIndex == std::string_view::npos || !parseEntity(text, refIndex, entities, codePoint, nextIndex) ||
+	    nextIndex != cut)
+		return false;
+
+	// Without its semicolon, a reference at the very end of a slice isn't read at all
+	if (text[cut - 1] != ';')
+		return true;
+	return codePoint >= 0xD800 && codePoint <= 0xDBFF &&
+	       parseEntity(text, cut, entities, lowSurrogate, afterLowSurrogate) && lowSurrogate >= 0xDC00 &&
+	       lowSurrogate <= 0xDFFF;
+}
+
+// --------------------------------------------------------------------------------------
+// HtmlTag::Unicode
+// --------------------------------------------------------------------------------------
+int Unicode::encodeText(std::string &text, std::string const &prefix) {
+	return doEncodeEscapes(text, prefix);
+}
+// --------------------------------------------------------------------------------------
+int Unicode::encodeText(std::wstring &text, std::wstring const &prefix) {
+	return doEncodeEscapes(text, prefix);
+}
+// --------------------------------------------------------------------------------------
+int Unicode::decodeText(std::string &text, std::string const &prefix) {
+	return doDecodeEscapes(text, prefix);
+}
+// --------------------------------------------------------------------------------------
+int Unicode::decodeText(std::wstring &text, std::wstring const &prefix) {
+	return doDecodeEscapes(text, prefix);
+}
+// --------------------------------------------------------------------------------------
+bool Unicode::splitsEscape(std::string_view text, size_t cut, std::string const &prefix) {
+	const size_t escLength = prefix.length() + 4;
+	char32_t highSurrogate = 0, lowSurrogate = 0;
+	if (prefix.empty() || cut < escLength || text.compare(cut, prefix.length(), prefix) != 0 ||
+	    parseEscape(text, cut + prefix.length(), 4, lowSurrogate) != 4 || lowSurrogate < 0xDC00 ||
+	    lowSurrogate > 0xDFFF)
+		return false;
+	return text.compare(cut - escLength, prefix.length(), prefix) == 0 &&
+	       parseEscape(text, cut - 4, 6, highSurrogate) == 4 && highSurrogate >= 0xD800 && highSurrogate <= 0xDBFF;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+/// Replaces characters in @p text with entities; works on UTF-8 bytes or wide text, code point by code point
+template <typename Str_T>
+int doEncodeEntities(Str_T &text, Entities::EntityList const &entities, bool includeLineBreaks) {
+	int result = 0;
+	if (!entities)
+		return result;
+
+	Str_T encoded;
+	size_t copied = 0;
+
+	try {
+		for (size_t pos = 0; pos < text.length();) {
+			const size_t charIndex = pos;
+			const char32_t charCode = TextConv::nextCodePoint(text, pos);
+			if (charCode == TextConv::invalidCodePoint)
+				continue;
+
+			std::string const &entity = entities[std::to_string(charCode)];
+			if (entity.empty() && charCode <= 127 && !(includeLineBreaks && (charCode == '\n' || charCode == '\r')))
+				continue;
+
+			const std::string encodedEntity = entity.empty() ? "#" + std::to_string(charCode) : entity;
+			if (result == 0)
+				encoded.reserve(text.length() + text.length() / 4);
+			encoded.append(text, copied, charIndex - copied);
+			encoded += '&';
+			encoded.append(encodedEntity.begin(), encodedEntity.end());
+			encoded += ';';
+			copied = pos;
+			++result;
+		}
+	} catch (...) {
+		return 0;
+	}
+
+	if (result > 0) {
+		encoded.append(text, copied, Str_T::npos);
+		text.swap(encoded);
+	}
+	return result;
+}
+// --------------------------------------------------------------------------------------
+/// Replaces entities in @p target with the characters they stand for; works on UTF-8 bytes or wide text
+template <typename Str_T>
+int doDecodeEntities(Str_T &target, Entities::EntityList const &entities) {
+	int result = 0;
+	size_t charIndex = target.find('&');
+
+	// Make sure the selection includes the semicolon
+	if (target.find(';', charIndex) == Str_T::npos)
+		return result;
+
+	Str_T decoded, character;
+	size_t copied = 0;
+
+	try {
+		while (charIndex != Str_T::npos) {
+			char32_t codePoint = 0, lowSurrogate = 0;
+			size_t nextIndex = 0, afterLowSurrogate = 0;
+
+			if (parseEntity(target, charIndex, entities, codePoint, nextIndex)) {
+				// Join a pair of surrogate references into the character they encode
+				if (codePoint >= 0xD800 && codePoint <= 0xDBFF && nextIndex < target.length() && target[nextIndex] == '&' &&
+				    parseEntity(target, nextIndex, entities, lowSurrogate, afterLowSurrogate) &&
+				    lowSurrogate >= 0xDC00 && lowSurrogate <= 0xDFFF) {
+					codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (lowSurrogate - 0xDC00);
+					nextIndex = afterLowSurrogate;
+				}
+
+				character.clear();
+				if (TextConv::appendCodePoint(character, codePoint)) {
+					decoded.append(target, copied, charIndex - copied);
+					decoded += character;
+					copied = nextIndex;
+					++result;
+					charIndex = target.find('&', nextIndex);
+					continue;
+				}
+			}
+
+			charIndex = target.find('&', charIndex + 1);
+		}
+	} catch (...) {
+		return 0;
+	}
+
+	if (result > 0) {
+		decoded.append(target, copied, Str_T::npos);
+		target.swap(decoded);
+	}
+	return result;
+}
+// --------------------------------------------------------------------------------------
+/// Reads the entity starting with the ampersand at @p charIndex; a name doesn't need its semicolon if it's
+/// followed by some other delimiter
+template <typename Str_T>
+bool parseEntity(Str_T const &target, size_t charIndex, Entities::EntityList const &entities, char32_t &codePoint,
+    size_t &nextIndex) {
+	using UChar_T = std::make_unsigned_t<typename Str_T::value_type>;
+	const size_t firstPos = charIndex + 1;
+	size_t lastPos = firstPos;
+	bool isNumeric = false, isHex = false, isDelimited = false;
+	std::wstring allowedChars;
+
+	for (size_t i = 1; i < target.length() - firstPos; i++) {
+		if (i == 1) {
+			if (target[firstPos] == '#') {
+				isNumeric = true;
+				allowedChars.append(L"x").append(Entities::scDigits);
+			} else
+				allowedChars.append(Entities::scLetters).append(L";");
+		} else if (i == 2) {
+			if (isNumeric) {
+				if (target[firstPos + 1] == 'x') {
+					isHex = true;
+					allowedChars.append(Entities::scHexLetters).append(L";");
+				} else
+					allowedChars.append(Entities::scDigits).append(L";");
+			}
+		}
+
+		const auto ch = static_cast<UChar_T>(target[firstPos + i]);
+		if (ch > 127 || allowedChars.find(static_cast<wchar_t>(ch)) == std::wstring::npos) {
+			// Invalid char found
+			lastPos = firstPos + i - 1;
+			nextIndex = firstPos + i;
+			isDelimited = true;
+			break;
+		} else if (ch == ';') {
+			// End found
+			lastPos = firstPos + i - 1;
+			nextIndex = firstPos + i + 1;
+			isDelimited = true;
+			break;
+		}
+	}
+
+	if (!isDelimited)
+		return false;
+
+	std::string code;
+	for (size_t i = firstPos + (isHex ? 2 : isNumeric ? 1 : 0); i <= lastPos; i++)
+		code += static_cast<char>(target[i]);
+
+	if (isNumeric)
+		codePoint = toCodePoint(code, isHex ? 16 : 10);
+	else {
+		std::string const &entity = entities[code];
+		codePoint = entity.empty() ? 0 : toCodePoint(entity, 10);
+	}
+
+	return codePoint != 0;
+}
+// --------------------------------------------------------------------------------------
+/// Escapes every non-ASCII character in @p text; astral characters become a pair of surrogate escapes
+template <typename Str_T>
+int doEncodeEscapes(Str_T &text, Str_T const &prefix) {
+	int result = 0;
+	Str_T encoded;
+	size_t copied = 0;
+
+	auto appendEscape = [&prefix, &encoded](char32_t unit) {
+		char hexDigits[8]{};
+		const int nDigits = std::snprintf(hexDigits, sizeof(hexDigits), "%04X", static_cast<unsigned>(unit));
+		encoded += prefix;
+		encoded.append(hexDigits, hexDigits + nDigits);
+	};
+
+	for (size_t pos = 0; pos < text.length();) {
+		const size_t chIndex = pos;
+		const char32_t charCode = TextConv::nextCodePoint(text, pos);
+		if (charCode <= 127 || charCode == TextConv::invalidCodePoint)
+			continue;
+
+		if (result == 0)
+			encoded.reserve(text.length() * 2);
+		encoded.append(text, copied, chIndex - copied);
+		if (charCode > 0xFFFF) {
+			appendEscape(0xD800 + ((charCode - 0x10000) >> 10));
+			appendEscape(0xDC00 + ((charCode - 0x10000) & 0x3FF));
+			result += 2;
+		} else {
+			appendEscape(charCode);
+			++result;
+		}
+		copied = pos;
+	}
+
+	if (result > 0) {
+		encoded.append(text, copied, Str_T::npos);
+		text.swap(encoded);
+	}
+	return result;
+}
+// --------------------------------------------------------------------------------------
+/// Replaces each @p prefix followed by 4 to 6 hex digits with the character it stands for; a pair of surrogate
+/// escapes becomes one character, and a lone surrogate is left alone
+template <typename Str_T>
+int doDecodeEscapes(Str_T &text, Str_T const &prefix) {
+	int result = 0;
+	if (prefix.empty())
+		return result;
+
+	Str_T decoded;
+	size_t copied = 0;
+
+	for (size_t escIndex = text.find(prefix); escIndex != Str_T::npos;) {
+		char32_t codePoint = 0, lowSurrogate = 0;
+		size_t nextIndex = escIndex + prefix.length();
+		const size_t nDigits = parseEscape(text, nextIndex, 6, codePoint);
+		nextIndex += nDigits;
+
+		if (nDigits >= 4 && codePoint >= 0xD800 && codePoint <= 0xDBFF &&
+		    text.compare(nextIndex, prefix.length(), prefix) == 0 &&
+		    parseEscape(text, nextIndex + prefix.length(), 4, lowSurrogate) == 4 && lowSurrogate >= 0xDC00 &&
+		    lowSurrogate <= 0xDFFF) {
+			codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (lowSurrogate - 0xDC00);
+			nextIndex += prefix.length() + 4;
+		}
+
+		if (nDigits >= 4 && !(codePoint >= 0xD800 && codePoint <= 0xDFFF)) {
+			const size_t decodedLen = decoded.length();
+			decoded.append(text, copied, escIndex - copied);
+			if (TextConv::appendCodePoint(decoded, codePoint)) {
+				copied = nextIndex;
+				++result;
+				escIndex = text.find(prefix, nextIndex);
+				continue;
+			}
+			decoded.resize(decodedLen);
+		}
+		escIndex = text.find(prefix, escIndex + 1);
+	}
+
+	if (result > 0) {
+		decoded.append(text, copied, Str_T::npos);
+		text.swap(decoded);
+	}
+	return result;
+}
+// --------------------------------------------------------------------------------------
+/// Reads up to @p maxDigits hex digits (of either case) at @p pos; returns how many there were
+template <typename Str_T>
+size_t parseEscape(Str_T const &text, size_t pos, size_t maxDigits, char32_t &value) noexcept {
+	size_t nDigits = 0;
+	value = 0;
+	for (; nDigits < maxDigits && pos + nDigits < text.length(); ++nDigits) {
+		const auto ch = static_cast<char32_t>(text[pos + nDigits]);
+		char32_t digit = 0;
+		if (ch >= '0' && ch <= '9')
+			digit = ch - '0';
+		else if ((ch | 0x20) >= 'a' && (ch | 0x20) <= 'f')
+			digit = (ch | 0x20) - 'a' + 10;
+		else
+			break;
+		value = (value << 4) | digit;
+	}
+	return nDigits;
+}
+// --------------------------------------------------------------------------------------
+char32_t toCodePoint(std::string const &digits, int base) {
+	if (digits.empty())
+		return 0;
+	char *end = nullptr;
+	const unsigned long value = std::strtoul(digits.c_str(), &end, base);
+	return (end == digits.c_str() || value > 0x10FFFF) ? 0 : static_cast<char32_t>(value);
+}
+}
@@ -0,0 +1,267 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#include <unordered_map>
+#include "Unicode.h"
+#include "DeferredDecoder.h"
+
+using namespace HtmlTag;
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+struct DirtySpan {
+	Sci_Position startPos;
+	Sci_Position endPos;
+};
+
+struct TrackedText {
+	std::vector<DirtySpan> spans;
+	/// The document's length as of the last edit seen; if it differs on return from the background, the spans
+	/// are out of date
+	Sci_Position docLength = 0;
+};
+
+void armIdleTimer();
+void disarmIdleTimer();
+bool isInputPending();
+Sci_Position tokenStart(SciActiveDocument const &doc, Sci_Position pos);
+
+// The longest named entity is "&CounterClockwiseContourIntegral;"
+constexpr Sci_Position maxTokenLength = 40;
+std::unordered_map<uintptr_t, TrackedText> trackedBuffers;
+uintptr_t activeBufferId = 0;
+UINT_PTR idleTimerId = 0;
+bool isDecoding = false;
+}
+
+// --------------------------------------------------------------------------------------
+// HtmlTag::DeferredDecoder
+// --------------------------------------------------------------------------------------
+void DeferredDecoder::track(Sci_Position startPos, Sci_Position endPos) {
+	activeBufferId = static_cast<uintptr_t>(plugin.sendNppMessage(NPPM_GETCURRENTBUFFERID));
+	TrackedText &tracked = trackedBuffers[activeBufferId];
+	std::vector<DirtySpan> &dirtySpans = tracked.spans;
+	tracked.docLength = plugin.editor().activeDocument().length();
+
+	// Keep spans sorted and merge the ones that touch
+	auto it = std::lower_bound(dirtySpans.begin(), dirtySpans.end(), startPos,
+	    [](DirtySpan const &span, Sci_Position pos) { return span.endPos < pos; });
+	if (it == dirtySpans.end() || it->startPos > endPos) {
+		dirtySpans.insert(it, DirtySpan{ startPos, endPos });
+	} else {
+		it->startPos = (std::min)(it->startPos, startPos);
+		it->endPos = (std::max)(it->endPos, endPos);
+		auto next = it + 1;
+		while (next != dirtySpans.end() && next->startPos <= it->endPos) {
+			it->endPos = (std::max)(it->endPos, next->endPos);
+			next = dirtySpans.erase(next);
+			it = next - 1;
+		}
+	}
+
+	armIdleTimer();
+}
+// --------------------------------------------------------------------------------------
+void DeferredDecoder::update(SCNotification const *scn) {
+	// Edits made by a walk over all buffers can't be told apart; activate() drops what they made stale
+	if (isDecoding || plugin.editor().walkingBuffers())
+		return;
+	auto tracked = trackedBuffers.find(activeBufferId);
+	if (tracked == trackedBuffers.end())
+		return;
+
+	std::vector<DirtySpan> &dirtySpans = tracked->second.spans;
+	if (scn->modificationType & SC_MOD_INSERTTEXT) {
+		tracked->second.docLength += scn->length;
+		for (auto &&span : dirtySpans) {
+			if (span.startPos > scn->position)
+				span.startPos += scn->length;
+			if (span.endPos >= scn->position)
+				span.endPos += scn->length;
+		}
+	} else if (scn->modificationType & SC_MOD_DELETETEXT) {
+		tracked->second.docLength -= scn->length;
+		const Sci_Position deletedEnd = scn->position + scn->length;
+		auto shift = [scn, deletedEnd](Sci_Position &pos) {
+			if (pos >= deletedEnd)
+				pos -= scn->length;
+			else if (pos > scn->position)
+				pos = scn->position;
+		};
+		for (auto it = dirtySpans.begin(); it != dirtySpans.end();) {
+			shift(it->startPos);
+			shift(it->endPos);
+			if (it->endPos <= it->startPos)
+				it = dirtySpans.erase(it);
+			else
+				++it;
+		}
+	}
+}
+// --------------------------------------------------------------------------------------
+int DeferredDecoder::flush(bool completedOnly) {
+	disarmIdleTimer();
+	auto tracked = trackedBuffers.find(activeBufferId);
+	if (tracked == trackedBuffers.end())
+		return 0;
+
+	// If another buffer is showing, the spans wait until theirs is active again
+	if (static_cast<uintptr_t>(plugin.sendNppMessage(NPPM_GETCURRENTBUFFERID)) != activeBufferId)
+		return 0;
+
+	std::vector<DirtySpan> &dirtySpans = tracked->second.spans;
+	if (dirtySpans.empty()) {
+		trackedBuffers.erase(tracked);
+		return 0;
+	}
+
+	SciActiveDocument doc = plugin.editor().activeDocument();
+	// Never overwrite a selection the user is working with; try again later
+	if (doc.currentSelection() || doc.getSelectionMode() != smStreamSingle) {
+		if (completedOnly)
+			armIdleTimer();
+		return 0;
+	}
+
+	const Sci_Position initialCaret = doc.currentPosition();
+	const Sci_Position initialLength = doc.length();
+	Sci_Position caret = initialCaret;
+	std::vector<DirtySpan> pending, leftover;
+
+	for (auto &&span : dirtySpans) {
+		DirtySpan target{ tokenStart(doc, span.startPos), span.endPos };
+		if (completedOnly && target.startPos <= caret && caret <= target.endPos) {
+			// The token at the caret may still be growing
+			const Sci_Position caretToken = tokenStart(doc, caret);
+			if (caretToken < target.endPos)
+				leftover.push_back(DirtySpan{ caretToken, target.endPos });
+			target.endPos = caretToken;
+		}
+		if (target.endPos > target.startPos)
+			pending.push_back(target);
+	}
+
+	int result = 0;
+	bool cancelled = false;
+	isDecoding = true;
+	try {
+		SciBulkEdit bulkEdit{ doc };
+		// Work back to front so the positions of pending spans stay valid
+		for (auto span = pending.rbegin(); span != pending.rend(); ++span) {
+			if (completedOnly && isInputPending()) {
+				cancelled = true;
+				break;
+			}
+
+			Sci_Position endPos = span->endPos;
+			if (plugin.options.liveEntityDecoding) {
+				doc.select(span->startPos, endPos - span->startPos);
+				result += Entities::decode();
+				endPos = doc.currentPosition();
+			}
+			if (plugin.options.liveUnicodeDecoding) {
+				doc.select(span->startPos, endPos - span->startPos);
+				result += Unicode::decode();
+				endPos = doc.currentPosition();
+			}
+
+			const Sci_Position delta = endPos - span->endPos;
+			if (caret >= span->endPos)
+				caret += delta;
+			else if (caret > span->startPos)
+				caret = (std::min)(caret, endPos);
+			for (auto &&rest : leftover) {
+				if (span->endPos <= rest.startPos) {
+					rest.startPos += delta;
+					rest.endPos += delta;
+				}
+			}
+		}
+	} catch (...) {
+		cancelled = true;
+	}
+
+	if (cancelled) {
+		// Roll back the partial batch and retry it later; the user's keystrokes come first
+		if (result > 0 || doc.length() != initialLength)
+			doc.sendMessage(SCI_UNDO);
+		doc.currentPosition(initialCaret);
+		result = 0;
+		armIdleTimer();
+	} else {
+		dirtySpans.swap(leftover);
+		doc.currentPosition(caret);
+	}
+	isDecoding = false;
+	tracked->second.docLength = doc.length();
+	if (dirtySpans.empty())
+		trackedBuffers.erase(tracked);
+
+	return result;
+}
+// --------------------------------------------------------------------------------------
+int DeferredDecoder::flushBeforeSave(uintptr_t bufferId) {
+	return (bufferId == activeBufferId) ? flush() : 0;
+}
+// --------------------------------------------------------------------------------------
+void DeferredDecoder::activate(uintptr_t bufferId) {
+	disarmIdleTimer();
+	activeBufferId = bufferId;
+	auto tracked = trackedBuffers.find(bufferId);
+	if (tracked == trackedBuffers.end())
+		return;
+
+	if (tracked->second.docLength != plugin.editor().activeDocument().length())
+		trackedBuffers.erase(tracked);
+	else
+		armIdleTimer();
+}
+// --------------------------------------------------------------------------------------
+void DeferredDecoder::forget(uintptr_t bufferId) {
+	trackedBuffers.erase(bufferId);
+	if (bufferId == activeBufferId)
+		disarmIdleTimer();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+void CALLBACK idleTimerProc(HWND /*unnamedParam1*/, UINT /*unnamedParam2*/, UINT_PTR eventID, DWORD /*unnamedParam4*/) {
+	::KillTimer(0, eventID);
+	if (eventID != idleTimerId)
+		return;
+
+	idleTimerId = 0;
+	DeferredDecoder::flush(true);
+}
+// --------------------------------------------------------------------------------------
+void armIdleTimer() {
+	disarmIdleTimer();
+	idleTimerId = ::SetTimer(0, 0, plugin.options.idleDecodingDelay, TIMERPROC(&idleTimerProc));
+}
+// --------------------------------------------------------------------------------------
+void disarmIdleTimer() {
+	if (idleTimerId != 0) {
+		::KillTimer(0, idleTimerId);
+		idleTimerId = 0;
+	}
+}
+// --------------------------------------------------------------------------------------
+bool isInputPending() {
+	return HIWORD(::GetQueueStatus(QS_KEY | QS_MOUSEBUTTON)) != 0;
+}
+// --------------------------------------------------------------------------------------
+Sci_Position tokenStart(SciActiveDocument const &doc, Sci_Position pos) {
+	const Sci_Position limit = (std::max)(Sci_Position(0), pos - maxTokenLength);
+	while (pos > limit) {
+		int ch = static_cast<int>(doc.sendMessage(SCI_GETCHARAT, pos - 1));
+		if (ch >= 0 && ch <= 0x20)
+			break;
+		--pos;
+	}
+	return pos;
+}
+}
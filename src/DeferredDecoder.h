@@ -0,0 +1,34 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#ifndef HTMLTAG_DEFERRED_DECODER_H
+#define HTMLTAG_DEFERRED_DECODER_H
+
+#include "HtmlTag.h"
+
+namespace HtmlTag {
+/// Decodes live entities and escapes in batches, when the editor is idle or a file is about to be saved
+namespace DeferredDecoder {
+	/// @brief Marks the text between @p startPos and @p endPos for decoding, and restarts the idle timer.
+	void track(Sci_Position startPos, Sci_Position endPos);
+	/// @brief Keeps tracked text in sync with edits reported by @c SCN_MODIFIED.
+	void update(SCNotification const *scn);
+	/// @brief Decodes all tracked text as a single undo action.
+	/// @param completedOnly Leave alone the token under the caret, and give up if user input arrives
+	/// @return The number of replacements made
+	int flush(bool completedOnly = false);
+	/// @brief Decodes the text tracked for @p bufferId if it's the active buffer, as it's about to be saved.
+	/// A background buffer keeps its text until it's next active.
+	int flushBeforeSave(uintptr_t bufferId);
+	/// @brief Picks up the text tracked for @p bufferId, now the active buffer, unless it was edited while in the
+	/// background; what was tracked for the buffer before it is kept for when that one's active again.
+	void activate(uintptr_t bufferId);
+	/// @brief Forgets the text tracked for @p bufferId, which is closing.
+	void forget(uintptr_t bufferId);
+}
+}
+#endif // ~HTMLTAG_DEFERRED_DECODER_H
@@ -6,190 +6,119 @@
   Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
   Original Pascal unit (c) Martijn Coppoolse <https://github.com/vor0nwe>
 */
-#include "TextConv.h"
 #include "HtmlTag.h"
 #include "Entities.h"
+#include "SlicedReplacement.h"
 
 using namespace HtmlTag;
 
-/////////////////////////////////////////////////////////////////////////////////////////
-namespace {
-int doEncode(std::wstring &text, EntityList &entities, bool includeLineBreaks);
-}
-
 // --------------------------------------------------------------------------------------
 // HtmlTag::Entities
 // --------------------------------------------------------------------------------------
 void Entities::encode(EntityReplacementScope scope, bool includeLineBreaks) {
-	EntityList entities{};
-	plugin.getEntities(entities);
+	SpanTrace::Span span{ "Entities::encode", "replace" };
+	EntityList const &entities = plugin.getEntities();
+
+	// Encoding a rectangular or multiple selection would scramble it
+	if (plugin.editor().activeDocument().getSelectionMode() != smStreamSingle)
+		return;
 
 	switch (scope) {
 		case EntityReplacementScope::ersDocument: {
+			auto encodeRange = [&entities, includeLineBreaks](SciTextRange &range) {
+				return range.transformText([&](auto &text) { return encodeText(text, entities, includeLineBreaks); });
+			};
+			if (SlicedReplacement::start(encodeRange, {}))
+				break;
 			SciActiveDocument doc = plugin.editor().activeDocument();
+			if (!plugin.confirmCopy(doc.length()))
+				break;
 			SciTextRange range = doc.getRange(0, doc.length());
-			std::wstring text{ range.text() };
-			if (doEncode(text, entities, includeLineBreaks) > 0)
-				range = text;
+			encodeRange(range);
 			break;
 		}
 
 		case EntityReplacementScope::ersAllDocuments: {
-			for (size_t docIndex = 0; docIndex < plugin.editor().getViews().size(); docIndex++) {
-				SciActiveDocument doc = plugin.editor().getViews()[docIndex];
+			plugin.forEachBuffer([includeLineBreaks](SciActiveDocument &doc, uintptr_t bufferId) {
+				EntityList const &bufferEntities = plugin.getEntities(bufferId);
+				if (!plugin.confirmCopy(doc.length()))
+					return;
 				SciTextRange range = doc.getRange(0, doc.length());
-				std::wstring text{ range.text() };
-				if (doEncode(text, entities, includeLineBreaks) > 0)
-					range = text;
-			}
+				range.transformText(
+				    [&](auto &text) { return encodeText(text, bufferEntities, includeLineBreaks); });
+			});
 			break;
 		}
 
 		default: { // ersSelection
 			SciActiveDocument doc = plugin.editor().activeDocument();
-			std::wstring text{ doc.currentSelection().text() };
-			if (doEncode(text, entities, includeLineBreaks) > 0) {
-				doc.currentSelection() = text;
-				doc.currentSelection().clearSelection();
-			}
+			SciSelection &selection = doc.currentSelection();
+			if (!plugin.confirmCopy(selection.length()))
+				break;
+			if (selection.transformText([&](auto &text) { return encodeText(text, entities, includeLineBreaks); }) > 0)
+				selection.clearSelection();
 			break;
 		}
 	}
 }
 // --------------------------------------------------------------------------------------
-int Entities::decode() {
+int Entities::decode(EntityReplacementScope scope) {
+	SpanTrace::Span span{ "Entities::decode", "replace" };
 	int result = 0;
-	SciActiveDocument doc = plugin.editor().activeDocument();
-	EntityList entities{};
-	plugin.getEntities(entities);
-
-	if (!entities || doc.getSelectionMode() != smStreamSingle)
-		return result;
-
-	std::wstring target{ doc.currentSelection().text() };
-	size_t charIndex = target.find(L'&');
+	EntityList const &entities = plugin.getEntities();
 
-	// Make sure the selection includes the semicolon
-	if (target.find(L';', charIndex) == std::wstring::npos)
+	if (!entities)
 		return result;
 
-	try {
-		while (charIndex != std::string::npos) {
-			size_t firstPos = charIndex + 1;
-			size_t lastPos = firstPos;
-			size_t nextIndex = target.length() + 1;
-			bool isNumeric = false, isHex = false;
-			std::wstringstream allowedChars;
+	switch (scope) {
+		case EntityReplacementScope::ersDocument: {
+			auto decodeRange = [&entities](SciTextRange &range) {
+				return range.transformText([&](auto &text) { return decodeText(text, entities); });
+			};
+			SliceCuts::Tokens references{ "&",
+				[&entities](std::string_view text, size_t cut) { return splitsReference(text, cut, entities); } };
+			if (SlicedReplacement::start(decodeRange, references))
+				break;
+			SciActiveDocument doc = plugin.editor().activeDocument();
+			if (!plugin.confirmCopy(doc.length()))
+				break;
+			SciTextRange range = doc.getRange(0, doc.length());
+			result = decodeRange(range);
+			break;
+		}
 
-			for (size_t i = 1; i < target.length() - firstPos; i++) {
-				if (i == 1) {
-					if (target[firstPos] == L'#') {
-						isNumeric = true;
-						allowedChars << L"x" << scDigits;
-					} else
-						allowedChars << scLetters << L";";
-				} else if (i == 2) {
-					if (isNumeric) {
-						if (target[firstPos + 1] == L'x') {
-							isHex = true;
-							allowedChars << scHexLetters << L";";
-						} else
-							allowedChars << scDigits << L";";
-					}
-				}
+		case EntityReplacementScope::ersAllDocuments: {
+			plugin.forEachBuffer([&result](SciActiveDocument &doc, uintptr_t bufferId) {
+				EntityList const &bufferEntities = plugin.getEntities(bufferId);
+				if (!plugin.confirmCopy(doc.length()))
+					return;
+				SciTextRange range = doc.getRange(0, doc.length());
+				result += range.transformText([&](auto &text) { return decodeText(text, bufferEntities); });
+			});
+			break;
+		}
 
-				if (allowedChars.str().find(target[firstPos + i]) == std::wstring::npos) {
-					// Invalid char found
-					lastPos = firstPos + i - 1;
-					nextIndex = firstPos + i;
-					break;
-				} else if (target[firstPos + i] == L';') {
-					// End found
-					lastPos = firstPos + i - 1;
-					nextIndex = firstPos + i + 1;
+		default: { // ersSelection
+			SciActiveDocument doc = plugin.editor().activeDocument();
+			if (doc.getSelectionMode() == smStreamSingle) {
+				SciSelection &selection = doc.currentSelection();
+				if (!plugin.confirmCopy(selection.length()))
 					break;
-				}
-			}
-
-			int codePoint = 0;
-			bool isValid = false;
-
-			if (isNumeric) {
-				if (isHex) {
-					std::wstring hexStr = target.substr(firstPos + 2, lastPos - firstPos - 1);
-					codePoint = std::stoi(hexStr, nullptr, 16);
-					isValid = (codePoint != 0);
-				} else {
-					std::wstring numStr = target.substr(firstPos + 1, lastPos - firstPos);
-					codePoint = std::stoi(numStr);
-					isValid = (codePoint != 0);
-				}
+				result = selection.transformText([&](auto &text) { return decodeText(text, entities); });
+				if (result > 0)
+					selection.clearSelection();
 			} else {
-				std::string entityCodeStr;
-				std::wstring entityCode = target.substr(firstPos, lastPos - firstPos + 1);
-				TextConv::textToBytes(entityCode.c_str(), entityCodeStr, CP_ACP);
-				std::string entity = entities[entityCodeStr];
-				if (!entity.empty()) {
-					codePoint = std::stoi(entity);
-					isValid = (codePoint != 0);
-				} else {
-					codePoint = 0;
-					isValid = false;
+				// Work back to front so the positions of earlier selections stay valid
+				std::vector<SciTextRange> ranges = doc.getSelections();
+				SciBulkEdit bulkEdit{ doc };
+				for (auto range = ranges.rbegin(); range != ranges.rend(); ++range) {
+					if (*range)
+						result += range->transformText([&](auto &text) { return decodeText(text, entities); });
 				}
 			}
-
-			if (isValid) {
-				target = target.substr(0, firstPos - 1) + static_cast<wchar_t>(codePoint) +
-					 target.substr(nextIndex);
-				++result;
-			}
-
-			charIndex = target.find(L'&', firstPos);
-		}
-	} catch (...) {
-	}
-
-	if (result > 0) {
-		doc.currentSelection() = target;
-		doc.currentSelection().clearSelection();
-	}
-
-	return result;
-}
-
-/////////////////////////////////////////////////////////////////////////////////////////
-namespace {
-int doEncode(std::wstring &text, Entities::EntityList &entities, bool includeLineBreaks) {
-	int result = 0;
-	SciActiveDocument doc = plugin.editor().activeDocument();
-
-	if (!entities || doc.getSelectionMode() != smStreamSingle)
-		return result;
-
-	std::wstring encodedEntity;
-	bool didReplace = false;
-
-	try {
-		for (intptr_t chIndex = text.length() - 1; chIndex >= 0; chIndex--) {
-			const std::wint_t charCode = text[chIndex];
-			std::string entity = entities[std::to_string(charCode)];
-			if (!entity.empty()) {
-				didReplace = true;
-				TextConv::bytesToText(entity.c_str(), encodedEntity);
-			} else if (charCode > 127 || (includeLineBreaks && (charCode == L'\n' || charCode == L'\r'))) {
-				didReplace = true;
-				encodedEntity = L"#" + std::to_wstring(charCode);
-			} else
-				didReplace = false;
-
-			if (didReplace) {
-				text = text.substr(0, chIndex) + L'&' + encodedEntity + L';' + text.substr(chIndex + 1);
-				++result;
-			}
+			break;
 		}
-	} catch (...) {
 	}
 
 	return result;
 }
-}
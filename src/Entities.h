@@ -9,6 +9,7 @@
 #define HTMLTAG_ENTITIES_H
 
 #include <map>
+#include <string_view>
 #include "HashedStringList.h"
 
 namespace HtmlTag {
@@ -22,8 +23,20 @@ namespace Entities {
 	constexpr wchar_t scHexLetters[] = L"ABCDEFabcdef";
 	constexpr wchar_t scLetters[] = L"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
 
-	int decode();
+	int decode(EntityReplacementScope scope = ersSelection);
 	void encode(EntityReplacementScope scope = ersSelection, bool includeLineBreaks = false);
+
+	/// @brief Replaces the characters in @p text that have entities, or are non-ASCII, with character references.
+	/// @return The number of replacements made
+	int encodeText(std::string &text, EntityList const &entities, bool includeLineBreaks = false);
+	int encodeText(std::wstring &text, EntityList const &entities, bool includeLineBreaks = false);
+	/// @brief Replaces the named and numeric character references in @p text with the characters they stand for.
+	/// @return The number of replacements made
+	int decodeText(std::string &text, EntityList const &entities);
+	int decodeText(std::wstring &text, EntityList const &entities);
+	/// @brief Whether @c decodeText reads the references either side of @p cut in @p text as one: a pair of
+	/// surrogates, or a reference without a semicolon, which only the next one delimits.
+	bool splitsReference(std::string_view text, size_t cut, EntityList const &entities);
 }
 }
 #endif // ~HTMLTAG_ENTITIES_H
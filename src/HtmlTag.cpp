@@ -5,15 +5,24 @@
 
   Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
 */
-#include <regex>
 #include <fstream>
+#include <sstream>
+#include <ctime>
+#include <chrono>
+#include <iomanip>
+#include <commctrl.h>
 
 #define SI_SUPPORT_IOSTREAMS /* CSimpleIniTempl<...>::LoadData(std::istream &) */
 
 #include "SimpleIni.h"
+#include "AllocationStats.h"
+#include "LatencyHistogram.h"
+#include "SpanTrace.h"
 #include "TextConv.h"
 #include "TagFinder.h"
 #include "Unicode.h"
+#include "DeferredDecoder.h"
+#include "SlicedReplacement.h"
 #include "AboutDlg.h"
 #include "HtmlTag.h"
 
@@ -24,14 +33,44 @@ namespace fs = std::filesystem;
 /////////////////////////////////////////////////////////////////////////////////////////
 namespace {
 enum DecodeCmd { dcAuto = -1, dcEntity, dcUnicode };
-enum CmdMenuPosition { cmpUnicode = 3, cmpEntities };
+/// Indices into the plugin menu; Notepad++ keys custom shortcuts to them, so new commands only ever go at the end
+enum CmdMenuPosition { cmpEntities = 12, cmpUnicode = 13, cmpLargeFiles = 24 };
+
+using Replacer = int (*)(EntityReplacementScope);
 
 bool autoCompleteMatchingTag(const Sci_Position startPos, const char *tagName);
 void findAndDecode(const int keyCode, DecodeCmd cmd = dcAuto);
+void replaceAndReport(Replacer replacer, EntityReplacementScope scope);
+void loadLatencies();
+void saveLatencies();
+std::string today();
+std::string timestamp();
+std::wstring megabytes(Sci_Position bytes);
 
 constexpr char defaultUnicodePrefix[] = R"(\u)";
+constexpr unsigned defaultIdleDecodingDelay = 750;
 constexpr wchar_t menuItemSeparator[] = L"-";
 std::unique_ptr<AboutDlg> aboutHtmlTag = nullptr;
+
+/// Times one menu command and charges its editor messages and memory use to it,
+/// saving them to the traces folder if the options say so;
+/// also the outermost span of the command's trace events
+class CommandTrace final {
+
+public:
+	explicit CommandTrace(const char *command);
+	~CommandTrace();
+	CommandTrace(const CommandTrace &) = delete;
+	CommandTrace &operator=(const CommandTrace &) = delete;
+
+private:
+	SciMessageStats::Command _stats;
+	SpanTrace::Span _span;
+	AllocationStats::Scope _memory;
+	std::unique_ptr<SciMessageRecorder> _recorder;
+	LatencyHistogram &_latency;
+	LatencyHistogram::Clock::time_point _started;
+};
 }
 
 #define CMDMENUPROC extern "C" void __cdecl
@@ -47,53 +86,92 @@ std::unique_ptr<AboutDlg> aboutHtmlTag = nullptr;
 // --------------------------------------------------------------------------------------
 CMDMENUPROC commandFindMatchingTag() {
 	CHECKCOMPATIBLE
+	CommandTrace trace{ "find_matching_tag" };
 	TagFinder::findMatchingTag();
 }
 // --------------------------------------------------------------------------------------
 CMDMENUPROC commandSelectMatchingTags() {
 	CHECKCOMPATIBLE
+	CommandTrace trace{ "select_matching_tags" };
 	TagFinder::findMatchingTag(soTags);
 }
 // --------------------------------------------------------------------------------------
 CMDMENUPROC commandSelectTagContents() {
 	CHECKCOMPATIBLE
+	CommandTrace trace{ "select_tag_and_contents" };
 	TagFinder::findMatchingTag(soTags | soContents);
 }
 // --------------------------------------------------------------------------------------
 CMDMENUPROC commandSelectTagContentsOnly() {
 	CHECKCOMPATIBLE
+	CommandTrace trace{ "select_tag_contents" };
 	TagFinder::findMatchingTag(soContents);
 }
 // --------------------------------------------------------------------------------------
+CMDMENUPROC commandCheckTagBalance() {
+	CHECKCOMPATIBLE
+	CommandTrace trace{ "check_tag_balance" };
+	TagFinder::checkTagBalance();
+}
+// --------------------------------------------------------------------------------------
 CMDMENUPROC commandEncodeEntities() {
 	CHECKCOMPATIBLE
+	CommandTrace trace{ "encode_entities" };
 	Entities::encode();
 }
 // --------------------------------------------------------------------------------------
 CMDMENUPROC commandEncodeEntitiesInclLineBreaks() {
 	CHECKCOMPATIBLE
+	CommandTrace trace{ "encode_entities_incl_line_breaks" };
 	Entities::encode(EntityReplacementScope::ersSelection, true);
 }
 // --------------------------------------------------------------------------------------
 CMDMENUPROC commandDecodeEntities() {
 	CHECKCOMPATIBLE
+	CommandTrace trace{ "decode_entities" };
 	if (!plugin.editor().activeDocument().currentSelection())
 		findAndDecode(0, dcEntity);
 	else
-		Entities::decode();
+		replaceAndReport(Entities::decode, ersSelection);
+}
+// --------------------------------------------------------------------------------------
+CMDMENUPROC commandDecodeEntitiesInDocument() {
+	CHECKCOMPATIBLE
+	CommandTrace trace{ "decode_entities_in_document" };
+	replaceAndReport(Entities::decode, ersDocument);
+}
+// --------------------------------------------------------------------------------------
+CMDMENUPROC commandDecodeEntitiesInAllDocuments() {
+	CHECKCOMPATIBLE
+	CommandTrace trace{ "decode_entities_in_all_documents" };
+	replaceAndReport(Entities::decode, ersAllDocuments);
 }
 // --------------------------------------------------------------------------------------
 CMDMENUPROC commandEncodeJS() {
 	CHECKCOMPATIBLE
+	CommandTrace trace{ "encode_unicode" };
 	Unicode::encode();
 }
 // --------------------------------------------------------------------------------------
 CMDMENUPROC commandDecodeJS() {
 	CHECKCOMPATIBLE
+	CommandTrace trace{ "decode_unicode" };
 	if (!plugin.editor().activeDocument().currentSelection())
 		findAndDecode(0, dcUnicode);
 	else
-		Unicode::decode();
+		replaceAndReport(Unicode::decode, ersSelection);
+}
+// --------------------------------------------------------------------------------------
+CMDMENUPROC commandDecodeJSInDocument() {
+	CHECKCOMPATIBLE
+	CommandTrace trace{ "decode_unicode_in_document" };
+	replaceAndReport(Unicode::decode, ersDocument);
+}
+// --------------------------------------------------------------------------------------
+CMDMENUPROC commandDecodeJSInAllDocuments() {
+	CHECKCOMPATIBLE
+	CommandTrace trace{ "decode_unicode_in_all_documents" };
+	replaceAndReport(Unicode::decode, ersAllDocuments);
 }
 // --------------------------------------------------------------------------------------
 CMDMENUPROC toggleLiveEntityecoding() {
@@ -104,6 +182,55 @@ CMDMENUPROC toggleLiveUnicodeDecoding() {
 	plugin.toggleOption(&plugin.options.liveUnicodeDecoding, CmdMenuPosition::cmpUnicode);
 }
 // --------------------------------------------------------------------------------------
+CMDMENUPROC commandLargeFileMode() {
+	const Sci_Position length = plugin.editor().activeDocument().length();
+	std::wstring status = plugin.formatMessage(plugin.largeFileMode() ? L"msg_large_file_on" : L"msg_large_file_off",
+	    { megabytes(length), megabytes(plugin.options.largeFiles.minBytes) });
+	plugin.sendNppMessage(NPPM_SETSTATUSBAR, STATUSBAR_DOC_TYPE, &status[0]);
+}
+// --------------------------------------------------------------------------------------
+CMDMENUPROC commandPerformanceStats() {
+	path_t statsFile = plugin.optionsConfig.parent_path() / L"performance-stats.txt";
+	std::ofstream ofs(statsFile.c_str(), std::ios::out | std::ios::binary);
+	if (!ofs)
+		return;
+	const SciTextCacheStats textCache = SciTextRange::textCacheStats();
+	ofs << "HTML Tag performance statistics, " << today() << "\n\n";
+	LatencyHistogram::report(ofs);
+	ofs << "\nText cache: " << textCache.hits << " hits, " << textCache.misses << " misses\n";
+	if constexpr (AllocationStats::enabled) {
+		ofs << '\n';
+		AllocationStats::report(ofs);
+	}
+	ofs.close();
+	std::wstring fileName = statsFile.wstring();
+	plugin.openFile(&fileName[0]);
+}
+// --------------------------------------------------------------------------------------
+CMDMENUPROC commandMessageStats() {
+	path_t statsFile = plugin.optionsConfig.parent_path() / L"message-stats.txt";
+	std::ofstream ofs(statsFile.c_str(), std::ios::out | std::ios::binary);
+	if (!ofs)
+		return;
+	SciMessageStats::report(ofs);
+	ofs.close();
+	std::wstring fileName = statsFile.wstring();
+	plugin.openFile(&fileName[0]);
+}
+// --------------------------------------------------------------------------------------
+CMDMENUPROC commandSaveTraceEvents() {
+	std::error_code err;
+	fs::create_directories(plugin.traces, err);
+	path_t eventsFile = plugin.traces / ("spans-" + timestamp() + ".json");
+	std::ofstream ofs(eventsFile.c_str(), std::ios::out | std::ios::binary);
+	if (!ofs)
+		return;
+	const size_t nEvents = SpanTrace::flush(ofs);
+	ofs.close();
+	std::wstring status = plugin.formatMessage(L"msg_spans_saved", { std::to_wstring(nEvents), eventsFile.wstring() });
+	plugin.sendNppMessage(NPPM_SETSTATUSBAR, STATUSBAR_DOC_TYPE, &status[0]);
+}
+// --------------------------------------------------------------------------------------
 CMDMENUPROC commandAbout() {
 	aboutHtmlTag->show();
 }
@@ -127,6 +254,8 @@ void HtmlTagPlugin::setInfo(const NppData *data) {
 	entities = configPath / L"entities.ini";
 	translations = configPath / L"localizations.ini";
 	optionsConfig = configPath / L"options.ini";
+	traces = configPath / L"traces";
+	latencies = configPath / L"latency-histograms.txt";
 	std::error_code result;
 	if (!fs::exists(configPath))
 		fs::create_directory(configPath, result);
@@ -137,6 +266,9 @@ void HtmlTagPlugin::setInfo(const NppData *data) {
 
 	initMenu();
 	loadOptions();
+	if (options.savePerformanceStats)
+		loadLatencies();
+	SpanTrace::enable(options.traceSpans != FALSE);
 	aboutHtmlTag = std::make_unique<AboutDlg>(this->instance(), *data);
 }
 // --------------------------------------------------------------------------------------
@@ -144,6 +276,7 @@ void HtmlTagPlugin::beNotified(SCNotification *scn) {
 	if (scn->nmhdr.hwndFrom == plugin.editor().windowHandle()) {
 		switch (scn->nmhdr.code) {
 			case NPPN_READY:
+				largeFileMode();
 #ifdef _M_X64
 				if (!plugin.supportsBigFiles()) {
 					std::wstringstream caption;
@@ -154,10 +287,34 @@ void HtmlTagPlugin::beNotified(SCNotification *scn) {
 				}
 #endif
 				break;
-			case NPPN_FILESAVED:
-				if (sameText(currentBufferPath(scn->nmhdr.idFrom), this->translations))
+			case NPPN_FILEBEFORESAVE: {
+				static LatencyHistogram &latency = LatencyHistogram::named("on_file_before_save");
+				LatencyHistogram::Timer timer{ latency };
+				if (options.idleDecoding)
+					DeferredDecoder::flushBeforeSave(scn->nmhdr.idFrom);
+				break;
+			}
+			case NPPN_BUFFERACTIVATED: {
+				static LatencyHistogram &latency = LatencyHistogram::named("on_buffer_activated");
+				LatencyHistogram::Timer timer{ latency };
+				SciActiveDocument::invalidateText();
+				if (editor().walkingBuffers()) // forEachBuffer catches up once it's done
+					break;
+				DeferredDecoder::activate(scn->nmhdr.idFrom);
+				largeFileMode();
+				break;
+			}
+			case NPPN_FILESAVED: {
+				static LatencyHistogram &latency = LatencyHistogram::named("on_file_saved");
+				LatencyHistogram::Timer timer{ latency };
+				if (sameText(currentBufferPath(scn->nmhdr.idFrom).native(), this->translations.native()))
 					updateMenu();
 				break;
+			}
+			case NPPN_FILEBEFORECLOSE:
+				DeferredDecoder::forget(scn->nmhdr.idFrom);
+				SlicedReplacement::abandon(scn->nmhdr.idFrom);
+				break;
 			case NPPN_NATIVELANGCHANGED:
 				updateMenu();
 				break;
@@ -168,37 +325,63 @@ void HtmlTagPlugin::beNotified(SCNotification *scn) {
 	} else {
 		static bool isAutoCompletionCandidate = false;
 		switch (scn->nmhdr.code) {
-			case SCN_AUTOCSELECTION:
-				if (isAutoCompletionCandidate && autoCompleteMatchingTag(scn->position, scn->text))
+			case SCN_AUTOCSELECTION: {
+				static LatencyHistogram &latency = LatencyHistogram::named("on_autocompletion");
+				LatencyHistogram::Timer timer{ latency };
+				if (isAutoCompletionCandidate && !largeFileMode() &&
+				    autoCompleteMatchingTag(scn->position, scn->text))
 					plugin.editor().activeDocument().sendMessage(SCI_AUTOCCANCEL);
 				break;
+			}
 			case SCN_AUTOCSELECTIONCHANGE: // https://www.scintilla.org/ScintillaDoc.html#SCN_AUTOCSELECTIONCHANGE
 				isAutoCompletionCandidate = (scn->listType == 0);
 				break;
 			case SCN_USERLISTSELECTION:
 				isAutoCompletionCandidate = false;
+				TagFinder::jumpToProblem(scn->listType, scn->text);
 				break;
-			case SCN_CHARADDED:
+			case SCN_CHARADDED: {
+				static LatencyHistogram &latency = LatencyHistogram::named("on_char_added");
+				LatencyHistogram::Timer timer{ latency };
 				if ((scn->characterSource == SC_CHARACTERSOURCE_DIRECT_INPUT) &&
+				    (options.liveEntityDecoding || options.liveUnicodeDecoding) && !largeFileMode() &&
 				    !plugin.editor().activeDocument().currentSelection()) {
-					findAndDecode(scn->ch);
+					if (options.idleDecoding && (options.liveEntityDecoding || options.liveUnicodeDecoding)) {
+						SciActiveDocument doc = plugin.editor().activeDocument();
+						Sci_Position caret = doc.currentPosition();
+						DeferredDecoder::track(doc.sendMessage(SCI_POSITIONBEFORE, caret), caret);
+					} else {
+						findAndDecode(scn->ch);
+					}
 				}
 				break;
+			}
+			case SCN_MODIFIED: {
+				static LatencyHistogram &latency = LatencyHistogram::named("on_modified");
+				LatencyHistogram::Timer timer{ latency };
+				if (scn->modificationType & (SC_MOD_INSERTTEXT | SC_MOD_DELETETEXT))
+					SciActiveDocument::invalidateText();
+				if (options.idleDecoding && scn->nmhdr.hwndFrom == plugin.currentScintilla())
+					DeferredDecoder::update(scn);
+				break;
+			}
 		}
 	}
 }
 // --------------------------------------------------------------------------------------
 void HtmlTagPlugin::finalize() {
+	stopWorkers();
+	SlicedReplacement::abandon();
+	if (options.savePerformanceStats)
+		saveLatencies();
 	saveOptions();
 }
 // --------------------------------------------------------------------------------------
-void HtmlTagPlugin::getEntities(EntityList &list) {
-	const char *listName = documentLangType() == L_XML ? "XML" : "HTML 5";
-	auto it = _entityMap.find(listName);
-	if (it != _entityMap.end() && it->second) {
-		list = it->second;
-		return;
-	}
+EntityList const &HtmlTagPlugin::getEntities(uintptr_t bufferId) {
+	const char *listName = documentLangType(bufferId) == L_XML ? "XML" : "HTML 5";
+	EntityList &list = _entityMap[listName];
+	if (list)
+		return list;
 
 	std::wstringstream errMsg;
 	path_t iniFile = this->entities;
@@ -210,7 +393,7 @@ void HtmlTagPlugin::getEntities(EntityList &list) {
 	}
 	if (!std::filesystem::exists(iniFile)) {
 		::MessageBoxW(editor().windowHandle(), &errMsg.str()[0], getMessage(L"err_config"), MB_ICONERROR);
-		return;
+		return list;
 	}
 
 	CSimpleIniCaseA config;
@@ -220,38 +403,66 @@ void HtmlTagPlugin::getEntities(EntityList &list) {
 	try {
 		SI_Error err = config.LoadData(stream);
 		if (err != SI_OK)
-			return;
+			return list;
 
 		std::list<CSimpleIniCaseA::Entry> charRefs;
 		if (!config.GetAllKeys(listName, charRefs))
-			return;
+			return list;
 
+		// Map names to code points and back
+		std::vector<EntityList::Pair_T> pairs;
+		pairs.reserve(charRefs.size() * 2);
 		for (auto &&entity : charRefs) {
 			std::string codePointStr = config.GetValue(listName, entity.pItem);
 			int codePoint = std::stoi(codePointStr);
 			if (codePoint > 0) {
-				_entityMap[listName].addPair(entity.pItem, std::to_string(codePoint));
-				_entityMap[listName].addPair(std::to_string(codePoint), entity.pItem);
+				pairs.emplace_back(entity.pItem, std::to_string(codePoint));
+				pairs.emplace_back(std::to_string(codePoint), entity.pItem);
 			}
 		}
-		list = _entityMap[listName];
+		// The last of several names for the same code point wins, as before
+		list = EntityList{ std::move(pairs) };
 	} catch (...) {
 		config.~CSimpleIniTempl();
 	}
 	ifs.close();
+	return list;
 }
 // --------------------------------------------------------------------------------------
 const wchar_t *HtmlTagPlugin::getMessage(std::wstring const &key) {
 	return _menuTitles[key].c_str();
 }
 // --------------------------------------------------------------------------------------
+std::wstring HtmlTagPlugin::formatMessage(std::wstring const &key, std::initializer_list<std::wstring> args) {
+	std::wstring msg = getMessage(key);
+	wchar_t argId[] = L"%1";
+	for (auto &&arg : args) {
+		size_t argPos = msg.find(argId);
+		if (argPos != std::wstring::npos)
+			msg.replace(argPos, 2, arg);
+		++argId[1];
+	}
+	return msg;
+}
+// --------------------------------------------------------------------------------------
+size_t HtmlTagPlugin::forEachBuffer(BufferAction const &action) {
+	const HWND statusBar = ::FindWindowExW(editor().windowHandle(), nullptr, STATUSCLASSNAMEW, nullptr);
+	const size_t nDone = editor().forEachBuffer(action, [this, statusBar](size_t nDone, size_t nTotal) {
+		std::wstring status = formatMessage(L"msg_progress", { std::to_wstring(nDone + 1), std::to_wstring(nTotal) });
+		sendNppMessage(NPPM_SETSTATUSBAR, STATUSBAR_DOC_TYPE, &status[0]);
+		if (statusBar)
+			::UpdateWindow(statusBar);
+		return !editor().escapePressed();
+	});
+	// The buffer activations were let go by while the walk was on
+	DeferredDecoder::activate(static_cast<uintptr_t>(sendNppMessage(NPPM_GETCURRENTBUFFERID)));
+	largeFileMode();
+	return nDone;
+}
+// --------------------------------------------------------------------------------------
 void HtmlTagPlugin::setUnicodeFormatOption(std::string const &userPrefix) {
 	if (!userPrefix.empty()) {
-		std::string reStr = std::regex_replace(userPrefix, std::regex(R"([\.*+?^${}()[\]|])"), R"(\$&)");
-		reStr = std::regex_replace(reStr, std::regex(R"(\\[[:alpha:]])"), R"(\\$&)");
-		reStr += R"([0-9A-F]{4,6})";
 		options.unicodePrefix = userPrefix;
-		options.unicodeRE = reStr;
 	} else if (options.unicodePrefix.empty()) {
 		setUnicodeFormatOption(defaultUnicodePrefix);
 	}
@@ -259,8 +470,24 @@ void HtmlTagPlugin::setUnicodeFormatOption(std::string const &userPrefix) {
 // --------------------------------------------------------------------------------------
 void HtmlTagPlugin::toggleOption(BOOL *pOption, const int menuPos) {
 	*pOption = !*pOption;
-	size_t cmdIdx = funcItems.count() - menuPos;
-	sendNppMessage(NPPM_SETMENUITEMCHECK, funcItems.getItemCmdId(cmdIdx), *pOption);
+	sendNppMessage(NPPM_SETMENUITEMCHECK, funcItems.getItemCmdId(static_cast<size_t>(menuPos)), *pOption);
+}
+// --------------------------------------------------------------------------------------
+bool HtmlTagPlugin::largeFileMode() {
+	const bool isLarge = options.largeFiles.isLarge(editor().activeDocument().length());
+	if (isLarge != _largeFileMode && funcItems) {
+		_largeFileMode = isLarge;
+		sendNppMessage(NPPM_SETMENUITEMCHECK, funcItems.getItemCmdId(CmdMenuPosition::cmpLargeFiles), isLarge);
+	}
+	return isLarge;
+}
+// --------------------------------------------------------------------------------------
+bool HtmlTagPlugin::confirmCopy(Sci_Position length) {
+	if (!options.largeFiles.needsConfirmation(length))
+		return true;
+	std::wstring prompt = formatMessage(L"msg_confirm_copy", { megabytes(length) });
+	return ::MessageBoxW(editor().windowHandle(), prompt.c_str(), _pluginName.c_str(), MB_YESNO | MB_ICONWARNING) ==
+	    IDYES;
 }
 // --------------------------------------------------------------------------------------
 void HtmlTagPlugin::initMenu() {
@@ -268,22 +495,47 @@ void HtmlTagPlugin::initMenu() {
 	setLanguage();
 	if (menuLocale() != LocalizedPlugin::defaultLangId)
 		loadTranslations();
-	funcItems.add(getMessage(L"menu_0"), commandFindMatchingTag, new sk{ false, true, false, 'T' });
-	funcItems.add(getMessage(L"menu_1"), commandSelectMatchingTags, new sk{ false, true, false, 113U });
-	funcItems.add(getMessage(L"menu_2"), commandSelectTagContents, new sk{ false, true, true, 'T' });
-	funcItems.add(getMessage(L"menu_3"), commandSelectTagContentsOnly, new sk{ true, true, false, 'T' });
-	funcItems.add(menuItemSeparator);
-	funcItems.add(getMessage(L"menu_4"), commandEncodeEntities, new sk{ true, false, false, 'E' });
-	funcItems.add(getMessage(L"menu_5"), commandEncodeEntitiesInclLineBreaks, new sk{ true, true, false, 'E' });
-	funcItems.add(getMessage(L"menu_6"), commandDecodeEntities, new sk{ true, false, true, 'E' });
-	funcItems.add(menuItemSeparator);
-	funcItems.add(getMessage(L"menu_7"), commandEncodeJS, new sk{ false, true, false, 'J' });
-	funcItems.add(getMessage(L"menu_8"), commandDecodeJS, new sk{ false, true, true, 'J' });
-	funcItems.add(menuItemSeparator);
-	funcItems.add(getMessage(L"menu_9"), toggleLiveEntityecoding);
-	funcItems.add(getMessage(L"menu_10"), toggleLiveUnicodeDecoding);
-	funcItems.add(menuItemSeparator);
-	funcItems.add(getMessage(L"menu_11"), commandAbout);
+	addMenuItem(L"menu_0", commandFindMatchingTag, new sk{ false, true, false, 'T' });
+	addMenuItem(L"menu_1", commandSelectMatchingTags, new sk{ false, true, false, 113U });
+	addMenuItem(L"menu_2", commandSelectTagContents, new sk{ false, true, true, 'T' });
+	addMenuItem(L"menu_3", commandSelectTagContentsOnly, new sk{ true, true, false, 'T' });
+	addMenuItem();
+	addMenuItem(L"menu_4", commandEncodeEntities, new sk{ true, false, false, 'E' });
+	addMenuItem(L"menu_5", commandEncodeEntitiesInclLineBreaks, new sk{ true, true, false, 'E' });
+	addMenuItem(L"menu_6", commandDecodeEntities, new sk{ true, false, true, 'E' });
+	addMenuItem();
+	addMenuItem(L"menu_7", commandEncodeJS, new sk{ false, true, false, 'J' });
+	addMenuItem(L"menu_8", commandDecodeJS, new sk{ false, true, true, 'J' });
+	addMenuItem();
+	addMenuItem(L"menu_9", toggleLiveEntityecoding);
+	addMenuItem(L"menu_10", toggleLiveUnicodeDecoding);
+	addMenuItem();
+	addMenuItem(L"menu_11", commandAbout);
+	// Commands added since go after these, so users' shortcuts stay with the commands they were mapped to
+	addMenuItem();
+	addMenuItem(L"menu_20", commandCheckTagBalance);
+	addMenuItem();
+	addMenuItem(L"menu_12", commandDecodeEntitiesInDocument);
+	addMenuItem(L"menu_13", commandDecodeEntitiesInAllDocuments);
+	addMenuItem(L"menu_14", commandDecodeJSInDocument);
+	addMenuItem(L"menu_15", commandDecodeJSInAllDocuments);
+	addMenuItem();
+	addMenuItem(L"menu_19", commandLargeFileMode);
+	addMenuItem();
+	addMenuItem(L"menu_17", commandPerformanceStats);
+	addMenuItem(L"menu_18", commandSaveTraceEvents);
+	if constexpr (SciMessageStats::enabled)
+		addMenuItem(L"menu_16", commandMessageStats);
+}
+// --------------------------------------------------------------------------------------
+void HtmlTagPlugin::addMenuItem(const wchar_t *msgId, PFUNCPLUGINCMD pFunc, ShortcutKey *sk) {
+	if (!msgId) {
+		funcItems.add(menuItemSeparator);
+		_menuItemIds.emplace_back();
+	} else {
+		funcItems.add(getMessage(msgId), pFunc, sk);
+		_menuItemIds.emplace_back(msgId);
+	}
 }
 // --------------------------------------------------------------------------------------
 void HtmlTagPlugin::updateMenu() {
@@ -294,11 +546,9 @@ void HtmlTagPlugin::updateMenu() {
 	loadTranslations();
 	HMENU hMenu = reinterpret_cast<HMENU>(sendNppMessage(NPPM_GETMENUHANDLE, NPPPLUGINMENU, nullptr));
 
-	for (intptr_t i = 0, menuId = 0; i < funcItems.count(); i++, menuId++) {
-		if (std::wcscmp(funcItems[i]._itemName, menuItemSeparator) == 0) {
-			menuId--;
+	for (intptr_t i = 0; i < funcItems.count(); i++) {
+		if (_menuItemIds[i].empty())
 			continue;
-		}
 
 		MENUITEMINFOW mii;
 		mii.cbSize = sizeof(MENUITEMINFOW);
@@ -310,7 +560,7 @@ void HtmlTagPlugin::updateMenu() {
 			std::wstring menubuf(++mii.cch, L'\0');
 			mii.dwTypeData = &menubuf[0];
 			::GetMenuItemInfoW(hMenu, mId, 0, &mii);
-			std::wstring newMenuTitle = getMessage(L"menu_" + std::to_wstring(menuId));
+			std::wstring newMenuTitle = getMessage(_menuItemIds[i]);
 			size_t shortcutPos = menubuf.find_last_of(0x9);
 			if (shortcutPos != std::wstring::npos)
 				newMenuTitle += menubuf.substr(shortcutPos);
@@ -351,6 +601,7 @@ void HtmlTagPlugin::loadTranslations() {
 }
 // --------------------------------------------------------------------------------------
 void HtmlTagPlugin::loadOptions() {
+	options.largeFiles = defaultLargeFileThresholds;
 	if (fs::exists(optionsConfig)) {
 		CSimpleIniA config;
 		std::ifstream ifs(optionsConfig.c_str(), std::ios::in | std::ios::binary);
@@ -361,21 +612,39 @@ void HtmlTagPlugin::loadOptions() {
 				return;
 			options.liveEntityDecoding = config.GetBoolValue("AUTO_DECODE", "ENTITIES", false);
 			options.liveUnicodeDecoding = config.GetBoolValue("AUTO_DECODE", "UNICODE_ESCAPE_CHARS", false);
+			options.idleDecoding = config.GetBoolValue("AUTO_DECODE", "WHEN_IDLE", false);
+			options.idleDecodingDelay = static_cast<unsigned>(
+			    config.GetLongValue("AUTO_DECODE", "IDLE_DELAY_MS", defaultIdleDecodingDelay));
 			std::string userPrefix =
 			    config.GetValue("FORMAT", "UNICODE_ESCAPE_PREFIX", defaultUnicodePrefix);
 			setUnicodeFormatOption(userPrefix);
+			options.bracedAttributes = config.GetBoolValue("FORMAT", "BRACED_ATTRIBUTES", false);
+			options.recordTraces = config.GetBoolValue("DIAGNOSTICS", "RECORD_TRACES", false);
+			options.anonymizeTraces = config.GetBoolValue("DIAGNOSTICS", "ANONYMIZE_TRACES", true);
+			options.savePerformanceStats = config.GetBoolValue("DIAGNOSTICS", "SAVE_PERFORMANCE_STATS", false);
+			options.traceSpans = config.GetBoolValue("DIAGNOSTICS", "TRACE_SPANS", false);
+			LargeFileThresholds &largeFiles = options.largeFiles;
+			largeFiles.minBytes = config.GetLongValue("LARGE_FILES", "MIN_BYTES", largeFiles.minBytes);
+			largeFiles.scanWindowBytes =
+			    config.GetLongValue("LARGE_FILES", "SCAN_WINDOW_BYTES", largeFiles.scanWindowBytes);
+			largeFiles.slicedEditBytes =
+			    config.GetLongValue("LARGE_FILES", "SLICED_EDIT_BYTES", largeFiles.slicedEditBytes);
+			largeFiles.confirmCopyBytes =
+			    config.GetLongValue("LARGE_FILES", "CONFIRM_COPY_BYTES", largeFiles.confirmCopyBytes);
 		} catch (...) {
 			config.~CSimpleIniTempl();
 		}
 		ifs.close();
 	} else {
 		setUnicodeFormatOption(defaultUnicodePrefix);
+		options.anonymizeTraces = TRUE;
 	}
 
-	size_t autoDecodeJs = funcItems.count() - CmdMenuPosition::cmpUnicode;
-	size_t autoDecodeEntities = funcItems.count() - CmdMenuPosition::cmpEntities;
-	funcItems[autoDecodeJs]._init2Check = options.liveUnicodeDecoding;
-	funcItems[autoDecodeEntities]._init2Check = options.liveEntityDecoding;
+	if (options.idleDecodingDelay == 0)
+		options.idleDecodingDelay = defaultIdleDecodingDelay;
+
+	funcItems[CmdMenuPosition::cmpUnicode]._init2Check = options.liveUnicodeDecoding;
+	funcItems[CmdMenuPosition::cmpEntities]._init2Check = options.liveEntityDecoding;
 }
 // --------------------------------------------------------------------------------------
 void HtmlTagPlugin::saveOptions() {
@@ -388,7 +657,19 @@ void HtmlTagPlugin::saveOptions() {
 	try {
 		config.SetLongValue("AUTO_DECODE", "ENTITIES", options.liveEntityDecoding);
 		config.SetLongValue("AUTO_DECODE", "UNICODE_ESCAPE_CHARS", options.liveUnicodeDecoding);
+		config.SetLongValue("AUTO_DECODE", "WHEN_IDLE", options.idleDecoding);
+		config.SetLongValue("AUTO_DECODE", "IDLE_DELAY_MS", options.idleDecodingDelay);
 		config.SetValue("FORMAT", "UNICODE_ESCAPE_PREFIX", options.unicodePrefix.c_str());
+		config.SetLongValue("FORMAT", "BRACED_ATTRIBUTES", options.bracedAttributes);
+		config.SetLongValue("DIAGNOSTICS", "RECORD_TRACES", options.recordTraces);
+		config.SetLongValue("DIAGNOSTICS", "ANONYMIZE_TRACES", options.anonymizeTraces);
+		config.SetLongValue("DIAGNOSTICS", "SAVE_PERFORMANCE_STATS", options.savePerformanceStats);
+		config.SetLongValue("DIAGNOSTICS", "TRACE_SPANS", options.traceSpans);
+		config.SetLongValue("LARGE_FILES", "MIN_BYTES", static_cast<long>(options.largeFiles.minBytes));
+		config.SetLongValue("LARGE_FILES", "SCAN_WINDOW_BYTES", static_cast<long>(options.largeFiles.scanWindowBytes));
+		config.SetLongValue("LARGE_FILES", "SLICED_EDIT_BYTES", static_cast<long>(options.largeFiles.slicedEditBytes));
+		config.SetLongValue(
+		    "LARGE_FILES", "CONFIRM_COPY_BYTES", static_cast<long>(options.largeFiles.confirmCopyBytes));
 		config.Save(ofs);
 	} catch (...) {
 		config.~CSimpleIniTempl();
@@ -413,6 +694,29 @@ MenuTitles::MenuTitles() : HashedStringList<std::wstring>() {
 		L"menu_9=Automatically decode entities",
 		L"menu_10=Automatically decode Unicode characters",
 		L"menu_11=&About...",
+		L"menu_12=Decode entities in document",
+		L"menu_13=Decode entities in all open documents",
+		L"menu_14=Decode Unicode characters in document",
+		L"menu_15=Decode Unicode characters in all open documents",
+		L"menu_16=Editor message &statistics",
+		L"menu_17=&Performance statistics",
+		L"menu_18=Save &trace events",
+		L"menu_19=Large file mode",
+		L"menu_20=Check tag &balance",
+		L"msg_replaced=%1 replacement(s) in %2 ms",
+		L"msg_progress=Processing document %1 of %2 (press Esc to cancel)",
+		L"msg_spans_saved=%1 trace event(s) saved to %2",
+		L"msg_slice_progress=Replacing: %1% done (press Esc to cancel)",
+		L"msg_slice_cancelled=Replacement cancelled; the document is unchanged",
+		L"msg_large_file_on=Large file mode is on: the document is %1 MB, the threshold %2 MB (see options.ini)",
+		L"msg_large_file_off=Large file mode is off: the document is %1 MB, the threshold %2 MB (see options.ini)",
+		L"msg_scan_bounded=No match within %1 KB of the caret (large file mode)",
+		L"msg_tag_balance=%1 unbalanced tag(s) among %2, checked at %3 MB/s",
+		L"msg_unclosed_tag=Unclosed <%1>",
+		L"msg_misnested_tag=Misnested <%1>",
+		L"msg_stray_tag=Stray </%1>",
+		L"msg_confirm_copy=This will copy %1 MB of text at once, which may take a while and use a lot of memory. "
+		L"Continue?",
 		L"err_compat=The installed version of HTML Tag requires Notepad++ 8.3 or newer. Plugin commands have "
 		L"been disabled.",
 		L"err_config=Missing Entities File",
@@ -446,8 +750,22 @@ bool autoCompleteMatchingTag(const Sci_Position startPos, const char *tagName) {
 	return false;
 }
 // --------------------------------------------------------------------------------------
+void replaceAndReport(Replacer replacer, EntityReplacementScope scope) {
+	const auto started = std::chrono::steady_clock::now();
+	const int nReplaced = replacer(scope);
+	// A large document is still being worked on, and will report when it's done
+	if (SlicedReplacement::running())
+		return;
+	const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - started;
+
+	std::wstringstream ms;
+	ms << std::fixed << std::setprecision(1) << elapsed.count();
+	std::wstring status = plugin.formatMessage(L"msg_replaced", { std::to_wstring(nReplaced), ms.str() });
+	plugin.sendNppMessage(NPPM_SETSTATUSBAR, STATUSBAR_DOC_TYPE, &status[0]);
+}
+// --------------------------------------------------------------------------------------
 void findAndDecode(const int keyCode, DecodeCmd cmd) {
-	using Decoder = int (*)();
+	using Decoder = int (*)(EntityReplacementScope);
 	int ch = keyCode & 0xff;
 
 	if ((cmd == dcAuto) && (!(plugin.options.liveEntityDecoding || plugin.options.liveUnicodeDecoding) ||
@@ -462,7 +780,7 @@ void findAndDecode(const int keyCode, DecodeCmd cmd) {
 	auto replace = [doc](Decoder decoder, Sci_Position start, Sci_Position end) {
 		int nDecoded = 0;
 		doc.select(start, end - start);
-		nDecoded = decoder();
+		nDecoded = decoder(ersSelection);
 		return (nDecoded > 0);
 	};
 
@@ -523,4 +841,65 @@ void findAndDecode(const int keyCode, DecodeCmd cmd) {
 		doc.currentPosition(caret);
 	}
 }
+// --------------------------------------------------------------------------------------
+CommandTrace::CommandTrace(const char *command)
+    : _stats(command),
+      _span(command, "command"),
+      _memory(command),
+      _recorder(plugin.options.recordTraces ? std::make_unique<SciMessageRecorder>(plugin.currentScintilla(),
+						      command, plugin.options.anonymizeTraces != FALSE)
+					    : nullptr),
+      _latency(LatencyHistogram::named(command)),
+      _started(LatencyHistogram::Clock::now()) {}
+// --------------------------------------------------------------------------------------
+CommandTrace::~CommandTrace() {
+	_latency.record(static_cast<uint64_t>(
+	    std::chrono::duration_cast<std::chrono::nanoseconds>(LatencyHistogram::Clock::now() - _started).count()));
+	if (!_recorder)
+		return;
+	try {
+		std::error_code err;
+		fs::create_directories(plugin.traces, err);
+		const std::string fileName = _recorder->trace().command() + '-' + timestamp() + ".trace";
+		std::ofstream ofs((plugin.traces / fileName).c_str(), std::ios::out | std::ios::binary);
+		_recorder->trace().save(ofs);
+	} catch (...) {
+	}
+}
+// --------------------------------------------------------------------------------------
+void loadLatencies() {
+	std::ifstream ifs(plugin.latencies.c_str(), std::ios::in | std::ios::binary);
+	std::string field, date;
+	// Carry on with the histograms saved earlier today, and start afresh every other day
+	if ((ifs >> field >> date) && field == "date" && date == today())
+		LatencyHistogram::load(ifs);
+}
+// --------------------------------------------------------------------------------------
+void saveLatencies() {
+	std::ofstream ofs(plugin.latencies.c_str(), std::ios::out | std::ios::binary);
+	if (!ofs)
+		return;
+	ofs << "date " << today() << '\n';
+	LatencyHistogram::save(ofs);
+}
+// --------------------------------------------------------------------------------------
+std::string today() {
+	const std::time_t now = std::time(nullptr);
+	std::ostringstream date;
+	date << std::put_time(std::localtime(&now), "%Y-%m-%d");
+	return date.str();
+}
+// --------------------------------------------------------------------------------------
+std::string timestamp() {
+	const std::time_t now = std::time(nullptr);
+	std::ostringstream time;
+	time << std::put_time(std::localtime(&now), "%Y%m%d-%H%M%S");
+	return time.str();
+}
+// --------------------------------------------------------------------------------------
+std::wstring megabytes(Sci_Position bytes) {
+	std::wstringstream mb;
+	mb << std::fixed << std::setprecision(1) << static_cast<double>(bytes) / (1024.0 * 1024.0);
+	return mb.str();
+}
 }
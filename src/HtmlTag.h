@@ -9,6 +9,7 @@
 #define HTML_TAG_H
 
 #include "Entities.h"
+#include "LargeFiles.h"
 #include "LocalizedPlugin.h"
 
 using namespace HtmlTag::Entities;
@@ -20,8 +21,16 @@ DEFINE_ENUM_FLAG_OPERATORS(SelectionOptions)
 struct PluginOptions {
 	BOOL liveEntityDecoding;
 	BOOL liveUnicodeDecoding;
+	BOOL idleDecoding;
+	unsigned idleDecodingDelay;
 	std::string unicodePrefix;
-	std::string unicodeRE;
+	/// Whether a '>' in braces, as in Razor and JSX, is part of the tag
+	BOOL bracedAttributes;
+	BOOL recordTraces;
+	BOOL anonymizeTraces;
+	BOOL savePerformanceStats;
+	BOOL traceSpans;
+	LargeFileThresholds largeFiles;
 };
 
 struct MenuTitles final : HashedStringList<std::wstring> {
@@ -32,27 +41,38 @@ class HtmlTagPlugin final : public LocalizedPlugin {
 
 public:
 	explicit HtmlTagPlugin() noexcept : LocalizedPlugin() {
-		_entityMap = { { "XML", EntityList{} }, { "HTML 5", EntityList{} } };
+		_entityMap.emplace("XML", EntityList{});
+		_entityMap.emplace("HTML 5", EntityList{});
 	}
 
 	void initialize(HMODULE);
 	void setInfo(const NppData *) override;
 	void beNotified(SCNotification *) override;
 	void finalize();
-	void getEntities(EntityList &);
+	EntityList const &getEntities(uintptr_t bufferId = 0ULL);
 	const wchar_t *getMessage(std::wstring const &) override;
+	std::wstring formatMessage(std::wstring const &, std::initializer_list<std::wstring>);
+	size_t forEachBuffer(BufferAction const &);
 	void setUnicodeFormatOption(std::string const &);
 	void toggleOption(BOOL *, const int);
+	/// @brief Whether the active document is big enough for large-file mode; keeps the menu's check mark in step.
+	bool largeFileMode();
+	/// @brief Asks the user before @p length bytes of text are copied in one go, if that's more than a little.
+	/// @return @c false if they'd rather not
+	bool confirmCopy(Sci_Position length);
 
 	PluginOptions options;
-	path_t optionsConfig, entities, translations;
+	path_t optionsConfig, entities, translations, traces, latencies;
 	static constexpr wchar_t pluginMenuName[] = L"&HTML Tag";
 
 private:
 	EntityMap _entityMap;
 	MenuTitles _menuTitles;
 	std::wstring _pluginName, _pluginDLLName;
+	std::vector<std::wstring> _menuItemIds;
+	bool _largeFileMode = false;
 	void initMenu();
+	void addMenuItem(const wchar_t *msgId = nullptr, PFUNCPLUGINCMD pFunc = nullptr, ShortcutKey *sk = nullptr);
 	void updateMenu();
 	void loadTranslations();
 	void loadOptions();
@@ -0,0 +1,36 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#ifndef HTMLTAG_LARGE_FILES_H
+#define HTMLTAG_LARGE_FILES_H
+
+#include "Scintilla.h"
+
+namespace HtmlTag {
+/// @brief The document sizes, in bytes, at which the plugin trades features for speed; set in the
+/// @c [LARGE_FILES] section of options.ini. A threshold of 0 turns its feature off.
+struct LargeFileThresholds {
+	/// Documents at least this long are in large-file mode: tag matching stays near the caret, and
+	/// live decoding and tag auto-completion are off
+	Sci_Position minBytes;
+	/// How far either side of the caret tag matching looks in large-file mode
+	Sci_Position scanWindowBytes;
+	/// Replacing this much of a document or more is done a slice at a time, without blocking the window
+	Sci_Position slicedEditBytes;
+	/// Copying this much text or more in one go asks first
+	Sci_Position confirmCopyBytes;
+
+	bool isLarge(Sci_Position length) const noexcept { return minBytes > 0 && length >= minBytes; }
+	bool isSliced(Sci_Position length) const noexcept { return slicedEditBytes > 0 && length >= slicedEditBytes; }
+	bool needsConfirmation(Sci_Position length) const noexcept {
+		return confirmCopyBytes > 0 && length >= confirmCopyBytes;
+	}
+};
+
+constexpr LargeFileThresholds defaultLargeFileThresholds{ 0x800000, 0x100000, 0x100000, 0x4000000 };
+}
+#endif // ~HTMLTAG_LARGE_FILES_H
@@ -15,6 +15,9 @@
 /////////////////////////////////////////////////////////////////////////////////////////
 namespace {
 path_t getModulePath(HMODULE hInstace);
+
+/// Tells @c messageProc that background jobs have callbacks waiting
+constexpr long msgRunWorkerCallbacks = 1;
 }
 
 // --------------------------------------------------------------------------------------
@@ -24,6 +27,9 @@ PluginBase::~PluginBase() {
 	funcItems.~FuncArray();
 	if (_editor)
 		delete _editor;
+	// Joining the workers under the loader lock would deadlock; the process is exiting anyway
+	if (_workers)
+		static_cast<void>(_workers.release());
 }
 // --------------------------------------------------------------------------------------
 void PluginBase::setInfo(const NppData *data) {
@@ -41,6 +47,29 @@ void PluginBase::setInfo(const NppData *data) {
 	_nppVersion.revision = loWords.rem;
 }
 // --------------------------------------------------------------------------------------
+LRESULT PluginBase::messageProc(UINT msg, WPARAM /*wParam*/, LPARAM lParam) {
+	auto *info = reinterpret_cast<CommunicationInfo *>(lParam);
+	if (msg == NPPM_MSGTOPLUGIN && info == &_workerCallbacks && _workers)
+		_workers->runPosted();
+	return TRUE;
+}
+// --------------------------------------------------------------------------------------
+WorkerPool &PluginBase::workers() {
+	if (!_workers) {
+		_moduleFileName = getModulePath(_hModule).filename().wstring();
+		_workerCallbacks = CommunicationInfo{ msgRunWorkerCallbacks, _moduleFileName.c_str(), nullptr };
+		_workers = std::make_unique<WorkerPool>(0, [this] {
+			::PostMessageW(_data._nppHandle, NPPM_MSGTOPLUGIN, reinterpret_cast<WPARAM>(_moduleFileName.c_str()),
+			    reinterpret_cast<LPARAM>(&_workerCallbacks));
+		});
+	}
+	return *_workers;
+}
+// --------------------------------------------------------------------------------------
+void PluginBase::stopWorkers() {
+	_workers = nullptr;
+}
+// --------------------------------------------------------------------------------------
 HWND PluginBase::currentScintilla() const {
 	intptr_t index = -1;
 	sendNppMessage(NPPM_GETCURRENTSCINTILLA, UNUSEDW, &index);
@@ -113,9 +142,12 @@ path_t PluginBase::pluginsConfigDir() const {
 	return path_t(s, path_t::format::native_format);
 }
 // --------------------------------------------------------------------------------------
-LangType PluginBase::documentLangType() const {
+LangType PluginBase::documentLangType(uintptr_t bufferId) const {
 	int typeInt;
-	sendNppMessage(NPPM_GETCURRENTLANGTYPE, 0, &typeInt);
+	if (bufferId > 0)
+		typeInt = static_cast<int>(sendNppMessage(NPPM_GETBUFFERLANGTYPE, bufferId, nullptr));
+	else
+		sendNppMessage(NPPM_GETCURRENTLANGTYPE, 0, &typeInt);
 	return static_cast<LangType>(typeInt);
 }
 // --------------------------------------------------------------------------------------
@@ -128,7 +160,7 @@ path_t PluginBase::pluginsHomeDir() const {
 bool PluginBase::openFile(wchar_t *filename) const {
 	path_t s = currentBufferPath();
 	// Ask if we are not already opened
-	if (TextConv::sameText(s, filename))
+	if (TextConv::sameText(s.wstring(), filename))
 		return true;
 	return (sendNppMessage(WM_DOOPEN, UNUSEDW, &filename[0]) == MessageResult::mrFalse);
 }
@@ -168,6 +200,101 @@ SciActiveDocument const &SciApplication::getDocument() const {
 	return getViews()[(index > 0)];
 }
 // --------------------------------------------------------------------------------------
+size_t SciApplication::forEachBuffer(BufferAction const &action, BufferProgress const &progress) const {
+	struct BufferPos {
+		uintptr_t id;
+		int view;
+		intptr_t index; // -1 if already visible
+	};
+	const int views[] = { MAIN_VIEW, SUB_VIEW };
+	intptr_t visibleIndex[] = { -1, -1 };
+	uintptr_t visibleId[] = { 0, 0 };
+	bool isVisible[] = { false, false };
+	std::vector<BufferPos> buffers;
+
+	for (int view : views) {
+		isVisible[view] = ::IsWindowVisible(getViews()[view].windowHandle()) != FALSE;
+		visibleIndex[view] = sendMessage(NPPM_GETCURRENTDOCINDEX, UNUSEDW, view);
+		if (visibleIndex[view] >= 0)
+			visibleId[view] = static_cast<uintptr_t>(sendMessage(NPPM_GETBUFFERIDFROMPOS, visibleIndex[view], view));
+	}
+
+	for (int view : views) {
+		if (visibleIndex[view] < 0) // View is hidden
+			continue;
+		const intptr_t nbFiles =
+		    sendMessage(NPPM_GETNBOPENFILES, UNUSEDW, (view == MAIN_VIEW) ? PRIMARY_VIEW : SECOND_VIEW);
+		for (intptr_t i = 0; i < nbFiles; i++) {
+			const uintptr_t id = static_cast<uintptr_t>(sendMessage(NPPM_GETBUFFERIDFROMPOS, i, view));
+			auto isSameBuffer = [id](BufferPos const &buffer) { return buffer.id == id; };
+			if (id == 0 || std::any_of(buffers.cbegin(), buffers.cend(), isSameBuffer))
+				continue;
+			// Prefer whichever view is already showing a cloned buffer
+			if (id == visibleId[MAIN_VIEW])
+				buffers.push_back(BufferPos{ id, MAIN_VIEW, -1 });
+			else if (id == visibleId[SUB_VIEW])
+				buffers.push_back(BufferPos{ id, SUB_VIEW, -1 });
+			else
+				buffers.push_back(BufferPos{ id, view, i });
+		}
+	}
+
+	const int activeView = static_cast<int>(sendMessage(NPPM_GETCURRENTVIEW));
+	bool viewChanged[] = { false, false };
+	size_t nDone = 0;
+
+	// WM_SETREDRAW TRUE would show a hidden view, so only views showing now are held back
+	for (int view : views) {
+		if (isVisible[view])
+			getViews()[view].sendMessage(WM_SETREDRAW, FALSE);
+	}
+
+	_walkingBuffers = true;
+	try {
+		for (auto &&buffer : buffers) {
+			if (progress && !progress(nDone, buffers.size()))
+				break;
+			if (buffer.index >= 0) {
+				SpanTrace::Span span{ "SciApplication::activateBuffer", "ui" };
+				sendMessage(NPPM_ACTIVATEDOC, buffer.view, buffer.index);
+				viewChanged[buffer.view] = true;
+			}
+			action(getViews()[buffer.view], buffer.id);
+			++nDone;
+		}
+	} catch (...) {
+	}
+
+	// Restore the visible buffers, ending with the view that had focus
+	if (viewChanged[MAIN_VIEW] || viewChanged[SUB_VIEW]) {
+		SpanTrace::Span span{ "SciApplication::activateBuffer", "ui" };
+		const int inactiveView = (activeView == MAIN_VIEW) ? SUB_VIEW : MAIN_VIEW;
+		if (viewChanged[inactiveView])
+			sendMessage(NPPM_ACTIVATEDOC, inactiveView, visibleIndex[inactiveView]);
+		sendMessage(NPPM_ACTIVATEDOC, activeView, visibleIndex[activeView]);
+	}
+
+	_walkingBuffers = false;
+
+	for (int view : views) {
+		if (isVisible[view]) {
+			getViews()[view].sendMessage(WM_SETREDRAW, TRUE);
+			::InvalidateRect(getViews()[view].windowHandle(), nullptr, TRUE);
+		}
+	}
+
+	if (progress)
+		progress(nDone, buffers.size());
+
+	return nDone;
+}
+// --------------------------------------------------------------------------------------
+bool SciApplication::escapePressed() const {
+	DWORD processId = 0;
+	::GetWindowThreadProcessId(::GetForegroundWindow(), &processId);
+	return processId == ::GetCurrentProcessId() && (::GetAsyncKeyState(VK_ESCAPE) & 0x8000) != 0;
+}
+// --------------------------------------------------------------------------------------
 void SciApplication::setApiLevel(SciApiLevel api) {
 	SciViewList views = getViews();
 	for (size_t i = 0; i < views.size(); i++)
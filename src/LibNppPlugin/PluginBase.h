@@ -9,10 +9,12 @@
 #define PLUGIN_BASE_H
 
 #include <filesystem>
+#include <functional>
 #include "PluginInterface.h"
 #include "SciTextObjects.h"
 #include "FuncArray.h"
 #include "VersionInfo.h"
+#include "WorkerPool.h"
 
 using namespace SciTextObjects;
 using path_t = std::filesystem::path;
@@ -20,6 +22,11 @@ using path_t = std::filesystem::path;
 /// Manager of Scintilla edit views
 class SciViewList;
 
+/// Receives an open buffer's ID, and the edit view currently showing it
+using BufferAction = std::function<void(SciActiveDocument &, uintptr_t)>;
+/// Receives the number of buffers processed so far, and the total; returns @c false to cancel
+using BufferProgress = std::function<bool(size_t, size_t)>;
+
 /// Communication broker between the plugin and Scintilla
 class SciApplication final : public SciWindowedObject {
 
@@ -43,13 +50,24 @@ public:
 	void operator=(SciApplication &&) = delete;
 
 	void setApiLevel(SciApiLevel api) override;
-	HWND const &windowHandle() const noexcept { return _windowHandle; }
 	SciViewList const &getViews() const noexcept { return *_viewList; }
 	SciActiveDocument const &activeDocument() const { return getDocument(); }
+	/// @brief Passes every open buffer to @p action, including those not showing in either view.
+	/// Notepad++ won't give out a hidden buffer's document, so each one is activated in its view, as if
+	/// its tab were clicked, then the visible buffers are restored. Only painting is held back: each
+	/// switch still notifies every plugin, updates the tabs and status bar, and styles a buffer that was
+	/// never shown, all of it. Each switch is traced as a "SciApplication::activateBuffer" span.
+	/// @return The number of buffers processed
+	size_t forEachBuffer(BufferAction const &action, BufferProgress const &progress = nullptr) const;
+	/// @brief @c true while @c forEachBuffer is switching buffers, so handlers of the switches can wait until it's done
+	bool walkingBuffers() const noexcept { return _walkingBuffers; }
+	/// @brief @c true if Esc is down while a window of this process has the focus
+	bool escapePressed() const;
 
 private:
 	static inline SciApplication *_instance = nullptr;
 	std::unique_ptr<SciViewList> _viewList = nullptr;
+	mutable bool _walkingBuffers = false;
 	SciActiveDocument const &getDocument() const;
 	explicit SciApplication(const NppData *data)
 	    : SciWindowedObject(data->_nppHandle),
@@ -69,6 +87,8 @@ public:
 
 	virtual void setInfo(const NppData *data);
 	virtual void beNotified(SCNotification *scn) = 0;
+	/// @brief Runs the callbacks queued for the UI thread by background jobs.
+	virtual LRESULT messageProc(UINT msg, WPARAM wParam, LPARAM lParam);
 
 	/// @brief Default API call wrapper
 	LRESULT sendNppMessage(const UINT msg, WPARAM wparam = UNUSEDW, LPARAM lparam = UNUSED) const;
@@ -79,7 +99,7 @@ public:
 	path_t pluginsHomeDir() const;
 	path_t pluginsConfigDir() const;
 	path_t currentBufferPath(uintptr_t bufferId = 0ULL) const;
-	LangType documentLangType() const;
+	LangType documentLangType(uintptr_t bufferId = 0ULL) const;
 	/// @brief @c true if N++ is v8.0 or later
 	bool supportsDarkMode() const noexcept;
 	/// @brief @c true if N++ is v8.3 or later
@@ -102,6 +122,11 @@ public:
 	Version const &nppVersion() const noexcept { return _nppVersion; }
 	SciApiLevel apiLevel() const;
 	HWND currentScintilla() const;
+	/// @brief The pool for background jobs, started on first use. Its callbacks reach the UI thread through
+	/// @c NPPM_MSGTOPLUGIN, so the plugin's exported @c messageProc must pass them to ours.
+	WorkerPool &workers();
+	/// @brief Cancels background jobs and waits for them to return; call on @c NPPN_SHUTDOWN, never from @c DllMain.
+	void stopWorkers();
 
 	FuncArray funcItems{};
 
@@ -113,6 +138,9 @@ private:
 	NppData _data;
 	Version _nppVersion;
 	SciApplication *_editor = nullptr;
+	std::unique_ptr<WorkerPool> _workers;
+	std::wstring _moduleFileName;
+	CommunicationInfo _workerCallbacks{};
 };
 
 // --------------------------------------------------------------------------------------
@@ -123,11 +151,14 @@ typedef std::vector<std::shared_ptr<SciActiveDocument>> ActiveDocuments;
 class SciViewList final {
 
 public:
-	explicit SciViewList(const NppData *data) noexcept
-	    : _views({
-		  std::make_shared<SciActiveDocument>(data->_scintillaMainHandle),
-		  std::make_shared<SciActiveDocument>(data->_scintillaSecondHandle),
-	      }) {}
+	explicit SciViewList(const NppData *data) noexcept {
+		for (HWND hWnd : { data->_scintillaMainHandle, data->_scintillaSecondHandle }) {
+			// Editor views live on our thread, so they can skip the message queue
+			if (auto direct = SciDirectTransport::create(hWnd))
+				SciMessageTransport::attach(hWnd, direct);
+			_views.push_back(std::make_shared<SciActiveDocument>(hWnd));
+		}
+	}
 
 	~SciViewList() noexcept {
 		for (size_t i = 0; i < _views.size(); i++)
@@ -0,0 +1,142 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <unistd.h>
+#include "windows.h"
+#include "SciTextObjects.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+std::atomic<UINT_PTR> lastTimerId{ 0 };
+std::atomic<DWORD> lastError{ ERROR_SUCCESS };
+}
+
+// --------------------------------------------------------------------------------------
+// Windows and messages
+// --------------------------------------------------------------------------------------
+LRESULT SendMessageW(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam) {
+	return SciTextObjects::SciMessageTransport::forWindow(hWnd)->send(msg, wParam, lParam);
+}
+// --------------------------------------------------------------------------------------
+LRESULT SendMessageTimeoutW(HWND /*hWnd*/, UINT /*msg*/, WPARAM /*wParam*/, LPARAM /*lParam*/, UINT /*flags*/,
+    UINT /*timeout*/, DWORD_PTR *result) {
+	if (result)
+		*result = 0;
+	return 0;
+}
+// --------------------------------------------------------------------------------------
+BOOL PostMessageW(HWND /*hWnd*/, UINT /*msg*/, WPARAM /*wParam*/, LPARAM /*lParam*/) {
+	return FALSE;
+}
+// --------------------------------------------------------------------------------------
+BOOL IsWindowVisible(HWND /*hWnd*/) {
+	return FALSE;
+}
+// --------------------------------------------------------------------------------------
+BOOL InvalidateRect(HWND /*hWnd*/, const void * /*rect*/, BOOL /*erase*/) {
+	return TRUE;
+}
+// --------------------------------------------------------------------------------------
+HWND GetForegroundWindow() {
+	return nullptr;
+}
+// --------------------------------------------------------------------------------------
+UINT_PTR SetTimer(HWND /*hWnd*/, UINT_PTR /*id*/, UINT /*elapse*/, TIMERPROC /*timerProc*/) {
+	return ++lastTimerId;
+}
+// --------------------------------------------------------------------------------------
+BOOL KillTimer(HWND /*hWnd*/, UINT_PTR /*id*/) {
+	return TRUE;
+}
+// --------------------------------------------------------------------------------------
+short GetAsyncKeyState(int /*key*/) {
+	return 0;
+}
+// --------------------------------------------------------------------------------------
+BOOL MessageBeep(UINT /*type*/) {
+	return TRUE;
+}
+// --------------------------------------------------------------------------------------
+int MessageBoxW(HWND /*hWnd*/, LPCWSTR /*text*/, LPCWSTR /*caption*/, UINT type) {
+	// No one to ask, so take the default answer
+	return (type & MB_YESNO) == MB_YESNO ? IDYES : IDOK;
+}
+
+// --------------------------------------------------------------------------------------
+// Processes and threads
+// --------------------------------------------------------------------------------------
+DWORD GetCurrentThreadId() {
+	return static_cast<DWORD>(std::hash<std::thread::id>{}(std::this_thread::get_id()));
+}
+// --------------------------------------------------------------------------------------
+DWORD GetCurrentProcessId() {
+	return static_cast<DWORD>(::getpid());
+}
+// --------------------------------------------------------------------------------------
+DWORD GetWindowThreadProcessId(HWND /*hWnd*/, DWORD *processId) {
+	if (processId)
+		*processId = 0;
+	return 0;
+}
+// --------------------------------------------------------------------------------------
+DWORD GetModuleFileNameW(HMODULE /*hModule*/, LPWSTR fileName, DWORD size) {
+	if (fileName && size > 0)
+		fileName[0] = L'\0';
+	return 0;
+}
+// --------------------------------------------------------------------------------------
+DWORD GetLastError() {
+	return lastError;
+}
+// --------------------------------------------------------------------------------------
+void SetLastError(DWORD error) {
+	lastError = error;
+}
+
+// --------------------------------------------------------------------------------------
+// Code pages
+// --------------------------------------------------------------------------------------
+int MultiByteToWideChar(UINT /*cp*/, DWORD /*flags*/, LPCSTR src, int srcLen, LPWSTR dest, int destLen) {
+	if (!src || srcLen < 0)
+		return 0;
+	if (!dest || destLen == 0)
+		return srcLen;
+	if (destLen < srcLen) {
+		lastError = ERROR_INSUFFICIENT_BUFFER;
+		return 0;
+	}
+	for (int i = 0; i < srcLen; i++)
+		dest[i] = static_cast<wchar_t>(static_cast<unsigned char>(src[i]));
+	return srcLen;
+}
+// --------------------------------------------------------------------------------------
+int WideCharToMultiByte(UINT /*cp*/, DWORD /*flags*/, LPCWSTR src, int srcLen, LPSTR dest, int destLen,
+    LPCSTR defaultChar, BOOL *usedDefault) {
+	if (!src || srcLen < 0)
+		return 0;
+	if (!dest || destLen == 0)
+		return srcLen;
+	if (destLen < srcLen) {
+		lastError = ERROR_INSUFFICIENT_BUFFER;
+		return 0;
+	}
+	if (usedDefault)
+		*usedDefault = FALSE;
+	for (int i = 0; i < srcLen; i++) {
+		if (static_cast<unsigned long>(src[i]) <= 0xFF) {
+			dest[i] = static_cast<char>(src[i]);
+		} else {
+			dest[i] = defaultChar ? *defaultChar : '?';
+			if (usedDefault)
+				*usedDefault = TRUE;
+		}
+	}
+	return srcLen;
+}
@@ -0,0 +1,16 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#ifndef WIN32_COMPAT_TCHAR_H
+#define WIN32_COMPAT_TCHAR_H
+
+/// @file
+/// @brief For the Notepad++ headers that include it; @c TCHAR is always @c wchar_t here, as in a @c UNICODE build.
+#include "windows.h"
+
+#define _T(s) L##s
+#endif // ~WIN32_COMPAT_TCHAR_H
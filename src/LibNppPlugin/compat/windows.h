@@ -0,0 +1,109 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#ifndef WIN32_COMPAT_H
+#define WIN32_COMPAT_H
+
+/**
+ * @file
+ * @brief The part of the Win32 API that the headless targets compile against, for hosts that don't have it.
+ *
+ * There are no windows here: an editor only answers through the @c SciMessageTransport attached to its handle,
+ * no window is ever visible, and timers never fire. Only on the include path when not building for Windows.
+ */
+#include <cstdint>
+#include <cwchar>
+
+#define WINAPI
+#define CALLBACK
+#define __cdecl
+#define __stdcall
+#define __declspec(attr)
+
+typedef int BOOL;
+typedef unsigned char BYTE, UCHAR;
+typedef unsigned short WORD;
+typedef unsigned long DWORD, ULONG;
+typedef long LONG;
+typedef unsigned int UINT;
+typedef char CHAR;
+typedef wchar_t WCHAR, TCHAR;
+typedef intptr_t INT_PTR, LONG_PTR, LPARAM, LRESULT;
+typedef uintptr_t UINT_PTR, ULONG_PTR, DWORD_PTR, WPARAM;
+typedef void *HANDLE, *HWND, *HMODULE, *HINSTANCE, *HMENU, *HICON, *HBITMAP, *HFONT, *LPVOID;
+typedef const char *LPCSTR;
+typedef char *LPSTR;
+typedef const wchar_t *LPCWSTR, *LPCTSTR;
+typedef wchar_t *LPWSTR, *LPTSTR;
+typedef void(CALLBACK *TIMERPROC)(HWND, UINT, UINT_PTR, DWORD);
+
+#define TRUE 1
+#define FALSE 0
+#define MAX_PATH 260
+#define CP_ACP 0
+#define CP_UTF8 65001
+#define MB_ERR_INVALID_CHARS 0x8
+#define WC_ERR_INVALID_CHARS 0x80
+#define ERROR_SUCCESS 0L
+#define ERROR_INSUFFICIENT_BUFFER 122L
+#define ERROR_MOD_NOT_FOUND 126L
+#define WM_USER 0x0400
+#define WM_SETREDRAW 0x000B
+#define WM_TIMER 0x0113
+#define SMTO_NORMAL 0x0000
+#define SMTO_ABORTIFHUNG 0x0002
+#define USER_TIMER_MINIMUM 0x0000000A
+#define VK_ESCAPE 0x1B
+#define MB_OK 0x0L
+#define MB_OKCANCEL 0x1L
+#define MB_YESNO 0x4L
+#define MB_ICONERROR 0x10L
+#define MB_ICONWARNING 0x30L
+#define MB_ICONINFORMATION 0x40L
+#define IDOK 1
+#define IDYES 6
+#define LOWORD(l) (static_cast<WORD>(static_cast<DWORD_PTR>(l) & 0xffff))
+#define HIWORD(l) (static_cast<WORD>((static_cast<DWORD_PTR>(l) >> 16) & 0xffff))
+#define TEXT(s) L##s
+#define ARRAYSIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+#define DEFINE_ENUM_FLAG_OPERATORS(ENUMTYPE)                                                                      \
+	inline ENUMTYPE operator|(ENUMTYPE a, ENUMTYPE b) { return ENUMTYPE(int(a) | int(b)); }                        \
+	inline ENUMTYPE &operator|=(ENUMTYPE &a, ENUMTYPE b) { return a = a | b; }                                      \
+	inline ENUMTYPE operator&(ENUMTYPE a, ENUMTYPE b) { return ENUMTYPE(int(a) & int(b)); }                        \
+	inline ENUMTYPE &operator&=(ENUMTYPE &a, ENUMTYPE b) { return a = a & b; }                                      \
+	inline ENUMTYPE operator~(ENUMTYPE a) { return ENUMTYPE(~int(a)); }                                            \
+	inline ENUMTYPE operator^(ENUMTYPE a, ENUMTYPE b) { return ENUMTYPE(int(a) ^ int(b)); }                        \
+	inline ENUMTYPE &operator^=(ENUMTYPE &a, ENUMTYPE b) { return a = a ^ b; }
+
+/// @brief Delivers to the @c SciMessageTransport attached to @p hWnd, if any, or else answers 0.
+LRESULT SendMessageW(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
+/// Answers 0 and fails: there's no window to receive it
+LRESULT SendMessageTimeoutW(
+    HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam, UINT flags, UINT timeout, DWORD_PTR *result);
+BOOL PostMessageW(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
+BOOL IsWindowVisible(HWND hWnd);
+BOOL InvalidateRect(HWND hWnd, const void *rect, BOOL erase);
+HWND GetForegroundWindow();
+/// Returns a new ID each time; the timer never fires
+UINT_PTR SetTimer(HWND hWnd, UINT_PTR id, UINT elapse, TIMERPROC timerProc);
+BOOL KillTimer(HWND hWnd, UINT_PTR id);
+short GetAsyncKeyState(int key);
+BOOL MessageBeep(UINT type);
+int MessageBoxW(HWND hWnd, LPCWSTR text, LPCWSTR caption, UINT type);
+DWORD GetCurrentThreadId();
+DWORD GetCurrentProcessId();
+DWORD GetWindowThreadProcessId(HWND hWnd, DWORD *processId);
+DWORD GetModuleFileNameW(HMODULE hModule, LPWSTR fileName, DWORD size);
+DWORD GetLastError();
+void SetLastError(DWORD error);
+/// Reads any code page as Latin-1; @c TextConv handles UTF-8 itself
+int MultiByteToWideChar(UINT cp, DWORD flags, LPCSTR src, int srcLen, LPWSTR dest, int destLen);
+/// Writes any code page as Latin-1, with @c '?' for what it can't hold
+int WideCharToMultiByte(
+    UINT cp, DWORD flags, LPCWSTR src, int srcLen, LPSTR dest, int destLen, LPCSTR defaultChar, BOOL *usedDefault);
+#endif // ~WIN32_COMPAT_H
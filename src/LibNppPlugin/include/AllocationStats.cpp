@@ -0,0 +1,191 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <iomanip>
+#include <mutex>
+#include <new>
+#include <ostream>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "AllocationStats.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+/// Totals for one command
+struct CommandUsage {
+	uint64_t calls;
+	uint64_t allocations;
+	uint64_t largestPeak;
+	uint64_t lastPeak;
+};
+
+std::atomic<int64_t> bytesAllocated{ 0 };
+std::atomic<int64_t> peakAllocated{ 0 };
+std::atomic<uint64_t> allocationCount{ 0 };
+
+std::mutex usageLock;
+std::unordered_map<std::string_view, CommandUsage> commands;
+
+void raisePeak(int64_t bytes) noexcept;
+double toKb(uint64_t bytes) noexcept;
+}
+
+// --------------------------------------------------------------------------------------
+// AllocationStats::Scope
+// --------------------------------------------------------------------------------------
+AllocationStats::Usage AllocationStats::Scope::usage() const noexcept {
+	const int64_t peak = peakAllocated.load(std::memory_order_relaxed) - _baseline;
+	return Usage{ allocationCount.load(std::memory_order_relaxed) - _allocations,
+		static_cast<uint64_t>((std::max)(peak, int64_t{ 0 })) };
+}
+// --------------------------------------------------------------------------------------
+void AllocationStats::Scope::begin() noexcept {
+	_allocations = allocationCount.load(std::memory_order_relaxed);
+	_baseline = bytesAllocated.load(std::memory_order_relaxed);
+	_outerPeak = peakAllocated.exchange(_baseline, std::memory_order_relaxed);
+}
+// --------------------------------------------------------------------------------------
+void AllocationStats::Scope::end() noexcept {
+	const Usage used = usage();
+	// The enclosing scope saw this one's peak too
+	raisePeak(_outerPeak);
+	if (!_name)
+		return;
+
+	try {
+		std::lock_guard<std::mutex> lock{ usageLock };
+		CommandUsage &command = commands[_name];
+		++command.calls;
+		command.allocations += used.allocations;
+		command.largestPeak = (std::max)(command.largestPeak, used.peakBytes);
+		command.lastPeak = used.peakBytes;
+	} catch (...) {
+	}
+}
+
+// --------------------------------------------------------------------------------------
+// AllocationStats
+// --------------------------------------------------------------------------------------
+int64_t AllocationStats::bytesInUse() noexcept {
+	return bytesAllocated.load(std::memory_order_relaxed);
+}
+// --------------------------------------------------------------------------------------
+void AllocationStats::report(std::ostream &os) {
+	using Row = std::pair<std::string_view, CommandUsage>;
+	std::vector<Row> rows;
+	{
+		std::lock_guard<std::mutex> lock{ usageLock };
+		rows.assign(commands.begin(), commands.end());
+	}
+	std::sort(rows.begin(), rows.end(),
+	    [](Row const &a, Row const &b) { return a.second.largestPeak > b.second.largestPeak; });
+
+	os << "Memory in use: " << std::fixed << std::setprecision(1) << toKb(static_cast<uint64_t>(bytesInUse()))
+	   << " KB\n\n";
+	os << std::left << std::setw(32) << "command" << std::right << std::setw(10) << "calls" << std::setw(14)
+	   << "allocations" << std::setw(14) << "peak KB" << std::setw(14) << "last KB" << '\n';
+	for (Row const &row : rows) {
+		CommandUsage const &cmd = row.second;
+		os << std::left << std::setw(32) << row.first << std::right << std::setw(10) << cmd.calls << std::setw(14)
+		   << cmd.allocations << std::setw(14) << toKb(cmd.largestPeak) << std::setw(14) << toKb(cmd.lastPeak) << '\n';
+	}
+}
+// --------------------------------------------------------------------------------------
+void AllocationStats::reset() {
+	std::lock_guard<std::mutex> lock{ usageLock };
+	commands.clear();
+}
+
+#ifdef ALLOCATION_STATS
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+/// Every block starts with its size, padded to keep the rest suitably aligned
+constexpr size_t headerSize = (std::max)(sizeof(size_t), alignof(std::max_align_t));
+
+void *countedAlloc(size_t size) noexcept {
+	auto *block = static_cast<unsigned char *>(std::malloc(size + headerSize));
+	if (!block)
+		return nullptr;
+	*reinterpret_cast<size_t *>(block) = size;
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	raisePeak(bytesAllocated.fetch_add(static_cast<int64_t>(size), std::memory_order_relaxed) +
+	    static_cast<int64_t>(size));
+	return block + headerSize;
+}
+// --------------------------------------------------------------------------------------
+void countedFree(void *ptr) noexcept {
+	if (!ptr)
+		return;
+	unsigned char *block = static_cast<unsigned char *>(ptr) - headerSize;
+	bytesAllocated.fetch_sub(static_cast<int64_t>(*reinterpret_cast<size_t *>(block)), std::memory_order_relaxed);
+	std::free(block);
+}
+}
+
+// --------------------------------------------------------------------------------------
+// Global allocation functions
+// --------------------------------------------------------------------------------------
+void *operator new(std::size_t size) {
+	for (;;) {
+		if (void *ptr = countedAlloc(size))
+			return ptr;
+		std::new_handler handler = std::get_new_handler();
+		if (!handler)
+			throw std::bad_alloc{};
+		handler();
+	}
+}
+void *operator new[](std::size_t size) {
+	return ::operator new(size);
+}
+void *operator new(std::size_t size, std::nothrow_t const &) noexcept {
+	try {
+		return ::operator new(size);
+	} catch (...) {
+		return nullptr;
+	}
+}
+void *operator new[](std::size_t size, std::nothrow_t const &) noexcept {
+	return ::operator new(size, std::nothrow);
+}
+void operator delete(void *ptr) noexcept {
+	countedFree(ptr);
+}
+void operator delete[](void *ptr) noexcept {
+	countedFree(ptr);
+}
+void operator delete(void *ptr, std::size_t) noexcept {
+	countedFree(ptr);
+}
+void operator delete[](void *ptr, std::size_t) noexcept {
+	countedFree(ptr);
+}
+void operator delete(void *ptr, std::nothrow_t const &) noexcept {
+	countedFree(ptr);
+}
+void operator delete[](void *ptr, std::nothrow_t const &) noexcept {
+	countedFree(ptr);
+}
+#endif // ALLOCATION_STATS
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+void raisePeak(int64_t bytes) noexcept {
+	int64_t peak = peakAllocated.load(std::memory_order_relaxed);
+	while (bytes > peak && !peakAllocated.compare_exchange_weak(peak, bytes, std::memory_order_relaxed)) {
+	}
+}
+// --------------------------------------------------------------------------------------
+double toKb(uint64_t bytes) noexcept {
+	return static_cast<double>(bytes) / 1024.0;
+}
+}
@@ -0,0 +1,69 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#ifndef ALLOCATION_STATS_H
+#define ALLOCATION_STATS_H
+
+#include <cstdint>
+#include <iosfwd>
+
+/// @brief Counts the memory taken through @c operator @c new, and the high-water mark of each command.
+///
+/// Only compiled in when @c ALLOCATION_STATS is defined, since it replaces the global allocation functions of
+/// the module it's linked into; otherwise every scope is discarded at compile time.
+class AllocationStats final {
+
+public:
+#ifdef ALLOCATION_STATS
+	static constexpr bool enabled = true;
+#else
+	static constexpr bool enabled = false;
+#endif
+
+	/// Allocations and the most memory in use above the starting level, in bytes
+	struct Usage {
+		uint64_t allocations;
+		uint64_t peakBytes;
+	};
+
+	/// @brief Measures the allocations made, by any thread, between its construction and destruction.
+	/// The peak of a scope includes those of the scopes nested in it.
+	class Scope final {
+	public:
+		/// @param name If given, charges the usage to this command when the scope ends;
+		/// must outlive the statistics, e.g. a string literal
+		explicit Scope(const char *name = nullptr) noexcept : _name(name) {
+			if constexpr (enabled)
+				begin();
+		}
+		~Scope() {
+			if constexpr (enabled)
+				end();
+		}
+		Scope(const Scope &) = delete;
+		Scope &operator=(const Scope &) = delete;
+
+		/// @return The usage so far
+		Usage usage() const noexcept;
+
+	private:
+		void begin() noexcept;
+		void end() noexcept;
+
+		const char *_name;
+		uint64_t _allocations = 0;
+		int64_t _baseline = 0;
+		int64_t _outerPeak = 0;
+	};
+
+	/// @return The bytes currently allocated by the module
+	static int64_t bytesInUse() noexcept;
+	/// @brief Writes a table of the calls, allocations and peaks of each command, largest peak first.
+	static void report(std::ostream &os);
+	static void reset();
+};
+#endif // ~ALLOCATION_STATS_H
@@ -9,45 +9,127 @@
 #define HASHED_STRING_LIST_H
 
 #include <string>
+#include <string_view>
 #include <initializer_list>
-#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <cstdint>
 
 /// Quick and dirty C++ adaptation of Free Pascal's @c THashedStringList
 /// @see https://www.freepascal.org/docs-html/fcl/inifiles/thashedstringlist.html
+/// @note Entries are kept in one flat array, indexed by an open-addressing hash table; lookups take any
+/// string view and never allocate
 template <typename Str_T = std::string>
 struct HashedStringList {
+	using View_T = std::basic_string_view<typename Str_T::value_type>;
+	using Pair_T = std::pair<Str_T, Str_T>;
+
 	explicit HashedStringList() noexcept { nameValueSeparator = "="; }
 
+	/// @brief Builds the list in one pass from @p pairs, in any order; of any equal names, the last one wins.
+	explicit HashedStringList(std::vector<Pair_T> &&pairs) : HashedStringList() {
+		_entries.reserve(pairs.size());
+		reserve(pairs.size());
+		for (Pair_T &pair : pairs) {
+			const size_t hash = hashOf(pair.first);
+			const size_t slot = findSlot(pair.first, hash);
+			if (_slots[slot] != 0) {
+				_entries[_slots[slot] - 1].value = std::move(pair.second);
+				continue;
+			}
+			_entries.push_back(Entry{ std::move(pair.first), std::move(pair.second), hash });
+			_slots[slot] = static_cast<uint32_t>(_entries.size());
+		}
+	}
+
+	HashedStringList(HashedStringList &&) noexcept = default;
+	HashedStringList &operator=(HashedStringList &&) noexcept = default;
+	HashedStringList(HashedStringList const &) = delete;
+	HashedStringList &operator=(HashedStringList const &) = delete;
+
 	void addStrings(std::initializer_list<Str_T> source, bool clearFirst = false) {
 		if (clearFirst)
-			_strings.clear();
+			clear();
+		reserve(_entries.size() + source.size());
 		for (Str_T const &str : source) {
 			size_t delim = str.find_first_of(nameValueSeparator);
 			addPair(str.substr(0, delim), str.substr(delim + 1));
 		}
 	}
 
-	HashedStringList operator=(HashedStringList<Str_T> const &source) {
-		if (source)
-			_strings.clear();
-		for (auto &&pair : source._strings)
-			addPair(pair.first, pair.second);
-		return *this;
+	Str_T const &operator[](View_T key) const noexcept {
+		if (_entries.empty())
+			return _empty;
+		const uint32_t index = _slots[findSlot(key, hashOf(key))];
+		return (index != 0) ? _entries[index - 1].value : _empty;
 	}
 
-	Str_T const &operator[](Str_T const &key) const {
-		auto it = _strings.find(key);
-		return (it != _strings.end() ? it->second : _empty);
+	explicit operator bool() const noexcept { return !_entries.empty(); }
+	size_t size() const noexcept { return _entries.size(); }
+
+	Str_T &addPair(Str_T key, Str_T val) {
+		reserve(_entries.size() + 1);
+		const size_t hash = hashOf(key);
+		const size_t slot = findSlot(key, hash);
+		if (_slots[slot] != 0)
+			return _entries[_slots[slot] - 1].value = std::move(val);
+		_entries.push_back(Entry{ std::move(key), std::move(val), hash });
+		_slots[slot] = static_cast<uint32_t>(_entries.size());
+		return _entries.back().value;
 	}
 
-	operator bool() const noexcept { return !_strings.empty(); }
-	Str_T &addPair(Str_T const &key, Str_T const &val) { return _strings[key] = val; }
+	void clear() noexcept {
+		_entries.clear();
+		_slots.clear();
+	}
 
 	Str_T nameValueSeparator;
 
 private:
-	std::unordered_map<Str_T, Str_T> _strings;
+	struct Entry {
+		Str_T name;
+		Str_T value;
+		size_t hash;
+	};
+
+	static constexpr size_t minSlots = 16;
+	std::vector<Entry> _entries;
+	/// 1-based indices into @c _entries, or 0 for an empty slot; never more than half full
+	std::vector<uint32_t> _slots;
 	Str_T _empty{};
+
+	static size_t hashOf(View_T key) noexcept { return std::hash<View_T>{}(key); }
+
+	size_t findSlot(View_T key, size_t hash) const noexcept {
+		const size_t mask = _slots.size() - 1;
+		size_t slot = hash & mask;
+		while (_slots[slot] != 0) {
+			Entry const &entry = _entries[_slots[slot] - 1];
+			if (entry.hash == hash && View_T{ entry.name } == key)
+				break;
+			slot = (slot + 1) & mask;
+		}
+		return slot;
+	}
+
+	size_t emptySlot(size_t hash) const noexcept {
+		const size_t mask = _slots.size() - 1;
+		size_t slot = hash & mask;
+		while (_slots[slot] != 0)
+			slot = (slot + 1) & mask;
+		return slot;
+	}
+
+	void reserve(size_t count) {
+		size_t nSlots = minSlots;
+		while (nSlots < count * 2)
+			nSlots <<= 1;
+		if (nSlots <= _slots.size())
+			return;
+		_slots.assign(nSlots, 0);
+		for (size_t i = 0; i < _entries.size(); i++)
+			_slots[emptySlot(_entries[i].hash)] = static_cast<uint32_t>(i + 1);
+	}
 };
 
 template <>
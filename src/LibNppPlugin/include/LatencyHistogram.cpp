@@ -0,0 +1,180 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#include <algorithm>
+#include <iomanip>
+#include <istream>
+#include <memory>
+#include <ostream>
+#include <vector>
+#include "LatencyHistogram.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+constexpr char histogramsSignature[] = "LATENCY-HISTOGRAMS";
+constexpr int histogramsVersion = 1;
+
+std::atomic<LatencyHistogram *> histograms{ nullptr };
+
+double toMs(uint64_t ns) noexcept;
+}
+
+// --------------------------------------------------------------------------------------
+// LatencyHistogram
+// --------------------------------------------------------------------------------------
+LatencyHistogram &LatencyHistogram::named(std::string_view name) {
+	LatencyHistogram *head = histograms.load(std::memory_order_acquire);
+	for (LatencyHistogram *histogram = head; histogram; histogram = histogram->_next) {
+		if (histogram->_name == name)
+			return *histogram;
+	}
+
+	std::unique_ptr<LatencyHistogram> created{ new LatencyHistogram(name) };
+	for (;;) {
+		created->_next = head;
+		if (histograms.compare_exchange_weak(head, created.get(), std::memory_order_release, std::memory_order_acquire))
+			return *created.release();
+		// Someone else got in first; they might have added this very name
+		for (LatencyHistogram *histogram = head; histogram != created->_next; histogram = histogram->_next) {
+			if (histogram->_name == name)
+				return *histogram;
+		}
+	}
+}
+// --------------------------------------------------------------------------------------
+void LatencyHistogram::forEach(std::function<void(LatencyHistogram &)> const &fn) {
+	for (LatencyHistogram *histogram = histograms.load(std::memory_order_acquire); histogram;
+	     histogram = histogram->_next)
+		fn(*histogram);
+}
+// --------------------------------------------------------------------------------------
+void LatencyHistogram::record(uint64_t ns) noexcept {
+	_buckets[indexOf(ns)].fetch_add(1, std::memory_order_relaxed);
+	_count.fetch_add(1, std::memory_order_relaxed);
+	_total.fetch_add(ns, std::memory_order_relaxed);
+	uint64_t longest = _max.load(std::memory_order_relaxed);
+	while (ns > longest && !_max.compare_exchange_weak(longest, ns, std::memory_order_relaxed)) {
+	}
+}
+// --------------------------------------------------------------------------------------
+uint64_t LatencyHistogram::percentile(double fraction) const noexcept {
+	uint64_t recorded = 0;
+	for (auto const &bucket : _buckets)
+		recorded += bucket.load(std::memory_order_relaxed);
+	if (recorded == 0)
+		return 0;
+
+	const auto target = (std::max)(uint64_t{ 1 },
+	    static_cast<uint64_t>(std::clamp(fraction, 0.0, 1.0) * static_cast<double>(recorded) + 0.5));
+	uint64_t seen = 0;
+	for (size_t i = 0; i < bucketCount; ++i) {
+		seen += _buckets[i].load(std::memory_order_relaxed);
+		if (seen >= target)
+			return (std::min)(highestEquivalent(i), longest());
+	}
+	return longest();
+}
+// --------------------------------------------------------------------------------------
+void LatencyHistogram::reset() noexcept {
+	for (auto &bucket : _buckets)
+		bucket.store(0, std::memory_order_relaxed);
+	_count.store(0, std::memory_order_relaxed);
+	_total.store(0, std::memory_order_relaxed);
+	_max.store(0, std::memory_order_relaxed);
+}
+// --------------------------------------------------------------------------------------
+void LatencyHistogram::report(std::ostream &os) {
+	std::vector<LatencyHistogram *> rows;
+	forEach([&rows](LatencyHistogram &histogram) {
+		if (histogram.count() > 0)
+			rows.push_back(&histogram);
+	});
+	std::sort(rows.begin(), rows.end(), [](auto const *a, auto const *b) { return a->total() > b->total(); });
+
+	os << std::left << std::setw(36) << "command / notification" << std::right << std::setw(10) << "count"
+	   << std::setw(12) << "p50 ms" << std::setw(12) << "p95 ms" << std::setw(12) << "p99 ms" << std::setw(12)
+	   << "max ms" << std::setw(14) << "total ms" << '\n'
+	   << std::fixed << std::setprecision(3);
+	for (LatencyHistogram const *row : rows) {
+		os << std::left << std::setw(36) << row->name() << std::right << std::setw(10) << row->count()
+		   << std::setw(12) << toMs(row->percentile(0.5)) << std::setw(12) << toMs(row->percentile(0.95))
+		   << std::setw(12) << toMs(row->percentile(0.99)) << std::setw(12) << toMs(row->longest()) << std::setw(14)
+		   << toMs(row->total()) << '\n';
+	}
+}
+// --------------------------------------------------------------------------------------
+void LatencyHistogram::save(std::ostream &os) {
+	os << histogramsSignature << ' ' << histogramsVersion << '\n';
+	forEach([&os](LatencyHistogram &histogram) {
+		if (histogram.count() == 0)
+			return;
+		size_t used = 0;
+		for (auto const &bucket : histogram._buckets)
+			used += bucket.load(std::memory_order_relaxed) ? 1 : 0;
+		os << histogram._name << ' ' << histogram.count() << ' ' << histogram.total() << ' ' << histogram.longest()
+		   << ' ' << used << '\n';
+		for (size_t i = 0; i < bucketCount; ++i) {
+			if (const uint32_t n = histogram._buckets[i].load(std::memory_order_relaxed))
+				os << i << ' ' << n << ' ';
+		}
+		os << '\n';
+	});
+}
+// --------------------------------------------------------------------------------------
+bool LatencyHistogram::load(std::istream &is) {
+	std::string field;
+	int version = 0;
+	if (!(is >> field >> version) || field != histogramsSignature || version != histogramsVersion)
+		return false;
+
+	std::string name;
+	uint64_t count = 0, total = 0, longest = 0;
+	size_t used = 0;
+	while (is >> name >> count >> total >> longest >> used) {
+		LatencyHistogram &histogram = named(name);
+		for (size_t i = 0; i < used; ++i) {
+			size_t index = 0;
+			uint32_t n = 0;
+			if (!(is >> index >> n) || index >= bucketCount)
+				return false;
+			histogram._buckets[index].fetch_add(n, std::memory_order_relaxed);
+		}
+		histogram._count.fetch_add(count, std::memory_order_relaxed);
+		histogram._total.fetch_add(total, std::memory_order_relaxed);
+		uint64_t current = histogram.longest();
+		while (longest > current && !histogram._max.compare_exchange_weak(current, longest)) {
+		}
+	}
+	return is.eof();
+}
+// --------------------------------------------------------------------------------------
+size_t LatencyHistogram::indexOf(uint64_t ns) noexcept {
+	// The first 2 * 32 values have a bucket each; every doubling after that is split into 32 buckets
+	constexpr uint64_t linearRange = 2ULL << subBucketBits;
+	uint64_t value = (std::min)(ns, (uint64_t{ 1 } << maxMagnitude) - 1);
+	size_t shift = 0;
+	while (value >= linearRange) {
+		value >>= 1;
+		++shift;
+	}
+	return (shift << subBucketBits) + static_cast<size_t>(value);
+}
+// --------------------------------------------------------------------------------------
+uint64_t LatencyHistogram::highestEquivalent(size_t index) noexcept {
+	if (index < (2ULL << subBucketBits))
+		return index;
+	const size_t shift = (index >> subBucketBits) - 1;
+	const uint64_t value = index - (shift << subBucketBits);
+	return ((value + 1) << shift) - 1;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+double toMs(uint64_t ns) noexcept {
+	return static_cast<double>(ns) / 1e6;
+}
+}
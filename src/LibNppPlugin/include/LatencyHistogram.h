@@ -0,0 +1,79 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <string_view>
+
+/// @brief A log-linear (HDR-style) histogram of durations, which any thread can record into without locking.
+///
+/// Durations are kept to within 1/32 (about 3%) of their true value, up to almost 5 hours.
+class LatencyHistogram final {
+
+public:
+	using Clock = std::chrono::steady_clock;
+
+	/// Records the time between its construction and destruction
+	class Timer final {
+	public:
+		explicit Timer(LatencyHistogram &histogram) noexcept : _histogram(histogram), _started(Clock::now()) {}
+		~Timer() {
+			_histogram.record(static_cast<uint64_t>(
+			    std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - _started).count()));
+		}
+		Timer(const Timer &) = delete;
+		Timer &operator=(const Timer &) = delete;
+
+	private:
+		LatencyHistogram &_histogram;
+		Clock::time_point _started;
+	};
+
+	/// @brief Returns the histogram called @p name, creating it on first use.
+	/// @note Histograms are never freed, so references to them stay valid until the process exits
+	static LatencyHistogram &named(std::string_view name);
+	static void forEach(std::function<void(LatencyHistogram &)> const &fn);
+
+	void record(uint64_t ns) noexcept;
+	/// @return The duration that @p fraction of the recorded ones didn't exceed, in nanoseconds
+	uint64_t percentile(double fraction) const noexcept;
+	uint64_t count() const noexcept { return _count.load(std::memory_order_relaxed); }
+	uint64_t longest() const noexcept { return _max.load(std::memory_order_relaxed); }
+	uint64_t total() const noexcept { return _total.load(std::memory_order_relaxed); }
+	std::string const &name() const noexcept { return _name; }
+	void reset() noexcept;
+
+	/// @brief Writes a table of the count, p50, p95, p99 and maximum of every histogram, slowest first.
+	static void report(std::ostream &os);
+	/// @brief Writes every histogram, so that @c load can add them to those of a later session.
+	static void save(std::ostream &os);
+	static bool load(std::istream &is);
+
+private:
+	explicit LatencyHistogram(std::string_view name) : _name(name) {}
+	static size_t indexOf(uint64_t ns) noexcept;
+	static uint64_t highestEquivalent(size_t index) noexcept;
+
+	static constexpr unsigned subBucketBits = 5;
+	static constexpr unsigned maxMagnitude = 44;
+	static constexpr size_t bucketCount = (maxMagnitude - subBucketBits + 2) << subBucketBits;
+
+	std::string _name;
+	LatencyHistogram *_next = nullptr;
+	std::atomic<uint64_t> _count{ 0 };
+	std::atomic<uint64_t> _total{ 0 };
+	std::atomic<uint64_t> _max{ 0 };
+	std::atomic<uint32_t> _buckets[bucketCount]{};
+};
+#endif // ~LATENCY_HISTOGRAM_H
@@ -0,0 +1,826 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+#include "SciMemoryDocument.h"
+
+using namespace SciTextObjects;
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+std::string translatePattern(const char *pattern, bool posix);
+Sci_Position countLines(const char *bytes, size_t len) noexcept;
+bool isWordByte(char ch) noexcept;
+bool sameByte(char a, char b, bool matchCase) noexcept;
+}
+
+// --------------------------------------------------------------------------------------
+// SciTextObjects::SciMemoryDocument
+// --------------------------------------------------------------------------------------
+sptr_t SciMemoryDocument::send(unsigned msg, uptr_t wParam, sptr_t lParam) {
+	const auto pos = static_cast<Sci_Position>(wParam);
+	char *buffer = reinterpret_cast<char *>(lParam);
+	const char *bytes = reinterpret_cast<const char *>(lParam);
+
+	switch (msg) {
+		// Text
+		case SCI_GETLENGTH:
+		case SCI_GETTEXTLENGTH:
+			return length();
+		case SCI_GETCHARAT:
+			return (pos < 0 || pos >= length()) ? 0 : static_cast<sptr_t>(_text.at(static_cast<size_t>(pos)));
+		case SCI_GETTEXT: {
+			if (!buffer)
+				return length();
+			const Sci_Position len = (std::min)(pos, length());
+			_text.copy(0, static_cast<size_t>(len), buffer);
+			buffer[len] = '\0';
+			return len;
+		}
+		case SCI_SETTEXT:
+			replaceRange(0, length(), bytes, static_cast<Sci_Position>(std::strlen(bytes)), false);
+			setSelection(0, 0);
+			return 0;
+		case SCI_CLEARALL:
+			deleteBytes(0, length());
+			setSelection(0, 0);
+			return 0;
+		case SCI_GETTEXTRANGE: {
+			auto *tr = reinterpret_cast<Sci_TextRange *>(lParam);
+			return getRange(tr->chrg.cpMin, tr->chrg.cpMax, tr->lpstrText);
+		}
+		case SCI_GETTEXTRANGEFULL: {
+			auto *tr = reinterpret_cast<Sci_TextRangeFull *>(lParam);
+			return getRange(tr->chrg.cpMin, tr->chrg.cpMax, tr->lpstrText);
+		}
+		case SCI_GETCHARACTERPOINTER:
+			return reinterpret_cast<sptr_t>(_text.data());
+		case SCI_GETRANGEPOINTER:
+			return reinterpret_cast<sptr_t>(_text.data() + clamp(pos));
+		case SCI_GETDOCPOINTER:
+			return reinterpret_cast<sptr_t>(this);
+		case SCI_INSERTTEXT:
+			insertBytes(pos < 0 ? mainSelection().caret : clamp(pos), bytes,
+			    static_cast<Sci_Position>(std::strlen(bytes)));
+			return 0;
+		case SCI_ADDTEXT: {
+			const Sci_Position caret = mainSelection().caret;
+			insertBytes(caret, bytes, pos);
+			setSelection(caret + pos, caret + pos);
+			return 0;
+		}
+		case SCI_APPENDTEXT:
+			insertBytes(length(), bytes, pos);
+			return 0;
+		case SCI_DELETERANGE:
+			deleteBytes(clamp(pos), static_cast<Sci_Position>(lParam));
+			return 0;
+		case SCI_REPLACESEL: {
+			const Sci_Position startPos = mainSelection().start();
+			const Sci_Position len = replaceRange(
+			    startPos, mainSelection().end(), bytes, static_cast<Sci_Position>(std::strlen(bytes)), false);
+			setSelection(startPos + len, startPos + len);
+			return 0;
+		}
+		case SCI_GETSELTEXT: {
+			const Selection sel = mainSelection();
+			return getRange(sel.start(), sel.end(), buffer);
+		}
+		case SCI_GETCURLINE: {
+			const Sci_Position caret = mainSelection().caret;
+			const Sci_Position lineStart = positionFromLine(lineFromPosition(caret));
+			if (buffer && pos > 0) {
+				const Sci_Position lineEnd = positionAfter(lineEndPosition(lineFromPosition(caret)));
+				getRange(lineStart, (std::min)(lineEnd, lineStart + pos - 1), buffer);
+			}
+			return caret - lineStart;
+		}
+
+		// Searching and replacing
+		case SCI_FINDTEXT: {
+			auto *ttf = reinterpret_cast<Sci_TextToFind *>(lParam);
+			Sci_Position matchEnd = 0;
+			const Sci_Position found = findText(static_cast<int>(wParam), ttf->chrg.cpMin,
+			    ttf->chrg.cpMax < 0 ? length() : ttf->chrg.cpMax, ttf->lpstrText, matchEnd);
+			if (found >= 0) {
+				ttf->chrgText.cpMin = static_cast<Sci_PositionCR>(found);
+				ttf->chrgText.cpMax = static_cast<Sci_PositionCR>(matchEnd);
+			}
+			return found;
+		}
+		case SCI_FINDTEXTFULL: {
+			auto *ttf = reinterpret_cast<Sci_TextToFindFull *>(lParam);
+			Sci_Position matchEnd = 0;
+			const Sci_Position found = findText(static_cast<int>(wParam), ttf->chrg.cpMin,
+			    ttf->chrg.cpMax < 0 ? length() : ttf->chrg.cpMax, ttf->lpstrText, matchEnd);
+			if (found >= 0) {
+				ttf->chrgText.cpMin = found;
+				ttf->chrgText.cpMax = matchEnd;
+			}
+			return found;
+		}
+		case SCI_SETTARGETSTART:
+			_targetStart = pos;
+			return 0;
+		case SCI_SETTARGETEND:
+			_targetEnd = pos;
+			return 0;
+		case SCI_SETTARGETRANGE:
+			_targetStart = pos;
+			_targetEnd = static_cast<Sci_Position>(lParam);
+			return 0;
+		case SCI_GETTARGETSTART:
+			return _targetStart;
+		case SCI_GETTARGETEND:
+			return _targetEnd;
+		case SCI_TARGETWHOLEDOCUMENT:
+			_targetStart = 0;
+			_targetEnd = length();
+			return 0;
+		case SCI_TARGETFROMSELECTION:
+			_targetStart = mainSelection().start();
+			_targetEnd = mainSelection().end();
+			return 0;
+		case SCI_SETSEARCHFLAGS:
+			_searchFlags = static_cast<int>(wParam);
+			return 0;
+		case SCI_GETSEARCHFLAGS:
+			return _searchFlags;
+		case SCI_SEARCHINTARGET: {
+			const std::string pattern(bytes, static_cast<size_t>(pos));
+			Sci_Position matchEnd = 0;
+			const Sci_Position found = findText(_searchFlags, _targetStart, _targetEnd, pattern.c_str(), matchEnd);
+			if (found >= 0) {
+				_targetStart = found;
+				_targetEnd = matchEnd;
+			}
+			return found;
+		}
+		case SCI_REPLACETARGET:
+		case SCI_REPLACETARGETMINIMAL: {
+			const auto len = static_cast<sptr_t>(wParam) < 0 ? static_cast<Sci_Position>(std::strlen(bytes)) : pos;
+			replaceRange(_targetStart, _targetEnd, bytes, len, msg == SCI_REPLACETARGETMINIMAL);
+			_targetEnd = clamp(_targetStart) + len;
+			return len;
+		}
+
+		// Selection and caret
+		case SCI_GETCURRENTPOS:
+			return mainSelection().caret;
+		case SCI_GETANCHOR:
+			return mainSelection().anchor;
+		case SCI_SETCURRENTPOS:
+			setSelection(clamp(pos), mainSelection().anchor);
+			return 0;
+		case SCI_SETANCHOR:
+			setSelection(mainSelection().caret, clamp(pos));
+			return 0;
+		case SCI_GOTOPOS:
+			setSelection(clamp(pos), clamp(pos));
+			return 0;
+		case SCI_GOTOLINE: {
+			const Sci_Position lineStart = positionFromLine((std::max)(Sci_Position(0), pos));
+			const Sci_Position caret = lineStart < 0 ? length() : lineStart;
+			setSelection(caret, caret);
+			return 0;
+		}
+		case SCI_SETSEL: {
+			const Sci_Position caret = (lParam < 0) ? length() : clamp(static_cast<Sci_Position>(lParam));
+			setSelection(caret, pos < 0 ? caret : clamp(pos));
+			return 0;
+		}
+		case SCI_SETSELECTION:
+			setSelection(clamp(pos), clamp(static_cast<Sci_Position>(lParam)));
+			return 0;
+		case SCI_ADDSELECTION:
+			_selections.push_back(Selection{ clamp(pos), clamp(static_cast<Sci_Position>(lParam)) });
+			_mainSelection = _selections.size() - 1;
+			return 0;
+		case SCI_CLEARSELECTIONS:
+			setSelection(0, 0);
+			return 0;
+		case SCI_GETSELECTIONS:
+			return static_cast<sptr_t>(_selections.size());
+		case SCI_GETMAINSELECTION:
+			return static_cast<sptr_t>(_mainSelection);
+		case SCI_SETMAINSELECTION:
+			if (wParam < _selections.size())
+				_mainSelection = static_cast<size_t>(wParam);
+			return 0;
+		case SCI_GETSELECTIONNSTART:
+			return wParam < _selections.size() ? _selections[wParam].start() : INVALID_POSITION;
+		case SCI_GETSELECTIONNEND:
+			return wParam < _selections.size() ? _selections[wParam].end() : INVALID_POSITION;
+		case SCI_GETSELECTIONNCARET:
+			return wParam < _selections.size() ? _selections[wParam].caret : INVALID_POSITION;
+		case SCI_GETSELECTIONNANCHOR:
+			return wParam < _selections.size() ? _selections[wParam].anchor : INVALID_POSITION;
+		case SCI_GETSELECTIONSTART:
+			return mainSelection().start();
+		case SCI_GETSELECTIONEND:
+			return mainSelection().end();
+		case SCI_SETSELECTIONSTART:
+			setSelection((std::max)(mainSelection().caret, clamp(pos)), clamp(pos));
+			return 0;
+		case SCI_SETSELECTIONEND:
+			setSelection(clamp(pos), (std::min)(mainSelection().anchor, clamp(pos)));
+			return 0;
+		case SCI_SETSELECTIONMODE:
+		case SCI_CHANGESELECTIONMODE:
+			_selectionMode = static_cast<int>(wParam);
+			return 0;
+		case SCI_GETSELECTIONMODE:
+			return _selectionMode;
+		case SCI_SELECTIONISRECTANGLE:
+			return _selectionMode == SC_SEL_RECTANGLE || _selectionMode == SC_SEL_THIN;
+
+		// Lines and positions
+		case SCI_GETLINECOUNT:
+			return lineCount();
+		case SCI_LINEFROMPOSITION:
+			return lineFromPosition(pos);
+		case SCI_POSITIONFROMLINE:
+			return positionFromLine(pos);
+		case SCI_GETLINEENDPOSITION:
+			return lineEndPosition(pos);
+		case SCI_LINELENGTH:
+			return (pos < 0 || pos >= lineCount()) ? 0
+			                                       : ((pos + 1 < lineCount()) ? positionFromLine(pos + 1) : length()) -
+			                                             positionFromLine(pos);
+		case SCI_GETCOLUMN:
+			return column(clamp(pos));
+		case SCI_POSITIONBEFORE:
+			return positionBefore(clamp(pos));
+		case SCI_POSITIONAFTER:
+			return positionAfter(clamp(pos));
+		case SCI_GETLINEINDENTATION:
+			return lineIndentation(pos);
+		case SCI_SETLINEINDENTATION:
+			setLineIndentation(pos, static_cast<int>(lParam));
+			return 0;
+		case SCI_GETLINEINDENTPOSITION: {
+			Sci_Position indentPos = positionFromLine(pos);
+			const Sci_Position lineEnd = lineEndPosition(pos);
+			while (indentPos >= 0 && indentPos < lineEnd &&
+			       (_text.at(static_cast<size_t>(indentPos)) == ' ' || _text.at(static_cast<size_t>(indentPos)) == '\t'))
+				++indentPos;
+			return indentPos;
+		}
+		case SCI_SETTABWIDTH:
+			_tabWidth = (std::max)(1, static_cast<int>(wParam));
+			return 0;
+		case SCI_GETTABWIDTH:
+			return _tabWidth;
+		case SCI_SETUSETABS:
+			_useTabs = (wParam != 0);
+			return 0;
+		case SCI_GETUSETABS:
+			return _useTabs;
+		case SCI_GETEOLMODE:
+			return SC_EOL_CRLF;
+
+		// Undo
+		case SCI_BEGINUNDOACTION:
+			if (_undoDepth++ == 0 && _collectUndo)
+				_undoGroups.emplace_back();
+			return 0;
+		case SCI_ENDUNDOACTION:
+			endUndoGroup();
+			return 0;
+		case SCI_UNDO:
+			undo();
+			return 0;
+		case SCI_CANUNDO:
+			return std::any_of(
+			    _undoGroups.begin(), _undoGroups.end(), [](std::vector<UndoStep> const &group) { return !group.empty(); });
+		case SCI_EMPTYUNDOBUFFER:
+			_undoGroups.clear();
+			_savePoint = 0;
+			return 0;
+		case SCI_SETUNDOCOLLECTION:
+			_collectUndo = (wParam != 0);
+			return 0;
+		case SCI_GETUNDOCOLLECTION:
+			return _collectUndo;
+		case SCI_SETSAVEPOINT:
+			_savePoint = _undoGroups.size();
+			return 0;
+		case SCI_GETMODIFY:
+			return _savePoint != _undoGroups.size();
+
+		// Document state
+		case SCI_GETMODEVENTMASK:
+			return _modEventMask;
+		case SCI_SETMODEVENTMASK:
+			_modEventMask = static_cast<int>(wParam);
+			return 0;
+		case SCI_GETCODEPAGE:
+			return _codePage;
+		case SCI_SETCODEPAGE:
+			_codePage = static_cast<int>(wParam);
+			return 0;
+		case SCI_GETREADONLY:
+			return _readOnly;
+		case SCI_SETREADONLY:
+			_readOnly = (wParam != 0);
+			return 0;
+		case SCI_GETENDSTYLED:
+			return _endStyled;
+		case SCI_STARTSTYLING:
+			_endStyled = clamp(pos);
+			return 0;
+		case SCI_SETSTYLING:
+			_endStyled = clamp(_endStyled + pos);
+			return 0;
+
+		// Nothing to display
+		case SCI_LINESONSCREEN:
+			return lineCount();
+		case SCI_SELECTIONFROMPOINT:
+			return -1;
+		default:
+			return 0;
+	}
+}
+// --------------------------------------------------------------------------------------
+void SciMemoryDocument::setText(std::string const &text) {
+	const bool collectUndo = _collectUndo;
+	_collectUndo = false;
+	replaceRange(0, length(), text.data(), static_cast<Sci_Position>(text.size()), false);
+	_collectUndo = collectUndo;
+	_undoGroups.clear();
+	_savePoint = 0;
+	setSelection(0, 0);
+}
+// --------------------------------------------------------------------------------------
+std::string SciMemoryDocument::text() const {
+	std::string result(_text.length(), '\0');
+	_text.copy(0, result.size(), &result[0]);
+	return result;
+}
+// --------------------------------------------------------------------------------------
+void SciMemoryDocument::insertBytes(Sci_Position pos, const char *src, Sci_Position len, int source) {
+	if (_readOnly || len <= 0)
+		return;
+
+	// The source may point into our own buffer, e.g. from SCI_GETCHARACTERPOINTER
+	std::string inserted(src, static_cast<size_t>(len));
+	_text.insert(static_cast<size_t>(pos), inserted.data(), inserted.size());
+	_lineStartsValid = false;
+	++_modifications;
+
+	for (auto &&sel : _selections) {
+		if (sel.caret > pos)
+			sel.caret += len;
+		if (sel.anchor > pos)
+			sel.anchor += len;
+	}
+	_endStyled = (std::min)(_endStyled, pos);
+
+	int startAction = 0;
+	if (source == SC_PERFORMED_USER && _collectUndo) {
+		if (_undoDepth == 0 || _undoGroups.empty())
+			_undoGroups.emplace_back();
+		startAction = _undoGroups.back().empty() ? SC_STARTACTION : 0;
+		_undoGroups.back().push_back(UndoStep{ true, pos, inserted });
+	}
+	notify(SC_MOD_INSERTTEXT | source | startAction, pos, len, inserted.data(),
+	    countLines(inserted.data(), inserted.size()));
+}
+// --------------------------------------------------------------------------------------
+void SciMemoryDocument::deleteBytes(Sci_Position pos, Sci_Position len, int source) {
+	len = (std::min)(len, length() - pos);
+	if (_readOnly || len <= 0)
+		return;
+
+	std::string deleted(static_cast<size_t>(len), '\0');
+	_text.copy(static_cast<size_t>(pos), deleted.size(), &deleted[0]);
+	_text.erase(static_cast<size_t>(pos), deleted.size());
+	_lineStartsValid = false;
+	++_modifications;
+
+	const Sci_Position deletedEnd = pos + len;
+	auto shift = [pos, len, deletedEnd](Sci_Position &p) {
+		if (p >= deletedEnd)
+			p -= len;
+		else if (p > pos)
+			p = pos;
+	};
+	for (auto &&sel : _selections) {
+		shift(sel.caret);
+		shift(sel.anchor);
+	}
+	_endStyled = (std::min)(_endStyled, pos);
+
+	int startAction = 0;
+	if (source == SC_PERFORMED_USER && _collectUndo) {
+		if (_undoDepth == 0 || _undoGroups.empty())
+			_undoGroups.emplace_back();
+		startAction = _undoGroups.back().empty() ? SC_STARTACTION : 0;
+		_undoGroups.back().push_back(UndoStep{ false, pos, deleted });
+	}
+	notify(SC_MOD_DELETETEXT | source | startAction, pos, len, deleted.data(),
+	    -countLines(deleted.data(), deleted.size()));
+}
+// --------------------------------------------------------------------------------------
+void SciMemoryDocument::notify(
+    int modificationType, Sci_Position pos, Sci_Position len, const char *bytes, Sci_Position linesAdded) {
+	if (!_listener || (modificationType & _modEventMask) == 0)
+		return;
+
+	SCNotification scn{};
+	scn.nmhdr.hwndFrom = this;
+	scn.nmhdr.code = SCN_MODIFIED;
+	scn.modificationType = modificationType;
+	scn.position = pos;
+	scn.length = len;
+	scn.text = bytes;
+	scn.linesAdded = linesAdded;
+	_listener(scn);
+}
+// --------------------------------------------------------------------------------------
+Sci_Position SciMemoryDocument::replaceRange(
+    Sci_Position startPos, Sci_Position endPos, const char *src, Sci_Position len, bool minimal) {
+	startPos = clamp(startPos);
+	endPos = (std::max)(startPos, clamp(endPos));
+	if (_readOnly)
+		return 0;
+
+	Sci_Position skipStart = 0, skipEnd = 0;
+	if (minimal) {
+		// Leave the text both versions share alone, like SCI_REPLACETARGETMINIMAL
+		const Sci_Position common = (std::min)(len, endPos - startPos);
+		while (skipStart < common && _text.at(static_cast<size_t>(startPos + skipStart)) == src[skipStart])
+			++skipStart;
+		while (skipEnd < common - skipStart &&
+		       _text.at(static_cast<size_t>(endPos - skipEnd - 1)) == src[len - skipEnd - 1])
+			++skipEnd;
+	}
+
+	const bool grouped = (_undoDepth == 0);
+	if (grouped)
+		send(SCI_BEGINUNDOACTION);
+	deleteBytes(startPos + skipStart, endPos - startPos - skipStart - skipEnd);
+	insertBytes(startPos + skipStart, src + skipStart, len - skipStart - skipEnd);
+	if (grouped)
+		send(SCI_ENDUNDOACTION);
+	return len;
+}
+// --------------------------------------------------------------------------------------
+Sci_Position SciMemoryDocument::findText(
+    int flags, Sci_Position minPos, Sci_Position maxPos, const char *pattern, Sci_Position &matchEnd) {
+	const bool backwards = minPos > maxPos;
+	const Sci_Position lo = clamp((std::min)(minPos, maxPos)), hi = clamp((std::max)(minPos, maxPos));
+	const bool matchCase = (flags & SCFIND_MATCHCASE) != 0;
+	const char *text = _text.data();
+
+	if (flags & SCFIND_REGEXP) {
+		try {
+			// Searches tend to repeat the same pattern, so keep the last one compiled
+			if (_regexFlags != flags || _regexPattern != pattern) {
+				auto syntax = std::regex::ECMAScript;
+				if (!matchCase)
+					syntax |= std::regex::icase;
+				_regex = std::regex(translatePattern(pattern, (flags & SCFIND_POSIX) != 0), syntax);
+				_regexPattern = pattern;
+				_regexFlags = flags;
+			}
+			auto matchFlags = std::regex_constants::match_default;
+			if (lo > 0)
+				matchFlags |= std::regex_constants::match_prev_avail;
+
+			Sci_Position found = INVALID_POSITION;
+			for (std::cregex_iterator it(text + lo, text + hi, _regex, matchFlags), last; it != last; ++it) {
+				found = lo + static_cast<Sci_Position>(it->position());
+				matchEnd = found + static_cast<Sci_Position>(it->length());
+				if (!backwards)
+					break;
+			}
+			return found;
+		} catch (std::regex_error const &) {
+			return INVALID_POSITION;
+		}
+	}
+
+	const auto needleLen = static_cast<Sci_Position>(std::strlen(pattern));
+	if (needleLen > hi - lo)
+		return INVALID_POSITION;
+
+	auto matchesAt = [&](Sci_Position at) {
+		for (Sci_Position i = 0; i < needleLen; ++i) {
+			if (!sameByte(text[at + i], pattern[i], matchCase))
+				return false;
+		}
+		if ((flags & (SCFIND_WHOLEWORD | SCFIND_WORDSTART)) && at > 0 && isWordByte(text[at - 1]))
+			return false;
+		if ((flags & SCFIND_WHOLEWORD) && at + needleLen < length() && isWordByte(text[at + needleLen]))
+			return false;
+		return true;
+	};
+
+	if (backwards) {
+		for (Sci_Position at = hi - needleLen; at >= lo; --at) {
+			if (matchesAt(at)) {
+				matchEnd = at + needleLen;
+				return at;
+			}
+		}
+	} else if (matchCase && !(flags & (SCFIND_WHOLEWORD | SCFIND_WORDSTART))) {
+		const std::string_view haystack(text + lo, static_cast<size_t>(hi - lo));
+		const size_t at = haystack.find(pattern, 0, static_cast<size_t>(needleLen));
+		if (at != std::string_view::npos) {
+			matchEnd = lo + static_cast<Sci_Position>(at) + needleLen;
+			return lo + static_cast<Sci_Position>(at);
+		}
+	} else {
+		for (Sci_Position at = lo; at + needleLen <= hi; ++at) {
+			if (matchesAt(at)) {
+				matchEnd = at + needleLen;
+				return at;
+			}
+		}
+	}
+	return INVALID_POSITION;
+}
+// --------------------------------------------------------------------------------------
+sptr_t SciMemoryDocument::getRange(Sci_Position minPos, Sci_Position maxPos, char *dest) {
+	minPos = clamp(minPos);
+	maxPos = (maxPos < 0) ? length() : (std::max)(minPos, clamp(maxPos));
+	if (dest) {
+		_text.copy(static_cast<size_t>(minPos), static_cast<size_t>(maxPos - minPos), dest);
+		dest[maxPos - minPos] = '\0';
+	}
+	return maxPos - minPos;
+}
+// --------------------------------------------------------------------------------------
+void SciMemoryDocument::undo() {
+	while (!_undoGroups.empty() && _undoGroups.back().empty())
+		_undoGroups.pop_back();
+	if (_undoGroups.empty() || _undoDepth > 0)
+		return;
+
+	const std::vector<UndoStep> group = std::move(_undoGroups.back());
+	_undoGroups.pop_back();
+	Sci_Position caret = 0;
+	for (auto step = group.rbegin(); step != group.rend(); ++step) {
+		const auto len = static_cast<Sci_Position>(step->bytes.size());
+		if (step->inserted) {
+			deleteBytes(step->position, len, SC_PERFORMED_UNDO);
+			caret = step->position;
+		} else {
+			insertBytes(step->position, step->bytes.data(), len, SC_PERFORMED_UNDO);
+			caret = step->position + len;
+		}
+	}
+	setSelection(caret, caret);
+}
+// --------------------------------------------------------------------------------------
+void SciMemoryDocument::endUndoGroup() noexcept {
+	if (_undoDepth == 0)
+		return;
+	if (--_undoDepth == 0 && !_undoGroups.empty() && _undoGroups.back().empty())
+		_undoGroups.pop_back();
+}
+// --------------------------------------------------------------------------------------
+Sci_Position SciMemoryDocument::clamp(Sci_Position pos) const noexcept {
+	return (std::max)(Sci_Position(0), (std::min)(pos, length()));
+}
+// --------------------------------------------------------------------------------------
+std::vector<Sci_Position> const &SciMemoryDocument::lineStarts() {
+	if (!_lineStartsValid) {
+		const char *text = _text.data();
+		const auto len = static_cast<Sci_Position>(_text.length());
+		_lineStarts.assign(1, 0);
+		for (Sci_Position i = 0; i < len; ++i) {
+			if (text[i] == '\r' && i + 1 < len && text[i + 1] == '\n')
+				++i;
+			if (text[i] == '\r' || text[i] == '\n')
+				_lineStarts.push_back(i + 1);
+		}
+		_lineStartsValid = true;
+	}
+	return _lineStarts;
+}
+// --------------------------------------------------------------------------------------
+Sci_Position SciMemoryDocument::lineCount() {
+	return static_cast<Sci_Position>(lineStarts().size());
+}
+// --------------------------------------------------------------------------------------
+Sci_Position SciMemoryDocument::lineFromPosition(Sci_Position pos) {
+	auto const &starts = lineStarts();
+	return static_cast<Sci_Position>(std::upper_bound(starts.begin(), starts.end(), clamp(pos)) - starts.begin()) - 1;
+}
+// --------------------------------------------------------------------------------------
+Sci_Position SciMemoryDocument::positionFromLine(Sci_Position line) {
+	auto const &starts = lineStarts();
+	if (line < 0)
+		return starts[static_cast<size_t>(lineFromPosition(mainSelection().caret))];
+	if (line > lineCount())
+		return INVALID_POSITION;
+	return (line == lineCount()) ? length() : starts[static_cast<size_t>(line)];
+}
+// --------------------------------------------------------------------------------------
+Sci_Position SciMemoryDocument::lineEndPosition(Sci_Position line) {
+	if (line < 0 || line + 1 >= lineCount())
+		return length();
+	Sci_Position endPos = lineStarts()[static_cast<size_t>(line + 1)];
+	if (endPos > 0 && _text.at(static_cast<size_t>(endPos - 1)) == '\n')
+		--endPos;
+	if (endPos > 0 && _text.at(static_cast<size_t>(endPos - 1)) == '\r')
+		--endPos;
+	return endPos;
+}
+// --------------------------------------------------------------------------------------
+Sci_Position SciMemoryDocument::column(Sci_Position pos) {
+	Sci_Position col = 0;
+	for (Sci_Position i = positionFromLine(lineFromPosition(pos)); i < pos; i = positionAfter(i)) {
+		if (_text.at(static_cast<size_t>(i)) == '\t')
+			col = (col / _tabWidth + 1) * _tabWidth;
+		else
+			++col;
+	}
+	return col;
+}
+// --------------------------------------------------------------------------------------
+Sci_Position SciMemoryDocument::positionBefore(Sci_Position pos) const noexcept {
+	if (pos <= 0)
+		return 0;
+	Sci_Position prev = pos - 1;
+	if (_text.at(static_cast<size_t>(prev)) == '\n' && prev > 0 && _text.at(static_cast<size_t>(prev - 1)) == '\r')
+		return prev - 1;
+	if (_codePage == SC_CP_UTF8) {
+		while (prev > 0 && pos - prev < 4 && (_text.at(static_cast<size_t>(prev)) & 0xC0) == 0x80)
+			--prev;
+	}
+	return prev;
+}
+// --------------------------------------------------------------------------------------
+Sci_Position SciMemoryDocument::positionAfter(Sci_Position pos) const noexcept {
+	if (pos >= length())
+		return length();
+	if (_text.at(static_cast<size_t>(pos)) == '\r' && pos + 1 < length() &&
+	    _text.at(static_cast<size_t>(pos + 1)) == '\n')
+		return pos + 2;
+	Sci_Position next = pos + 1;
+	if (_codePage == SC_CP_UTF8) {
+		while (next < length() && next - pos < 4 && (_text.at(static_cast<size_t>(next)) & 0xC0) == 0x80)
+			++next;
+	}
+	return next;
+}
+// --------------------------------------------------------------------------------------
+int SciMemoryDocument::lineIndentation(Sci_Position line) {
+	if (line < 0 || line >= lineCount())
+		return 0;
+	int indent = 0;
+	const Sci_Position lineEnd = lineEndPosition(line);
+	for (Sci_Position i = positionFromLine(line); i < lineEnd; ++i) {
+		const char ch = _text.at(static_cast<size_t>(i));
+		if (ch == ' ')
+			++indent;
+		else if (ch == '\t')
+			indent = (indent / _tabWidth + 1) * _tabWidth;
+		else
+			break;
+	}
+	return indent;
+}
+// --------------------------------------------------------------------------------------
+void SciMemoryDocument::setLineIndentation(Sci_Position line, int indent) {
+	if (line < 0 || line >= lineCount())
+		return;
+	indent = (std::max)(0, indent);
+	std::string prefix;
+	if (_useTabs)
+		prefix.assign(static_cast<size_t>(indent / _tabWidth), '\t');
+	prefix.append(static_cast<size_t>(_useTabs ? indent % _tabWidth : indent), ' ');
+
+	const Sci_Position lineStart = positionFromLine(line), lineEnd = lineEndPosition(line);
+	Sci_Position indentEnd = lineStart;
+	while (indentEnd < lineEnd &&
+	       (_text.at(static_cast<size_t>(indentEnd)) == ' ' || _text.at(static_cast<size_t>(indentEnd)) == '\t'))
+		++indentEnd;
+	replaceRange(lineStart, indentEnd, prefix.data(), static_cast<Sci_Position>(prefix.size()), true);
+}
+// --------------------------------------------------------------------------------------
+void SciMemoryDocument::setSelection(Sci_Position caret, Sci_Position anchor) {
+	_selections.assign(1, Selection{ caret, anchor });
+	_mainSelection = 0;
+}
+
+// --------------------------------------------------------------------------------------
+// SciTextObjects::SciMemoryDocument::GapBuffer
+// --------------------------------------------------------------------------------------
+void SciMemoryDocument::GapBuffer::copy(size_t pos, size_t len, char *dest) const noexcept {
+	const size_t gapLen = _gapEnd - _gapStart;
+	if (pos < _gapStart) {
+		const size_t before = (std::min)(len, _gapStart - pos);
+		std::memcpy(dest, _data.data() + pos, before);
+		dest += before;
+		pos += before;
+		len -= before;
+	}
+	if (len > 0)
+		std::memcpy(dest, _data.data() + pos + gapLen, len);
+}
+// --------------------------------------------------------------------------------------
+void SciMemoryDocument::GapBuffer::insert(size_t pos, const char *src, size_t len) {
+	moveGap(pos);
+	if (_gapEnd - _gapStart < len) {
+		const size_t extra = (std::max)(len, length() / 4) + 1024;
+		_data.insert(_data.begin() + static_cast<std::ptrdiff_t>(_gapEnd), extra, '\0');
+		_gapEnd += extra;
+	}
+	std::memcpy(_data.data() + _gapStart, src, len);
+	_gapStart += len;
+}
+// --------------------------------------------------------------------------------------
+void SciMemoryDocument::GapBuffer::erase(size_t pos, size_t len) noexcept {
+	moveGap(pos);
+	_gapEnd += len;
+}
+// --------------------------------------------------------------------------------------
+const char *SciMemoryDocument::GapBuffer::data() {
+	moveGap(length());
+	if (_gapStart == _data.size()) {
+		_data.push_back('\0');
+		_gapEnd = _data.size();
+	}
+	_data[_gapStart] = '\0';
+	return _data.data();
+}
+// --------------------------------------------------------------------------------------
+void SciMemoryDocument::GapBuffer::moveGap(size_t pos) noexcept {
+	if (pos < _gapStart) {
+		const size_t count = _gapStart - pos;
+		std::memmove(_data.data() + _gapEnd - count, _data.data() + pos, count);
+		_gapStart -= count;
+		_gapEnd -= count;
+	} else if (pos > _gapStart) {
+		const size_t count = pos - _gapStart;
+		std::memmove(_data.data() + _gapStart, _data.data() + _gapEnd, count);
+		_gapStart += count;
+		_gapEnd += count;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+/// Rewrites Scintilla's regular expression dialect for @c std::regex
+std::string translatePattern(const char *pattern, bool posix) {
+	std::string result;
+	bool inClass = false;
+	for (const char *ch = pattern; *ch; ++ch) {
+		if (*ch == '\\' && ch[1]) {
+			++ch;
+			if (!inClass && (*ch == '<' || *ch == '>')) {
+				result += "\\b";
+			} else if (!inClass && !posix && (*ch == '(' || *ch == ')')) {
+				result += *ch;
+			} else {
+				result += '\\';
+				result += *ch;
+			}
+			continue;
+		}
+		if (inClass) {
+			inClass = (*ch != ']') || (result.back() == '[') || (result.back() == '^' && result[result.size() - 2] == '[');
+		} else if (*ch == '[') {
+			inClass = true;
+		} else if (!posix && (*ch == '(' || *ch == ')')) {
+			result += '\\';
+		}
+		result += *ch;
+	}
+	return result;
+}
+// --------------------------------------------------------------------------------------
+Sci_Position countLines(const char *bytes, size_t len) noexcept {
+	Sci_Position lines = 0;
+	for (size_t i = 0; i < len; ++i) {
+		if (bytes[i] == '\n' || (bytes[i] == '\r' && (i + 1 == len || bytes[i + 1] != '\n')))
+			++lines;
+	}
+	return lines;
+}
+// --------------------------------------------------------------------------------------
+bool isWordByte(char ch) noexcept {
+	const auto byte = static_cast<unsigned char>(ch);
+	return byte >= 0x80 || byte == '_' || (byte >= '0' && byte <= '9') || ((byte | 0x20) >= 'a' && (byte | 0x20) <= 'z');
+}
+// --------------------------------------------------------------------------------------
+bool sameByte(char a, char b, bool matchCase) noexcept {
+	if (a == b)
+		return true;
+	if (matchCase)
+		return false;
+	const auto lower = static_cast<unsigned char>(a | 0x20);
+	return lower == static_cast<unsigned char>(b | 0x20) && lower >= 'a' && lower <= 'z';
+}
+}
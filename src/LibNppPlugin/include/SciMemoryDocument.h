@@ -0,0 +1,135 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#ifndef SCI_MEMORY_DOCUMENT_H
+#define SCI_MEMORY_DOCUMENT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <functional>
+#include <regex>
+#include "Scintilla.h"
+
+namespace SciTextObjects {
+// --------------------------------------------------------------------------------------
+// SciMemoryDocument
+// --------------------------------------------------------------------------------------
+/// @brief A headless stand-in for a Scintilla window, answering the messages @c SciActiveDocument sends.
+///
+/// Needs no Win32 API, so it builds on other platforms, where the bench drives the portable code through it.
+/// The text objects, and so the commands built on them, are exercised off-screen by routing a window's messages
+/// here with:
+/// @code
+///   SciMessageTransport::attach(hWnd, std::make_shared<SciCallbackTransport>(
+///       [&doc](unsigned msg, uptr_t wParam, sptr_t lParam) { return doc.send(msg, wParam, lParam); }));
+/// @endcode
+/// @note Only one (stream) selection is tracked per range; regular expressions use @c std::regex (ECMAScript),
+/// after translating Scintilla's @c \\( @c \\) groups and @c \\< @c \\> word boundaries.
+class SciMemoryDocument {
+
+public:
+	using Listener = std::function<void(SCNotification const &)>;
+
+	SciMemoryDocument() = default;
+	explicit SciMemoryDocument(std::string const &text) { setText(text); }
+
+	sptr_t send(unsigned msg, uptr_t wParam = 0, sptr_t lParam = 0);
+
+	void setText(std::string const &text);
+	std::string text() const;
+	Sci_Position length() const noexcept { return static_cast<Sci_Position>(_text.length()); }
+	/// @brief Counts every insertion and deletion, including those made by undo.
+	uint64_t modificationCount() const noexcept { return _modifications; }
+	/// @brief Receives an @c SCN_MODIFIED notification for each change allowed by the modification event mask.
+	void onNotify(Listener listener) { _listener = std::move(listener); }
+
+private:
+	/// Text storage with a movable gap, so that clustered edits don't shift the whole document
+	class GapBuffer {
+	public:
+		size_t length() const noexcept { return _data.size() - (_gapEnd - _gapStart); }
+		char at(size_t pos) const noexcept { return _data[pos < _gapStart ? pos : pos + (_gapEnd - _gapStart)]; }
+		void copy(size_t pos, size_t len, char *dest) const noexcept;
+		void insert(size_t pos, const char *src, size_t len);
+		void erase(size_t pos, size_t len) noexcept;
+		/// @brief Closes the gap behind the text and returns it as one contiguous, NUL-terminated run.
+		const char *data();
+
+	private:
+		void moveGap(size_t pos) noexcept;
+		std::vector<char> _data;
+		size_t _gapStart = 0;
+		size_t _gapEnd = 0;
+	};
+
+	struct Selection {
+		Sci_Position caret;
+		Sci_Position anchor;
+		Sci_Position start() const noexcept { return caret < anchor ? caret : anchor; }
+		Sci_Position end() const noexcept { return caret < anchor ? anchor : caret; }
+	};
+
+	struct UndoStep {
+		bool inserted;
+		Sci_Position position;
+		std::string bytes;
+	};
+
+	void insertBytes(Sci_Position pos, const char *src, Sci_Position len, int source = SC_PERFORMED_USER);
+	void deleteBytes(Sci_Position pos, Sci_Position len, int source = SC_PERFORMED_USER);
+	void notify(int modificationType, Sci_Position pos, Sci_Position len, const char *bytes, Sci_Position linesAdded);
+	Sci_Position replaceRange(Sci_Position startPos, Sci_Position endPos, const char *src, Sci_Position len,
+	    bool minimal);
+	Sci_Position findText(int flags, Sci_Position minPos, Sci_Position maxPos, const char *pattern,
+	    Sci_Position &matchEnd);
+	sptr_t getRange(Sci_Position minPos, Sci_Position maxPos, char *dest);
+	void undo();
+	void endUndoGroup() noexcept;
+
+	Sci_Position clamp(Sci_Position pos) const noexcept;
+	Sci_Position lineFromPosition(Sci_Position pos);
+	Sci_Position positionFromLine(Sci_Position line);
+	Sci_Position lineEndPosition(Sci_Position line);
+	Sci_Position lineCount();
+	Sci_Position column(Sci_Position pos);
+	Sci_Position positionBefore(Sci_Position pos) const noexcept;
+	Sci_Position positionAfter(Sci_Position pos) const noexcept;
+	int lineIndentation(Sci_Position line);
+	void setLineIndentation(Sci_Position line, int indent);
+	std::vector<Sci_Position> const &lineStarts();
+
+	Selection &mainSelection() noexcept { return _selections[_mainSelection]; }
+	void setSelection(Sci_Position caret, Sci_Position anchor);
+
+	GapBuffer _text;
+	std::vector<Sci_Position> _lineStarts;
+	bool _lineStartsValid = false;
+	std::vector<Selection> _selections{ Selection{ 0, 0 } };
+	size_t _mainSelection = 0;
+	int _selectionMode = SC_SEL_STREAM;
+	Sci_Position _targetStart = 0;
+	Sci_Position _targetEnd = 0;
+	int _searchFlags = 0;
+	std::string _regexPattern;
+	int _regexFlags = -1;
+	std::regex _regex;
+	std::vector<std::vector<UndoStep>> _undoGroups;
+	int _undoDepth = 0;
+	bool _collectUndo = true;
+	size_t _savePoint = 0;
+	uint64_t _modifications = 0;
+	int _modEventMask = SC_MODEVENTMASKALL;
+	int _codePage = SC_CP_UTF8;
+	int _tabWidth = 8;
+	bool _useTabs = true;
+	bool _readOnly = false;
+	Sci_Position _endStyled = 0;
+	Listener _listener;
+};
+}
+#endif // ~SCI_MEMORY_DOCUMENT_H
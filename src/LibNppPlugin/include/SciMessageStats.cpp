@@ -0,0 +1,118 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#include <algorithm>
+#include <atomic>
+#include <iomanip>
+#include <mutex>
+#include <ostream>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "SciMessageTrace.h"
+#include "SciMessageStats.h"
+
+using namespace SciTextObjects;
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+struct CommandCounters {
+	SciMessageCounter total;
+	std::unordered_map<unsigned, SciMessageCounter> messages;
+};
+
+std::mutex statsLock;
+std::unordered_map<std::string_view, CommandCounters> commands;
+/// Commands run on the UI thread, so one is current for the whole module
+std::atomic<const char *> currentCommand{ nullptr };
+
+/// Charged with messages sent outside of any command, e.g. by notification handlers
+constexpr char noCommand[] = "(other)";
+constexpr size_t busiestMessages = 8;
+
+void add(SciMessageCounter &counter, uint64_t bytes, uint64_t ns) noexcept;
+double toMs(uint64_t ns) noexcept;
+}
+
+// --------------------------------------------------------------------------------------
+// SciTextObjects::SciMessageStats
+// --------------------------------------------------------------------------------------
+void SciMessageStats::count(unsigned msg, uptr_t wParam, sptr_t lParam, sptr_t result, Clock::time_point started) {
+	const auto ns = static_cast<uint64_t>(
+	    std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - started).count());
+	const uint64_t bytes = SciMessageTrace::transferSize(msg, wParam, lParam, result);
+	std::lock_guard<std::mutex> lock{ statsLock };
+	const char *const name = currentCommand.load(std::memory_order_relaxed);
+	CommandCounters &command = commands[name ? name : noCommand];
+	add(command.total, bytes, ns);
+	add(command.messages[msg], bytes, ns);
+}
+// --------------------------------------------------------------------------------------
+void SciMessageStats::report(std::ostream &os) {
+	using Row = std::pair<std::string_view, CommandCounters>;
+	std::vector<Row> rows;
+	{
+		std::lock_guard<std::mutex> lock{ statsLock };
+		rows.assign(commands.begin(), commands.end());
+	}
+	std::sort(rows.begin(), rows.end(),
+	    [](Row const &a, Row const &b) { return a.second.total.ns > b.second.total.ns; });
+
+	const SciMessageCounter sum = total();
+	os << "Editor messages: " << sum.calls << ", " << sum.bytes << " bytes, " << std::fixed << std::setprecision(3)
+	   << toMs(sum.ns) << " ms\n\n";
+	os << std::left << std::setw(40) << "command / message" << std::right << std::setw(12) << "calls" << std::setw(14)
+	   << "bytes" << std::setw(14) << "ms" << '\n';
+	for (Row const &row : rows) {
+		SciMessageCounter const &cmd = row.second.total;
+		os << std::left << std::setw(40) << row.first << std::right << std::setw(12) << cmd.calls << std::setw(14)
+		   << cmd.bytes << std::setw(14) << toMs(cmd.ns) << '\n';
+
+		std::vector<std::pair<unsigned, SciMessageCounter>> messages(
+		    row.second.messages.begin(), row.second.messages.end());
+		std::sort(messages.begin(), messages.end(),
+		    [](auto const &a, auto const &b) { return a.second.ns > b.second.ns; });
+		messages.resize((std::min)(messages.size(), busiestMessages));
+		for (auto const &msg : messages) {
+			os << "  " << std::left << std::setw(38) << msg.first << std::right << std::setw(12) << msg.second.calls
+			   << std::setw(14) << msg.second.bytes << std::setw(14) << toMs(msg.second.ns) << '\n';
+		}
+	}
+}
+// --------------------------------------------------------------------------------------
+SciMessageCounter SciMessageStats::total() {
+	SciMessageCounter sum{ 0, 0, 0 };
+	std::lock_guard<std::mutex> lock{ statsLock };
+	for (auto const &command : commands) {
+		sum.calls += command.second.total.calls;
+		sum.bytes += command.second.total.bytes;
+		sum.ns += command.second.total.ns;
+	}
+	return sum;
+}
+// --------------------------------------------------------------------------------------
+void SciMessageStats::reset() {
+	std::lock_guard<std::mutex> lock{ statsLock };
+	commands.clear();
+}
+// --------------------------------------------------------------------------------------
+const char *SciMessageStats::enter(const char *name) noexcept {
+	return currentCommand.exchange(name, std::memory_order_relaxed);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+void add(SciMessageCounter &counter, uint64_t bytes, uint64_t ns) noexcept {
+	++counter.calls;
+	counter.bytes += bytes;
+	counter.ns += ns;
+}
+// --------------------------------------------------------------------------------------
+double toMs(uint64_t ns) noexcept {
+	return static_cast<double>(ns) / 1e6;
+}
+}
@@ -0,0 +1,71 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#ifndef SCI_MESSAGE_STATS_H
+#define SCI_MESSAGE_STATS_H
+
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include "Scintilla.h"
+
+namespace SciTextObjects {
+/// Totals for one message, or one command
+struct SciMessageCounter {
+	uint64_t calls;
+	uint64_t bytes;
+	uint64_t ns;
+};
+
+// --------------------------------------------------------------------------------------
+// SciMessageStats
+// --------------------------------------------------------------------------------------
+/// @brief Counts the messages sent to editors, per message and per command, with the bytes they moved
+/// and the time they took.
+///
+/// Only compiled in when @c SCI_MESSAGE_STATS is defined; otherwise every call is discarded at compile time.
+class SciMessageStats {
+
+public:
+#ifdef SCI_MESSAGE_STATS
+	static constexpr bool enabled = true;
+#else
+	static constexpr bool enabled = false;
+#endif
+	using Clock = std::chrono::steady_clock;
+
+	/// Charges the messages sent by any thread to @p name, until it goes out of scope; only the UI thread runs commands
+	class Command final {
+	public:
+		/// @param name Must outlive the statistics, e.g. a string literal
+		explicit Command(const char *name) noexcept {
+			if constexpr (enabled)
+				_outer = enter(name);
+		}
+		~Command() {
+			if constexpr (enabled)
+				enter(_outer);
+		}
+		Command(const Command &) = delete;
+		Command &operator=(const Command &) = delete;
+
+	private:
+		const char *_outer = nullptr;
+	};
+
+	static void count(unsigned msg, uptr_t wParam, sptr_t lParam, sptr_t result, Clock::time_point started);
+	/// @brief Writes a table of the totals per command, with the busiest messages of each.
+	static void report(std::ostream &os);
+	static SciMessageCounter total();
+	static void reset();
+
+private:
+	/// @return The command that was current before
+	static const char *enter(const char *name) noexcept;
+};
+}
+#endif // ~SCI_MESSAGE_STATS_H
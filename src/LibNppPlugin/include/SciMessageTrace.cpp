@@ -0,0 +1,418 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#include <algorithm>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <random>
+#include "SciMessageTrace.h"
+
+using namespace SciTextObjects;
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+constexpr char traceSignature[] = "SCI-MESSAGE-TRACE";
+constexpr int traceVersion = 1;
+
+uint64_t mix(uint64_t &state) noexcept;
+bool isWordByte(unsigned char byte) noexcept;
+bool keepsWord(std::string const &bytes, size_t wordStart) noexcept;
+size_t sequenceLength(unsigned char lead) noexcept;
+bool readPayload(std::istream &is, std::string &bytes, size_t len);
+}
+
+// --------------------------------------------------------------------------------------
+// SciTextObjects::SciMessageTrace
+// --------------------------------------------------------------------------------------
+SciMessageTrace::SciMessageTrace(std::string command, bool anonymize)
+    : _command(std::move(command)), _anonymized(anonymize) {
+	if (_anonymized) {
+		std::random_device seed;
+		_salt = (static_cast<uint64_t>(seed()) << 32) | seed();
+	}
+}
+// --------------------------------------------------------------------------------------
+void SciMessageTrace::snapshot(Sender const &send) {
+	const auto len = static_cast<size_t>(send(SCI_GETLENGTH, 0, 0));
+	_text.assign(len + 1, '\0');
+	send(SCI_GETTEXT, len + 1, reinterpret_cast<sptr_t>(&_text[0]));
+	_text.resize(len);
+	anonymize(_text);
+	_codePage = static_cast<int>(send(SCI_GETCODEPAGE, 0, 0));
+	_selectionMode = static_cast<int>(send(SCI_GETSELECTIONMODE, 0, 0));
+	_caret = send(SCI_GETCURRENTPOS, 0, 0);
+	_anchor = send(SCI_GETANCHOR, 0, 0);
+	_targetStart = send(SCI_GETTARGETSTART, 0, 0);
+	_targetEnd = send(SCI_GETTARGETEND, 0, 0);
+	_searchFlags = static_cast<int>(send(SCI_GETSEARCHFLAGS, 0, 0));
+	_records.clear();
+}
+// --------------------------------------------------------------------------------------
+SciTraceRecord SciMessageTrace::begin(unsigned msg, uptr_t wParam, sptr_t lParam) const {
+	SciTraceRecord record;
+	record.msg = msg;
+	record.wParam = wParam;
+	record.lParam = lParam;
+	const SciPayload kind = payloadKind(msg, wParam);
+	if (kind == SciPayload::none)
+		return record;
+
+	record.lParam = lParam ? 1 : 0;
+	if (!lParam)
+		return record;
+
+	const auto *bytes = reinterpret_cast<const char *>(lParam);
+	switch (kind) {
+		case SciPayload::inString:
+			record.payload.assign(bytes);
+			break;
+		case SciPayload::inBytes:
+			record.payload.assign(bytes, static_cast<size_t>(wParam));
+			break;
+		case SciPayload::textRange: {
+			const auto *tr = reinterpret_cast<const Sci_TextRange *>(lParam);
+			record.rangeStart = tr->chrg.cpMin;
+			record.rangeEnd = tr->chrg.cpMax;
+			break;
+		}
+		case SciPayload::textRangeFull: {
+			const auto *tr = reinterpret_cast<const Sci_TextRangeFull *>(lParam);
+			record.rangeStart = tr->chrg.cpMin;
+			record.rangeEnd = tr->chrg.cpMax;
+			break;
+		}
+		case SciPayload::findText: {
+			const auto *ttf = reinterpret_cast<const Sci_TextToFind *>(lParam);
+			record.rangeStart = ttf->chrg.cpMin;
+			record.rangeEnd = ttf->chrg.cpMax;
+			record.payload.assign(ttf->lpstrText);
+			break;
+		}
+		case SciPayload::findTextFull: {
+			const auto *ttf = reinterpret_cast<const Sci_TextToFindFull *>(lParam);
+			record.rangeStart = ttf->chrg.cpMin;
+			record.rangeEnd = ttf->chrg.cpMax;
+			record.payload.assign(ttf->lpstrText);
+			break;
+		}
+		default:
+			break;
+	}
+	record.payloadSize = record.payload.size();
+	// Search patterns are built from tag names, which anonymizing keeps anyway
+	if (kind == SciPayload::inString || (kind == SciPayload::inBytes && msg != SCI_SEARCHINTARGET))
+		anonymize(record.payload);
+	return record;
+}
+// --------------------------------------------------------------------------------------
+void SciMessageTrace::end(SciTraceRecord &&record, sptr_t result, uint64_t elapsedNs) {
+	record.result = result;
+	record.elapsedNs = elapsedNs;
+	switch (payloadKind(record.msg, record.wParam)) {
+		case SciPayload::outBytes:
+		case SciPayload::textRange:
+		case SciPayload::textRangeFull:
+			// SCI_GETCURLINE returns the caret's column, so count the buffer it was given instead
+			if (record.lParam)
+				record.payloadSize = static_cast<size_t>(
+				    record.msg == SCI_GETCURLINE ? record.wParam : (std::max)(result, sptr_t{ 0 }));
+			break;
+		default:
+			break;
+	}
+	_records.push_back(std::move(record));
+}
+// --------------------------------------------------------------------------------------
+void SciMessageTrace::prepare(Sender const &send) const {
+	send(SCI_SETCODEPAGE, static_cast<uptr_t>(_codePage), 0);
+	send(SCI_SETTEXT, 0, reinterpret_cast<sptr_t>(_text.c_str()));
+	send(SCI_EMPTYUNDOBUFFER, 0, 0);
+	send(SCI_SETSELECTIONMODE, static_cast<uptr_t>(_selectionMode), 0);
+	send(SCI_SETSEL, static_cast<uptr_t>(_anchor), _caret);
+	send(SCI_SETTARGETRANGE, static_cast<uptr_t>(_targetStart), _targetEnd);
+	send(SCI_SETSEARCHFLAGS, static_cast<uptr_t>(_searchFlags), 0);
+}
+// --------------------------------------------------------------------------------------
+SciTraceReplay SciMessageTrace::replay(Sender const &send) const {
+	SciTraceReplay outcome{ 0, 0, -1 };
+	std::string buffer;
+	for (SciTraceRecord const &record : _records) {
+		const SciPayload kind = payloadKind(record.msg, record.wParam);
+		sptr_t lParam = record.lParam;
+		Sci_TextRangeFull range{};
+		Sci_TextRange narrowRange{};
+		Sci_TextToFindFull search{};
+		Sci_TextToFind narrowSearch{};
+		bool comparable = record.msg != SCI_GETCHARACTERPOINTER && record.msg != SCI_GETRANGEPOINTER &&
+				  !(_anonymized && record.msg == SCI_GETCHARAT);
+
+		if (kind != SciPayload::none && record.lParam) {
+			size_t needed = (std::max)(record.payloadSize, static_cast<size_t>(record.wParam));
+			if (record.msg == SCI_GETSELTEXT)
+				needed = (std::max)(needed, static_cast<size_t>(send(SCI_GETSELTEXT, 0, 0)));
+			if (kind == SciPayload::textRange || kind == SciPayload::textRangeFull)
+				needed = (std::max)(needed, static_cast<size_t>(record.rangeEnd < 0
+								 ? send(SCI_GETLENGTH, 0, 0)
+								 : record.rangeEnd - record.rangeStart));
+			switch (kind) {
+				case SciPayload::inString:
+				case SciPayload::inBytes:
+					buffer = record.payload;
+					buffer.push_back('\0');
+					lParam = reinterpret_cast<sptr_t>(buffer.data());
+					break;
+				case SciPayload::outBytes:
+				case SciPayload::textRange:
+				case SciPayload::textRangeFull:
+					buffer.assign(needed + 1, '\0');
+					lParam = reinterpret_cast<sptr_t>(&buffer[0]);
+					if (kind == SciPayload::textRangeFull) {
+						range.chrg = { record.rangeStart, record.rangeEnd };
+						range.lpstrText = &buffer[0];
+						lParam = reinterpret_cast<sptr_t>(&range);
+					} else if (kind == SciPayload::textRange) {
+						narrowRange.chrg = { static_cast<Sci_PositionCR>(record.rangeStart),
+							static_cast<Sci_PositionCR>(record.rangeEnd) };
+						narrowRange.lpstrText = &buffer[0];
+						lParam = reinterpret_cast<sptr_t>(&narrowRange);
+					}
+					break;
+				case SciPayload::findTextFull:
+					search.chrg = { record.rangeStart, record.rangeEnd };
+					search.lpstrText = record.payload.c_str();
+					lParam = reinterpret_cast<sptr_t>(&search);
+					break;
+				case SciPayload::findText:
+					narrowSearch.chrg = { static_cast<Sci_PositionCR>(record.rangeStart),
+						static_cast<Sci_PositionCR>(record.rangeEnd) };
+					narrowSearch.lpstrText = record.payload.c_str();
+					lParam = reinterpret_cast<sptr_t>(&narrowSearch);
+					break;
+				default:
+					break;
+			}
+		}
+		const sptr_t result = send(record.msg, record.wParam, lParam);
+		if (comparable && result != record.result) {
+			if (outcome.mismatches++ == 0)
+				outcome.firstMismatch = static_cast<ptrdiff_t>(outcome.messages);
+		}
+		++outcome.messages;
+	}
+	return outcome;
+}
+// --------------------------------------------------------------------------------------
+void SciMessageTrace::save(std::ostream &os) const {
+	os << traceSignature << ' ' << traceVersion << '\n'
+	   << "command " << _command << '\n'
+	   << "anonymized " << (_anonymized ? 1 : 0) << '\n'
+	   << "codepage " << _codePage << '\n'
+	   << "selection " << _selectionMode << ' ' << _caret << ' ' << _anchor << '\n'
+	   << "target " << _targetStart << ' ' << _targetEnd << ' ' << _searchFlags << '\n'
+	   << "text " << _text.size() << '\n';
+	os.write(_text.data(), static_cast<std::streamsize>(_text.size()));
+	os << '\n' << "messages " << _records.size() << '\n';
+	for (SciTraceRecord const &record : _records) {
+		os << record.msg << ' ' << record.wParam << ' ' << record.lParam << ' ' << record.rangeStart << ' '
+		   << record.rangeEnd << ' ' << record.result << ' ' << record.elapsedNs << ' ' << record.payloadSize << ' '
+		   << record.payload.size() << '\n';
+		os.write(record.payload.data(), static_cast<std::streamsize>(record.payload.size()));
+		os << '\n';
+	}
+}
+// --------------------------------------------------------------------------------------
+bool SciMessageTrace::load(std::istream &is) {
+	std::string field;
+	int version = 0;
+	if (!(is >> field >> version) || field != traceSignature || version != traceVersion)
+		return false;
+
+	int anonymized = 0;
+	size_t len = 0;
+	is >> field;
+	is.get();
+	std::getline(is, _command);
+	is >> field >> anonymized >> field >> _codePage >> field >> _selectionMode >> _caret >> _anchor >> field >>
+	    _targetStart >> _targetEnd >> _searchFlags >> field >> len;
+	if (!is || !readPayload(is, _text, len))
+		return false;
+
+	_anonymized = anonymized != 0;
+	_salt = 0;
+	size_t count = 0;
+	if (!(is >> field >> count) || field != "messages")
+		return false;
+
+	_records.assign(count, SciTraceRecord{});
+	for (SciTraceRecord &record : _records) {
+		is >> record.msg >> record.wParam >> record.lParam >> record.rangeStart >> record.rangeEnd >> record.result >>
+		    record.elapsedNs >> record.payloadSize >> len;
+		if (!is || !readPayload(is, record.payload, len))
+			return false;
+	}
+	return true;
+}
+// --------------------------------------------------------------------------------------
+uint64_t SciMessageTrace::elapsedNs() const noexcept {
+	uint64_t total = 0;
+	for (SciTraceRecord const &record : _records)
+		total += record.elapsedNs;
+	return total;
+}
+// --------------------------------------------------------------------------------------
+uint64_t SciMessageTrace::payloadBytes() const noexcept {
+	uint64_t total = 0;
+	for (SciTraceRecord const &record : _records)
+		total += record.payloadSize;
+	return total;
+}
+// --------------------------------------------------------------------------------------
+SciPayload SciMessageTrace::payloadKind(unsigned msg, uptr_t wParam) noexcept {
+	switch (msg) {
+		case SCI_SETTEXT:
+		case SCI_INSERTTEXT:
+		case SCI_REPLACESEL:
+			return SciPayload::inString;
+		case SCI_ADDTEXT:
+		case SCI_APPENDTEXT:
+		case SCI_SEARCHINTARGET:
+			return SciPayload::inBytes;
+		case SCI_REPLACETARGET:
+		case SCI_REPLACETARGETMINIMAL:
+			return static_cast<sptr_t>(wParam) < 0 ? SciPayload::inString : SciPayload::inBytes;
+		case SCI_GETTEXT:
+		case SCI_GETSELTEXT:
+		case SCI_GETCURLINE:
+			return SciPayload::outBytes;
+		case SCI_GETTEXTRANGE:
+			return SciPayload::textRange;
+		case SCI_GETTEXTRANGEFULL:
+			return SciPayload::textRangeFull;
+		case SCI_FINDTEXT:
+			return SciPayload::findText;
+		case SCI_FINDTEXTFULL:
+			return SciPayload::findTextFull;
+		default:
+			return SciPayload::none;
+	}
+}
+// --------------------------------------------------------------------------------------
+size_t SciMessageTrace::transferSize(unsigned msg, uptr_t wParam, sptr_t lParam, sptr_t result) noexcept {
+	if (!lParam)
+		return 0;
+	switch (payloadKind(msg, wParam)) {
+		case SciPayload::inString:
+			return std::strlen(reinterpret_cast<const char *>(lParam));
+		case SciPayload::inBytes:
+			return static_cast<size_t>(wParam);
+		case SciPayload::outBytes:
+		case SciPayload::textRange:
+		case SciPayload::textRangeFull:
+			return static_cast<size_t>(msg == SCI_GETCURLINE ? wParam : (std::max)(result, sptr_t{ 0 }));
+		case SciPayload::findText:
+			return std::strlen(reinterpret_cast<const Sci_TextToFind *>(lParam)->lpstrText);
+		case SciPayload::findTextFull:
+			return std::strlen(reinterpret_cast<const Sci_TextToFindFull *>(lParam)->lpstrText);
+		default:
+			return 0;
+	}
+}
+// --------------------------------------------------------------------------------------
+void SciMessageTrace::anonymize(std::string &bytes) const {
+	if (!_anonymized)
+		return;
+
+	size_t pos = 0;
+	while (pos < bytes.size()) {
+		if (!isWordByte(static_cast<unsigned char>(bytes[pos]))) {
+			++pos;
+			continue;
+		}
+		size_t wordEnd = pos;
+		uint64_t state = _salt;
+		while (wordEnd < bytes.size() && isWordByte(static_cast<unsigned char>(bytes[wordEnd]))) {
+			state = (state ^ static_cast<unsigned char>(bytes[wordEnd])) * 0x100000001b3ULL;
+			++wordEnd;
+		}
+		if (keepsWord(bytes, pos)) {
+			pos = wordEnd;
+			continue;
+		}
+		// Equal words map to equal replacements, and every character keeps its byte length
+		while (pos < wordEnd) {
+			const auto byte = static_cast<unsigned char>(bytes[pos]);
+			const uint64_t pick = mix(state);
+			if (byte >= 'a' && byte <= 'z') {
+				bytes[pos++] = static_cast<char>('a' + pick % 26);
+			} else if (byte >= 'A' && byte <= 'Z') {
+				bytes[pos++] = static_cast<char>('A' + pick % 26);
+			} else if (byte >= '0' && byte <= '9') {
+				bytes[pos++] = static_cast<char>('0' + pick % 10);
+			} else if (byte < 0x80) {
+				++pos;
+			} else {
+				static constexpr const char *placeholders[] = { "", "", "\xC3\x80", "\xE4\xB8\x80",
+					"\xF0\x9F\x98\x80" };
+				const size_t len = sequenceLength(byte);
+				if (len < 2 || pos + len > wordEnd) {
+					bytes[pos++] = '?';
+					continue;
+				}
+				std::memcpy(&bytes[pos], placeholders[len], len);
+				bytes[pos + len - 1] = static_cast<char>(0x80 | (pick % 0x40));
+				pos += len;
+			}
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+uint64_t mix(uint64_t &state) noexcept {
+	uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+// --------------------------------------------------------------------------------------
+bool isWordByte(unsigned char byte) noexcept {
+	return byte >= 0x80 || byte == '_' || (byte >= '0' && byte <= '9') ||
+	       ((byte | 0x20) >= 'a' && (byte | 0x20) <= 'z');
+}
+// --------------------------------------------------------------------------------------
+bool keepsWord(std::string const &bytes, size_t wordStart) noexcept {
+	if (wordStart == 0)
+		return false;
+	const char prev = bytes[wordStart - 1];
+	if (prev == '<' || prev == '&')
+		return true;
+	if (wordStart < 2)
+		return false;
+	const char first = bytes[wordStart - 2];
+	return (prev == '/' && first == '<') || (prev == '#' && first == '&');
+}
+// --------------------------------------------------------------------------------------
+size_t sequenceLength(unsigned char lead) noexcept {
+	if ((lead & 0xE0) == 0xC0)
+		return 2;
+	if ((lead & 0xF0) == 0xE0)
+		return 3;
+	if ((lead & 0xF8) == 0xF0)
+		return 4;
+	return 1;
+}
+// --------------------------------------------------------------------------------------
+bool readPayload(std::istream &is, std::string &bytes, size_t len) {
+	if (is.get() != '\n')
+		return false;
+	bytes.assign(len, '\0');
+	if (len > 0 && !is.read(&bytes[0], static_cast<std::streamsize>(len)))
+		return false;
+	return is.get() == '\n';
+}
+}
@@ -0,0 +1,110 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#ifndef SCI_MESSAGE_TRACE_H
+#define SCI_MESSAGE_TRACE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <iosfwd>
+#include <functional>
+#include "Scintilla.h"
+
+namespace SciTextObjects {
+/// What a message passes through its @c lParam, besides a plain number
+enum class SciPayload { none, inString, inBytes, outBytes, textRange, textRangeFull, findText, findTextFull };
+
+/// One message sent to an editor, with its arguments and the size of the data it moved
+struct SciTraceRecord {
+	unsigned msg = 0;
+	uptr_t wParam = 0;
+	/// The plain argument; for messages with a payload, 0 if the pointer was null, otherwise 1
+	sptr_t lParam = 0;
+	/// The character range of a text range or search structure
+	Sci_Position rangeStart = 0;
+	Sci_Position rangeEnd = 0;
+	sptr_t result = 0;
+	uint64_t elapsedNs = 0;
+	/// How many bytes were passed in, or copied out
+	size_t payloadSize = 0;
+	/// The bytes passed in; copied out bytes are only counted
+	std::string payload;
+};
+
+/// The outcome of replaying a trace
+struct SciTraceReplay {
+	size_t messages;
+	size_t mismatches;
+	/// Index of the first record whose result differed from the recorded one, or -1
+	ptrdiff_t firstMismatch;
+};
+
+// --------------------------------------------------------------------------------------
+// SciMessageTrace
+// --------------------------------------------------------------------------------------
+/// @brief The messages one command sent to an editor, and the document they were sent to.
+///
+/// Saved traces can be replayed against any message handler, e.g. a @c SciMemoryDocument,
+/// so slow commands reported from the field can be reproduced and measured anywhere.
+/// @note Only the main selection of a single document is captured.
+class SciMessageTrace {
+
+public:
+	using Sender = std::function<sptr_t(unsigned, uptr_t, sptr_t)>;
+
+	SciMessageTrace() = default;
+	/// @param anonymize Replace the words of the document and inserted text with random ones of the same length;
+	/// markup, tag and entity names are kept, so that the trace still takes the same path when replayed
+	SciMessageTrace(std::string command, bool anonymize);
+
+	/// @brief Copies the document's text and selection state, before the command starts.
+	void snapshot(Sender const &send);
+	/// @brief Captures a message's arguments; pass the result to @c end once the message returns.
+	SciTraceRecord begin(unsigned msg, uptr_t wParam, sptr_t lParam) const;
+	void end(SciTraceRecord &&record, sptr_t result, uint64_t elapsedNs);
+
+	/// @brief Restores the snapshot through @p send.
+	void prepare(Sender const &send) const;
+	/// @brief Sends every recorded message again, to a handler that was given to @c prepare.
+	SciTraceReplay replay(Sender const &send) const;
+
+	void save(std::ostream &os) const;
+	/// @return @c false if @p is doesn't hold a trace
+	bool load(std::istream &is);
+
+	std::string const &command() const noexcept { return _command; }
+	std::string const &text() const noexcept { return _text; }
+	std::vector<SciTraceRecord> const &records() const noexcept { return _records; }
+	bool anonymized() const noexcept { return _anonymized; }
+	/// @brief Sum of the time spent in the editor while recording.
+	uint64_t elapsedNs() const noexcept;
+	/// @brief Sum of the bytes moved by all messages.
+	uint64_t payloadBytes() const noexcept;
+
+	static SciPayload payloadKind(unsigned msg, uptr_t wParam) noexcept;
+	/// @brief How many bytes a message moved through its @c lParam, after it returned @p result.
+	static size_t transferSize(unsigned msg, uptr_t wParam, sptr_t lParam, sptr_t result) noexcept;
+
+private:
+	void anonymize(std::string &bytes) const;
+
+	std::string _command;
+	bool _anonymized = false;
+	uint64_t _salt = 0;
+	int _codePage = SC_CP_UTF8;
+	int _selectionMode = SC_SEL_STREAM;
+	Sci_Position _caret = 0;
+	Sci_Position _anchor = 0;
+	Sci_Position _targetStart = 0;
+	Sci_Position _targetEnd = 0;
+	int _searchFlags = 0;
+	std::string _text;
+	std::vector<SciTraceRecord> _records;
+};
+}
+#endif // ~SCI_MESSAGE_TRACE_H
@@ -6,6 +6,10 @@
   Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
   Original Pascal unit (c) Martijn Coppoolse <https://github.com/vor0nwe>
 */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
 #include "TextConv.h"
 #include "SciTextObjects.h"
 
@@ -16,28 +20,174 @@ using namespace TextConv;
 namespace {
 typedef std::vector<std::shared_ptr<SciTextRangeMark>> TextRangeMarks;
 TextRangeMarks textRangeMarks;
+/// Bumped by every edit to any document, and every swap, so ranges and snapshots can tell if their text is still
+/// current; one count for all documents, not one each. 0 means "never cached"
+std::atomic<uint64_t> textVersion{ 1 };
+std::atomic<uint64_t> textCacheHits{ 0 };
+std::atomic<uint64_t> textCacheMisses{ 0 };
+
+std::mutex transportsLock;
+std::vector<std::pair<HWND, std::shared_ptr<SciMessageTransport>>> transports;
+void eraseTransport(HWND hWnd);
+
+std::atomic<SciMessageRecorder *> activeRecorder{ nullptr };
+
+/// Guards the two lists below, which are keyed by document
+std::mutex snapshotsLock;
+std::vector<std::pair<sptr_t, std::weak_ptr<const SciDocumentSnapshot>>> latestSnapshots;
+/// Buffers of snapshots no one holds any more
+std::vector<std::pair<sptr_t, std::string>> spareSnapshotBuffers;
+constexpr size_t maxSpareSnapshotBuffers = 2;
+
+/// Lent to one @c ScratchBytes at a time
+std::string spareBytes;
+std::atomic<bool> spareLent{ false };
+
+/// Borrows the byte buffer kept for passing text to and from Scintilla; a re-entrant caller, or one on another
+/// thread, gets a fresh one
+class ScratchBytes final {
+
+public:
+	ScratchBytes() noexcept : _borrowed(!spareLent.exchange(true, std::memory_order_acquire)) {
+		if (_borrowed)
+			_bytes = std::move(spareBytes);
+	}
+	~ScratchBytes() {
+		if (!_borrowed)
+			return;
+		if (_bytes.capacity() <= maxSpareCapacity)
+			spareBytes = std::move(_bytes);
+		spareLent.store(false, std::memory_order_release);
+	}
+	ScratchBytes(const ScratchBytes &) = delete;
+	ScratchBytes &operator=(const ScratchBytes &) = delete;
+	std::string &operator*() noexcept { return _bytes; }
+	std::string *operator->() noexcept { return &_bytes; }
+
+private:
+	static constexpr size_t maxSpareCapacity = 0x100000ULL;
+	std::string _bytes;
+	bool _borrowed;
+};
 }
 
 // --------------------------------------------------------------------------------------
-// SciTextObjects::SciWindowedObject
+// SciTextObjects::SciMessageTransport
 // --------------------------------------------------------------------------------------
-LRESULT SciWindowedObject::sendMessage(const UINT msg, WPARAM wParam, LPARAM lParam) const {
+void SciMessageTransport::attach(HWND hWnd, std::shared_ptr<SciMessageTransport> transport) {
+	std::lock_guard<std::mutex> lock{ transportsLock };
+	eraseTransport(hWnd);
+	transports.emplace_back(hWnd, std::move(transport));
+}
+// --------------------------------------------------------------------------------------
+void SciMessageTransport::detach(HWND hWnd) {
+	std::lock_guard<std::mutex> lock{ transportsLock };
+	eraseTransport(hWnd);
+}
+// --------------------------------------------------------------------------------------
+std::shared_ptr<SciMessageTransport> SciMessageTransport::forWindow(HWND hWnd) {
+	std::lock_guard<std::mutex> lock{ transportsLock };
+	for (auto &&transport : transports) {
+		if (transport.first == hWnd)
+			return transport.second;
+	}
+	transports.emplace_back(hWnd, std::make_shared<SciWindowTransport>(hWnd));
+	return transports.back().second;
+}
+
+// --------------------------------------------------------------------------------------
+// SciTextObjects::SciWindowTransport
+// --------------------------------------------------------------------------------------
+sptr_t SciWindowTransport::send(unsigned msg, uptr_t wParam, sptr_t lParam) {
 	DWORD_PTR result = 0;
 	try {
 		::SendMessageTimeoutW(_windowHandle, msg, wParam, lParam, SMTO_NORMAL, 5000, &result);
 	} catch (...) {
 	}
-	return static_cast<LRESULT>(result);
+	return static_cast<sptr_t>(result);
 }
+
 // --------------------------------------------------------------------------------------
-LRESULT SciWindowedObject::sendMessage(const UINT msg, WPARAM wParam, void *lParam) const {
-	DWORD_PTR result = 0;
-	try {
-		::SendMessageTimeoutW(
-		    _windowHandle, msg, wParam, reinterpret_cast<LPARAM>(lParam), SMTO_NORMAL, 5000, &result);
-	} catch (...) {
+// SciTextObjects::SciDirectTransport
+// --------------------------------------------------------------------------------------
+SciDirectTransport::SciDirectTransport(HWND hWnd, SciFnDirect fn, SciFnDirectStatus fnStatus, sptr_t ptr) noexcept
+    : _fallback(hWnd),
+      _fn(fn),
+      _fnStatus(fnStatus),
+      _ptr(ptr),
+      _ownerThread(::GetWindowThreadProcessId(hWnd, nullptr)) {
+}
+// --------------------------------------------------------------------------------------
+std::shared_ptr<SciMessageTransport> SciDirectTransport::create(HWND hWnd) {
+	SciWindowTransport window{ hWnd };
+	// SCI_GETDIRECTSTATUSFUNCTION is new in Scintilla 5.1.5; older versions answer 0
+	auto fnStatus = reinterpret_cast<SciFnDirectStatus>(window.send(SCI_GETDIRECTSTATUSFUNCTION, 0, 0));
+	auto fn = fnStatus ? nullptr : reinterpret_cast<SciFnDirect>(window.send(SCI_GETDIRECTFUNCTION, 0, 0));
+	sptr_t ptr = window.send(SCI_GETDIRECTPOINTER, 0, 0);
+	if (ptr == 0 || (!fn && !fnStatus))
+		return nullptr;
+	return std::shared_ptr<SciMessageTransport>(new SciDirectTransport(hWnd, fn, fnStatus, ptr));
+}
+// --------------------------------------------------------------------------------------
+sptr_t SciDirectTransport::send(unsigned msg, uptr_t wParam, sptr_t lParam) {
+	if (msg < SCI_START || ::GetCurrentThreadId() != _ownerThread)
+		return _fallback.send(msg, wParam, lParam);
+	if (_fnStatus)
+		return _fnStatus(_ptr, msg, wParam, lParam, &_status);
+	return _fn(_ptr, msg, wParam, lParam);
+}
+
+// --------------------------------------------------------------------------------------
+// SciTextObjects::SciMessageRecorder
+// --------------------------------------------------------------------------------------
+SciMessageRecorder::SciMessageRecorder(HWND hWnd, std::string command, bool anonymize)
+    : _windowHandle(hWnd),
+      _ownerThread(::GetCurrentThreadId()),
+      _previous(nullptr),
+      _trace(std::move(command), anonymize) {
+	auto transport = SciMessageTransport::forWindow(hWnd);
+	_trace.snapshot([&transport](unsigned msg, uptr_t wParam, sptr_t lParam) {
+		return transport->send(msg, wParam, lParam);
+	});
+	_previous = activeRecorder.exchange(this);
+}
+// --------------------------------------------------------------------------------------
+SciMessageRecorder::~SciMessageRecorder() {
+	activeRecorder.store(_previous);
+}
+// --------------------------------------------------------------------------------------
+SciMessageRecorder *SciMessageRecorder::recording(HWND hWnd) noexcept {
+	SciMessageRecorder *recorder = activeRecorder.load(std::memory_order_relaxed);
+	if (!recorder || recorder->_windowHandle != hWnd || recorder->_ownerThread != ::GetCurrentThreadId())
+		return nullptr;
+	return recorder;
+}
+// --------------------------------------------------------------------------------------
+sptr_t SciMessageRecorder::send(SciMessageTransport &transport, unsigned msg, uptr_t wParam, sptr_t lParam) {
+	using namespace std::chrono;
+	SciTraceRecord record = _trace.begin(msg, wParam, lParam);
+	const auto start = steady_clock::now();
+	const sptr_t result = transport.send(msg, wParam, lParam);
+	const auto elapsed = duration_cast<nanoseconds>(steady_clock::now() - start).count();
+	_trace.end(std::move(record), result, static_cast<uint64_t>(elapsed));
+	return result;
+}
+
+// --------------------------------------------------------------------------------------
+// SciTextObjects::SciWindowedObject
+// --------------------------------------------------------------------------------------
+LRESULT SciWindowedObject::sendMessage(const UINT msg, WPARAM wParam, LPARAM lParam) const {
+	if constexpr (SciMessageStats::enabled) {
+		const auto started = SciMessageStats::Clock::now();
+		const sptr_t result = deliver(msg, wParam, lParam);
+		SciMessageStats::count(msg, wParam, lParam, result, started);
+		return static_cast<LRESULT>(result);
 	}
-	return static_cast<LRESULT>(result);
+	return static_cast<LRESULT>(deliver(msg, wParam, lParam));
+}
+// --------------------------------------------------------------------------------------
+LRESULT SciWindowedObject::sendMessage(const UINT msg, WPARAM wParam, void *lParam) const {
+	return sendMessage(msg, wParam, reinterpret_cast<LPARAM>(lParam));
 }
 // --------------------------------------------------------------------------------------
 void SciWindowedObject::postMessage(const UINT msg, WPARAM wParam, LPARAM lParam) const {
@@ -45,13 +195,19 @@ void SciWindowedObject::postMessage(const UINT msg, WPARAM wParam, LPARAM lParam
 		::PostMessageW(_windowHandle, msg, wParam, lParam);
 	} catch (...) {
 	}
+	// Posted messages return at once, so only their number is worth counting
+	if constexpr (SciMessageStats::enabled)
+		SciMessageStats::count(msg, wParam, 0, 0, SciMessageStats::Clock::now());
 }
 // --------------------------------------------------------------------------------------
 void SciWindowedObject::postMessage(const UINT msg, WPARAM wParam, void *lParam) const {
-	try {
-		::PostMessageW(_windowHandle, msg, wParam, reinterpret_cast<LPARAM>(lParam));
-	} catch (...) {
-	}
+	postMessage(msg, wParam, reinterpret_cast<LPARAM>(lParam));
+}
+// --------------------------------------------------------------------------------------
+sptr_t SciWindowedObject::deliver(const UINT msg, WPARAM wParam, LPARAM lParam) const {
+	if (SciMessageRecorder *recorder = SciMessageRecorder::recording(_windowHandle))
+		return recorder->send(*_transport, msg, wParam, lParam);
+	return _transport->send(msg, wParam, lParam);
 }
 
 // --------------------------------------------------------------------------------------
@@ -78,10 +234,81 @@ SelectionMode SciActiveDocument::getSelectionMode() const {
 	return static_cast<SelectionMode>(mode);
 }
 // --------------------------------------------------------------------------------------
+std::vector<SciTextRange> SciActiveDocument::getSelections() const {
+	std::vector<SciTextRange> ranges;
+	const LRESULT count = sendMessage(SCI_GETSELECTIONS);
+	for (LRESULT i = 0; i < count; i++) {
+		ranges.emplace_back(
+		    *this, sendMessage(SCI_GETSELECTIONNSTART, i), sendMessage(SCI_GETSELECTIONNEND, i));
+	}
+	std::sort(ranges.begin(), ranges.end(),
+	    [](SciTextRange const &a, SciTextRange const &b) { return a.startPos() < b.startPos(); });
+	return ranges;
+}
+// --------------------------------------------------------------------------------------
 void SciActiveDocument::insert(std::wstring const &text, const Sci_Position position) const {
-	std::string chars(sizeof(wchar_t) * text.size() + 1, 0);
-	textToBytes(text.c_str(), chars, (UINT)sendMessage(SCI_GETCODEPAGE));
-	sendMessage(SCI_INSERTTEXT, position, &chars[0]);
+	ScratchBytes chars;
+	textToBytes(text.data(), text.size(), *chars, codePage());
+	sendMessage(SCI_INSERTTEXT, position, chars->data());
+	invalidateText();
+}
+// --------------------------------------------------------------------------------------
+SciSnapshotPtr SciActiveDocument::snapshot() const {
+	SpanTrace::Span span{ "SciActiveDocument::snapshot", "io" };
+	const auto document = static_cast<sptr_t>(sendMessage(SCI_GETDOCPOINTER));
+	const uint64_t version = textVersion;
+	std::unique_ptr<SciDocumentSnapshot> copy{ new SciDocumentSnapshot{} };
+	{
+		std::lock_guard<std::mutex> lock{ snapshotsLock };
+		for (auto const &latest : latestSnapshots) {
+			SciSnapshotPtr shared = latest.second.lock();
+			if (latest.first == document && shared && shared->_version == version)
+				return shared;
+		}
+		auto spare = std::find_if(spareSnapshotBuffers.begin(), spareSnapshotBuffers.end(),
+		    [document](auto const &buffer) { return buffer.first == document; });
+		if (spare != spareSnapshotBuffers.end()) {
+			copy->_text = std::move(spare->second);
+			spareSnapshotBuffers.erase(spare);
+		}
+	}
+
+	// Gathers the text into one block, so it only has to be copied once
+	const auto *chars = reinterpret_cast<const char *>(sendMessage(SCI_GETCHARACTERPOINTER));
+	copy->_text.assign(chars ? chars : "", chars ? static_cast<size_t>(getLength()) : 0);
+	copy->_document = document;
+	copy->_version = version;
+	copy->_codePage = codePage();
+	const auto languageLength = static_cast<size_t>(sendMessage(SCI_GETLEXERLANGUAGE, UNUSEDW, nullptr));
+	if (languageLength > 0) {
+		copy->_language.resize(languageLength + 1);
+		sendMessage(SCI_GETLEXERLANGUAGE, UNUSEDW, &copy->_language[0]);
+		copy->_language.resize(languageLength);
+	}
+
+	SciSnapshotPtr shared{ copy.release(), [](SciDocumentSnapshot const *expired) {
+		std::unique_ptr<SciDocumentSnapshot> owned{ const_cast<SciDocumentSnapshot *>(expired) };
+		try {
+			std::lock_guard<std::mutex> lock{ snapshotsLock };
+			spareSnapshotBuffers.erase(std::remove_if(spareSnapshotBuffers.begin(), spareSnapshotBuffers.end(),
+			    [&owned](auto const &buffer) { return buffer.first == owned->_document; }),
+			    spareSnapshotBuffers.end());
+			spareSnapshotBuffers.emplace_back(owned->_document, std::move(owned->_text));
+			if (spareSnapshotBuffers.size() > maxSpareSnapshotBuffers)
+				spareSnapshotBuffers.erase(spareSnapshotBuffers.begin());
+		} catch (...) {
+		}
+	} };
+	std::lock_guard<std::mutex> lock{ snapshotsLock };
+	latestSnapshots.erase(std::remove_if(latestSnapshots.begin(), latestSnapshots.end(),
+	    [document](auto const &latest) { return latest.first == document || latest.second.expired(); }),
+	    latestSnapshots.end());
+	latestSnapshots.emplace_back(document, shared);
+	return shared;
+}
+// --------------------------------------------------------------------------------------
+void SciActiveDocument::invalidateText() noexcept {
+	++textVersion;
 }
 // --------------------------------------------------------------------------------------
 void SciActiveDocument::select(const Sci_Position startPos, const Sci_Position length) const {
@@ -121,6 +348,7 @@ void SciActiveDocument::find(std::wstring const &text, SciTextRange &target, con
 // --------------------------------------------------------------------------------------
 void SciActiveDocument::find(std::wstring const &text, SciTextRange &target, const int options,
     const Sci_Position startPos, Sci_Position endPos) const {
+	SpanTrace::Span span{ "SciActiveDocument::find", "lookup" };
 	UINT sciMsg = (this->_apiLevel < SciApiLevel::sciApi_GTE_523) ? SCI_FINDTEXT : SCI_FINDTEXTFULL;
 	Sci_TextToFindFull ttf = Sci_TextToFindFull{};
 
@@ -133,9 +361,9 @@ void SciActiveDocument::find(std::wstring const &text, SciTextRange &target, con
 	else
 		ttf.chrg.cpMax = endPos;
 
-	std::string lpstrText(sizeof(wchar_t) * text.size() + 1, 0);
-	textToBytes(text.c_str(), lpstrText, (UINT)sendMessage(SCI_GETCODEPAGE));
-	ttf.lpstrText = &lpstrText[0];
+	ScratchBytes lpstrText;
+	textToBytes(text.data(), text.size(), *lpstrText, codePage());
+	ttf.lpstrText = lpstrText->data();
 	ttf.chrgText = ttf.chrg;
 	LRESULT rngStart = sendMessage(sciMsg, options, &ttf);
 
@@ -191,6 +419,17 @@ Sci_Position SciActiveDocument::currentPosition(const Sci_Position value) const
 	return (sendMessage(SCI_SETCURRENTPOS, value) == 0) ? value : INVALID_POSITION;
 }
 
+// --------------------------------------------------------------------------------------
+// SciTextObjects::SciDocumentSnapshot
+// --------------------------------------------------------------------------------------
+bool SciDocumentSnapshot::stale() const noexcept {
+	return textVersion.load(std::memory_order_relaxed) != _version;
+}
+// --------------------------------------------------------------------------------------
+bool SciDocumentSnapshot::matches(SciActiveDocument const &doc) const {
+	return !stale() && static_cast<sptr_t>(doc.sendMessage(SCI_GETDOCPOINTER)) == _document;
+}
+
 // --------------------------------------------------------------------------------------
 // SciTextObjects::SciTextRange
 // --------------------------------------------------------------------------------------
@@ -254,28 +493,58 @@ const std::wstring SciTextRange::text() {
 	if (getLength() <= 0)
 		return _text;
 
+	const UINT cp = _editor.codePage();
+	const uint64_t version = textVersion;
+	if (_textVersion == version && _textCodePage == cp && _textStartPos == _startPos && _textEndPos == _endPos) {
+		++textCacheHits;
+		return _text;
+	}
+
+	++textCacheMisses;
+	SpanTrace::Span span{ "SciTextRange::text", "io" };
+	ScratchBytes bytes;
+	getBytes(*bytes);
+	bytesToText(bytes->data(), bytes->size(), _text, cp);
+	_textVersion = version;
+	_textCodePage = cp;
+	_textStartPos = _startPos;
+	_textEndPos = _endPos;
+	return _text;
+}
+// --------------------------------------------------------------------------------------
+void SciTextRange::getBytes(std::string &dest) const {
+	if (getLength() <= 0) {
+		dest.clear();
+		return;
+	}
+
+	SpanTrace::Span span{ "SciTextRange::getBytes", "io" };
 	UINT sciMsg = (_editor._apiLevel < SciApiLevel::sciApi_GTE_523) ? SCI_GETTEXTRANGE : SCI_GETTEXTRANGEFULL;
 	Sci_TextRangeFull tr = Sci_TextRangeFull{};
-	std::string lpstrText(getLength() + 1, 0);
+	dest.resize(static_cast<size_t>(getLength()) + 1);
 	tr.chrg.cpMin = _startPos;
 	tr.chrg.cpMax = _endPos;
-	tr.lpstrText = &lpstrText[0];
+	tr.lpstrText = &dest[0];
 
-	_editor.sendMessage(sciMsg, 0, &tr);
-	bytesToText(tr.lpstrText, _text, (UINT)_editor.sendMessage(SCI_GETCODEPAGE));
-	return _text;
+	const LRESULT nBytes = _editor.sendMessage(sciMsg, 0, &tr);
+	dest.resize(static_cast<size_t>(nBytes));
 }
 // --------------------------------------------------------------------------------------
 void SciTextRange::setText(std::wstring const &value) {
-	Sci_Position txtRng = 0, nReplaced = 0;
-	std::string chars(sizeof(wchar_t) * value.size() + 1, 0);
+	ScratchBytes bytes;
+	textToBytes(value.data(), value.size(), *bytes, _editor.codePage());
+	setBytes(*bytes);
+}
+// --------------------------------------------------------------------------------------
+void SciTextRange::setBytes(std::string const &value) {
+	SpanTrace::Span span{ "SciTextRange::setBytes", "io" };
+	Sci_Position nReplaced = 0;
 	UINT sciMsg = (_editor._apiLevel < SciApiLevel::sciApi_GTE_532) ? SCI_REPLACETARGET : SCI_REPLACETARGETMINIMAL;
-	textToBytes(&value[0], chars, (UINT)_editor.sendMessage(SCI_GETCODEPAGE));
-	txtRng = static_cast<Sci_Position>(chars.substr(0, chars.find_first_of('\0')).size());
 	_editor.sendMessage(SCI_SETTARGETSTART, _startPos);
 	_editor.sendMessage(SCI_SETTARGETEND, _endPos);
-	nReplaced = _editor.sendMessage(sciMsg, txtRng, &chars[0]);
+	nReplaced = _editor.sendMessage(sciMsg, value.size(), reinterpret_cast<LPARAM>(value.c_str()));
 	_endPos -= (_endPos - _startPos) - nReplaced;
+	SciActiveDocument::invalidateText();
 }
 // --------------------------------------------------------------------------------------
 Sci_Position SciTextRange::getStartCol() const {
@@ -292,6 +561,7 @@ int SciTextRange::getIndentLevel() const {
 // --------------------------------------------------------------------------------------
 void SciTextRange::setIndentLevel(const int value) {
 	_editor.sendMessage(SCI_SETLINEINDENTATION, value);
+	SciActiveDocument::invalidateText();
 }
 // --------------------------------------------------------------------------------------
 Sci_Position SciTextRange::getEndCol() const {
@@ -307,6 +577,7 @@ void SciTextRange::indent(const int levels) {
 		_editor.sendMessage(
 		    SCI_SETLINEINDENTATION, i, _editor.sendMessage(SCI_GETLINEINDENTATION, i) + LRESULT(levels));
 	}
+	SciActiveDocument::invalidateText();
 }
 // --------------------------------------------------------------------------------------
 void SciTextRange::mark(const int style, const unsigned durationInMs) {
@@ -327,6 +598,10 @@ void SciTextRange::select() {
 void SciTextRange::clearSelection() {
 	setAnchor(_editor.currentPosition());
 }
+// --------------------------------------------------------------------------------------
+SciTextCacheStats SciTextRange::textCacheStats() noexcept {
+	return SciTextCacheStats{ textCacheHits, textCacheMisses };
+}
 
 // --------------------------------------------------------------------------------------
 // SciTextObjects::SciSelection
@@ -369,22 +644,32 @@ void SciSelection::setStart(const Sci_Position value) {
 }
 // --------------------------------------------------------------------------------------
 const std::wstring SciSelection::text() {
+	ScratchBytes bytes;
+	getBytes(*bytes);
+	bytesToText(bytes->data(), bytes->size(), _text, _editor.codePage());
+	return _text;
+}
+// --------------------------------------------------------------------------------------
+void SciSelection::getBytes(std::string &dest) const {
 	Sci_Position lenSel = _editor.sendMessage(SCI_GETSELTEXT, 0, nullptr);
 	if (_editor.getApiLevel() >= SciApiLevel::sciApi_GTE_515)
 		lenSel++;
-	std::string chars(lenSel, 0);
-	_editor.sendMessage(SCI_GETSELTEXT, 0, &chars[0]);
-	bytesToText(&chars[0], _text, (UINT)_editor.sendMessage(SCI_GETCODEPAGE));
-	return _text;
+	dest.resize(static_cast<size_t>(lenSel));
+	_editor.sendMessage(SCI_GETSELTEXT, 0, &dest[0]);
+	dest.resize(static_cast<size_t>(lenSel) - 1);
 }
 // --------------------------------------------------------------------------------------
 void SciSelection::setText(std::wstring const &value) {
-	Sci_Position lenNew = 0, endPos = 0;
-	std::string chars(sizeof(wchar_t) * value.size() + 1, 0);
-	textToBytes(&value[0], chars, (UINT)_editor.sendMessage(SCI_GETCODEPAGE));
-	lenNew = static_cast<Sci_Position>(chars.substr(0, chars.find_first_of('\0')).size());
+	ScratchBytes bytes;
+	textToBytes(value.data(), value.size(), *bytes, _editor.codePage());
+	setBytes(*bytes);
+}
+// --------------------------------------------------------------------------------------
+void SciSelection::setBytes(std::string const &value) {
+	Sci_Position lenNew = static_cast<Sci_Position>(value.size()), endPos = 0;
 	bool Reversed = (this->getAnchor() > this->getCurrentPos());
-	_editor.sendMessage(SCI_REPLACESEL, 0, &chars[0]);
+	_editor.sendMessage(SCI_REPLACESEL, 0, reinterpret_cast<LPARAM>(value.c_str()));
+	SciActiveDocument::invalidateText();
 	endPos = this->getCurrentPos();
 	if (Reversed)
 		_editor.sendMessage(SCI_SETSEL, endPos, endPos - lenNew);
@@ -422,3 +707,35 @@ SciTextRangeMark::~SciTextRangeMark() {
 		currentStyleEnd = _startPos;
 	_editor.sendMessage(SCI_STARTSTYLING, currentStyleEnd);
 }
+
+// --------------------------------------------------------------------------------------
+// SciTextObjects::SciBulkEdit
+// --------------------------------------------------------------------------------------
+SciBulkEdit::SciBulkEdit(SciActiveDocument const &editor_, const int eventMask)
+    : _editor(editor_),
+      _eventMask(editor_.sendMessage(SCI_GETMODEVENTMASK)),
+      // Redraw is already off if an outer scope (or a hidden view) got here first
+      _restoreRedraw(::IsWindowVisible(editor_.windowHandle()) != FALSE) {
+	_editor.sendMessage(SCI_BEGINUNDOACTION);
+	_editor.sendMessage(SCI_SETMODEVENTMASK, eventMask);
+	if (_restoreRedraw)
+		_editor.sendMessage(WM_SETREDRAW, FALSE);
+}
+// --------------------------------------------------------------------------------------
+SciBulkEdit::~SciBulkEdit() {
+	_editor.sendMessage(SCI_SETMODEVENTMASK, _eventMask);
+	_editor.sendMessage(SCI_ENDUNDOACTION);
+	if (_restoreRedraw) {
+		_editor.sendMessage(WM_SETREDRAW, TRUE);
+		::InvalidateRect(_editor.windowHandle(), nullptr, TRUE);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+void eraseTransport(HWND hWnd) {
+	transports.erase(std::remove_if(transports.begin(), transports.end(),
+			     [hWnd](auto &&transport) { return transport.first == hWnd; }),
+	    transports.end());
+}
+}
@@ -15,10 +15,16 @@
 #define SCI_TEXT_OBJECTS_H
 
 #include <string>
+#include <string_view>
 #include <memory>
+#include <vector>
+#include <functional>
 #include <windows.h>
 #include "Scintilla.h"
 #include "SciApi.h"
+#include "SciMessageTrace.h"
+#include "SciMessageStats.h"
+#include "SpanTrace.h"
 
 #define UNUSED 0LL
 #define UNUSEDW 0ULL
@@ -28,8 +34,113 @@ enum MessageResult : LRESULT { mrFalse, mrTrue };
 enum SelectionMode : unsigned { smStreamSingle = SC_SEL_STREAM, smColumn, smLines, smThin, smStreamMulti };
 constexpr unsigned multiselectionMask = 0x4;
 
+/// How often @c SciTextRange::text() could skip refetching the text
+struct SciTextCacheStats {
+	uint64_t hits;
+	uint64_t misses;
+};
+
 class SciTextRange;
 class SciSelection;
+class SciWindowedObject;
+class SciDocumentSnapshot;
+using SciSnapshotPtr = std::shared_ptr<const SciDocumentSnapshot>;
+
+// --------------------------------------------------------------------------------------
+// SciMessageTransport
+// --------------------------------------------------------------------------------------
+/// Delivers messages to an editor window, or to anything standing in for one
+class SciMessageTransport {
+
+public:
+	virtual ~SciMessageTransport() = default;
+	virtual sptr_t send(unsigned msg, uptr_t wParam, sptr_t lParam) = 0;
+
+	/// @brief Routes the messages of every object created for @p hWnd from now on through @p transport.
+	static void attach(HWND hWnd, std::shared_ptr<SciMessageTransport> transport);
+	static void detach(HWND hWnd);
+	/// @brief Returns the transport attached to @p hWnd, or else a @c SciWindowTransport.
+	static std::shared_ptr<SciMessageTransport> forWindow(HWND hWnd);
+};
+
+// --------------------------------------------------------------------------------------
+// SciWindowTransport
+// --------------------------------------------------------------------------------------
+/// Sends window messages; works for any window, from any thread
+class SciWindowTransport final : public SciMessageTransport {
+
+public:
+	explicit SciWindowTransport(HWND hWnd) noexcept : _windowHandle(hWnd) {}
+	sptr_t send(unsigned msg, uptr_t wParam, sptr_t lParam) override;
+
+private:
+	HWND _windowHandle;
+};
+
+// --------------------------------------------------------------------------------------
+// SciDirectTransport
+// --------------------------------------------------------------------------------------
+/// Calls straight into a Scintilla instance, skipping the window procedure
+/// @note Window messages, and messages sent from other threads, still go through @c SciWindowTransport
+class SciDirectTransport final : public SciMessageTransport {
+
+public:
+	/// @return A direct transport for @p hWnd, or @c nullptr if it doesn't provide one
+	static std::shared_ptr<SciMessageTransport> create(HWND hWnd);
+	sptr_t send(unsigned msg, uptr_t wParam, sptr_t lParam) override;
+	int lastStatus() const noexcept { return _status; }
+
+private:
+	SciDirectTransport(HWND hWnd, SciFnDirect fn, SciFnDirectStatus fnStatus, sptr_t ptr) noexcept;
+	SciWindowTransport _fallback;
+	SciFnDirect _fn;
+	SciFnDirectStatus _fnStatus;
+	sptr_t _ptr;
+	DWORD _ownerThread;
+	int _status = 0;
+};
+
+// --------------------------------------------------------------------------------------
+// SciCallbackTransport
+// --------------------------------------------------------------------------------------
+/// Hands messages to a function in the same process, e.g. a fake editor under test
+class SciCallbackTransport final : public SciMessageTransport {
+
+public:
+	using Callback = std::function<sptr_t(unsigned, uptr_t, sptr_t)>;
+	explicit SciCallbackTransport(Callback callback) : _callback(std::move(callback)) {}
+	sptr_t send(unsigned msg, uptr_t wParam, sptr_t lParam) override { return _callback(msg, wParam, lParam); }
+
+private:
+	Callback _callback;
+};
+
+// --------------------------------------------------------------------------------------
+// SciMessageRecorder
+// --------------------------------------------------------------------------------------
+/// @brief Records what every @c SciWindowedObject sends to one window from the calling thread,
+/// from construction until destruction.
+class SciMessageRecorder final {
+
+public:
+	/// @param anonymize See @c SciMessageTrace
+	SciMessageRecorder(HWND hWnd, std::string command, bool anonymize = false);
+	~SciMessageRecorder();
+	SciMessageRecorder(const SciMessageRecorder &) = delete;
+	SciMessageRecorder &operator=(const SciMessageRecorder &) = delete;
+	SciMessageTrace const &trace() const noexcept { return _trace; }
+
+private:
+	friend SciWindowedObject;
+	/// @return The recorder listening to @p hWnd on this thread, or @c nullptr
+	static SciMessageRecorder *recording(HWND hWnd) noexcept;
+	sptr_t send(SciMessageTransport &transport, unsigned msg, uptr_t wParam, sptr_t lParam);
+
+	HWND _windowHandle;
+	DWORD _ownerThread;
+	SciMessageRecorder *_previous;
+	SciMessageTrace _trace;
+};
 
 // --------------------------------------------------------------------------------------
 // SciWindowedObject
@@ -37,18 +148,27 @@ class SciSelection;
 class SciWindowedObject {
 
 public:
-	SciWindowedObject(HWND hWnd) : _windowHandle(hWnd), _apiLevel(SciApiLevel::sciApi_GTE_541) {}
+	SciWindowedObject(HWND hWnd)
+	    : _windowHandle(hWnd),
+	      _apiLevel(SciApiLevel::sciApi_GTE_541),
+	      _transport(SciMessageTransport::forWindow(hWnd)) {}
 	virtual ~SciWindowedObject() = default;
 	virtual LRESULT sendMessage(const UINT msg, WPARAM wParam = UNUSEDW, LPARAM lParam = UNUSED) const;
 	virtual LRESULT sendMessage(const UINT msg, WPARAM wParam, void *lParam) const;
 	virtual void postMessage(const UINT msg, WPARAM wParam = UNUSEDW, LPARAM lParam = UNUSED) const;
 	virtual void postMessage(const UINT msg, WPARAM wParam, void *lParam) const;
 	SciApiLevel getApiLevel() const { return _apiLevel; }
+	HWND const &windowHandle() const noexcept { return _windowHandle; }
 
 protected:
 	HWND _windowHandle;
 	SciApiLevel _apiLevel;
+	std::shared_ptr<SciMessageTransport> _transport;
 	virtual void setApiLevel(SciApiLevel api) { _apiLevel = api; }
+
+private:
+	/// @brief Hands a message to the recorder, if one is listening, or else straight to the transport.
+	sptr_t deliver(const UINT msg, WPARAM wParam, LPARAM lParam) const;
 };
 
 // --------------------------------------------------------------------------------------
@@ -62,6 +182,7 @@ public:
 	SciTextRange getRange(const Sci_Position startPos = 0, const Sci_Position endPos = 0) const;
 	SciTextRange getLines(const Sci_Position startLine, const Sci_Position count = 1) const;
 	SelectionMode getSelectionMode() const;
+	std::vector<SciTextRange> getSelections() const;
 	void insert(std::wstring const &text, const Sci_Position pos) const;
 	void select(const Sci_Position start = 0, const Sci_Position length = INVALID_POSITION) const;
 	void selectLines(const Sci_Position startLine, const Sci_Position lineCount = 1) const;
@@ -74,6 +195,14 @@ public:
 	Sci_Position currentPosition(const Sci_Position value) const;
 	Sci_Position nextLineStartPosition() const { return getNextLineStart(); }
 	Sci_Position length() const { return getLength(); }
+	UINT codePage() const { return static_cast<UINT>(sendMessage(SCI_GETCODEPAGE)); }
+	bool readOnly() const { return getReadOnly(); }
+	void readOnly(const bool value) { setReadOnly(value); }
+	/// @brief Copies the text for reading off the UI thread, or shares the latest snapshot of this document
+	/// if no document has been edited or swapped since.
+	SciSnapshotPtr snapshot() const;
+	/// @brief Marks the text cached by every range as stale; call when any document is edited or swapped.
+	static void invalidateText() noexcept;
 
 	void setApiLevel(SciApiLevel api) override { SciWindowedObject::setApiLevel(api); };
 
@@ -90,6 +219,41 @@ private:
 	void setReadOnly(bool value);
 };
 
+// --------------------------------------------------------------------------------------
+// SciDocumentSnapshot
+// --------------------------------------------------------------------------------------
+/// @brief A copy of a document's text, taken on the UI thread, which any thread can read while the editor
+/// carries on. When no one holds a snapshot any more, its buffer is kept for the next one of the same document.
+///
+/// The version is counted for all documents together: an edit to any buffer, or a tab switch, makes every
+/// snapshot stale, including those of documents that didn't change.
+class SciDocumentSnapshot final {
+	friend SciActiveDocument;
+
+public:
+	std::string_view text() const noexcept { return _text; }
+	/// The document's identity, from @c SCI_GETDOCPOINTER
+	sptr_t document() const noexcept { return _document; }
+	/// The count of edits to any document when the snapshot was taken
+	uint64_t version() const noexcept { return _version; }
+	UINT codePage() const noexcept { return _codePage; }
+	/// The name of the document's lexer, e.g. @c "hypertext"
+	std::string const &language() const noexcept { return _language; }
+	/// @brief @c true if any document has been edited or swapped out since, meaning that results computed from
+	/// the snapshot must be thrown away. Safe to poll from any thread.
+	bool stale() const noexcept;
+	/// @brief @c true if @p doc still holds the text that was copied, so results computed from it can be applied.
+	bool matches(SciActiveDocument const &doc) const;
+
+private:
+	SciDocumentSnapshot() = default;
+	std::string _text;
+	sptr_t _document = 0;
+	uint64_t _version = 0;
+	UINT _codePage = 0;
+	std::string _language;
+};
+
 // --------------------------------------------------------------------------------------
 // SciTextRange
 // --------------------------------------------------------------------------------------
@@ -105,6 +269,35 @@ public:
 	virtual Sci_Position endPos() const { return getEnd(); }
 	virtual Sci_Position length() const { return getLength(); }
 	virtual const std::wstring text();
+	virtual void getBytes(std::string &dest) const;
+	virtual void setBytes(std::string const &value);
+
+	/// @brief Passes the text to @p edit as UTF-8 bytes if that's the document's encoding, or else as a wide
+	/// string, and writes it back if @p edit reports any changes.
+	/// @return The result of @p edit
+	template <typename Fn>
+	int transformText(Fn &&edit) {
+		int result = 0;
+		if (_editor.codePage() == SC_CP_UTF8) {
+			std::string bytes;
+			getBytes(bytes);
+			{
+				SpanTrace::Span span{ "SciTextRange::transformText", "replace" };
+				result = edit(bytes);
+			}
+			if (result > 0)
+				setBytes(bytes);
+		} else {
+			std::wstring wideText{ text() };
+			{
+				SpanTrace::Span span{ "SciTextRange::transformText", "replace" };
+				result = edit(wideText);
+			}
+			if (result > 0)
+				setText(wideText);
+		}
+		return result;
+	}
 
 	virtual SciTextRange operator=(SciTextRange const &other) {
 		setStart(other.getStart());
@@ -124,12 +317,17 @@ public:
 	void indent(const int levels = 1);
 	void mark(const int style, const unsigned timeoutMSecs = 0);
 	SciActiveDocument const &editor() const { return _editor; }
+	static SciTextCacheStats textCacheStats() noexcept;
 
 protected:
 	SciActiveDocument _editor;
 	std::wstring _text;
 	Sci_Position _startPos;
 	Sci_Position _endPos;
+	uint64_t _textVersion = 0;
+	UINT _textCodePage = 0;
+	Sci_Position _textStartPos = 0;
+	Sci_Position _textEndPos = 0;
 	Sci_Position getAnchor() const;
 	Sci_Position getFirstLine() const;
 	Sci_Position getStartCol() const;
@@ -161,6 +359,8 @@ public:
 	Sci_Position endPos() const override { return getEnd(); }
 	Sci_Position length() const override { return getLength(); }
 	const std::wstring text() override;
+	void getBytes(std::string &dest) const override;
+	void setBytes(std::string const &value) override;
 
 	SciTextRange operator=(std::wstring const &value) override {
 		setText(value);
@@ -197,5 +397,26 @@ private:
 	Sci_Position _endPos;
 	uintptr_t _timerID;
 };
+
+// --------------------------------------------------------------------------------------
+// SciBulkEdit
+// --------------------------------------------------------------------------------------
+/// Groups edits into a single undo action, with redraws and most @c SCN_MODIFIED events suppressed until
+/// the object goes out of scope
+class SciBulkEdit final {
+
+public:
+	explicit SciBulkEdit(SciActiveDocument const &editor_, const int eventMask = SC_MOD_NONE);
+	~SciBulkEdit();
+	SciBulkEdit(const SciBulkEdit &) = delete;
+	SciBulkEdit(SciBulkEdit &&) = delete;
+	SciBulkEdit &operator=(const SciBulkEdit &) = delete;
+	SciBulkEdit &operator=(SciBulkEdit &&) = delete;
+
+private:
+	SciActiveDocument _editor;
+	LRESULT _eventMask;
+	bool _restoreRedraw;
+};
 }
 #endif // ~SCI_TEXT_OBJECTS_H
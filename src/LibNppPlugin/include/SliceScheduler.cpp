@@ -0,0 +1,74 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#include <algorithm>
+#include "SliceScheduler.h"
+
+// --------------------------------------------------------------------------------------
+// SliceScheduler
+// --------------------------------------------------------------------------------------
+SliceScheduler::SliceScheduler(std::chrono::microseconds budget, Now now)
+    : _budget(budget), _now(now ? std::move(now) : Now{ &Clock::now }) {}
+// --------------------------------------------------------------------------------------
+void SliceScheduler::start(SlicedJob job) {
+	cancel();
+	_job = std::move(job);
+	_stats = SliceStats{ 0, 0, 0 };
+	_cancelled = false;
+	_running = static_cast<bool>(_job.step);
+}
+// --------------------------------------------------------------------------------------
+bool SliceScheduler::runSlice() {
+	if (!_running)
+		return false;
+
+	const Clock::time_point started = _now();
+	bool more = true;
+	++_stats.slices;
+	_inSlice = true;
+	try {
+		// Always make some headway, however slow the steps are
+		do {
+			++_stats.steps;
+			more = _job.step();
+		} while (more && !_cancelled && _now() - started < _budget);
+
+		const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(_now() - started);
+		_stats.longest = (std::max)(_stats.longest, static_cast<uint64_t>(elapsed.count()));
+		if (more && !_cancelled && _job.yield && !_job.yield())
+			_cancelled = true;
+	} catch (...) {
+		// A job that throws is left half done, which is as good as cancelled
+		_cancelled = true;
+	}
+	_inSlice = false;
+
+	if (!more || _cancelled) {
+		finish(_cancelled);
+		return false;
+	}
+	return true;
+}
+// --------------------------------------------------------------------------------------
+void SliceScheduler::cancel() {
+	if (!_running)
+		return;
+	// Never free a step, or the yield, while it's still running
+	if (_inSlice)
+		_cancelled = true;
+	else
+		finish(true);
+}
+// --------------------------------------------------------------------------------------
+void SliceScheduler::finish(bool cancelled) {
+	_running = false;
+	// Free the job's captures before telling its owner, who may start another
+	SlicedJob job = std::move(_job);
+	_job = SlicedJob{};
+	if (job.completed)
+		job.completed(cancelled);
+}
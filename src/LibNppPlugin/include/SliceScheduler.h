@@ -0,0 +1,73 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#ifndef SLICE_SCHEDULER_H
+#define SLICE_SCHEDULER_H
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+/// A long job that must stay on the UI thread, cut into steps short enough to run between its messages
+struct SlicedJob {
+	/// Does the next piece of work, which should take a small part of a slice.
+	/// Returns @c false once there's none left
+	std::function<bool()> step;
+	/// Runs after each slice that leaves work to do, e.g. to show progress.
+	/// Returns @c false to cancel the job
+	std::function<bool()> yield;
+	/// Runs once the job has finished, with @c true if it was cancelled
+	std::function<void(bool)> completed;
+};
+
+/// How a job's slices went
+struct SliceStats {
+	uint64_t slices;
+	uint64_t steps;
+	/// The longest slice, in nanoseconds
+	uint64_t longest;
+};
+
+/// @brief Runs a @c SlicedJob a few milliseconds at a time, whenever its owner calls @c runSlice,
+/// e.g. from a timer, so the window stays responsive in between.
+///
+/// The clock can be replaced, so that slicing can be checked without waiting on a real one.
+class SliceScheduler final {
+
+public:
+	using Clock = std::chrono::steady_clock;
+	using Now = std::function<Clock::time_point()>;
+
+	/// @param budget How long a slice may keep running steps; at least one step is run every slice
+	/// @param now The clock to time slices by; @c Clock::now by default
+	explicit SliceScheduler(std::chrono::microseconds budget = std::chrono::milliseconds{ 8 }, Now now = nullptr);
+	SliceScheduler(const SliceScheduler &) = delete;
+	SliceScheduler &operator=(const SliceScheduler &) = delete;
+
+	/// @brief Takes on @p job, after cancelling any job still running.
+	void start(SlicedJob job);
+	/// @brief Runs steps of the current job until it's finished or the budget is spent.
+	/// @return @c true if the job has more to do, and another slice should be scheduled
+	bool runSlice();
+	/// @brief Stops the current job before its next step, and reports it as cancelled. Steps may call it too.
+	void cancel();
+	bool running() const noexcept { return _running; }
+	SliceStats const &stats() const noexcept { return _stats; }
+	std::chrono::microseconds budget() const noexcept { return _budget; }
+
+private:
+	void finish(bool cancelled);
+
+	std::chrono::microseconds _budget;
+	Now _now;
+	SlicedJob _job;
+	SliceStats _stats{ 0, 0, 0 };
+	bool _running = false;
+	bool _inSlice = false;
+	bool _cancelled = false;
+};
+#endif // ~SLICE_SCHEDULER_H
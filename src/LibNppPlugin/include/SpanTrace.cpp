@@ -0,0 +1,81 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <ostream>
+#include <windows.h>
+#include "SpanTrace.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+/// One finished span; @c sequence is odd while the slot is being written, so @c flush can skip torn slots
+struct Event {
+	std::atomic<uint64_t> sequence;
+	std::atomic<const char *> name;
+	std::atomic<const char *> category;
+	std::atomic<uint64_t> started;
+	std::atomic<uint64_t> duration;
+	std::atomic<uint32_t> thread;
+};
+
+Event events[SpanTrace::capacity];
+std::atomic<uint64_t> eventsWritten{ 0 };
+std::atomic<uint64_t> eventsFlushed{ 0 };
+}
+
+// --------------------------------------------------------------------------------------
+// SpanTrace
+// --------------------------------------------------------------------------------------
+size_t SpanTrace::flush(std::ostream &os) {
+	const uint64_t written = eventsWritten.load();
+	const uint64_t flushed = eventsFlushed.exchange(written);
+	const uint64_t first = (std::max)(flushed, written > capacity ? written - capacity : 0);
+	size_t count = 0;
+
+	os << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	for (uint64_t i = first; i < written; ++i) {
+		Event const &event = events[i % capacity];
+		const uint64_t sequence = event.sequence.load();
+		const char *name = event.name.load();
+		const char *category = event.category.load();
+		const uint64_t started = event.started.load();
+		const uint64_t duration = event.duration.load();
+		const uint32_t thread = event.thread.load();
+		if (sequence != 2 * i + 2 || event.sequence.load() != sequence)
+			continue;
+
+		char times[64];
+		std::snprintf(times, sizeof times, "\"ts\":%.3f,\"dur\":%.3f", static_cast<double>(started) / 1e3,
+		    static_cast<double>(duration) / 1e3);
+		os << (count++ ? ",\n" : "\n") << "{\"name\":\"" << name << "\",\"cat\":\"" << category
+		   << "\",\"ph\":\"X\"," << times << ",\"pid\":1,\"tid\":" << thread << '}';
+	}
+	os << "\n],\"otherData\":{\"dropped\":" << (first - flushed) << "}}\n";
+	return count;
+}
+// --------------------------------------------------------------------------------------
+uint64_t SpanTrace::now() noexcept {
+	using namespace std::chrono;
+	static const steady_clock::time_point origin = steady_clock::now();
+	return static_cast<uint64_t>(duration_cast<nanoseconds>(steady_clock::now() - origin).count());
+}
+// --------------------------------------------------------------------------------------
+void SpanTrace::record(const char *name, const char *category, uint64_t started, uint64_t ended) noexcept {
+	const uint64_t index = eventsWritten.fetch_add(1);
+	Event &event = events[index % capacity];
+	event.sequence.store(2 * index + 1);
+	event.name.store(name);
+	event.category.store(category);
+	event.started.store(started);
+	event.duration.store(ended - started);
+	// The system's own thread ID, as a debugger shows it
+	event.thread.store(static_cast<uint32_t>(::GetCurrentThreadId()));
+	event.sequence.store(2 * index + 2);
+}
+
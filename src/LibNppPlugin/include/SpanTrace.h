@@ -0,0 +1,56 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#ifndef SPAN_TRACE_H
+#define SPAN_TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <iosfwd>
+
+/// @brief Collects timed, nested spans into a ring buffer, to be saved as Chrome trace-event JSON
+/// and opened in Perfetto or @c about:tracing.
+///
+/// Off by default; while off, a span costs one relaxed load.
+/// When more spans end than the buffer holds between two flushes, the oldest are dropped.
+class SpanTrace final {
+
+public:
+	/// Records the time between its construction and destruction
+	class Span final {
+	public:
+		/// @param name, category Must outlive the trace, e.g. string literals
+		explicit Span(const char *name, const char *category = "plugin") noexcept
+		    : _name(enabled() ? name : nullptr), _category(category), _started(_name ? now() : 0) {}
+		~Span() {
+			if (_name)
+				record(_name, _category, _started, now());
+		}
+		Span(const Span &) = delete;
+		Span &operator=(const Span &) = delete;
+
+	private:
+		const char *_name;
+		const char *_category;
+		uint64_t _started;
+	};
+
+	static constexpr size_t capacity = 0x8000;
+
+	static void enable(bool on) noexcept { _enabled.store(on, std::memory_order_relaxed); }
+	static bool enabled() noexcept { return _enabled.load(std::memory_order_relaxed); }
+	/// @brief Writes the spans recorded since the last flush, and empties the buffer.
+	/// @return The number of spans written
+	static size_t flush(std::ostream &os);
+
+private:
+	/// @return Nanoseconds since the first span
+	static uint64_t now() noexcept;
+	static void record(const char *name, const char *category, uint64_t started, uint64_t ended) noexcept;
+	static inline std::atomic<bool> _enabled{ false };
+};
+#endif // ~SPAN_TRACE_H
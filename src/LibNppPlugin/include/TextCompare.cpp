@@ -0,0 +1,112 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#include "TextCompare.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TEXTCONV_USE_SSE2
+#endif
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+wchar_t foldCase(wchar_t wc) noexcept;
+constexpr char asciiLower(char c) noexcept {
+	return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c;
+}
+}
+
+// --------------------------------------------------------------------------------------
+// TextConv
+// --------------------------------------------------------------------------------------
+bool TextConv::sameText(std::string_view lhs, std::string_view rhs) noexcept {
+	if (lhs.size() != rhs.size())
+		return false;
+
+	size_t i = 0;
+#ifdef TEXTCONV_USE_SSE2
+	// Lowercase 16 bytes at a time; bytes >= 0x80 compare as negative, so they never count as letters
+	const __m128i upperA = _mm_set1_epi8('A' - 1), upperZ = _mm_set1_epi8('Z' + 1), caseBit = _mm_set1_epi8(0x20);
+	auto toLower = [&](__m128i chunk) {
+		const __m128i isUpper = _mm_and_si128(_mm_cmpgt_epi8(chunk, upperA), _mm_cmplt_epi8(chunk, upperZ));
+		return _mm_or_si128(chunk, _mm_and_si128(isUpper, caseBit));
+	};
+	for (; i + 16 <= lhs.size(); i += 16) {
+		const __m128i a = toLower(_mm_loadu_si128(reinterpret_cast<const __m128i *>(lhs.data() + i)));
+		const __m128i b = toLower(_mm_loadu_si128(reinterpret_cast<const __m128i *>(rhs.data() + i)));
+		if (_mm_movemask_epi8(_mm_cmpeq_epi8(a, b)) != 0xFFFF)
+			return false;
+	}
+#endif
+	for (; i < lhs.size(); i++) {
+		if (lhs[i] != rhs[i] && asciiLower(lhs[i]) != asciiLower(rhs[i]))
+			return false;
+	}
+	return true;
+}
+// --------------------------------------------------------------------------------------
+bool TextConv::sameText(std::wstring_view lhs, std::wstring_view rhs) noexcept {
+	if (lhs.size() != rhs.size())
+		return false;
+
+	for (size_t i = 0; i < lhs.size(); i++) {
+		const wchar_t a = lhs[i], b = rhs[i];
+		if (a == b)
+			continue;
+		if (a < 0x80 && b < 0x80) {
+			if (asciiLower(static_cast<char>(a)) != asciiLower(static_cast<char>(b)))
+				return false;
+		} else if (foldCase(a) != foldCase(b)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+/// Simple case folding of the alphabets most likely to show up in tag names and file paths
+/// @see https://www.unicode.org/Public/UCD/latest/ucd/CaseFolding.txt
+wchar_t foldCase(wchar_t wc) noexcept {
+	const auto ch = static_cast<char32_t>(wc);
+	auto shifted = [wc](int offset) { return static_cast<wchar_t>(wc + offset); };
+
+	if (ch < 0x80)
+		return static_cast<wchar_t>(asciiLower(static_cast<char>(ch)));
+	// Latin-1 Supplement
+	if (ch >= 0xC0 && ch <= 0xDE && ch != 0xD7)
+		return shifted(0x20);
+	// Latin Extended-A: mostly upper/lower pairs; dotted and dotless I have no simple folding
+	if (ch == 0x130 || ch == 0x131)
+		return wc;
+	if ((ch >= 0x100 && ch <= 0x137) || (ch >= 0x14A && ch <= 0x177))
+		return static_cast<wchar_t>(ch | 1);
+	if ((ch >= 0x139 && ch <= 0x148) || (ch >= 0x179 && ch <= 0x17E))
+		return (ch & 1) ? shifted(1) : wc;
+	if (ch == 0x178)
+		return 0xFF;
+	if (ch == 0x17F)
+		return L's';
+	// Greek
+	if ((ch >= 0x391 && ch <= 0x3A9 && ch != 0x3A2))
+		return shifted(0x20);
+	if (ch == 0x3C2)
+		return 0x3C3;
+	// Cyrillic
+	if (ch >= 0x400 && ch <= 0x40F)
+		return shifted(0x50);
+	if (ch >= 0x410 && ch <= 0x42F)
+		return shifted(0x20);
+	// Armenian
+	if (ch >= 0x531 && ch <= 0x556)
+		return shifted(0x30);
+	// Fullwidth Latin
+	if (ch >= 0xFF21 && ch <= 0xFF3A)
+		return shifted(0x20);
+	return wc;
+}
+}
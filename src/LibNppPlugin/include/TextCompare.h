@@ -0,0 +1,21 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#ifndef TEXT_COMPARE_H
+#define TEXT_COMPARE_H
+
+#include <string_view>
+
+/// Case-insensitive comparison, independent of the Win32 API
+namespace TextConv {
+/// @brief @c true if both strings are the same, ignoring the case of ASCII letters.
+bool sameText(std::string_view lhs, std::string_view rhs) noexcept;
+/// @brief @c true if both strings are the same, ignoring case.
+/// @note Uses simple case folding for the Latin, Greek, Cyrillic and Armenian alphabets
+bool sameText(std::wstring_view lhs, std::wstring_view rhs) noexcept;
+}
+#endif // ~TEXT_COMPARE_H
@@ -5,8 +5,9 @@
 
   Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
 */
-#include <locale>
+#include <cstring>
 #include "TextConv.h"
+#include "Utf8.h"
 
 /////////////////////////////////////////////////////////////////////////////////////////
 #ifndef WC_ERR_INVALID_CHARS
@@ -18,49 +19,74 @@ unsigned WC_ERR_INVALID_CHARS =
 }
 #endif
 
+namespace {
+bool isAsciiCompatible(UINT cp);
+}
+
 // --------------------------------------------------------------------------------------
 // TextConv
 // --------------------------------------------------------------------------------------
 void TextConv::bytesToText(const char *src, std::wstring &dest, UINT cp) {
 	if (!src)
 		return;
-	// https://learn.microsoft.com/windows/win32/api/stringapiset/nf-stringapiset-multibytetowidechar
-	unsigned dwFlags = (cp == CP_UTF8 || cp == 54936) ? MB_ERR_INVALID_CHARS : 0;
-	int len = ::MultiByteToWideChar(cp, dwFlags, src, -1, nullptr, 0);
-	if (len > 0) {
-		if ((size_t)len > dest.capacity())
-			dest.resize(len);
-		::MultiByteToWideChar(cp, dwFlags, src, -1, &dest[0], len);
-		dest = std::wstring(&dest[0]);
+	bytesToText(src, std::strlen(src), dest, cp);
+}
+// --------------------------------------------------------------------------------------
+size_t TextConv::bytesToText(const char *src, size_t len, std::wstring &dest, UINT cp) {
+	if (!src || len == 0) {
+		dest.clear();
+		return 0;
 	}
+	if (cp == CP_UTF8) {
+		Utf8::toWide(src, len, dest);
+		return dest.size();
+	}
+	if (isAsciiCompatible(cp) && Utf8::asciiPrefix(src, len) == len) {
+		dest.assign(src, src + len);
+		return len;
+	}
+	// https://learn.microsoft.com/windows/win32/api/stringapiset/nf-stringapiset-multibytetowidechar
+	// No code page produces more wide characters than it has bytes, so one pass is enough
+	unsigned dwFlags = (cp == 54936) ? MB_ERR_INVALID_CHARS : 0;
+	dest.resize(len);
+	int nChars = ::MultiByteToWideChar(cp, dwFlags, src, static_cast<int>(len), &dest[0], static_cast<int>(len));
+	dest.resize((nChars > 0) ? static_cast<size_t>(nChars) : 0ULL);
+	return dest.size();
 }
 // --------------------------------------------------------------------------------------
 void TextConv::textToBytes(const wchar_t *src, std::string &dest, UINT cp) {
 	if (!src)
 		return;
-	// https://learn.microsoft.com/windows/win32/api/stringapiset/nf-stringapiset-widechartomultibyte
-	unsigned dwFlags = (cp == CP_UTF8 || cp == 54936) ? WC_ERR_INVALID_CHARS : 0;
-	int len = ::WideCharToMultiByte(cp, dwFlags, src, -1, nullptr, 0, nullptr, nullptr);
-	if (len > 0) {
-		if ((size_t)len > dest.capacity())
-			dest.resize(len);
-		::WideCharToMultiByte(cp, dwFlags, src, -1, &dest[0], len, nullptr, nullptr);
-		dest = std::string(&dest[0]);
-	}
+	textToBytes(src, std::wcslen(src), dest, cp);
 }
 // --------------------------------------------------------------------------------------
-bool TextConv::sameText(std::string lhs, std::string rhs) {
-	auto tolower_l = [](uint8_t c) { return std::tolower(c, std::locale()); };
-	std::transform(lhs.begin(), lhs.end(), lhs.begin(), tolower_l);
-	std::transform(rhs.begin(), rhs.end(), rhs.begin(), tolower_l);
-	return lhs == rhs;
-}
-// --------------------------------------------------------------------------------------
-bool TextConv::sameText(std::wstring lhs, std::wstring rhs) {
-	auto towlower_l = [](std::wint_t wc) { return std::tolower(wc, std::locale()); };
-	std::transform(lhs.begin(), lhs.end(), lhs.begin(), towlower_l);
-	std::transform(rhs.begin(), rhs.end(), rhs.begin(), towlower_l);
-	return lhs == rhs;
+size_t TextConv::textToBytes(const wchar_t *src, size_t len, std::string &dest, UINT cp) {
+	if (!src || len == 0) {
+		dest.clear();
+		return 0;
+	}
+	if (cp == CP_UTF8) {
+		Utf8::fromWide(src, len, dest);
+		return dest.size();
+	}
+	if (isAsciiCompatible(cp) && std::all_of(src, src + len, [](wchar_t wc) { return wc < 0x80; })) {
+		dest.resize(len);
+		std::transform(src, src + len, dest.begin(), [](wchar_t wc) { return static_cast<char>(wc); });
+		return len;
+	}
+	// https://learn.microsoft.com/windows/win32/api/stringapiset/nf-stringapiset-widechartomultibyte
+	// Try the worst case for the double-byte code pages first; only GB18030 should ever need a second pass
+	unsigned dwFlags = (cp == 54936) ? WC_ERR_INVALID_CHARS : 0;
+	int nBytes = static_cast<int>(len * 2);
+	dest.resize(static_cast<size_t>(nBytes));
+	nBytes = ::WideCharToMultiByte(cp, dwFlags, src, static_cast<int>(len), &dest[0], nBytes, nullptr, nullptr);
+	if (nBytes == 0 && ::GetLastError() == ERROR_INSUFFICIENT_BUFFER) {
+		nBytes = ::WideCharToMultiByte(cp, dwFlags, src, static_cast<int>(len), nullptr, 0, nullptr, nullptr);
+		dest.resize(static_cast<size_t>((std::max)(nBytes, 0)));
+		nBytes = ::WideCharToMultiByte(cp, dwFlags, src, static_cast<int>(len), &dest[0], nBytes, nullptr, nullptr);
+	}
+	dest.resize((nBytes > 0) ? static_cast<size_t>(nBytes) : 0ULL);
+	return dest.size();
 }
 // --------------------------------------------------------------------------------------
 size_t TextConv::pos(const char *subStr, std::string const &str, size_t offSet) {
@@ -72,3 +98,12 @@ size_t TextConv::pos(const wchar_t *subStr, std::wstring const &wstr, size_t off
 	const size_t result = wstr.find(subStr, offSet);
 	return (result == std::wstring::npos) ? 0 : result + 1;
 }
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+/// @c true if every ASCII byte in @c cp means the same ASCII character, i.e. it can be widened as-is
+bool isAsciiCompatible(UINT cp) {
+	return cp == CP_ACP || cp == 874 || (cp >= 932 && cp <= 950) || (cp >= 1250 && cp <= 1258) || cp == 1361 ||
+	    cp == 54936;
+}
+}
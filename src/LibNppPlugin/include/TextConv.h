@@ -10,18 +10,22 @@
 
 #include <windows.h>
 #include <string>
+#include <string_view>
 #include <algorithm>
+#include "TextCompare.h"
 
 /// String conversion utilities
 namespace TextConv {
 /// @brief Encodes a byte buffer according to @c cp and stores the result in a wide string.
 void bytesToText(const char *src, std::wstring &dest, UINT cp = CP_UTF8);
+/// @brief Encodes @p len bytes according to @c cp into @p dest, reusing its storage.
+/// @return The number of wide characters written; 0 if @p src is not valid in @c cp
+size_t bytesToText(const char *src, size_t len, std::wstring &dest, UINT cp = CP_UTF8);
 /// @brief Encodes a wide string according to @c cp and stores the result in a character string.
 void textToBytes(const wchar_t *src, std::string &dest, UINT cp = CP_ACP);
-/// @brief @c true if both strings are the same, ignoring case.
-bool sameText(std::string lhs, std::string rhs);
-/// @copydoc TextConv::sameText(std::string, std::string)
-bool sameText(std::wstring lhs, std::wstring rhs);
+/// @brief Encodes @p len wide characters according to @c cp into @p dest, reusing its storage.
+/// @return The number of bytes written; 0 if @p src can't be represented in @c cp
+size_t textToBytes(const wchar_t *src, size_t len, std::string &dest, UINT cp = CP_ACP);
 /// @brief Returns the 1-based index of a substring within a string, or 0 if not found.
 /// @see https://www.freepascal.org/docs-html/rtl/system/pos.html
 size_t pos(const char *subStr, std::string const &str, size_t offSet = 0ULL);
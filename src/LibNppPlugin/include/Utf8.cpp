@@ -0,0 +1,230 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#include <cstdint>
+#include <cstring>
+#include "Utf8.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define UTF8_USE_SSE2
+#endif
+
+using namespace TextConv;
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+size_t decodeOne(const uint8_t *src, size_t len, char32_t &codePoint) noexcept;
+wchar_t *putCodePoint(wchar_t *dest, char32_t codePoint) noexcept;
+constexpr bool isSurrogate(char32_t ch) noexcept {
+	return ch >= 0xD800 && ch <= 0xDFFF;
+}
+}
+
+// --------------------------------------------------------------------------------------
+// TextConv
+// --------------------------------------------------------------------------------------
+char32_t TextConv::nextCodePoint(std::string const &str, size_t &pos) noexcept {
+	const auto lead = static_cast<uint8_t>(str[pos]);
+	if (lead < 0x80) {
+		++pos;
+		return lead;
+	}
+	char32_t codePoint = 0;
+	const size_t seqLen = decodeOne(reinterpret_cast<const uint8_t *>(str.data()) + pos, str.size() - pos, codePoint);
+	if (seqLen == 0) {
+		++pos;
+		return invalidCodePoint;
+	}
+	pos += seqLen;
+	return codePoint;
+}
+// --------------------------------------------------------------------------------------
+char32_t TextConv::nextCodePoint(std::wstring const &str, size_t &pos) noexcept {
+	const auto ch = static_cast<char32_t>(str[pos++]);
+	if (sizeof(wchar_t) == 2 && ch >= 0xD800 && ch <= 0xDBFF && pos < str.size()) {
+		const auto low = static_cast<char32_t>(str[pos]);
+		if (low >= 0xDC00 && low <= 0xDFFF) {
+			++pos;
+			return 0x10000 + ((ch - 0xD800) << 10) + (low - 0xDC00);
+		}
+	}
+	return ch;
+}
+// --------------------------------------------------------------------------------------
+bool TextConv::appendCodePoint(std::string &str, char32_t codePoint) {
+	if (isSurrogate(codePoint) || codePoint > 0x10FFFF)
+		return false;
+	if (codePoint < 0x80) {
+		str += static_cast<char>(codePoint);
+	} else if (codePoint < 0x800) {
+		str += static_cast<char>(0xC0 | (codePoint >> 6));
+		str += static_cast<char>(0x80 | (codePoint & 0x3F));
+	} else if (codePoint < 0x10000) {
+		str += static_cast<char>(0xE0 | (codePoint >> 12));
+		str += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+		str += static_cast<char>(0x80 | (codePoint & 0x3F));
+	} else {
+		str += static_cast<char>(0xF0 | (codePoint >> 18));
+		str += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+		str += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+		str += static_cast<char>(0x80 | (codePoint & 0x3F));
+	}
+	return true;
+}
+// --------------------------------------------------------------------------------------
+bool TextConv::appendCodePoint(std::wstring &str, char32_t codePoint) {
+	if (codePoint > 0x10FFFF)
+		return false;
+	wchar_t units[2]{};
+	str.append(units, putCodePoint(units, codePoint));
+	return true;
+}
+
+// --------------------------------------------------------------------------------------
+// TextConv::Utf8
+// --------------------------------------------------------------------------------------
+size_t Utf8::asciiPrefix(const char *src, size_t len) noexcept {
+	size_t i = 0;
+#ifdef UTF8_USE_SSE2
+	for (; i + 16 <= len; i += 16) {
+		const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+		if (_mm_movemask_epi8(chunk) != 0)
+			break;
+	}
+#else
+	for (uint64_t word = 0; i + sizeof(word) <= len; i += sizeof(word)) {
+		std::memcpy(&word, src + i, sizeof(word));
+		if ((word & 0x8080808080808080ULL) != 0)
+			break;
+	}
+#endif
+	while (i < len && (src[i] & 0x80) == 0)
+		++i;
+	return i;
+}
+// --------------------------------------------------------------------------------------
+bool Utf8::toWide(const char *src, size_t len, std::wstring &dest) {
+	// No code point takes more UTF-16 (or UTF-32) units than UTF-8 bytes
+	dest.resize(len);
+	const auto *bytes = reinterpret_cast<const uint8_t *>(src);
+	wchar_t *out = &dest[0];
+	size_t i = 0;
+
+	while (i < len) {
+		const size_t end = i + asciiPrefix(src + i, len - i);
+		for (; i < end; ++i)
+			*out++ = static_cast<wchar_t>(bytes[i]);
+		if (i == len)
+			break;
+
+		char32_t codePoint = 0;
+		const size_t seqLen = decodeOne(bytes + i, len - i, codePoint);
+		if (seqLen == 0) {
+			dest.clear();
+			return false;
+		}
+		i += seqLen;
+		out = putCodePoint(out, codePoint);
+	}
+
+	dest.resize(static_cast<size_t>(out - dest.data()));
+	return true;
+}
+// --------------------------------------------------------------------------------------
+bool Utf8::fromWide(const wchar_t *src, size_t len, std::string &dest) {
+	// 3 bytes per UTF-16 unit (a surrogate pair needs only 4), or 4 per UTF-32 unit
+	dest.resize(len * (sizeof(wchar_t) == 2 ? 3 : 4));
+	char *out = &dest[0];
+
+	for (size_t i = 0; i < len; ++i) {
+		char32_t ch = static_cast<char32_t>(src[i]);
+		if (ch < 0x80) {
+			*out++ = static_cast<char>(ch);
+			continue;
+		}
+		if (sizeof(wchar_t) == 2 && isSurrogate(ch)) {
+			const char32_t low = (i + 1 < len) ? static_cast<char32_t>(src[i + 1]) : 0;
+			if (ch > 0xDBFF || low < 0xDC00 || low > 0xDFFF) {
+				dest.clear();
+				return false;
+			}
+			ch = 0x10000 + ((ch - 0xD800) << 10) + (low - 0xDC00);
+			++i;
+		} else if (isSurrogate(ch) || ch > 0x10FFFF) {
+			dest.clear();
+			return false;
+		}
+
+		if (ch < 0x800) {
+			*out++ = static_cast<char>(0xC0 | (ch >> 6));
+		} else if (ch < 0x10000) {
+			*out++ = static_cast<char>(0xE0 | (ch >> 12));
+			*out++ = static_cast<char>(0x80 | ((ch >> 6) & 0x3F));
+		} else {
+			*out++ = static_cast<char>(0xF0 | (ch >> 18));
+			*out++ = static_cast<char>(0x80 | ((ch >> 12) & 0x3F));
+			*out++ = static_cast<char>(0x80 | ((ch >> 6) & 0x3F));
+		}
+		*out++ = static_cast<char>(0x80 | (ch & 0x3F));
+	}
+
+	dest.resize(static_cast<size_t>(out - dest.data()));
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+/// Returns the length of the well-formed sequence at @p src, or 0 if there isn't one
+/// @see https://www.unicode.org/versions/Unicode15.0.0/ch03.pdf#G27506 (Table 3-7)
+size_t decodeOne(const uint8_t *src, size_t len, char32_t &codePoint) noexcept {
+	const uint8_t lead = src[0];
+	size_t seqLen = 0;
+	uint8_t lower = 0x80, upper = 0xBF;
+
+	if (lead >= 0xC2 && lead <= 0xDF) {
+		seqLen = 2;
+		codePoint = lead & 0x1F;
+	} else if (lead >= 0xE0 && lead <= 0xEF) {
+		seqLen = 3;
+		codePoint = lead & 0x0F;
+		if (lead == 0xE0)
+			lower = 0xA0; // overlong
+		else if (lead == 0xED)
+			upper = 0x9F; // surrogate
+	} else if (lead >= 0xF0 && lead <= 0xF4) {
+		seqLen = 4;
+		codePoint = lead & 0x07;
+		if (lead == 0xF0)
+			lower = 0x90; // overlong
+		else if (lead == 0xF4)
+			upper = 0x8F; // > U+10FFFF
+	} else {
+		return 0;
+	}
+
+	if (len < seqLen || src[1] < lower || src[1] > upper)
+		return 0;
+	for (size_t i = 1; i < seqLen; ++i) {
+		if ((src[i] & 0xC0) != 0x80)
+			return 0;
+		codePoint = (codePoint << 6) | (src[i] & 0x3F);
+	}
+	return seqLen;
+}
+// --------------------------------------------------------------------------------------
+wchar_t *putCodePoint(wchar_t *dest, char32_t codePoint) noexcept {
+	if (sizeof(wchar_t) == 2 && codePoint > 0xFFFF) {
+		codePoint -= 0x10000;
+		*dest++ = static_cast<wchar_t>(0xD800 | (codePoint >> 10));
+		*dest++ = static_cast<wchar_t>(0xDC00 | (codePoint & 0x3FF));
+	} else {
+		*dest++ = static_cast<wchar_t>(codePoint);
+	}
+	return dest;
+}
+}
@@ -0,0 +1,38 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#ifndef UTF8_H
+#define UTF8_H
+
+#include <string>
+
+/// Portable, validating UTF-8 transcoding, independent of the Win32 API
+namespace TextConv {
+/// Returned by @c nextCodePoint for a byte that doesn't start a well-formed UTF-8 sequence
+constexpr char32_t invalidCodePoint = 0xFFFFFFFF;
+
+/// @brief Reads the UTF-8 sequence starting at @p pos and moves @p pos past it.
+char32_t nextCodePoint(std::string const &str, size_t &pos) noexcept;
+/// @brief Reads the character (or surrogate pair) starting at @p pos and moves @p pos past it.
+char32_t nextCodePoint(std::wstring const &str, size_t &pos) noexcept;
+/// @brief Appends the UTF-8 encoding of @p codePoint, unless it's a surrogate or out of range.
+bool appendCodePoint(std::string &str, char32_t codePoint);
+/// @brief Appends @p codePoint as one character, or a surrogate pair if needed, unless it's out of range.
+bool appendCodePoint(std::wstring &str, char32_t codePoint);
+
+namespace Utf8 {
+	/// @brief Returns the length of the leading run of ASCII bytes in @p src.
+	size_t asciiPrefix(const char *src, size_t len) noexcept;
+	/// @brief Decodes @p len bytes of UTF-8 into @p dest, reusing its storage.
+	/// @return @c false if @p src is not well-formed UTF-8, in which case @p dest is left empty
+	bool toWide(const char *src, size_t len, std::wstring &dest);
+	/// @brief Encodes @p len wide characters as UTF-8 into @p dest, reusing its storage.
+	/// @return @c false if @p src contains an unpaired surrogate, in which case @p dest is left empty
+	bool fromWide(const wchar_t *src, size_t len, std::string &dest);
+}
+}
+#endif // ~UTF8_H
@@ -0,0 +1,196 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#include <algorithm>
+#include "WorkerPool.h"
+
+/// The queue of one worker thread
+struct WorkerPool::Worker {
+	std::mutex lock;
+	std::deque<Task> tasks;
+	std::atomic<uint64_t> executed{ 0 };
+	std::atomic<uint64_t> stolen{ 0 };
+};
+
+/// The latest report of one job, and its callback
+struct WorkerProgress::State {
+	std::function<void(size_t, size_t)> callback;
+	std::atomic<size_t> done{ 0 };
+	std::atomic<size_t> total{ 0 };
+	std::atomic<bool> posted{ false };
+};
+
+// --------------------------------------------------------------------------------------
+// WorkerPool
+// --------------------------------------------------------------------------------------
+WorkerPool::WorkerPool(unsigned threads, std::function<void()> notify) : _notify(std::move(notify)) {
+	if (threads == 0)
+		threads = (std::max)(std::thread::hardware_concurrency(), 2U) - 1;
+	for (unsigned i = 0; i < threads; ++i)
+		_workers.push_back(std::make_unique<Worker>());
+	for (size_t i = 0; i < threads; ++i)
+		_threads.emplace_back(&WorkerPool::workerLoop, this, i);
+}
+// --------------------------------------------------------------------------------------
+WorkerPool::~WorkerPool() {
+	_shutdown.cancel();
+	{
+		std::lock_guard<std::mutex> lock{ _idleLock };
+		_stopping = true;
+	}
+	_wake.notify_all();
+	for (std::thread &thread : _threads)
+		thread.join();
+}
+// --------------------------------------------------------------------------------------
+CancellationToken WorkerPool::run(WorkerJob job) {
+	CancellationToken token = _shutdown.child();
+	auto progress = std::make_shared<WorkerProgress::State>();
+	progress->callback = std::move(job.progress);
+	submit([this, token, progress, work = std::move(job.work), completed = std::move(job.completed)] {
+		WorkerProgress reporter{ *this, progress };
+		try {
+			if (work && !token.cancelled())
+				work(token, reporter);
+		} catch (...) {
+		}
+		if (completed)
+			post([token, completed] { completed(token.cancelled()); });
+	});
+	return token;
+}
+// --------------------------------------------------------------------------------------
+void WorkerPool::submit(Task task) {
+	size_t index = callingWorker();
+	if (index == _threads.size())
+		index = _nextWorker++ % _workers.size();
+	{
+		std::lock_guard<std::mutex> lock{ _idleLock };
+		{
+			std::lock_guard<std::mutex> queueLock{ _workers[index]->lock };
+			_workers[index]->tasks.push_back(std::move(task));
+		}
+		++_queued;
+		++_pending;
+	}
+	_wake.notify_one();
+}
+// --------------------------------------------------------------------------------------
+void WorkerPool::post(Task callback) {
+	bool wasEmpty = false;
+	{
+		std::lock_guard<std::mutex> lock{ _postedLock };
+		wasEmpty = _posted.empty();
+		_posted.push_back(std::move(callback));
+	}
+	// Once is enough until the UI thread gets round to them
+	if (wasEmpty && _notify)
+		_notify();
+}
+// --------------------------------------------------------------------------------------
+size_t WorkerPool::runPosted() {
+	std::vector<Task> callbacks;
+	{
+		std::lock_guard<std::mutex> lock{ _postedLock };
+		callbacks.swap(_posted);
+	}
+	for (Task const &callback : callbacks) {
+		try {
+			callback();
+		} catch (...) {
+		}
+	}
+	return callbacks.size();
+}
+// --------------------------------------------------------------------------------------
+void WorkerPool::wait() {
+	std::unique_lock<std::mutex> lock{ _idleLock };
+	_idle.wait(lock, [this] { return _pending == 0; });
+}
+// --------------------------------------------------------------------------------------
+std::vector<WorkerStats> WorkerPool::stats() const {
+	std::vector<WorkerStats> result;
+	for (auto const &worker : _workers) {
+		result.push_back(WorkerStats{
+		    worker->executed.load(std::memory_order_relaxed), worker->stolen.load(std::memory_order_relaxed) });
+	}
+	return result;
+}
+// --------------------------------------------------------------------------------------
+void WorkerPool::workerLoop(size_t index) {
+	for (;;) {
+		Task task;
+		if (take(index, task)) {
+			try {
+				task();
+			} catch (...) {
+			}
+			_workers[index]->executed.fetch_add(1, std::memory_order_relaxed);
+			std::lock_guard<std::mutex> lock{ _idleLock };
+			if (--_pending == 0)
+				_idle.notify_all();
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock{ _idleLock };
+		_wake.wait(lock, [this] { return _stopping || _queued > 0; });
+		if (_stopping && _queued == 0)
+			return;
+	}
+}
+// --------------------------------------------------------------------------------------
+size_t WorkerPool::callingWorker() const noexcept {
+	// A linear search; there are only a few threads
+	const std::thread::id self = std::this_thread::get_id();
+	size_t index = 0;
+	while (index < _threads.size() && _threads[index].get_id() != self)
+		++index;
+	return index;
+}
+// --------------------------------------------------------------------------------------
+bool WorkerPool::take(size_t index, Task &task) {
+	const size_t count = _workers.size();
+	bool found = false;
+	for (size_t i = 0; i < count && !found; ++i) {
+		Worker &worker = *_workers[(index + i) % count];
+		std::lock_guard<std::mutex> queueLock{ worker.lock };
+		if (worker.tasks.empty())
+			continue;
+		// Newest first from our own queue, while it's still warm in the cache; oldest first from others
+		if (i == 0) {
+			task = std::move(worker.tasks.back());
+			worker.tasks.pop_back();
+		} else {
+			task = std::move(worker.tasks.front());
+			worker.tasks.pop_front();
+			_workers[index]->stolen.fetch_add(1, std::memory_order_relaxed);
+		}
+		found = true;
+	}
+	// Not while holding a queue's lock, since submit takes them in the opposite order
+	if (found) {
+		std::lock_guard<std::mutex> lock{ _idleLock };
+		--_queued;
+	}
+	return found;
+}
+
+// --------------------------------------------------------------------------------------
+// WorkerProgress
+// --------------------------------------------------------------------------------------
+void WorkerProgress::report(size_t done, size_t total) {
+	if (!_state->callback)
+		return;
+	_state->done.store(done, std::memory_order_relaxed);
+	_state->total.store(total, std::memory_order_relaxed);
+	if (_state->posted.exchange(true))
+		return;
+	_pool.post([state = _state] {
+		state->posted.store(false);
+		state->callback(state->done.load(std::memory_order_relaxed), state->total.load(std::memory_order_relaxed));
+	});
+}
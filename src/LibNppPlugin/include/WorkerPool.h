@@ -0,0 +1,144 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// @brief A flag shared by a job and its owner, through which the owner asks the job to stop early.
+/// Copies share the same flag; a @c child token is cancelled along with its parent.
+class CancellationToken final {
+
+public:
+	CancellationToken() : _state(std::make_shared<State>()) {}
+	void cancel() const noexcept { _state->cancelled.store(true, std::memory_order_relaxed); }
+	bool cancelled() const noexcept {
+		for (State const *state = _state.get(); state; state = state->parent.get()) {
+			if (state->cancelled.load(std::memory_order_relaxed))
+				return true;
+		}
+		return false;
+	}
+	CancellationToken child() const {
+		CancellationToken token;
+		token._state->parent = _state;
+		return token;
+	}
+
+private:
+	struct State {
+		std::atomic<bool> cancelled{ false };
+		std::shared_ptr<State> parent;
+	};
+	std::shared_ptr<State> _state;
+};
+
+class WorkerPool;
+
+/// Lets a running job tell the UI thread how far it has got
+class WorkerProgress final {
+
+public:
+	/// @brief Records that @p done of @p total steps are finished. Reports are coalesced, so the UI thread
+	/// only ever sees the latest, and never has more than one waiting.
+	void report(size_t done, size_t total);
+
+private:
+	friend class WorkerPool;
+	struct State;
+	WorkerProgress(WorkerPool &pool, std::shared_ptr<State> state) : _pool(pool), _state(std::move(state)) {}
+	WorkerPool &_pool;
+	std::shared_ptr<State> _state;
+};
+
+/// A unit of background work, with the callbacks that report on it
+struct WorkerJob {
+	/// Runs on a worker thread; should return soon after the token is cancelled.
+	/// Must not touch the editor, which belongs to the UI thread
+	std::function<void(CancellationToken const &, WorkerProgress &)> work;
+	/// Runs on the UI thread with the number of steps done, and the total
+	std::function<void(size_t, size_t)> progress;
+	/// Runs on the UI thread once @c work has returned, with @c true if it was cancelled
+	std::function<void(bool)> completed;
+};
+
+/// Tasks run and stolen by one worker thread
+struct WorkerStats {
+	uint64_t executed;
+	uint64_t stolen;
+};
+
+/// @brief A work-stealing pool of threads, which hands the results of its jobs back to the UI thread.
+///
+/// Each worker takes the newest task from its own queue, and steals the oldest from another's when its own
+/// runs dry. Callbacks meant for the UI thread are queued until it calls @c runPosted, which @p notify
+/// should arrange, e.g. by posting a message to the main window.
+class WorkerPool final {
+
+public:
+	using Task = std::function<void()>;
+
+	/// @param threads The number of workers; by default, one fewer than the number of cores
+	/// @param notify Called from any thread when callbacks are waiting for @c runPosted
+	explicit WorkerPool(unsigned threads = 0, std::function<void()> notify = nullptr);
+	/// @brief Cancels every job, waits for the workers to finish the tasks already queued, and discards
+	/// the callbacks still waiting for the UI thread.
+	~WorkerPool();
+	WorkerPool(const WorkerPool &) = delete;
+	WorkerPool &operator=(const WorkerPool &) = delete;
+
+	/// @brief Starts @p job on a worker thread.
+	/// @return The token that cancels it
+	CancellationToken run(WorkerJob job);
+	/// @brief Queues @p task, on the calling worker's own queue if it's one of ours.
+	void submit(Task task);
+	/// @brief Queues @p callback for the UI thread.
+	void post(Task callback);
+	/// @brief Runs the callbacks queued for the UI thread.
+	/// @return How many there were
+	size_t runPosted();
+	/// @brief Blocks until every queued task has finished; not to be called by a worker.
+	void wait();
+
+	size_t threadCount() const noexcept { return _threads.size(); }
+	std::vector<WorkerStats> stats() const;
+
+private:
+	struct Worker;
+
+	void workerLoop(size_t index);
+	/// @return The index of the worker running on the calling thread, or @c threadCount() if it's not one of ours
+	size_t callingWorker() const noexcept;
+	bool take(size_t index, Task &task);
+
+	std::vector<std::unique_ptr<Worker>> _workers;
+	std::vector<std::thread> _threads;
+	std::function<void()> _notify;
+	CancellationToken _shutdown;
+
+	/// Guards the counters below, and the wake-ups of idle workers and of @c wait
+	std::mutex _idleLock;
+	std::condition_variable _wake;
+	std::condition_variable _idle;
+	size_t _queued = 0;
+	size_t _pending = 0;
+	bool _stopping = false;
+	std::atomic<size_t> _nextWorker{ 0 };
+
+	std::mutex _postedLock;
+	std::vector<Task> _posted;
+};
+#endif // ~WORKER_POOL_H
@@ -0,0 +1,57 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#include <algorithm>
+#include "SliceCuts.h"
+
+using namespace HtmlTag;
+
+// --------------------------------------------------------------------------------------
+// HtmlTag::SliceCuts
+// --------------------------------------------------------------------------------------
+Sci_Position SliceCuts::chunkEnd(
+    TagSource::Send const &send, Sci_Position startPos, Sci_Position target, Tokens const &tokens) {
+	const TagSource source{ send };
+	if (target >= source.length())
+		return source.length();
+
+	auto positionAfter = [&send](Sci_Position pos) {
+		return static_cast<Sci_Position>(send(SCI_POSITIONAFTER, static_cast<uptr_t>(pos), 0));
+	};
+	auto charBoundary = [&](Sci_Position pos) {
+		return positionAfter(static_cast<Sci_Position>(send(SCI_POSITIONBEFORE, static_cast<uptr_t>(pos), 0)));
+	};
+
+	// Never split a token: cut after whitespace or a tag, or just before a character that may start a token.
+	// A cut between joined tokens is passed over, and the search goes on as far back again
+	std::string_view text;
+	Sci_Position windowStart = target, limit = target - maxTokenLength;
+	for (Sci_Position cut = target; cut > startPos && cut > limit; --cut) {
+		// Each read covers several cuts, and whole tokens either side of them
+		if (cut - maxTokenLength < windowStart && windowStart > startPos) {
+			windowStart = (std::max)(startPos, cut - 4 * maxTokenLength);
+			text = source.view(windowStart, cut + maxTokenLength - windowStart);
+		}
+		const auto at = static_cast<size_t>(cut - windowStart);
+		if (at >= text.length())
+			break;
+
+		const auto before = static_cast<unsigned char>(text[at - 1]);
+		const bool afterBreak = before <= 0x20 || before == '>';
+		const bool beforeToken = text[at] != '\0' && tokens.breakChars.find(text[at]) != std::string::npos;
+		// E.g. a low surrogate's escape, which is read along with the high one before it
+		if (tokens.joined && tokens.joined(text, at)) {
+			limit = cut - maxTokenLength;
+			continue;
+		}
+		// In a DBCS code page, the token character might be a trail byte
+		if (afterBreak || (beforeToken && positionAfter(cut - 1) == cut))
+			return cut;
+	}
+	// No token starts close enough to the cut to straddle it
+	return charBoundary(target);
+}
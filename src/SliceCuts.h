@@ -0,0 +1,39 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#ifndef HTMLTAG_SLICE_CUTS_H
+#define HTMLTAG_SLICE_CUTS_H
+
+#include "TagLexer.h"
+
+namespace HtmlTag {
+/// @brief Picks where a long rewrite is cut into slices, so that rewriting them one at a time gives the same
+/// text as rewriting the whole document at once.
+namespace SliceCuts {
+	/// What a rewrite reads as one token, which no slice may end inside
+	struct Tokens {
+		/// The characters that can start a token
+		std::string breakChars;
+		/// @brief Whether the rewrite reads the tokens either side of the cut at @p cut in @p text as one, e.g.
+		/// the escapes for the two halves of a surrogate pair; may be empty
+		std::function<bool(std::string_view text, size_t cut)> joined;
+	};
+
+	/// About how much of the document each slice rewrites
+	constexpr Sci_Position chunkLength = 0x10000;
+	/// How far back from its target, or from a pair of joined tokens, a cut is looked for; the longest named
+	/// entity is "&CounterClockwiseContourIntegral;"
+	constexpr Sci_Position maxTokenLength = 40;
+
+	/// @brief Finds where the slice starting at @p startPos should end, near @p target: just after whitespace or
+	/// a tag, or just before a character that may start a token, unless that parts two joined tokens.
+	/// @param send Reaches the document, which is read through range pointers
+	Sci_Position chunkEnd(
+	    TagSource::Send const &send, Sci_Position startPos, Sci_Position target, Tokens const &tokens);
+}
+}
+#endif // ~HTMLTAG_SLICE_CUTS_H
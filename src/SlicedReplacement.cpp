@@ -0,0 +1,175 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+#include "SliceScheduler.h"
+#include "SlicedReplacement.h"
+
+using namespace HtmlTag;
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+/// The document being rewritten, and how far the run has got
+struct SlicedRun {
+	SciActiveDocument doc;
+	sptr_t document;
+	uintptr_t bufferId;
+	SlicedReplacement::Transform transform;
+	SliceCuts::Tokens tokens;
+	/// The next position to rewrite, and the end of the text still to do, which moves as chunks grow or shrink
+	Sci_Position pos;
+	Sci_Position endPos;
+	Sci_Position consumed;
+	Sci_Position total;
+	int replaced;
+	int percentShown;
+	bool cancelRequested;
+	std::chrono::steady_clock::time_point started;
+};
+
+bool step();
+bool yield();
+void completed(bool cancelled);
+void CALLBACK sliceTimerProc(HWND, UINT, UINT_PTR, DWORD);
+void disarmSliceTimer();
+
+std::unique_ptr<SlicedRun> run = nullptr;
+SliceScheduler scheduler;
+UINT_PTR sliceTimerId = 0;
+}
+
+// --------------------------------------------------------------------------------------
+// HtmlTag::SlicedReplacement
+// --------------------------------------------------------------------------------------
+bool SlicedReplacement::start(Transform transform, SliceCuts::Tokens tokens) {
+	// One run at a time; its progress is already on the status bar
+	if (run)
+		return true;
+
+	SciActiveDocument doc = plugin.editor().activeDocument();
+	const Sci_Position length = doc.length();
+	if (!plugin.options.largeFiles.isSliced(length) || doc.readOnly())
+		return false;
+
+	run = std::make_unique<SlicedRun>(SlicedRun{ doc, doc.sendMessage(SCI_GETDOCPOINTER),
+	    static_cast<uintptr_t>(plugin.sendNppMessage(NPPM_GETCURRENTBUFFERID)), std::move(transform),
+	    std::move(tokens), 0, length, 0, length, 0, -1, false, std::chrono::steady_clock::now() });
+
+	// The run's undo action outlasts any one scope, so it's opened here and closed by completed()
+	run->doc.sendMessage(SCI_BEGINUNDOACTION);
+	run->doc.readOnly(true);
+	scheduler.start(SlicedJob{ step, yield, completed });
+	sliceTimerId = ::SetTimer(0, 0, USER_TIMER_MINIMUM, TIMERPROC(&sliceTimerProc));
+	return true;
+}
+// --------------------------------------------------------------------------------------
+bool SlicedReplacement::running() {
+	return run != nullptr;
+}
+// --------------------------------------------------------------------------------------
+void SlicedReplacement::cancel() {
+	// Roll back when the document is next in view, not whatever has taken its place
+	if (run)
+		run->cancelRequested = true;
+}
+// --------------------------------------------------------------------------------------
+void SlicedReplacement::abandon(uintptr_t bufferId) {
+	if (!run || (bufferId != 0 && bufferId != run->bufferId))
+		return;
+	disarmSliceTimer();
+	run.reset();
+	scheduler.cancel();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+bool step() {
+	SciActiveDocument const &doc = run->doc;
+	auto send = [&doc](unsigned msg, uptr_t wParam, sptr_t lParam) {
+		return static_cast<sptr_t>(doc.sendMessage(msg, static_cast<WPARAM>(wParam), static_cast<LPARAM>(lParam)));
+	};
+	const Sci_Position target = (std::min)(run->pos + SliceCuts::chunkLength, run->endPos);
+	const Sci_Position cut = SliceCuts::chunkEnd(send, run->pos, target, run->tokens);
+	SciTextRange range = run->doc.getRange(run->pos, cut);
+	{
+		// Nested in the run's undo action, which it merges into
+		SciBulkEdit bulkEdit{ run->doc };
+		run->replaced += run->transform(range);
+	}
+	run->consumed += cut - run->pos;
+	run->endPos += range.endPos() - cut;
+	run->pos = range.endPos();
+	return run->pos < run->endPos;
+}
+// --------------------------------------------------------------------------------------
+bool yield() {
+	if (run->cancelRequested || plugin.editor().escapePressed())
+		return false;
+
+	const int percent = static_cast<int>(100.0 * static_cast<double>(run->consumed) / static_cast<double>(run->total));
+	if (percent != run->percentShown) {
+		run->percentShown = percent;
+		std::wstring status = plugin.formatMessage(L"msg_slice_progress", { std::to_wstring(percent) });
+		plugin.sendNppMessage(NPPM_SETSTATUSBAR, STATUSBAR_DOC_TYPE, &status[0]);
+	}
+	return true;
+}
+// --------------------------------------------------------------------------------------
+void completed(bool cancelled) {
+	disarmSliceTimer();
+	// Abandoned along with its document
+	if (!run)
+		return;
+
+	std::unique_ptr<SlicedRun> finished = std::move(run);
+	SciActiveDocument &doc = finished->doc;
+	const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - finished->started;
+	doc.readOnly(false);
+	doc.sendMessage(SCI_ENDUNDOACTION);
+
+	std::wstring status;
+	if (cancelled) {
+		if (finished->replaced > 0)
+			doc.sendMessage(SCI_UNDO);
+		status = plugin.getMessage(L"msg_slice_cancelled");
+	} else {
+		std::wstringstream ms;
+		ms << std::fixed << std::setprecision(1) << elapsed.count();
+		status = plugin.formatMessage(L"msg_replaced", { std::to_wstring(finished->replaced), ms.str() });
+	}
+	plugin.sendNppMessage(NPPM_SETSTATUSBAR, STATUSBAR_DOC_TYPE, &status[0]);
+}
+// --------------------------------------------------------------------------------------
+void CALLBACK sliceTimerProc(HWND /*hWnd*/, UINT /*uMsg*/, UINT_PTR eventID, DWORD /*dwTime*/) {
+	if (eventID != sliceTimerId || !run) {
+		::KillTimer(0, eventID);
+		return;
+	}
+
+	// Wait while another document is in the view; only ours is read-only
+	if (run->doc.sendMessage(SCI_GETDOCPOINTER) != run->document)
+		return;
+
+	if (run->cancelRequested) {
+		scheduler.cancel();
+		return;
+	}
+	run->doc.readOnly(false);
+	if (scheduler.runSlice())
+		run->doc.readOnly(true);
+}
+// --------------------------------------------------------------------------------------
+void disarmSliceTimer() {
+	if (sliceTimerId != 0) {
+		::KillTimer(0, sliceTimerId);
+		sliceTimerId = 0;
+	}
+}
+}
@@ -0,0 +1,39 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#ifndef HTMLTAG_SLICED_REPLACEMENT_H
+#define HTMLTAG_SLICED_REPLACEMENT_H
+
+#include <functional>
+#include <string>
+#include "HtmlTag.h"
+#include "SliceCuts.h"
+
+namespace HtmlTag {
+/// @brief Rewrites large documents a few milliseconds at a time, from a timer, so the window stays responsive.
+///
+/// The document is read-only until the run ends, and all of it is one undo action, which is undone
+/// if the user presses Esc.
+namespace SlicedReplacement {
+	/// Rewrites one chunk of the document, returning the number of replacements made
+	using Transform = std::function<int(SciTextRange &)>;
+
+	/// @brief Starts rewriting the active document through @p transform, unless it's shorter than the
+	/// @c SLICED_EDIT_BYTES threshold.
+	/// @param tokens What @p transform replaces; chunks are only cut before one of them, or after whitespace
+	/// @return @c false if the caller should do the work itself, in one go
+	bool start(Transform transform, SliceCuts::Tokens tokens);
+	/// @return @c true until the current run has finished, or been cancelled
+	bool running();
+	/// @brief Stops the current run and undoes its edits.
+	void cancel();
+	/// @brief Stops the current run without touching the editor, if it's editing @p bufferId,
+	/// or whatever it's editing if @p bufferId is 0.
+	void abandon(uintptr_t bufferId = 0);
+}
+}
+#endif // ~HTMLTAG_SLICED_REPLACEMENT_H
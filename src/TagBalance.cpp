@@ -0,0 +1,354 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#include <algorithm>
+#include "TagBalance.h"
+
+using namespace HtmlTag;
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+enum ElementFlags : unsigned { efVoid = 0x1, efOptionalEnd = 0x2, efRawText = 0x4 };
+
+/// Elements whose start tags close an open element that has an optional end tag
+enum ElementGroup : unsigned {
+	egBlock = 0x1,
+	egListItem = 0x2,
+	egDefinition = 0x4,
+	egOption = 0x8,
+	egOptgroup = 0x10,
+	egRuby = 0x20,
+	egRow = 0x40,
+	egCell = 0x80,
+	egSection = 0x100,
+	egBody = 0x200,
+};
+
+/// What HTML says about an element's tags
+struct Element {
+	std::string_view name;
+	unsigned flags;
+	/// The groups it belongs to
+	unsigned groups;
+	/// The groups whose start tags close it, if its end tag is optional
+	unsigned closedBy;
+};
+
+struct OpenTag {
+	std::string name;
+	Sci_Position startPos;
+	Sci_Position endPos;
+	Element const *element;
+};
+
+/// The stack of open elements, and what's wrong so far
+class BalanceChecker final {
+
+public:
+	explicit BalanceChecker(TagBalance::Dialect dialect)
+	    : _dialect(dialect), _report{ {}, 0, 0 }, _foreignRoot(std::string::npos) {}
+	/// @brief Whether a @c '<' at the start of @p text is only text, in a @c <script> or the like.
+	bool inRawText(std::string_view text) const;
+	void read(TagLexer::Tag &tag);
+	TagBalance::Report finish();
+
+private:
+	void open(TagLexer::Tag &tag, bool foreign);
+	void close(TagLexer::Tag const &tag);
+	void report(TagBalance::ProblemKind kind, std::string const &name, Sci_Position startPos, Sci_Position endPos);
+	/// Whether @p tag is read as XML would read it: it is in XML, and in HTML it's an <svg> or <math>, or in one
+	bool isForeign(TagLexer::Tag const &tag) const noexcept;
+	void truncate(std::vector<OpenTag>::iterator first);
+
+	TagBalance::Dialect _dialect;
+	TagBalance::Report _report;
+	std::vector<OpenTag> _openTags;
+	/// Where the outermost open <svg> or <math> is on the stack, or npos
+	size_t _foreignRoot;
+	/// The name of the element whose contents are being skipped
+	std::string _rawText;
+};
+
+Element const *findElement(std::string_view name) noexcept;
+bool isMarkup(std::string_view head) noexcept;
+void toLower(std::string &name) noexcept;
+
+/* https://html.spec.whatwg.org/multipage/syntax.html#elements-2 */
+/* https://html.spec.whatwg.org/multipage/syntax.html#optional-tags */
+constexpr Element htmlElements[] = {
+	{ "address", 0, egBlock, 0 },
+	{ "area", efVoid, 0, 0 },
+	{ "article", 0, egBlock, 0 },
+	{ "aside", 0, egBlock, 0 },
+	{ "base", efVoid, 0, 0 },
+	{ "basefont", efVoid, 0, 0 },
+	{ "blockquote", 0, egBlock, 0 },
+	{ "body", efOptionalEnd, egBody, 0 },
+	{ "br", efVoid, 0, 0 },
+	{ "col", efVoid, 0, 0 },
+	{ "colgroup", efOptionalEnd, 0, egRow | egSection },
+	{ "dd", efOptionalEnd, egDefinition, egDefinition },
+	{ "details", 0, egBlock, 0 },
+	{ "dialog", 0, egBlock, 0 },
+	{ "div", 0, egBlock, 0 },
+	{ "dl", 0, egBlock, 0 },
+	{ "dt", efOptionalEnd, egDefinition, egDefinition },
+	{ "embed", efVoid, 0, 0 },
+	{ "fieldset", 0, egBlock, 0 },
+	{ "figcaption", 0, egBlock, 0 },
+	{ "figure", 0, egBlock, 0 },
+	{ "footer", 0, egBlock, 0 },
+	{ "form", 0, egBlock, 0 },
+	{ "frame", efVoid, 0, 0 },
+	{ "h1", 0, egBlock, 0 },
+	{ "h2", 0, egBlock, 0 },
+	{ "h3", 0, egBlock, 0 },
+	{ "h4", 0, egBlock, 0 },
+	{ "h5", 0, egBlock, 0 },
+	{ "h6", 0, egBlock, 0 },
+	{ "head", efOptionalEnd, 0, egBody },
+	{ "header", 0, egBlock, 0 },
+	{ "hgroup", 0, egBlock, 0 },
+	{ "hr", efVoid, egBlock, 0 },
+	{ "html", efOptionalEnd, 0, 0 },
+	{ "img", efVoid, 0, 0 },
+	{ "input", efVoid, 0, 0 },
+	{ "isindex", efVoid, 0, 0 },
+	{ "keygen", efVoid, 0, 0 },
+	{ "li", efOptionalEnd, egListItem, egListItem },
+	{ "link", efVoid, 0, 0 },
+	{ "main", 0, egBlock, 0 },
+	{ "menu", 0, egBlock, 0 },
+	{ "meta", efVoid, 0, 0 },
+	{ "nav", 0, egBlock, 0 },
+	{ "ol", 0, egBlock, 0 },
+	{ "optgroup", efOptionalEnd, egOption | egOptgroup, egOptgroup },
+	{ "option", efOptionalEnd, egOption, egOption },
+	{ "p", efOptionalEnd, egBlock, egBlock },
+	{ "param", efVoid, 0, 0 },
+	{ "pre", 0, egBlock, 0 },
+	{ "rp", efOptionalEnd, egRuby, egRuby },
+	{ "rt", efOptionalEnd, egRuby, egRuby },
+	{ "script", efRawText, 0, 0 },
+	{ "search", 0, egBlock, 0 },
+	{ "section", 0, egBlock, 0 },
+	{ "source", efVoid, 0, 0 },
+	{ "style", efRawText, 0, 0 },
+	{ "table", 0, egBlock, 0 },
+	{ "tbody", efOptionalEnd, egRow | egSection, egSection },
+	{ "td", efOptionalEnd, egCell, egCell | egRow },
+	{ "textarea", efRawText, 0, 0 },
+	{ "tfoot", efOptionalEnd, egRow | egSection, 0 },
+	{ "th", efOptionalEnd, egCell, egCell | egRow },
+	{ "thead", efOptionalEnd, egRow | egSection, egSection },
+	{ "title", efRawText, 0, 0 },
+	{ "tr", efOptionalEnd, egRow, egRow },
+	{ "track", efVoid, 0, 0 },
+	{ "ul", 0, egBlock, 0 },
+	{ "wbr", efVoid, 0, 0 },
+};
+
+/// Where the names starting with each letter begin in @c htmlElements, so that a lookup compares only a few
+struct ElementIndex {
+	size_t first[27];
+	constexpr ElementIndex() : first{} {
+		for (size_t letter = 0, i = 0; letter < 27; ++letter) {
+			while (i < std::size(htmlElements) && htmlElements[i].name[0] < static_cast<char>('a' + letter))
+				++i;
+			first[letter] = i;
+		}
+	}
+};
+constexpr ElementIndex elementIndex{};
+
+/// How far ahead the next '<' is looked for at once; most of it is read from the source's current window
+constexpr Sci_Position scanLength = 0x1000;
+}
+
+// --------------------------------------------------------------------------------------
+// HtmlTag::TagBalance
+// --------------------------------------------------------------------------------------
+TagBalance::Report TagBalance::check(TagSource const &source, Dialect dialect, TagLexer::TagSyntax syntax) {
+	BalanceChecker checker{ dialect };
+	TagLexer::Tag tag{};
+	const Sci_Position length = source.length();
+	for (Sci_Position pos = 0; pos < length;) {
+		const std::string_view text = source.view(pos, scanLength);
+		if (text.empty())
+			break;
+		const size_t at = text.find('<');
+		if (at == std::string_view::npos) {
+			pos += static_cast<Sci_Position>(text.size());
+			continue;
+		}
+
+		pos += static_cast<Sci_Position>(at);
+		const auto headLength = static_cast<size_t>(TagLexer::maxNameLength + 3);
+		const std::string_view head =
+		    (text.size() - at >= headLength) ? text.substr(at, headLength) : source.view(pos, headLength);
+		const bool rawText = checker.inRawText(head);
+		if (!rawText && isMarkup(head)) {
+			// Comments and the like are passed over whole
+			pos = (std::max)(pos + 1, TagLexer::findTagEnd(source, pos, -1, syntax));
+		} else if (rawText || !TagLexer::readTag(source, pos, -1, tag, syntax)) {
+			++pos;
+		} else {
+			checker.read(tag);
+			pos = tag.endPos;
+		}
+	}
+	return checker.finish();
+}
+// --------------------------------------------------------------------------------------
+bool TagBalance::isVoidElement(std::string_view name) noexcept {
+	// None is named longer than "basefont"
+	char lowered[8];
+	if (name.size() > sizeof(lowered))
+		return false;
+	for (size_t i = 0; i < name.size(); ++i)
+		lowered[i] = (name[i] >= 'A' && name[i] <= 'Z') ? static_cast<char>(name[i] + ('a' - 'A')) : name[i];
+	Element const *element = findElement(std::string_view{ lowered, name.size() });
+	return element && (element->flags & efVoid);
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+bool BalanceChecker::inRawText(std::string_view text) const {
+	if (_rawText.empty())
+		return false;
+	// Only the raw text element's own end tag ends it, whatever the case
+	if (text.size() < _rawText.size() + 2 || text[1] != '/')
+		return true;
+	for (size_t i = 0; i < _rawText.size(); ++i) {
+		const char ch = text[i + 2];
+		if (_rawText[i] != ((ch >= 'A' && ch <= 'Z') ? static_cast<char>(ch + ('a' - 'A')) : ch))
+			return true;
+	}
+	const size_t after = _rawText.size() + 2;
+	return after < text.size() && text[after] != '>' && text[after] != '/' && text[after] != ' ' &&
+	       text[after] != '\t' && text[after] != '\r' && text[after] != '\n' && text[after] != '\f';
+}
+// --------------------------------------------------------------------------------------
+void BalanceChecker::read(TagLexer::Tag &tag) {
+	++_report.tags;
+	if (_dialect == TagBalance::dlHtml)
+		toLower(tag.name);
+	// In HTML, "/>" means nothing, e.g. <div/> opens a div, except in SVG and MathML
+	if (tag.isEndTag) {
+		close(tag);
+		return;
+	}
+	const bool foreign = isForeign(tag);
+	if (!tag.isSelfClosing || !foreign)
+		open(tag, foreign);
+}
+// --------------------------------------------------------------------------------------
+TagBalance::Report BalanceChecker::finish() {
+	for (auto openTag = _openTags.rbegin(); openTag != _openTags.rend(); ++openTag) {
+		if (!openTag->element || !(openTag->element->flags & efOptionalEnd))
+			report(TagBalance::pkUnclosed, openTag->name, openTag->startPos, openTag->endPos);
+	}
+	_openTags.clear();
+	std::stable_sort(_report.problems.begin(), _report.problems.end(),
+	    [](TagBalance::Problem const &a, TagBalance::Problem const &b) { return a.startPos < b.startPos; });
+	return std::move(_report);
+}
+// --------------------------------------------------------------------------------------
+void BalanceChecker::open(TagLexer::Tag &tag, bool foreign) {
+	Element const *element = foreign ? nullptr : findElement(tag.name);
+	if (element) {
+		if (element->flags & efVoid)
+			return;
+		// e.g. a <li> closes the <li> before it, and any <p> in that, and a <tr> the <td> and <tr> before it
+		while (element->groups != 0) {
+			auto closed = std::find_if(_openTags.rbegin(), _openTags.rend(), [element](OpenTag const &openTag) {
+				return !openTag.element || !(openTag.element->flags & efOptionalEnd) ||
+				       (openTag.element->closedBy & element->groups);
+			});
+			if (closed == _openTags.rend() || !closed->element || !(closed->element->closedBy & element->groups))
+				break;
+			truncate(std::prev(closed.base()));
+		}
+		if (element->flags & efRawText)
+			_rawText = tag.name;
+	}
+	if (foreign && _foreignRoot == std::string::npos && _dialect == TagBalance::dlHtml)
+		_foreignRoot = _openTags.size();
+	_openTags.emplace_back(OpenTag{ std::move(tag.name), tag.startPos, tag.endPos, element });
+}
+// --------------------------------------------------------------------------------------
+void BalanceChecker::close(TagLexer::Tag const &tag) {
+	_rawText.clear();
+	auto match = std::find_if(_openTags.rbegin(), _openTags.rend(),
+	    [&tag](OpenTag const &openTag) { return openTag.name == tag.name; });
+	if (match == _openTags.rend()) {
+		report(TagBalance::pkStray, tag.name, tag.startPos, tag.endPos);
+		return;
+	}
+
+	// Whatever is still open inside it is closed with it, which is fine if its end tag is optional
+	for (auto openTag = _openTags.rbegin(); openTag != match; ++openTag) {
+		if (!openTag->element || !(openTag->element->flags & efOptionalEnd))
+			report(TagBalance::pkMisnested, openTag->name, openTag->startPos, openTag->endPos);
+	}
+	truncate(std::prev(match.base()));
+}
+// --------------------------------------------------------------------------------------
+void BalanceChecker::report(
+    TagBalance::ProblemKind kind, std::string const &name, Sci_Position startPos, Sci_Position endPos) {
+	if (_report.problems.size() < TagBalance::maxProblems) {
+		_report.problems.push_back(TagBalance::Problem{ kind, name, startPos, endPos });
+	} else {
+		++_report.unreported;
+	}
+}
+// --------------------------------------------------------------------------------------
+bool BalanceChecker::isForeign(TagLexer::Tag const &tag) const noexcept {
+	const std::string_view name = tag.name;
+	return _dialect == TagBalance::dlXml || _foreignRoot != std::string::npos || name == "svg" || name == "math";
+}
+// --------------------------------------------------------------------------------------
+/// Closes the open elements from @p first on, and leaves foreign content if the <svg> or <math> was among them
+void BalanceChecker::truncate(std::vector<OpenTag>::iterator first) {
+	_openTags.erase(first, _openTags.end());
+	if (_foreignRoot != std::string::npos && _openTags.size() <= _foreignRoot)
+		_foreignRoot = std::string::npos;
+}
+// --------------------------------------------------------------------------------------
+Element const *findElement(std::string_view name) noexcept {
+	if (name.empty() || name[0] < 'a' || name[0] > 'z')
+		return nullptr;
+	// No letter starts more than a dozen names, and most differ in length
+	const size_t letter = static_cast<size_t>(name[0] - 'a');
+	for (size_t i = elementIndex.first[letter]; i < elementIndex.first[letter + 1]; ++i) {
+		if (htmlElements[i].name == name)
+			return &htmlElements[i];
+	}
+	return nullptr;
+}
+// --------------------------------------------------------------------------------------
+/// Whether @p head starts a comment, declaration, or processing instruction, rather than a tag
+bool isMarkup(std::string_view head) noexcept {
+	return head.size() >= 2 && (head[1] == '!' || head[1] == '?' || head[1] == '%');
+}
+// --------------------------------------------------------------------------------------
+void toLower(std::string &name) noexcept {
+	for (char &ch : name) {
+		if (ch >= 'A' && ch <= 'Z')
+			ch = static_cast<char>(ch + ('a' - 'A'));
+	}
+}
+// --------------------------------------------------------------------------------------
+constexpr bool isSorted() noexcept {
+	for (size_t i = 1; i < std::size(htmlElements); ++i) {
+		if (!(htmlElements[i - 1].name < htmlElements[i].name))
+			return false;
+	}
+	return true;
+}
+static_assert(isSorted(), "findElement expects htmlElements sorted by name");
+}
@@ -0,0 +1,59 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#ifndef HTMLTAG_TAG_BALANCE_H
+#define HTMLTAG_TAG_BALANCE_H
+
+#include <vector>
+#include "TagLexer.h"
+
+namespace HtmlTag {
+/// @brief Checks that every tag in a document is closed, and closed in order, in one pass over its text.
+///
+/// In HTML, names are matched without regard to case, void elements such as @c <br> never need closing,
+/// and elements whose end tag is optional, such as @c <p>, @c <li> and @c <td>, are closed by whatever
+/// would close them in a browser. The contents of @c <script>, @c <style>, @c <textarea> and @c <title>
+/// are skipped. As in a browser, @c <div/> opens a div: only in SVG and MathML does @c /> close an element.
+namespace TagBalance {
+	enum Dialect { dlHtml, dlXml };
+
+	enum ProblemKind {
+		/// An opening tag still open at the end of the document
+		pkUnclosed,
+		/// An opening tag closed by the end tag of an element it's nested in, e.g. @c <i> in @c <b><i></b>
+		pkMisnested,
+		/// An end tag that closes nothing
+		pkStray,
+	};
+
+	struct Problem {
+		ProblemKind kind;
+		std::string name;
+		/// The tag at fault: the opening tag, unless it's stray
+		Sci_Position startPos;
+		Sci_Position endPos;
+	};
+
+	struct Report {
+		/// In document order
+		std::vector<Problem> problems;
+		/// Problems found after the first @c maxProblems
+		size_t unreported;
+		/// Tags read, not counting comments and the like
+		size_t tags;
+	};
+
+	/// The most problems a report keeps; a document in some other language could have millions
+	constexpr size_t maxProblems = 10000;
+
+	/// @brief Reads the whole of @p source a chunk at a time, without copying it.
+	Report check(TagSource const &source, Dialect dialect = dlHtml, TagLexer::TagSyntax syntax = TagLexer::tsHtml);
+	/// @brief Whether the HTML element @p name, in any case, is void, like @c <br>, and never needs closing.
+	bool isVoidElement(std::string_view name) noexcept;
+}
+}
+#endif // ~HTMLTAG_TAG_BALANCE_H
@@ -6,324 +6,234 @@
   Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
   Original Pascal unit (c) Martijn Coppoolse <https://github.com/vor0nwe>
 */
+#include <chrono>
+#include <iomanip>
+#include <sstream>
 #include "TextConv.h"
 #include "TagFinder.h"
+#include "TagBalance.h"
+#include "TagMatcher.h"
 
 using namespace HtmlTag;
 using namespace TextConv;
 
 /////////////////////////////////////////////////////////////////////////////////////////
 namespace {
-enum SearchDirection { dirBackward = -1, dirNone, dirForward, dirUnknown };
-
-struct TagPair {
-	std::string name;
-	SciTextRange *tag;
-};
-
-SciTextRange *extractTagName(std::string &tagName, bool &isOpenTag, bool &isEndTag, Sci_Position tagPos = -1);
+/// The part of the document that searches may cover; all of it, unless it's a large file
+TagMatcher::Bounds scanBounds(SciActiveDocument const &doc);
+TagSource documentSource(SciActiveDocument const &doc);
+TagLexer::TagSyntax tagSyntax();
 void selectTags(SciTextRange *startTag, SciTextRange *endTag = nullptr);
+/// The start of @p tag's text, which holds its name, without its attributes, which may be megabytes long
+std::wstring tagPrefix(SciTextRange const &tag);
+int balanceIndicator();
+std::string problemEntry(SciActiveDocument const &doc, TagBalance::Problem const &problem);
 
-/* https://html.spec.whatwg.org/multipage/syntax.html#void-elements */
-constexpr const char *voidElements[] = {
-	"AREA",
-	"BASE",
-	"BASEFONT",
-	"BR",
-	"COL",
-	"EMBED",
-	"FRAME",
-	"HR",
-	"IMG",
-	"INPUT",
-	"ISINDEX",
-	"LINK",
-	"META",
-	"PARAM",
-	"SOURCE",
-	"TRACK",
-	"WBR",
-};
 constexpr int ncHighlightTimeout = 1000;
+/// Tells our jump list from autocompletion lists and other plugins' lists
+constexpr int balanceListType = 0x4854;
+/// Used if Notepad++ is too old to hand out indicators
+constexpr int fallbackBalanceIndicator = 9;
+constexpr int balanceIndicatorColor = 0x0000FF;
+/// The most problems the jump list holds; all of them are marked
+constexpr size_t maxListedProblems = 500;
+/// The tags in the jump list, by entry, and the document they're in
+std::vector<std::pair<std::string, Sci_Position>> listedProblems;
+sptr_t listedDocument = 0;
 }
 
 // --------------------------------------------------------------------------------------
 // HtmlTag::TagFinder
 // --------------------------------------------------------------------------------------
 void TagFinder::findMatchingTag(SelectionOptions options) {
-	std::string tagName;
-	bool dispose;
-	SearchDirection searchDirection = dirUnknown;
+	SpanTrace::Span span{ "TagFinder::findMatchingTag", "scan" };
 	SciActiveDocument doc = plugin.editor().activeDocument();
-	SciTextRange match{ doc };
-	SciTextRange *currentTag = nullptr;
-	TagPair matchingTags[2]{ { "", currentTag } };
-	// --------------------------------------------------------------------------------------
-	auto classifyTag = [&matchingTags, &currentTag, &match, &tagName, &searchDirection, &dispose](
-			       SearchDirection processDirection, char prefix) {
-		tagName = prefix + tagName;
-
-		if (!matchingTags->tag) {
-			*matchingTags = TagPair{ tagName, currentTag };
-			dispose = false;
-			searchDirection = processDirection;
-		} else {
-			if (sameText(tagName.substr(1), matchingTags->name.substr(1))) {
-				if (searchDirection != processDirection)
-					match = *currentTag;
-				matchingTags[1] = TagPair{ tagName, currentTag };
-				dispose = false;
-			}
-		}
-	};
-	// --------------------------------------------------------------------------------------
-	SciTextRange nextTag{ doc };
-	bool isStartTag, isEndTag;
-	bool isXML = (plugin.documentLangType() == L_XML);
 	bool wantSelection = !(options & soNone);
 	bool contentsOnly = wantSelection && !(options & soTags);
 	bool tagsOnly = wantSelection && !(options & soContents);
+	const TagMatcher::Bounds bounds = scanBounds(doc);
+	const TagBalance::Dialect dialect = (plugin.documentLangType() == L_XML) ? TagBalance::dlXml : TagBalance::dlHtml;
+	// Make sure we search forwards
+	const Sci_Position caret = doc.currentPosition();
+	const Sci_Position from = (caret <= doc.sendMessage(SCI_GETANCHOR)) ? caret + 1 : caret;
 
 	try {
-		do {
-			dispose = true;
-			if (!nextTag) {
-				// The first time, begin at the document's current position
-				currentTag = extractTagName(tagName, isStartTag, isEndTag);
-			} else {
-				currentTag = extractTagName(tagName, isStartTag, isEndTag, nextTag.startPos() + 1);
-				nextTag = doc.getRange();
-			}
+		TagMatcher::Match found;
+		if (!TagMatcher::findMatchingTag(documentSource(doc), from, bounds, found, dialect, tagSyntax()))
+			return;
 
-			if (currentTag && !tagName.empty()) {
-				// HTML void elements are self-closing
-				if (!isXML && isStartTag && !isEndTag) {
-					for (size_t i = 0; i < ARRAYSIZE(voidElements) - 1; i++) {
-						if (sameText(tagName, voidElements[i])) {
-							isEndTag = true;
-							break;
-						}
-					}
-				}
+		SciTextRange currentTag = doc.getRange(found.tag.startPos, found.tag.endPos);
+		SciTextRange match = doc.getRange(found.partner.startPos, found.partner.endPos);
+		if (found.partner.startPos < 0) { // A tag with no match
+			if (wantSelection)
+				currentTag.select();
 
-				if (isStartTag && isEndTag) {
-					tagName = '*' + tagName;
-					if (!matchingTags->tag) {
-						match = *currentTag;
-						*matchingTags = TagPair{ tagName, currentTag };
-						dispose = false;
-						searchDirection = dirNone;
-					}
-				} else if (isStartTag) {
-					classifyTag(dirForward, '+');
-				} else if (isEndTag) {
-					classifyTag(dirBackward, '-');
-				} else { // A tag that doesn't open and doesn't close?!?
-					::MessageBeep(MB_ICONWARNING);
-				}
+			currentTag.mark(STYLE_BRACEBAD, ncHighlightTimeout);
+			::MessageBeep(MB_ICONWARNING);
+			if (bounds.maxPos >= 0) {
+				// The match may lie beyond what a large file lets us scan
+				std::wstring status = plugin.formatMessage(
+				    L"msg_scan_bounded", { std::to_wstring(plugin.options.largeFiles.scanWindowBytes / 1024) });
+				plugin.sendNppMessage(NPPM_SETSTATUSBAR, STATUSBAR_DOC_TYPE, &status[0]);
 			}
-
-			// Find the next tag in the search direction
-			switch (searchDirection) {
-				case dirForward: { // Look forward for corresponding closing tag
-					nextTag = doc.getRange();
-					doc.find(LR"(<[^%\\?])", nextTag, SCFIND_REGEXP | SCFIND_POSIX,
-					    currentTag->endPos());
-					if (nextTag.length() != 0)
-						nextTag.endPos(nextTag.endPos() - 1);
+		} else if (found.partner.startPos == found.tag.startPos) { // Self-closing tag
+			if (tagsOnly)
+				selectTags(&match);
+			else
+				match.select();
+		} else {
+			// Matching tag may be hidden by a fold
+			doc.sendMessage(
+			    SCI_FOLDLINE, doc.sendMessage(SCI_LINEFROMPOSITION, match.startPos()), SC_FOLDACTION_EXPAND);
+
+			if (wantSelection && !tagsOnly) {
+				SciTextRange selRange{ doc }, selRangeNoSpaces{ doc };
+				if (currentTag.startPos() < match.startPos()) {
+					if (contentsOnly)
+						selRange = doc.getRange(currentTag.endPos(), match.startPos());
 					else
-						nextTag = doc.getRange();
-					break;
-				}
-				case dirBackward: { // Look backward for corresponding opening tag
-					Sci_Position initPos = currentTag->startPos();
-					do {
-						nextTag = doc.getRange();
-						doc.find(L">", nextTag, 0, initPos, 0);
-						if (nextTag.length() != 0) {
-							if (nextTag.startPos() == 0) {
-								nextTag = doc.getRange();
-								break;
-							}
-							nextTag.startPos(nextTag.startPos() - 1);
-							if (nextTag.text()[0] == L'%' || nextTag.text()[0] == L'?') {
-								initPos = nextTag.startPos();
-								continue;
-							} else {
-								nextTag.startPos(nextTag.startPos() + 1);
-								break;
-							}
-						} else
-							nextTag = doc.getRange();
-					} while (nextTag);
-					break;
-				}
-				default: // dirUnknown, dirNone
-					nextTag = doc.getRange();
-					break;
-			}
-
-			if (dispose) {
-				delete currentTag;
-				currentTag = nullptr;
-			}
-		} while (nextTag && !match);
-
-		if (match) {
-			if (matchingTags[1].tag) {
-				if (currentTag)
-					delete currentTag;
-
-				currentTag = matchingTags->tag;
-
-				// Matching tag may be hidden by a fold
-				doc.sendMessage(SCI_FOLDLINE, doc.sendMessage(SCI_LINEFROMPOSITION, match.startPos()),
-				    SC_FOLDACTION_EXPAND);
-
-				if (wantSelection && !tagsOnly) {
-					SciTextRange selRange{ doc }, selRangeNoSpaces{ doc };
-					if (currentTag->startPos() < match.startPos()) {
-						if (contentsOnly)
-							selRange = doc.getRange(currentTag->endPos(), match.startPos());
-						else
-							selRange = doc.getRange(currentTag->startPos(), match.endPos());
-					} else {
-						if (contentsOnly)
-							selRange = doc.getRange(match.endPos(), currentTag->startPos());
-						else
-							selRange = doc.getRange(match.startPos(), currentTag->endPos());
-					}
-					// TODO: make optional, read setting from .ini ([MatchTag] SkipWhitespace=1)
-					if (contentsOnly) {
-						// Leave out whitespace at beginning
-						doc.find(LR"([^ \r\n\t])", selRangeNoSpaces,
-						    SCFIND_REGEXP | SCFIND_POSIX, selRange.startPos(),
-						    selRange.endPos());
-						if (selRangeNoSpaces.length() != 0)
-							selRange.startPos(selRangeNoSpaces.startPos());
-						// Also leave out whitespace at end
-						doc.find(LR"([^ \r\n\t])", selRangeNoSpaces,
-						    SCFIND_REGEXP | SCFIND_POSIX, selRange.endPos(),
-						    selRange.startPos());
-						if (selRangeNoSpaces.length() != 0)
-							selRange.endPos(selRangeNoSpaces.endPos());
-					}
-					selRange.select();
-				} else if (wantSelection) {
-					selectTags(currentTag, &match);
+						selRange = doc.getRange(currentTag.startPos(), match.endPos());
 				} else {
-					match.select();
+					if (contentsOnly)
+						selRange = doc.getRange(match.endPos(), currentTag.startPos());
+					else
+						selRange = doc.getRange(match.startPos(), currentTag.endPos());
+				}
+				// TODO: make optional, read setting from .ini ([MatchTag] SkipWhitespace=1)
+				if (contentsOnly) {
+					// Leave out whitespace at beginning
+					doc.find(LR"([^ \r\n\t])", selRangeNoSpaces,
+					    SCFIND_REGEXP | SCFIND_POSIX, selRange.startPos(),
+					    selRange.endPos());
+					if (selRangeNoSpaces.length() != 0)
+						selRange.startPos(selRangeNoSpaces.startPos());
+					// Also leave out whitespace at end
+					doc.find(LR"([^ \r\n\t])", selRangeNoSpaces,
+					    SCFIND_REGEXP | SCFIND_POSIX, selRange.endPos(),
+					    selRange.startPos());
+					if (selRangeNoSpaces.length() != 0)
+						selRange.endPos(selRangeNoSpaces.endPos());
 				}
-			} else { // Self-closing tag
-				if (tagsOnly)
-					selectTags(&match);
-				else
-					match.select();
+				selRange.select();
+			} else if (wantSelection) {
+				selectTags(&currentTag, &match);
+			} else {
+				match.select();
 			}
-		} else if (matchingTags->tag) { // A tag with no match
-			if (currentTag)
-				delete currentTag;
-
-			currentTag = matchingTags->tag;
-
-			if (wantSelection)
-				currentTag->select();
-
-			currentTag->mark(STYLE_BRACEBAD, ncHighlightTimeout);
-			::MessageBeep(MB_ICONWARNING);
 		}
-
-		if (matchingTags->tag)
-			delete matchingTags->tag;
-
 	} catch (...) {
 	}
 }
-
-/////////////////////////////////////////////////////////////////////////////////////////
-namespace {
-SciTextRange *extractTagName(std::string &tagName, bool &isOpenTag, bool &isEndTag, Sci_Position tagPos) {
+// --------------------------------------------------------------------------------------
+void TagFinder::checkTagBalance() {
+	SpanTrace::Span span{ "TagFinder::checkTagBalance", "scan" };
 	SciActiveDocument doc = plugin.editor().activeDocument();
-	bool closureFound = false;
-	isOpenTag = true;
-	isEndTag = false;
-	tagName.clear();
-
-	if (tagPos < 0) {
-		tagPos = (doc.currentPosition() <= doc.sendMessage(SCI_GETANCHOR)) // Make sure we search forwards
-			     ? doc.currentPosition() + 1
-			     : doc.currentPosition();
-	}
-
-	SciTextRange *result = new SciTextRange(doc);
-	doc.find(L"<", *result, 0, tagPos, 0);
-	if (result->length() == 0) {
-		doc.find(L"<", *result, 0, tagPos);
-		if (result->length() == 0)
-			return result;
-	}
-
-	SciTextRange tagEnd{ doc };
-	doc.find(L">", tagEnd, 0, result->endPos() + 1);
-	if (tagEnd.length() == 0)
-		return result;
-	else
-		result->endPos(tagEnd.endPos());
-
-	std::string digits, letters, attrchars{ "-_.:" };
-	textToBytes(result->text().data(), tagName, CP_ACP);
-	textToBytes(Entities::scDigits, digits, CP_ACP);
-	textToBytes(Entities::scLetters, letters, CP_ACP);
-
-	size_t startIndex = 0;
-	size_t endIndex = 0;
+	const TagBalance::Dialect dialect = (plugin.documentLangType() == L_XML) ? TagBalance::dlXml : TagBalance::dlHtml;
 
-	for (size_t i = 1; i < tagName.length(); i++) {
-		// Exit early when it's obviously a self-closing tag
-		if (tagName.substr(i) == "/>") {
-			isOpenTag = true;
-			isEndTag = true;
-			endIndex = i - 1;
-			break;
-		} else if (startIndex == 0) {
-			if (tagName[i] == '/') {
-				isOpenTag = false;
-				isEndTag = true;
-			} else if (digits.find(tagName[i]) != std::string::npos ||
-				   letters.find(tagName[i]) != std::string::npos ||
-				   attrchars.find(tagName[i]) != std::string::npos) {
-				startIndex = i;
-			}
-		} else if (endIndex == 0) {
-			if (tagName[i] && digits.find(tagName[i]) == std::string::npos &&
-			    letters.find(tagName[i]) == std::string::npos &&
-			    attrchars.find(tagName[i]) == std::string::npos) {
-				endIndex = i - 1;
-				if (isEndTag) {
-					break;
-				}
-			}
-		} else {
-			if (tagName[i] == '/') {
-				closureFound = true;
-			} else if (closureFound && !isspace(tagName[i])) {
-				closureFound = false;
+	try {
+		const auto started = std::chrono::steady_clock::now();
+		const TagSource source = documentSource(doc);
+		const TagBalance::Report report = TagBalance::check(source, dialect, tagSyntax());
+		const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started;
+
+		const int indicator = balanceIndicator();
+		doc.sendMessage(SCI_INDICSETSTYLE, indicator, INDIC_SQUIGGLE);
+		doc.sendMessage(SCI_INDICSETFORE, indicator, balanceIndicatorColor);
+		doc.sendMessage(SCI_SETINDICATORCURRENT, indicator);
+		doc.sendMessage(SCI_INDICATORCLEARRANGE, 0, source.length());
+		listedProblems.clear();
+		listedDocument = doc.sendMessage(SCI_GETDOCPOINTER);
+		std::string list;
+		for (TagBalance::Problem const &problem : report.problems) {
+			doc.sendMessage(SCI_INDICATORFILLRANGE, problem.startPos, problem.endPos - problem.startPos);
+			if (listedProblems.size() < maxListedProblems) {
+				listedProblems.emplace_back(problemEntry(doc, problem), problem.startPos);
+				list += (list.empty() ? "" : "\n") + listedProblems.back().first;
 			}
 		}
+
+		std::wstringstream mbPerSecond;
+		mbPerSecond << std::fixed << std::setprecision(1)
+			    << static_cast<double>(source.length()) / (1024.0 * 1024.0) / (std::max)(elapsed.count(), 1e-6);
+		std::wstring status = plugin.formatMessage(L"msg_tag_balance",
+		    { std::to_wstring(report.problems.size() + report.unreported), std::to_wstring(report.tags),
+			mbPerSecond.str() });
+		plugin.sendNppMessage(NPPM_SETSTATUSBAR, STATUSBAR_DOC_TYPE, &status[0]);
+
+		if (list.empty())
+			return;
+		// Entries hold spaces, so they're put one to a line while the list is read
+		const LRESULT separator = doc.sendMessage(SCI_AUTOCGETSEPARATOR);
+		doc.sendMessage(SCI_AUTOCSETSEPARATOR, '\n');
+		doc.sendMessage(SCI_USERLISTSHOW, balanceListType, &list[0]);
+		doc.sendMessage(SCI_AUTOCSETSEPARATOR, separator);
+	} catch (...) {
 	}
+}
+// --------------------------------------------------------------------------------------
+bool TagFinder::jumpToProblem(int listType, const char *entry) {
+	if (listType != balanceListType)
+		return false;
 
-	isEndTag = (isEndTag || closureFound);
-	if (endIndex == 0) {
-		tagName = tagName.substr(startIndex);
-	} else {
-		tagName = tagName.substr(startIndex, endIndex - startIndex + 1);
+	SciActiveDocument doc = plugin.editor().activeDocument();
+	if (!entry || doc.sendMessage(SCI_GETDOCPOINTER) != listedDocument)
+		return true;
+	auto problem = std::find_if(listedProblems.begin(), listedProblems.end(),
+	    [entry](std::pair<std::string, Sci_Position> const &listed) { return listed.first == entry; });
+	if (problem != listedProblems.end()) {
+		doc.sendMessage(SCI_ENSUREVISIBLE, doc.sendMessage(SCI_LINEFROMPOSITION, problem->second));
+		doc.sendMessage(SCI_GOTOPOS, problem->second);
 	}
+	return true;
+}
 
-	return result;
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+TagMatcher::Bounds scanBounds(SciActiveDocument const &doc) {
+	const Sci_Position window = plugin.options.largeFiles.scanWindowBytes;
+	if (!plugin.largeFileMode() || window <= 0)
+		return TagMatcher::Bounds{ 0, INVALID_POSITION };
+
+	const Sci_Position caret = doc.currentPosition();
+	return TagMatcher::Bounds{
+		(std::max)(Sci_Position(0), caret - window), (std::min)(doc.length(), caret + window) };
+}
+// --------------------------------------------------------------------------------------
+TagSource documentSource(SciActiveDocument const &doc) {
+	return TagSource{ [doc](unsigned msg, uptr_t wParam, sptr_t lParam) {
+		return static_cast<sptr_t>(doc.sendMessage(msg, static_cast<WPARAM>(wParam), static_cast<LPARAM>(lParam)));
+	} };
+}
+// --------------------------------------------------------------------------------------
+TagLexer::TagSyntax tagSyntax() {
+	return plugin.options.bracedAttributes ? TagLexer::tsBraces : TagLexer::tsHtml;
+}
+// --------------------------------------------------------------------------------------
+/// Asks Notepad++ for an indicator no other plugin uses, the first time
+int balanceIndicator() {
+	static int indicator = -1;
+	if (indicator < 0 && !plugin.sendNppMessage(NPPM_ALLOCATEINDICATOR, 1, &indicator))
+		indicator = fallbackBalanceIndicator;
+	return indicator;
+}
+// --------------------------------------------------------------------------------------
+/// e.g. "12:5  Unclosed <div>", counting columns in bytes from 1
+std::string problemEntry(SciActiveDocument const &doc, TagBalance::Problem const &problem) {
+	static const wchar_t *const kinds[] = { L"msg_unclosed_tag", L"msg_misnested_tag", L"msg_stray_tag" };
+	const auto line = static_cast<Sci_Position>(doc.sendMessage(SCI_LINEFROMPOSITION, problem.startPos));
+	const Sci_Position column = problem.startPos - doc.sendMessage(SCI_POSITIONFROMLINE, line);
+	std::wstring name;
+	bytesToText(problem.name.c_str(), name, doc.codePage());
+	std::wstring entry = std::to_wstring(line + 1) + L":" + std::to_wstring(column + 1) + L"  " +
+			     plugin.formatMessage(kinds[problem.kind], { name });
+	std::string bytes;
+	textToBytes(entry.c_str(), bytes, doc.codePage());
+	return bytes;
 }
 // --------------------------------------------------------------------------------------
 void selectTags(SciTextRange *startTag, SciTextRange *endTag) {
-	const std::wstring startTagName = startTag->text();
+	SciActiveDocument doc = plugin.editor().activeDocument();
+	const std::wstring startTagName = tagPrefix(*startTag);
 	size_t tagAttrPos = pos(L" ", startTagName);
 
 	// Trim attributes from tag selection
@@ -334,11 +244,11 @@ void selectTags(SciTextRange *startTag, SciTextRange *endTag) {
 	if (endTag == nullptr) {
 		// Narrow the selection around a self-closing tag
 		startTag->startPos(startTag->startPos() + pos(L"<", startTagName));
-		if (startTag->text().find(L"/>") != std::wstring::npos)
+		if (startTag->length() >= 2 && doc.sendMessage(SCI_GETCHARAT, startTag->endPos() - 2) == '/' &&
+		    doc.sendMessage(SCI_GETCHARAT, startTag->endPos() - 1) == '>')
 			startTag->endPos(startTag->endPos() - 1);
 	} else {
-		SciActiveDocument doc = plugin.editor().activeDocument();
-		const std::wstring endTagName = endTag->text();
+		const std::wstring endTagName = tagPrefix(*endTag);
 		tagAttrPos = pos(L" ", endTagName);
 
 		startTag->startPos(startTag->startPos() + (pos(L"/", startTagName) >> 1) + 1);
@@ -351,4 +261,10 @@ void selectTags(SciTextRange *startTag, SciTextRange *endTag) {
 		    SCI_ADDSELECTION, endTag->startPos() + (pos(L"/", endTagName) >> 1) + 1, endTag->endPos() - 1);
 	}
 }
+// --------------------------------------------------------------------------------------
+std::wstring tagPrefix(SciTextRange const &tag) {
+	// Enough for "</", the longest name, and the space after it
+	const Sci_Position length = (std::min)(tag.length(), TagLexer::maxNameLength + 3);
+	return plugin.editor().activeDocument().getRange(tag.startPos(), tag.startPos() + length).text();
+}
 }
@@ -13,6 +13,11 @@
 namespace HtmlTag {
 namespace TagFinder {
 	void findMatchingTag(SelectionOptions options = soNone);
+	/// @brief Marks every unclosed, misnested and stray tag in the active document, and lists them to jump to.
+	void checkTagBalance();
+	/// @brief Goes to the tag picked from the list shown by @c checkTagBalance.
+	/// @return @c false if the list was someone else's
+	bool jumpToProblem(int listType, const char *entry);
 }
 }
 #endif // ~HTMLTAG_TAGFINDER_H
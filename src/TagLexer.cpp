@@ -0,0 +1,296 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#include <algorithm>
+#include "TagLexer.h"
+
+using namespace HtmlTag;
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+/// Markup that ends at a fixed string, not the first '>' outside quotes
+struct Declaration {
+	std::string_view open;
+	std::string_view close;
+};
+
+Declaration const *declarationAt(std::string_view head) noexcept;
+Sci_Position tagEnd(TagSource const &source, Sci_Position startPos, Sci_Position limit, TagLexer::TagSyntax syntax,
+    std::string_view head, Declaration const *declaration, bool &selfClosing, bool unclosedQuote = false);
+Sci_Position findDelimiter(TagSource const &source, Sci_Position pos, Sci_Position limit, std::string_view delimiter);
+Sci_Position lastTagOpen(TagSource const &source, Sci_Position before, Sci_Position minPos);
+bool isTagOpen(char ch) noexcept;
+bool isNameChar(char ch) noexcept;
+bool isSpace(char ch) noexcept;
+
+constexpr Declaration declarations[] = {
+	{ "<!--", "-->" },
+	{ "<![CDATA[", "]]>" },
+	{ "<?", "?>" },
+	{ "<%", "%>" },
+};
+/// Most tags fit in the first chunk; each one after that is twice as long, up to the last size
+constexpr Sci_Position firstChunkLength = 0x100;
+constexpr Sci_Position lastChunkLength = 0x100000;
+/// The least an editor is asked for at a time; it's one message, however long
+constexpr Sci_Position windowLength = 0x10000;
+/// Which bytes a tag name can hold, looked up rather than compared, since most bytes in a tag are tested
+struct NameChars {
+	bool chars[0x100];
+	constexpr NameChars() : chars{} {
+		for (int ch = 0; ch < 0x100; ++ch) {
+			chars[ch] = (ch >= '0' && ch <= '9') || (ch >= 'A' && ch <= 'Z') || (ch >= 'a' && ch <= 'z') ||
+				    ch == '-' || ch == '_' || ch == '.' || ch == ':';
+		}
+	}
+};
+constexpr NameChars nameChars{};
+/// How many tags written out in an attribute value, e.g. title="<b>bold</b>", are passed over going backwards
+constexpr int maxNestedTags = 4;
+}
+
+// --------------------------------------------------------------------------------------
+// HtmlTag::TagSource
+// --------------------------------------------------------------------------------------
+TagSource::TagSource(Send send) : _send(std::move(send)), _length(0), _windowPos(0) {
+	_length = static_cast<Sci_Position>(_send(SCI_GETLENGTH, 0, 0));
+}
+// --------------------------------------------------------------------------------------
+std::string_view TagSource::fetch(Sci_Position pos, Sci_Position len) const {
+	pos = (std::max)(Sci_Position(0), (std::min)(pos, _length));
+	len = (std::max)(Sci_Position(0), (std::min)(len, _length - pos));
+	if (len == 0)
+		return std::string_view{};
+	if (!_send)
+		return _text.substr(static_cast<size_t>(pos), static_cast<size_t>(len));
+	if (pos >= _windowPos && pos + len <= _windowPos + static_cast<Sci_Position>(_window.size()))
+		return _window.substr(static_cast<size_t>(pos - _windowPos), static_cast<size_t>(len));
+
+	// Reading goes forwards, so whatever follows is likely to be read next
+	const Sci_Position fetched = (std::max)(len, (std::min)(windowLength, _length - pos));
+	const auto *chars = reinterpret_cast<const char *>(
+	    _send(SCI_GETRANGEPOINTER, static_cast<uptr_t>(pos), static_cast<sptr_t>(fetched)));
+	_window = chars ? std::string_view{ chars, static_cast<size_t>(fetched) } : std::string_view{};
+	_windowPos = pos;
+	return _window.substr(0, static_cast<size_t>(len));
+}
+
+// --------------------------------------------------------------------------------------
+// HtmlTag::TagLexer
+// --------------------------------------------------------------------------------------
+Sci_Position TagLexer::findTagEnd(
+    TagSource const &source, Sci_Position startPos, Sci_Position limit, TagSyntax syntax) {
+	limit = (limit < 0) ? source.length() : (std::min)(limit, source.length());
+	if (startPos >= limit)
+		return INVALID_POSITION;
+	const std::string_view head = source.view(startPos, (std::min)(firstChunkLength, limit - startPos));
+	bool selfClosing = false;
+	return tagEnd(source, startPos, limit, syntax, head, declarationAt(head), selfClosing);
+}
+// --------------------------------------------------------------------------------------
+Sci_Position TagLexer::findTagStart(
+    TagSource const &source, Sci_Position endPos, Sci_Position minPos, TagSyntax syntax) {
+	Sci_Position found = INVALID_POSITION;
+	int misses = 0;
+	for (Sci_Position open = lastTagOpen(source, endPos - 1, minPos); open >= 0;
+	     open = lastTagOpen(source, open, minPos)) {
+		if (findTagEnd(source, open, endPos, syntax) == endPos) {
+			// Keep going, in case this one is only written out in an attribute value of the one before
+			found = open;
+		} else if (found >= 0 || ++misses > maxNestedTags) {
+			break;
+		}
+	}
+	return found;
+}
+// --------------------------------------------------------------------------------------
+bool TagLexer::readTag(
+    TagSource const &source, Sci_Position startPos, Sci_Position limit, Tag &tag, TagSyntax syntax) {
+	// Reuses the name's storage, when reading tag after tag
+	tag.name.clear();
+	tag.startPos = startPos;
+	tag.endPos = INVALID_POSITION;
+	tag.isEndTag = tag.isSelfClosing = false;
+	limit = (limit < 0) ? source.length() : (std::min)(limit, source.length());
+	// One read serves the name and the start of the search for the end
+	const std::string_view head = source.view(startPos, (std::min)(firstChunkLength, limit - startPos));
+	if (head.size() < 2 || head[0] != '<' || !isTagOpen(head[1]))
+		return false;
+
+	Declaration const *declaration = declarationAt(head);
+	tag.endPos = tagEnd(source, startPos, limit, syntax, head, declaration, tag.isSelfClosing);
+	if (tag.endPos < 0)
+		return false;
+	// Comments and the like are passed over whole, but have no name to match; nor has a <!DOCTYPE>
+	if (declaration || head[1] == '!' || head[1] == '?' || head[1] == '%')
+		return true;
+
+	// Skip to the name, e.g. past '/' or '!'; the '>' ends the prefix, if the name doesn't
+	const std::string_view prefix = head.substr(0, static_cast<size_t>(tag.endPos - startPos));
+	size_t first = 1;
+	for (; first < prefix.size() && !isNameChar(prefix[first]) && prefix.substr(first) != "/>"; ++first) {
+		if (prefix[first] == '/')
+			tag.isEndTag = true;
+	}
+	size_t last = first;
+	while (last < prefix.size() && isNameChar(prefix[last]) && last - first < static_cast<size_t>(maxNameLength))
+		++last;
+	tag.name.assign(prefix.substr(first, last - first));
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+/// Returns the kind of declaration that @p head starts with, if it isn't a tag
+Declaration const *declarationAt(std::string_view head) noexcept {
+	if (head.size() < 2 || (head[1] != '!' && head[1] != '?' && head[1] != '%'))
+		return nullptr;
+	for (Declaration const &declaration : declarations) {
+		if (head.substr(0, declaration.open.size()) == declaration.open)
+			return &declaration;
+	}
+	return nullptr;
+}
+// --------------------------------------------------------------------------------------
+/// Finds the end of the tag at @p startPos, whose first bytes, up to @c firstChunkLength of them, are @p head,
+/// and which is the @p declaration found there, if any; @p selfClosing is set if it ends with a "/>" whose '/'
+/// isn't the end of an unquoted value, as in href=/>. If a quote is left open, the tag is read again knowing
+/// that, as @p unclosedQuote
+Sci_Position tagEnd(TagSource const &source, Sci_Position startPos, Sci_Position limit, TagLexer::TagSyntax syntax,
+    std::string_view head, Declaration const *declaration, bool &selfClosing, bool unclosedQuote) {
+	selfClosing = false;
+	if (declaration)
+		return findDelimiter(
+		    source, startPos + static_cast<Sci_Position>(declaration->open.size()), limit, declaration->close);
+
+	bool afterEquals = false, unquoted = false, slash = false;
+	char quote = '\0';
+	int braces = 0;
+
+	Sci_Position pos = startPos + 1;
+	std::string_view text = head.substr((std::min)(head.size(), size_t{ 1 }));
+	for (Sci_Position chunk = firstChunkLength * 2; !text.empty(); chunk = (std::min)(chunk * 2, lastChunkLength)) {
+		for (size_t i = 0; i < text.size();) {
+			if (quote) {
+				// The bulk of a huge attribute value is passed over here
+				const size_t close = text.find(quote, i);
+				// An unclosed quote ends at the first '>' after it, as it did before quotes were tracked
+				if (unclosedQuote && braces == 0) {
+					const size_t gt = text.substr(0, close).find('>', i);
+					if (gt != std::string_view::npos)
+						return pos + static_cast<Sci_Position>(gt) + 1;
+				}
+				if (close == std::string_view::npos)
+					break;
+				quote = '\0';
+				i = close + 1;
+				continue;
+			}
+
+			if (braces > 0) {
+				// Inside an expression, only its strings and nested braces matter
+				const char ch = text[i++];
+				if (ch == '{') {
+					++braces;
+				} else if (ch == '}') {
+					--braces;
+				} else if (ch == '"' || ch == '\'' || ch == '`') {
+					quote = ch;
+				}
+				continue;
+			}
+
+			// Names and unquoted values are passed over a run at a time
+			const size_t run = i;
+			while (i < text.size() && isNameChar(text[i]))
+				++i;
+			if (i != run) {
+				unquoted = unquoted || afterEquals;
+				afterEquals = slash = false;
+			}
+			if (i == text.size())
+				break;
+
+			const char ch = text[i++];
+			const bool quoted = (ch == '"' || ch == '\'') && afterEquals;
+			const bool braced = ch == '{' && (syntax & TagLexer::tsBraces);
+			if (ch == '>') {
+				selfClosing = slash;
+				return pos + static_cast<Sci_Position>(i);
+			}
+			// Whatever follows an '=' starts an unquoted value, which only whitespace ends
+			slash = ch == '/' && !unquoted && !afterEquals;
+			if (quoted) {
+				quote = ch;
+				afterEquals = false;
+			} else if (braced) {
+				braces = 1;
+				afterEquals = false;
+			} else if (ch == '=') {
+				afterEquals = true;
+			} else if (isSpace(ch)) {
+				unquoted = false;
+			} else {
+				unquoted = unquoted || afterEquals;
+				afterEquals = false;
+			}
+		}
+		pos += static_cast<Sci_Position>(text.size());
+		text = (pos < limit) ? source.view(pos, (std::min)(chunk, limit - pos)) : std::string_view{};
+	}
+	// Quotes are rarely left open, so that '>' is looked for in a second pass, not in every quoted value
+	if (quote && braces == 0 && !unclosedQuote)
+		return tagEnd(source, startPos, limit, syntax, head, declaration, selfClosing, true);
+	return INVALID_POSITION;
+}
+// --------------------------------------------------------------------------------------
+/// Returns the position just after the first @p delimiter from @p pos, or INVALID_POSITION
+Sci_Position findDelimiter(TagSource const &source, Sci_Position pos, Sci_Position limit, std::string_view delimiter) {
+	// Chunks overlap, so a delimiter can't be split between them
+	const auto overlap = static_cast<Sci_Position>(delimiter.size()) - 1;
+	for (Sci_Position chunk = firstChunkLength; pos < limit; chunk = (std::min)(chunk * 2, lastChunkLength)) {
+		const std::string_view text = source.view(pos, (std::min)(chunk, limit - pos));
+		const size_t found = text.find(delimiter);
+		if (found != std::string_view::npos)
+			return pos + static_cast<Sci_Position>(found + delimiter.size());
+		if (text.empty() || pos + static_cast<Sci_Position>(text.size()) >= limit)
+			break;
+		pos += static_cast<Sci_Position>(text.size()) - overlap;
+	}
+	return INVALID_POSITION;
+}
+// --------------------------------------------------------------------------------------
+/// Returns the position of the last '<' before @p before that could open a tag, or INVALID_POSITION
+Sci_Position lastTagOpen(TagSource const &source, Sci_Position before, Sci_Position minPos) {
+	for (Sci_Position chunk = firstChunkLength; before > minPos; chunk = (std::min)(chunk * 2, lastChunkLength)) {
+		const Sci_Position from = (std::max)(minPos, before - chunk);
+		// One byte more, to see what follows a '<' at the end
+		const std::string_view text = source.view(from, before - from + 1);
+		size_t at = static_cast<size_t>(before - from);
+		while (at > 0 && (at = text.rfind('<', at - 1)) != std::string_view::npos) {
+			if (at + 1 < text.size() && isTagOpen(text[at + 1]))
+				return from + static_cast<Sci_Position>(at);
+		}
+		before = from;
+	}
+	return INVALID_POSITION;
+}
+// --------------------------------------------------------------------------------------
+/// Whether @p ch, just after a '<', makes it a tag: "a < b" and "a<3" aren't
+bool isTagOpen(char ch) noexcept {
+	return (ch >= 'A' && ch <= 'Z') || (ch >= 'a' && ch <= 'z') || ch == '/' || ch == '!' || ch == '?' ||
+	       ch == '%' || ch == '_' || ch == ':';
+}
+// --------------------------------------------------------------------------------------
+bool isNameChar(char ch) noexcept {
+	return nameChars.chars[static_cast<unsigned char>(ch)];
+}
+// --------------------------------------------------------------------------------------
+bool isSpace(char ch) noexcept {
+	return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n' || ch == '\f';
+}
+}
@@ -0,0 +1,97 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#ifndef HTMLTAG_TAG_LEXER_H
+#define HTMLTAG_TAG_LEXER_H
+
+#include <functional>
+#include <string>
+#include <string_view>
+#include "Scintilla.h"
+
+namespace HtmlTag {
+/// @brief A document's text, read a chunk at a time without copying it: from an editor window, or a
+/// @c SciMemoryDocument, through @c SCI_GETRANGEPOINTER, or straight from memory, e.g. a mapped file.
+///
+/// An editor's text is fetched a window at a time, and reads inside the last window cost no message.
+/// @note The document's length is read once, so make a new source after editing it; nor is a source safe to
+/// share between threads
+class TagSource final {
+
+public:
+	using Send = std::function<sptr_t(unsigned, uptr_t, sptr_t)>;
+
+	explicit TagSource(Send send);
+	explicit TagSource(std::string_view text) noexcept
+	    : _text(text), _length(static_cast<Sci_Position>(text.size())), _window(text), _windowPos(0) {}
+
+	Sci_Position length() const noexcept { return _length; }
+	/// @brief Up to @p len bytes from @p pos, valid until the document next changes.
+	std::string_view view(Sci_Position pos, Sci_Position len) const {
+		// Most reads fall inside the last window, or the whole text, and are only sliced from it
+		if (pos >= _windowPos && len >= 0 && pos + len <= _windowPos + static_cast<Sci_Position>(_window.size()))
+			return _window.substr(static_cast<size_t>(pos - _windowPos), static_cast<size_t>(len));
+		return fetch(pos, len);
+	}
+
+private:
+	std::string_view fetch(Sci_Position pos, Sci_Position len) const;
+
+	Send _send;
+	std::string_view _text;
+	Sci_Position _length;
+	/// The text last fetched from the editor, and where it starts
+	mutable std::string_view _window;
+	mutable Sci_Position _windowPos;
+};
+
+/// @brief Reads tags without copying them, so that megabytes of inline SVG or @c data: URIs cost no more
+/// than a scan for their closing quote.
+///
+/// A @c '>' or @c '<' in a quoted attribute value, a comment, a CDATA section, or a PHP or ASP block
+/// neither ends nor starts a tag.
+namespace TagLexer {
+	/// The longest tag name read, as in RFC 1866; the rest of a longer one is ignored
+	constexpr Sci_Position maxNameLength = 72;
+
+	/// What else may hold a @c '>' inside a tag, besides quoted attribute values
+	enum TagSyntax {
+		tsHtml = 0,
+		/// Razor and JSX expressions, e.g. @c onClick={() => a > b}
+		tsBraces = 1,
+	};
+
+	struct Tag {
+		/// Empty for a comment, CDATA section, declaration such as @c <!DOCTYPE>, or PHP or ASP block
+		std::string name;
+		/// The position of the opening @c '<', and just after the closing @c '>'
+		Sci_Position startPos;
+		Sci_Position endPos;
+		/// Whether it's @c </name>, or ends with @c />
+		bool isEndTag;
+		bool isSelfClosing;
+	};
+
+	/// @brief Finds the @c '>' that closes the tag opened at @p startPos, in one pass that reads no further
+	/// than it must, and never past @p limit.
+	/// @param limit Where to give up, or -1 for the end of the document
+	/// @return The position just after the @c '>', or @c INVALID_POSITION
+	Sci_Position findTagEnd(
+	    TagSource const &source, Sci_Position startPos, Sci_Position limit = -1, TagSyntax syntax = tsHtml);
+	/// @brief Finds the @c '<' of the tag closed by the @c '>' just before @p endPos, looking back no
+	/// further than @p minPos. A @c '<' in the tag's attribute values is passed over, along with a few tags
+	/// written out in them.
+	/// @return @c INVALID_POSITION if the @c '>' closes no tag, e.g. in the text "a > b"
+	Sci_Position findTagStart(
+	    TagSource const &source, Sci_Position endPos, Sci_Position minPos = 0, TagSyntax syntax = tsHtml);
+	/// @brief Reads the name of the tag opened at @p startPos from its first few bytes, and finds its end.
+	/// @return @c false if there's no tag at @p startPos, or it isn't closed before @p limit
+	bool readTag(TagSource const &source, Sci_Position startPos, Sci_Position limit, Tag &tag,
+	    TagSyntax syntax = tsHtml);
+}
+}
+#endif // ~HTMLTAG_TAG_LEXER_H
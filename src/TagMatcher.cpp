@@ -0,0 +1,150 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+  Original Pascal unit (c) Martijn Coppoolse <https://github.com/vor0nwe>
+*/
+#include <algorithm>
+#include "TagMatcher.h"
+
+using namespace HtmlTag;
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+Sci_Position nextTagOpen(TagSource const &source, Sci_Position pos, Sci_Position limit);
+Sci_Position firstOf(TagSource const &source, char ch, Sci_Position pos, Sci_Position limit);
+Sci_Position lastOf(TagSource const &source, char ch, Sci_Position before, Sci_Position minPos);
+bool opensTag(char ch) noexcept;
+bool sameName(std::string_view lhs, std::string_view rhs) noexcept;
+
+/// How much text each search reads at once
+constexpr Sci_Position scanLength = 0x1000;
+}
+
+// --------------------------------------------------------------------------------------
+// HtmlTag::TagMatcher
+// --------------------------------------------------------------------------------------
+bool TagMatcher::findMatchingTag(TagSource const &source, Sci_Position from, Bounds const &bounds, Match &match,
+    TagBalance::Dialect dialect, TagLexer::TagSyntax syntax) {
+	const Sci_Position maxPos = (bounds.maxPos < 0) ? source.length() : (std::min)(bounds.maxPos, source.length());
+	from = (std::min)(from, source.length());
+	TagLexer::Tag tag;
+	auto readTag = [&](Sci_Position start) {
+		if (!TagLexer::readTag(source, start, maxPos, tag, syntax))
+			return false;
+		// HTML void elements are self-closing
+		if (dialect == TagBalance::dlHtml && !tag.isEndTag && TagBalance::isVoidElement(tag.name))
+			tag.isSelfClosing = true;
+		return true;
+	};
+
+	// The first time, begin at the document's current position; a search that starts past its bound would
+	// turn around and run backwards
+	Sci_Position start = lastOf(source, '<', from, bounds.minPos);
+	if (start < 0 && from < maxPos)
+		start = firstOf(source, '<', from, maxPos);
+	if (start < 0 || !readTag(start) || tag.name.empty())
+		return false;
+
+	match.tag = tag;
+	match.partner = TagLexer::Tag{ {}, INVALID_POSITION, INVALID_POSITION, false, false };
+	if (tag.isSelfClosing) {
+		match.partner = tag;
+		return true;
+	}
+
+	const std::string name = tag.name;
+	int depth = 1;
+	if (!match.tag.isEndTag) {
+		// Look forward for the corresponding closing tag, from just past each tag, attributes and all; only
+		// a '<' that opens a tag is read, and comments and PHP or ASP blocks are read whole, and passed over
+		for (Sci_Position pos = match.tag.endPos; pos < maxPos;) {
+			const Sci_Position next = nextTagOpen(source, pos, maxPos);
+			if (next < 0)
+				break;
+			if (!readTag(next)) {
+				pos = next + 1;
+				continue;
+			}
+			pos = tag.endPos;
+			if (tag.isSelfClosing || !sameName(tag.name, name))
+				continue;
+			depth += tag.isEndTag ? -1 : 1;
+			if (depth == 0) {
+				match.partner = std::move(tag);
+				break;
+			}
+		}
+	} else {
+		// Look backward for the corresponding opening tag, passing over a '>' in text or an attribute value,
+		// and landing on the '<' of the tag it closes
+		for (Sci_Position pos = match.tag.startPos; pos > bounds.minPos;) {
+			const Sci_Position gt = lastOf(source, '>', pos, bounds.minPos);
+			if (gt < 0)
+				break;
+			const Sci_Position tagStart = TagLexer::findTagStart(source, gt + 1, bounds.minPos, syntax);
+			pos = (tagStart < 0) ? gt : tagStart;
+			if (tagStart < 0 || !readTag(tagStart) || tag.isSelfClosing || !sameName(tag.name, name))
+				continue;
+			depth += tag.isEndTag ? 1 : -1;
+			if (depth == 0) {
+				match.partner = std::move(tag);
+				break;
+			}
+		}
+	}
+	return true;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+/// Returns the position of the first '<' that opens a tag, comment or block at or after @p pos, and before
+/// @p limit, or -1
+Sci_Position nextTagOpen(TagSource const &source, Sci_Position pos, Sci_Position limit) {
+	for (; pos < limit; pos += scanLength) {
+		// One byte more, to see what follows a '<' at the end
+		const std::string_view text = source.view(pos, (std::min)(scanLength + 1, limit - pos));
+		for (size_t at = text.find('<'); at != std::string_view::npos && at + 1 < text.size();
+		     at = text.find('<', at + 1)) {
+			if (opensTag(text[at + 1]))
+				return pos + static_cast<Sci_Position>(at);
+		}
+	}
+	return INVALID_POSITION;
+}
+// --------------------------------------------------------------------------------------
+/// Returns the position of the first @p ch at or after @p pos, and before @p limit, or -1
+Sci_Position firstOf(TagSource const &source, char ch, Sci_Position pos, Sci_Position limit) {
+	for (; pos < limit; pos += scanLength) {
+		const size_t at = source.view(pos, (std::min)(scanLength, limit - pos)).find(ch);
+		if (at != std::string_view::npos)
+			return pos + static_cast<Sci_Position>(at);
+	}
+	return INVALID_POSITION;
+}
+// --------------------------------------------------------------------------------------
+/// Returns the position of the last @p ch before @p before, and not before @p minPos, or -1
+Sci_Position lastOf(TagSource const &source, char ch, Sci_Position before, Sci_Position minPos) {
+	while (before > minPos) {
+		const Sci_Position start = (std::max)(minPos, before - scanLength);
+		const size_t at = source.view(start, before - start).rfind(ch);
+		if (at != std::string_view::npos)
+			return start + static_cast<Sci_Position>(at);
+		before = start;
+	}
+	return INVALID_POSITION;
+}
+// --------------------------------------------------------------------------------------
+bool opensTag(char ch) noexcept {
+	return (ch >= 'A' && ch <= 'Z') || (ch >= 'a' && ch <= 'z') || ch == '/' || ch == '!' || ch == '?' ||
+	       ch == '%' || ch == '_' || ch == ':';
+}
+// --------------------------------------------------------------------------------------
+bool sameName(std::string_view lhs, std::string_view rhs) noexcept {
+	auto lower = [](char ch) { return (ch >= 'A' && ch <= 'Z') ? static_cast<char>(ch + ('a' - 'A')) : ch; };
+	return lhs.size() == rhs.size() &&
+	       std::equal(lhs.begin(), lhs.end(), rhs.begin(), [&lower](char a, char b) { return lower(a) == lower(b); });
+}
+}
@@ -0,0 +1,41 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#ifndef HTMLTAG_TAG_MATCHER_H
+#define HTMLTAG_TAG_MATCHER_H
+
+#include "TagBalance.h"
+
+namespace HtmlTag {
+/// @brief Finds the partner of the tag at the caret, by the same searches whether the text is in an editor
+/// window or in memory.
+namespace TagMatcher {
+	/// The part of the document that searches may cover
+	struct Bounds {
+		Sci_Position minPos;
+		/// Or -1 for the end of the document
+		Sci_Position maxPos;
+	};
+
+	struct Match {
+		/// The tag the search began at
+		TagLexer::Tag tag;
+		/// The tag itself, if it closes itself; its partner's @c startPos is @c INVALID_POSITION if there's none
+		TagLexer::Tag partner;
+	};
+
+	/// @brief Reads the last tag opened before @p from, or else the first one after it, and finds its partner:
+	/// forwards from an opening tag, or backwards from an end tag, passing over as many pairs of tags of the
+	/// same name as are nested between them.
+	///
+	/// Names are matched without regard to case. In HTML, void elements such as @c <br> close themselves.
+	/// @return @c false if there's no tag to begin at
+	bool findMatchingTag(TagSource const &source, Sci_Position from, Bounds const &bounds, Match &match,
+	    TagBalance::Dialect dialect = TagBalance::dlHtml, TagLexer::TagSyntax syntax = TagLexer::tsHtml);
+}
+}
+#endif // ~HTMLTAG_TAG_MATCHER_H
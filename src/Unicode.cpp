@@ -6,151 +6,139 @@
   Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
   Original Pascal unit (c) Martijn Coppoolse <https://github.com/vor0nwe>
 */
-#include <iomanip>
 #include "TextConv.h"
+#include "HtmlTag.h"
 #include "Unicode.h"
+#include "SlicedReplacement.h"
 
 using namespace HtmlTag;
 
 /////////////////////////////////////////////////////////////////////////////////////////
 namespace {
-int doEncode(std::wstring &text, bool multiSel);
 int doEncode(SciTextRange &range);
+int doDecode(SciTextRange &target);
+void getPrefix(std::string &prefix);
+void getPrefix(std::wstring &prefix);
 }
 
 // --------------------------------------------------------------------------------------
 // HtmlTag::Unicode
 // --------------------------------------------------------------------------------------
 void Unicode::encode(EntityReplacementScope scope) {
+	SpanTrace::Span span{ "Unicode::encode", "replace" };
 	switch (scope) {
 		case EntityReplacementScope::ersDocument: {
+			if (SlicedReplacement::start(doEncode, {}))
+				break;
 			SciActiveDocument doc = plugin.editor().activeDocument();
+			if (!plugin.confirmCopy(doc.length()))
+				break;
 			SciTextRange range = doc.getRange(0, doc.length());
 			doEncode(range);
 			range.clearSelection();
 			break;
 		}
 		case EntityReplacementScope::ersAllDocuments: {
-			for (size_t docIndex = 0; docIndex < plugin.editor().getViews().size(); docIndex++) {
-				SciActiveDocument doc = plugin.editor().getViews()[docIndex];
+			plugin.forEachBuffer([](SciActiveDocument &doc, uintptr_t /*bufferId*/) {
+				if (!plugin.confirmCopy(doc.length()))
+					return;
 				SciTextRange range = doc.getRange(0, doc.length());
 				doEncode(range);
 				range.clearSelection();
-			}
+			});
 			break;
 		}
 		default: { // ersSelection
 			SciActiveDocument doc = plugin.editor().activeDocument();
-			std::wstring targetText{ doc.currentSelection().text() };
-			bool multiSel = (doc.getSelectionMode() != smStreamSingle);
-			if (doEncode(targetText, multiSel) > 0) {
-				doc.currentSelection() = &targetText[0];
-				doc.currentSelection().clearSelection();
-			}
+			// Encoding a rectangular or multiple selection would scramble it
+			if (doc.getSelectionMode() == smStreamSingle && plugin.confirmCopy(doc.currentSelection().length()))
+				doEncode(doc.currentSelection());
 			break;
 		}
 	}
 }
 // --------------------------------------------------------------------------------------
-int Unicode::decode() {
+int Unicode::decode(EntityReplacementScope scope) {
+	SpanTrace::Span span{ "Unicode::decode", "replace" };
 	int result = 0;
-	SciActiveDocument doc = plugin.editor().activeDocument();
-
-	if (doc.getSelectionMode() != smStreamSingle)
-		return result;
-
-	size_t lenPrefix = plugin.options.unicodePrefix.size();
-	std::wstring pattern(plugin.options.unicodeRE.size() + 1, L'\0');
-	TextConv::bytesToText(plugin.options.unicodeRE.c_str(), pattern, CP_ACP);
-	SciTextRange target(doc, doc.currentSelection().startPos(), doc.currentSelection().endPos());
-	SciTextRange match{ doc };
-	wchar_t mbCharBuf[3]{};
-
-	doc.sendMessage(SCI_BEGINUNDOACTION);
-	try {
-		do {
-			doc.find(&pattern[0], match, SCFIND_REGEXP, target.startPos(), target.endPos());
-			if (match.length() != 0) {
-				// Adjust the target already
-				target.startPos(match.startPos() + 1);
-
-				// Check if code point belongs to a multi-byte glyph
-				int head, tail;
-				head = std::stoi(match.text().substr(lenPrefix, 6), nullptr, 16);
-				if (head >= 0x010000 && head <= 0x10FFFF) {
-					tail = ((head - 0x10000) & 0x03FF) + 0xDC00;
-					head = ((head - 0x10000) >> 10) + 0xD800;
-					mbCharBuf[0] = static_cast<wchar_t>(head);
-					mbCharBuf[1] = static_cast<wchar_t>(tail);
-					match = &std::wstring(mbCharBuf)[0];
-				} else if (head >= 0xD800 && head <= 0xDBFF) {
-					SciTextRange matchNext{ doc };
-					doc.find(&pattern[0], matchNext, SCFIND_REGEXP, match.endPos() - lenPrefix,
-					    target.endPos());
-					if (matchNext.length() != 0) {
-						tail = std::stoi(matchNext.text().substr(lenPrefix, 4), nullptr, 16);
-						if (tail > 0 && tail < UINT_LEAST16_MAX) {
-							mbCharBuf[0] = static_cast<wchar_t>(head);
-							mbCharBuf[1] = static_cast<wchar_t>(tail);
-							matchNext = L"";
-							match = &std::wstring(mbCharBuf)[0];
 
-							if (result < 1)
-								doc.currentSelection().startPos(match.startPos());
-						}
-					}
-				} else {
-					mbCharBuf[0] = static_cast<wchar_t>(head);
-					mbCharBuf[1] = 0;
-					match = &std::wstring(mbCharBuf)[0];
+	switch (scope) {
+		case EntityReplacementScope::ersDocument: {
+			std::string prefix;
+			getPrefix(prefix);
+			SliceCuts::Tokens escapes{ prefix.substr(0, 1),
+				[prefix](std::string_view text, size_t cut) { return Unicode::splitsEscape(text, cut, prefix); } };
+			if (SlicedReplacement::start(doDecode, escapes))
+				break;
+			SciActiveDocument doc = plugin.editor().activeDocument();
+			if (!plugin.confirmCopy(doc.length()))
+				break;
+			SciTextRange range = doc.getRange(0, doc.length());
+			result = doDecode(range);
+			break;
+		}
+		case EntityReplacementScope::ersAllDocuments: {
+			plugin.forEachBuffer([&result](SciActiveDocument &doc, uintptr_t /*bufferId*/) {
+				if (!plugin.confirmCopy(doc.length()))
+					return;
+				SciTextRange range = doc.getRange(0, doc.length());
+				result += doDecode(range);
+			});
+			break;
+		}
+		default: { // ersSelection
+			SciActiveDocument doc = plugin.editor().activeDocument();
+			if (doc.getSelectionMode() == smStreamSingle) {
+				SciSelection &selection = doc.currentSelection();
+				if (!plugin.confirmCopy(selection.length()))
+					break;
+				result = doDecode(selection);
+				if (result > 0)
+					selection.clearSelection();
+			} else {
+				// Work back to front so the positions of earlier selections stay valid
+				std::vector<SciTextRange> ranges = doc.getSelections();
+				SciBulkEdit bulkEdit{ doc };
+				for (auto range = ranges.rbegin(); range != ranges.rend(); ++range) {
+					if (*range)
+						result += doDecode(*range);
 				}
-
-				if (result < 1)
-					doc.currentSelection().startPos(match.startPos());
-
-				++result;
 			}
-		} while (match.length() != 0);
-	} catch (...) {
+			break;
+		}
 	}
-	doc.sendMessage(SCI_ENDUNDOACTION);
-
-	if (result > 0)
-		doc.currentSelection().clearSelection();
 
 	return result;
 }
 
 /////////////////////////////////////////////////////////////////////////////////////////
 namespace {
-int doEncode(std::wstring &text, bool multiSel) {
-	int result = 0;
-	if (multiSel)
-		return result;
-
-	std::wstring prefix(plugin.options.unicodePrefix.size() + 1, L'\0');
-	TextConv::bytesToText(plugin.options.unicodePrefix.c_str(), prefix, CP_ACP);
-
-	for (intptr_t chIndex = text.length() - 1; chIndex >= 0; chIndex--) {
-		const std::wint_t charCode = text[chIndex];
-		if (charCode > 127) {
-			std::wstringstream encoded;
-			encoded << text.substr(0, chIndex) << prefix << std::uppercase << std::hex << std::setw(4)
-				<< std::setfill(L'0') << charCode << text.substr(chIndex + 1);
-			text = encoded.str();
-			++result;
-		}
-	}
-	return result;
-}
-// --------------------------------------------------------------------------------------
 int doEncode(SciTextRange &range) {
-	std::wstring targetText{ range.text() };
-	int result = doEncode(targetText, false);
-	if (result > 0) {
-		range = &targetText[0];
+	int result = range.transformText([](auto &text) {
+		std::remove_reference_t<decltype(text)> prefix;
+		getPrefix(prefix);
+		return Unicode::encodeText(text, prefix);
+	});
+	if (result > 0)
 		range.clearSelection();
-	}
 	return result;
 }
+// --------------------------------------------------------------------------------------
+int doDecode(SciTextRange &target) {
+	return target.transformText([](auto &text) {
+		std::remove_reference_t<decltype(text)> prefix;
+		getPrefix(prefix);
+		return Unicode::decodeText(text, prefix);
+	});
+}
+// --------------------------------------------------------------------------------------
+void getPrefix(std::wstring &prefix) {
+	TextConv::bytesToText(plugin.options.unicodePrefix.c_str(), prefix, CP_ACP);
+}
+// --------------------------------------------------------------------------------------
+void getPrefix(std::string &prefix) {
+	std::wstring widePrefix;
+	getPrefix(widePrefix);
+	TextConv::textToBytes(widePrefix.c_str(), prefix, CP_UTF8);
+}
 }
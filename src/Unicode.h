@@ -8,12 +8,23 @@
 #ifndef HTMLTAG_UNICODE_H
 #define HTMLTAG_UNICODE_H
 
-#include "HtmlTag.h"
+#include "Entities.h"
 
 namespace HtmlTag {
 namespace Unicode {
-	int decode();
-	void encode(EntityReplacementScope scope = ersSelection);
+	int decode(Entities::EntityReplacementScope scope = Entities::ersSelection);
+	void encode(Entities::EntityReplacementScope scope = Entities::ersSelection);
+
+	/// @brief Replaces every non-ASCII character in @p text with @p prefix and its hex code.
+	/// @return The number of escapes written
+	int encodeText(std::string &text, std::string const &prefix);
+	int encodeText(std::wstring &text, std::wstring const &prefix);
+	/// @brief Replaces each @p prefix followed by 4 to 6 hex digits in @p text with the character it stands for.
+	/// @return The number of replacements made
+	int decodeText(std::string &text, std::string const &prefix);
+	int decodeText(std::wstring &text, std::wstring const &prefix);
+	/// @return @c true if @p cut in @p text falls between the escapes for the two halves of a surrogate pair
+	bool splitsEscape(std::string_view text, size_t cut, std::string const &prefix);
 }
 }
 #endif // ~HTMLTAG_UNICODE_H
@@ -0,0 +1,1619 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <locale>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "AllocationStats.h"
+#include "SciMemoryDocument.h"
+#include "Entities.h"
+#include "LargeFiles.h"
+#include "SliceCuts.h"
+#include "TagBalance.h"
+#include "TagLexer.h"
+#include "TagMatcher.h"
+#include "TextCompare.h"
+#include "Unicode.h"
+#include "Utf8.h"
+
+#ifndef HTMLTAG_ENTITIES_INI
+#define HTMLTAG_ENTITIES_INI "HTMLTag-entities.ini"
+#endif
+
+using namespace HtmlTag;
+using namespace SciTextObjects;
+namespace fs = std::filesystem;
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+struct Corpus {
+	std::string name;
+	std::string text;
+};
+
+struct Timing {
+	std::string scenario;
+	std::string corpus;
+	std::string param;
+	long long paramValue;
+	size_t bytes;
+	int count;
+	std::vector<double> samplesMs;
+	AllocationStats::Usage memory;
+	/// Whether the scenario transforms the whole document, and so counts towards @c BenchOptions::maxPeakRatio
+	bool wholeDocument;
+};
+
+struct Latency {
+	std::string scenario;
+	std::string corpus;
+	std::vector<double> samplesUs;
+};
+
+/// An opening tag and its partner
+struct TagPair {
+	Sci_Position open;
+	Sci_Position close;
+};
+
+/// A page or template written the way real ones are, with every element closed
+struct PageTemplate {
+	const char *name;
+	/// Whether it needs braces tracked
+	bool braced;
+	const char *text;
+};
+
+struct BenchOptions {
+	std::string entitiesIni = HTMLTAG_ENTITIES_INI;
+	std::string outFile;
+	/// Real pages to match tags in, from the files under this directory, if given
+	std::string pagesDir;
+	int scale = 1;
+	int iterations = 5;
+	/// Fails the run when a whole-document transform peaks above this many times the document's size
+	double maxPeakRatio = 0;
+	/// Fails the run when checking tag balance, at its best, reads fewer MiB a second than this
+	double minBalanceMbPerSec = 0;
+	/// The plugin's large-file thresholds, from the options.ini given by @c --options, or the defaults
+	LargeFileThresholds thresholds = defaultLargeFileThresholds;
+};
+
+/// A fixed-seed xorshift generator, so every run sees the same corpora
+class Random {
+public:
+	explicit Random(uint64_t seed) noexcept : _state(seed) {}
+	uint64_t next() noexcept {
+		_state ^= _state << 13;
+		_state ^= _state >> 7;
+		_state ^= _state << 17;
+		return _state;
+	}
+	size_t below(size_t bound) noexcept { return static_cast<size_t>(next() % bound); }
+
+private:
+	uint64_t _state;
+};
+
+/// @c HashedStringList as it was, over @c std::unordered_map, for comparison
+struct MapStringList {
+	std::string const &operator[](std::string const &key) const {
+		auto it = _strings.find(key);
+		return (it != _strings.end() ? it->second : _empty);
+	}
+	std::string &addPair(std::string const &key, std::string const &val) { return _strings[key] = val; }
+
+	std::unordered_map<std::string, std::string> _strings;
+	std::string _empty{};
+};
+
+/// The plugin's message transports, less the Win32 API: every message goes through a virtual @c send
+class Transport {
+public:
+	virtual ~Transport() = default;
+	virtual sptr_t send(unsigned msg, uptr_t wParam, sptr_t lParam) = 0;
+};
+
+/// As @c SciDirectTransport, calling a function with an instance pointer, after checking the thread
+class DirectTransport final : public Transport {
+public:
+	DirectTransport(SciFnDirectStatus fnStatus, sptr_t ptr) noexcept
+	    : _fnStatus(fnStatus), _ptr(ptr), _ownerThread(std::this_thread::get_id()) {}
+	sptr_t send(unsigned msg, uptr_t wParam, sptr_t lParam) override {
+		if (std::this_thread::get_id() != _ownerThread)
+			return 0;
+		return _fnStatus(_ptr, msg, wParam, lParam, &_status);
+	}
+
+private:
+	SciFnDirectStatus _fnStatus;
+	sptr_t _ptr;
+	std::thread::id _ownerThread;
+	int _status = 0;
+};
+
+/// As @c SciCallbackTransport
+class CallbackTransport final : public Transport {
+public:
+	using Callback = std::function<sptr_t(unsigned, uptr_t, sptr_t)>;
+	explicit CallbackTransport(Callback callback) : _callback(std::move(callback)) {}
+	sptr_t send(unsigned msg, uptr_t wParam, sptr_t lParam) override { return _callback(msg, wParam, lParam); }
+
+private:
+	Callback _callback;
+};
+
+Corpus flatHtml(int scale);
+Corpus deepDom(int depth);
+Corpus minifiedPage(int scale);
+Corpus entityXml(int scale);
+Corpus sizedHtml(Sci_Position bytes);
+Corpus hugeAttribute(Sci_Position bytes);
+Corpus trickyMarkup(int scale, bool braced, std::vector<TagPair> &pairs);
+Corpus misnestedMarkup(int scale);
+Corpus templatePages(PageTemplate const &page, int scale);
+std::vector<std::pair<Corpus, TagLexer::TagSyntax>> loadPages(std::string const &dir);
+std::string surrogateEscapes(size_t length, Random &rng);
+std::string surrogateReferences(size_t length, Random &rng);
+std::string mixedText(size_t length, int nonAsciiPercent, Random &rng);
+std::vector<Entities::EntityList::Pair_T> loadEntityPairs(std::string const &iniFile, const char *section);
+Entities::EntityList loadEntities(std::vector<Entities::EntityList::Pair_T> pairs);
+int fuzzTranscoding(int cases, Random &rng);
+bool decodeStrictly(std::string const &text, std::u32string &codePoints);
+Timing timeIt(BenchOptions const &options, std::function<int()> const &setUp, std::function<int()> const &run);
+TagSource documentSource(SciMemoryDocument &doc);
+Sci_Position findMatchingTag(SciMemoryDocument &doc, Sci_Position caret, Sci_Position window = 0,
+    TagLexer::TagSyntax syntax = TagLexer::tsHtml);
+int lexTags(SciMemoryDocument &doc, TagLexer::TagSyntax syntax, bool quoteAware);
+int matchRoundTrips(SciMemoryDocument &doc, TagLexer::TagSyntax syntax, int &openTags);
+Sci_Position tagOpening(std::string const &text, const char *needle, size_t nth);
+std::string textRange(SciMemoryDocument &doc, Sci_Position start, Sci_Position end);
+int transformDocument(SciMemoryDocument &doc, std::function<int(std::string &)> const &transform);
+int transformSliced(SciMemoryDocument &doc, Sci_Position sliceBytes, SliceCuts::Tokens const &tokens,
+    std::function<int(std::string &)> const &transform);
+int decodeEachReference(SciMemoryDocument &doc, Entities::EntityList const &entities, int eventMask);
+template <typename Str_T>
+bool sameTextLocale(Str_T lhs, Str_T rhs);
+sptr_t directStatus(sptr_t ptr, unsigned msg, uptr_t wParam, sptr_t lParam, int *status);
+Latency typeAndDecode(SciMemoryDocument &doc, std::string const &input, char trigger,
+    std::function<int(std::string &)> const &decoder);
+double percentile(std::vector<double> samples, double fraction);
+bool loadThresholds(std::string const &iniFile, LargeFileThresholds &thresholds);
+void writeJson(std::FILE *out, BenchOptions const &options, std::vector<Corpus> const &corpora,
+    std::vector<Timing> const &timings, std::vector<Latency> const &latencies);
+bool checkPeaks(BenchOptions const &options, std::vector<Timing> const &timings);
+bool checkBalanceThroughput(BenchOptions const &options, std::vector<Timing> const &timings);
+bool parseArgs(int argc, char **argv, BenchOptions &options);
+
+constexpr char unicodePrefix[] = "\\u";
+/// Each line of the misnested corpus has this many unbalanced tags: a misnested <i>, and the stray </i> after it
+constexpr int misnestedPerLine = 2;
+
+/// Markup, as found in real pages and templates, that trips up a search for the next '<' or '>'.
+/// Each case is a <div> whose partner is the </div> it ends with
+constexpr const char *trickyCases[] = {
+	R"(<div><a title="x > y" href="#">link</a></div>)",
+	R"(<div><img alt='1 < 2 > 0' src="a.png"></div>)",
+	R"(<div><!-- <div> commented out </div> --></div>)",
+	R"(<div><![CDATA[ if (a < b && c > d) ]]></div>)",
+	R"(<div><?php if ($a > $b) echo "</div>"; ?></div>)",
+	R"(<div><% if (a > b) { %><b>x</b><% } %></div>)",
+	R"(<div><input value="</div>" placeholder='a>b'></div>)",
+	R"(<div data-state='{"html":"<b>bold</b>"}'><span>s</span></div>)",
+	R"(<div><img src="data:image/svg+xml;utf8,<svg xmlns='http://www.w3.org/2000/svg'><rect width='1'/></svg>"></div>)",
+	R"(<div><p title=don't>it's</p></div>)",
+	R"(<div>a < b, c > d, x<3</div>)",
+	R"(<div><a title="a<b" href='c>d'>q</a></div>)",
+	R"(<div><div class="a>b"><div title='</div>'></div></div></div>)",
+};
+/// Razor and JSX, which need braces tracked
+constexpr const char *bracedCases[] = {
+	R"(<div><div onClick={() => a > b ? "</div>" : "x"}>go</div></div>)",
+	R"(<div><Item render={(x) => <b>{x}</b>} key={`k>${i}`} /></div>)",
+	R"(<div><span class=@{ Css(a > b) }>r</span></div>)",
+};
+/// A theme's PHP, a Razor view, a React component, a Jinja template with Alpine.js attributes, and a page from the
+/// days of upper-case tags
+constexpr PageTemplate pageTemplates[] = {
+	{ "wordpress_theme", false, R"html(<!DOCTYPE html>
+<html <?php language_attributes(); ?>>
+<head>
+<meta charset="<?php bloginfo('charset'); ?>">
+<meta name="viewport" content="width=device-width, initial-scale=1">
+<title><?php wp_title('|', true, 'right'); ?></title>
+<link rel="stylesheet" href="<?= get_stylesheet_uri() ?>">
+<?php wp_head(); ?>
+</head>
+<body <?php body_class(); ?>>
+<header class="site-header">
+<nav class="main-nav" aria-label="<?php esc_attr_e('Primary', 'theme'); ?>">
+<ul>
+<?php foreach ($menu->items as $item) : ?>
+<li class="<?= $item->current ? 'current' : '' ?>"><a href="<?= esc_url($item->url) ?>"><?= $item->title ?></a></li>
+<?php endforeach; ?>
+</ul>
+</nav>
+</header>
+<main id="content">
+<?php if (have_posts()) : while (have_posts()) : the_post(); ?>
+<article id="post-<?php the_ID(); ?>" <?php post_class(); ?>>
+<h2><a href="<?php the_permalink(); ?>"><?php the_title(); ?></a></h2>
+<div class="entry-meta"><time datetime="<?= get_the_date('c') ?>"><?= get_the_date() ?></time></div>
+<div class="entry"><?php the_excerpt(); ?></div>
+<?php if ($post->comment_count > 0) : ?><p class="comments"><?php comments_number(); ?></p><?php endif; ?>
+</article>
+<?php endwhile; endif; ?>
+</main>
+<footer><p>&copy; <?= date('Y') ?> <?php bloginfo('name'); ?></p></footer>
+<?php wp_footer(); ?>
+</body>
+</html>
+)html" },
+	{ "razor_view", true, R"html(@{
+    ViewData["Title"] = "Products";
+}
+<div class="container">
+<h1>@ViewData["Title"]</h1>
+<table class="table">
+<thead><tr><th>Name</th><th>Price</th><th></th></tr></thead>
+<tbody>
+@foreach (var item in Model) {
+<tr class="@(item.Stock > 0 ? "in-stock" : "sold-out")">
+<td>@Html.DisplayFor(m => item.Name)</td>
+<td>@item.Price.ToString("C")</td>
+<td><a asp-action="Edit" asp-route-id="@item.Id">Edit</a> | <a asp-action="Details" asp-route-id="@item.Id">Details</a></td>
+</tr>
+}
+</tbody>
+</table>
+@if (Model.Count() > 10) {
+<nav><ul class="pagination"><li class="page-item"><a class="page-link" href="?page=2">Next</a></li></ul></nav>
+}
+<form asp-action="Search" method="get"><input name="q" value="@ViewBag.Query" /><button type="submit">Search</button></form>
+<span class=@{ Css(Model.Count() > 0) }>@Model.Count() products</span>
+</div>
+)html" },
+	{ "react_component", true, R"html(export default function TodoList({ items, onToggle }) {
+  const [filter, setFilter] = useState('all');
+  const visible = items.filter((item) => filter === 'all' || (filter === 'done') === item.done);
+  return (
+    <section className="todo-list">
+      <header>
+        <h2>{visible.length > 0 ? `${visible.length} to do` : 'Nothing to do'}</h2>
+        <select value={filter} onChange={(e) => setFilter(e.target.value)}>
+          <option value="all">All</option>
+          <option value="done">Done</option>
+        </select>
+      </header>
+      <ul>
+        {visible.map((item) => (
+          <li key={item.id} className={item.done ? 'done' : undefined}>
+            <label>
+              <input type="checkbox" checked={item.done} onChange={() => onToggle(item.id)} />
+              <span title={`${item.text} > ${item.due}`}>{item.text}</span>
+            </label>
+          </li>
+        ))}
+      </ul>
+      {items.length > 100 && <p className="hint">Only the first 100 are shown</p>}
+    </section>
+  );
+}
+)html" },
+	{ "jinja_template", false, R"html({% extends "base.html" %}
+{% block content %}
+<!--[if lt IE 9]><p class="browserupgrade">Please upgrade your browser</p><![endif]-->
+<div class="product" x-data="{ open: false, qty: 1 }" @keydown.escape="open = false">
+<script type="application/ld+json">{"@context":"https://schema.org","@type":"Product","name":"{{ product.name }}"}</script>
+<h1 class="title">{{ product.name|title }}</h1>
+<div class="gallery">
+{% for image in product.images %}
+<figure><img src="{{ image.url }}" alt="{{ image.alt|default('') }}" loading="lazy"><figcaption>{{ image.caption }}</figcaption></figure>
+{% endfor %}
+</div>
+<button type="button" :class="{ 'active': qty > 1 }" @click="open = !open" :aria-expanded="open">
+<svg class="icon" viewBox="0 0 24 24" aria-hidden="true"><path d="M7 10l5 5 5-5z"/><circle cx="12" cy="12" r="10" fill="none"/></svg>
+<span>Options</span>
+</button>
+<div class="options" x-show="open" x-transition>
+<label for="qty">Quantity</label>
+<input id="qty" type="number" min="1" x-model.number="qty">
+{% if product.stock > 0 and qty <= product.stock %}
+<p class="stock">In stock<wbr>, ships today</p>
+{% else %}
+<p class="stock out">Out of stock</p>
+{% endif %}
+</div>
+<template x-if="qty > 5"><p class="bulk">Bulk discount applied</p></template>
+<div class="description">{{ product.description|safe }}</div>
+</div>
+{% endblock %}
+)html" },
+	{ "legacy_page", false, R"html(<HTML>
+<HEAD><TITLE>Welcome</TITLE>
+<META HTTP-EQUIV="Content-Type" CONTENT="text/html; charset=iso-8859-1">
+</HEAD>
+<BODY BGCOLOR=#FFFFFF onLoad="if (document.images.length > 0) preload();">
+<CENTER><FONT FACE="Verdana, Arial" SIZE=2>
+<!-- <TABLE> kept for old browsers --><TABLE WIDTH=600 BORDER=0 CELLPADDING=4>
+<TR><TD ALIGN=left><A HREF="index.html" onMouseOver="window.status='Home > Start'; return true">Home</A></TD>
+<TD ALIGN=right><IMG SRC="logo.gif" WIDTH=120 HEIGHT=40 ALT="Logo"></TD></TR>
+<TR><TD COLSPAN=2><P>Best viewed at 800x600<BR>with Netscape &gt; 4</P></TD></TR>
+</TABLE>
+</FONT></CENTER>
+<Div Class=footer><A HREF="mailto:webmaster@example.com">Webmaster</a></div>
+</BODY>
+</HTML>
+)html" },
+};
+}
+
+int main(int argc, char **argv) {
+	BenchOptions options;
+	if (!parseArgs(argc, argv, options))
+		return EXIT_FAILURE;
+
+	const std::vector<Entities::EntityList::Pair_T> htmlPairs = loadEntityPairs(options.entitiesIni, "HTML 5");
+	const Entities::EntityList html = loadEntities(htmlPairs);
+	const Entities::EntityList xml = loadEntities(loadEntityPairs(options.entitiesIni, "XML"));
+	if (!html || !xml) {
+		std::fprintf(stderr, "No entities found in %s\n", options.entitiesIni.c_str());
+		return EXIT_FAILURE;
+	}
+
+	const int deepest = 400 * options.scale;
+	const std::vector<Corpus> corpora{ flatHtml(options.scale), deepDom(deepest), minifiedPage(options.scale),
+		entityXml(options.scale) };
+	std::vector<Timing> timings;
+	std::vector<Latency> latencies;
+	SciMemoryDocument doc;
+
+	// Find the matching tag, from an opening tag with a given number of levels, or bytes, between it and its partner
+	auto matchFrom = [&](Corpus const &corpus, const char *needle, size_t nth, const char *param, long long value) {
+		const Sci_Position caret = tagOpening(corpus.text, needle, nth);
+		Timing timing = timeIt(
+		    options, [&] { doc.setText(corpus.text); return 0; },
+		    [&] { return findMatchingTag(doc, caret) >= 0 ? 1 : 0; });
+		timing.scenario = "find_matching_tag";
+		timing.corpus = corpus.name;
+		timing.param = param;
+		// Only the text between the tags is scanned
+		const auto distance = static_cast<long long>(findMatchingTag(doc, caret) - caret);
+		timing.paramValue = (value < 0) ? distance : value;
+		timing.bytes = static_cast<size_t>((std::max)(0LL, distance));
+		timings.push_back(std::move(timing));
+	};
+	for (int levels : { 1, deepest / 8, deepest / 2, deepest }) {
+		matchFrom(corpora[1], "<div", static_cast<size_t>(deepest - levels), "nesting_depth", levels);
+	}
+	matchFrom(corpora[0], "<section", 1000 * static_cast<size_t>(options.scale), "distance_bytes", -1);
+	matchFrom(corpora[0], "<body", 0, "distance_bytes", -1);
+	matchFrom(corpora[2], "<div", 1500 * static_cast<size_t>(options.scale), "distance_bytes", -1);
+	matchFrom(corpora[2], "<body", 0, "distance_bytes", -1);
+
+	// Read a tag whose attribute holds megabytes of inline SVG, then find the paragraph around it;
+	// copying the whole tag, as tag matching once did, is timed for comparison
+	for (Sci_Position bytes : { 0x400, 0x100000, 0xA00000 }) {
+		const Corpus corpus = hugeAttribute(bytes);
+		const Sci_Position start = tagOpening(corpus.text, "<img", 0);
+		TagLexer::Tag tag{};
+		auto attributeTiming = [&](Timing timing, const char *scenario, Sci_Position scanned) {
+			timing.scenario = scenario;
+			timing.corpus = corpus.name;
+			timing.param = "attribute_bytes";
+			timing.paramValue = static_cast<long long>(bytes);
+			timing.bytes = static_cast<size_t>(scanned);
+			timings.push_back(std::move(timing));
+		};
+		// Every iteration sets the same text, so the source stays valid
+		doc.setText(corpus.text);
+		const TagSource source = documentSource(doc);
+		TagLexer::readTag(source, start, -1, tag);
+		const Sci_Position tagLength = tag.endPos - start;
+
+		attributeTiming(timeIt(
+				    options, [&] { doc.setText(corpus.text); return 0; },
+				    [&] { return TagLexer::readTag(source, start, -1, tag) && tag.name == "img" ? 1 : 0; }),
+		    "read_tag", tagLength);
+		attributeTiming(timeIt(
+				    options, [&] { doc.setText(corpus.text); return 0; },
+				    [&] {
+					    std::string text(static_cast<size_t>(tagLength) + 1, '\0');
+					    Sci_TextRangeFull tr{ { start, start + tagLength }, &text[0] };
+					    text.resize(static_cast<size_t>(
+						doc.send(SCI_GETTEXTRANGEFULL, 0, reinterpret_cast<sptr_t>(&tr))));
+					    return text.compare(1, 3, "img") == 0 ? 1 : 0;
+				    }),
+		    "read_tag_copy", tagLength);
+		attributeTiming(timeIt(
+				    options, [&] { doc.setText(corpus.text); return 0; },
+				    [&] { return findMatchingTag(doc, 0) >= 0 ? 1 : 0; }),
+		    "find_matching_tag", static_cast<Sci_Position>(corpus.text.size()));
+	}
+
+	// Match every tag pair in the tricky markup, both ways; a tag pair matched wrongly fails the run.
+	// Then read every tag in the plain corpora, with and without braces tracked, and as they were read before
+	// quotes were tracked, for comparison
+	bool allMatched = true;
+	for (bool braced : { false, true }) {
+		std::vector<TagPair> pairs;
+		const Corpus corpus = trickyMarkup(options.scale, braced, pairs);
+		const TagLexer::TagSyntax syntax = braced ? TagLexer::tsBraces : TagLexer::tsHtml;
+		for (bool forward : { true, false }) {
+			Timing timing = timeIt(
+			    options, [&] { doc.setText(corpus.text); return 0; },
+			    [&] {
+				    int matched = 0;
+				    for (TagPair const &pair : pairs) {
+					    matched += forward ? (findMatchingTag(doc, pair.open, 0, syntax) == pair.close)
+							       : (findMatchingTag(doc, pair.close, 0, syntax) == pair.open);
+				    }
+				    return matched;
+			    });
+			timing.scenario = forward ? "find_matching_tag" : "find_opening_tag";
+			timing.corpus = corpus.name;
+			timing.param = "braces";
+			timing.paramValue = braced ? 1 : 0;
+			timing.bytes = corpus.text.size();
+			if (timing.count != static_cast<int>(pairs.size())) {
+				std::fprintf(stderr, "%s matched %d of %zu tag pairs in %s\n", timing.scenario.c_str(), timing.count,
+				    pairs.size(), corpus.name.c_str());
+				allMatched = false;
+			}
+			timings.push_back(std::move(timing));
+		}
+	}
+
+	// Match every opening tag in the pages and templates forwards, then back again from its partner. Every
+	// element in the templates is closed, so a tag that doesn't come back fails the run; pages read with --pages
+	// are only reported, as a real page may well leave a <p> or <li> open
+	auto roundTrips = [&](Corpus const &corpus, TagLexer::TagSyntax syntax, bool mustMatch) {
+		int openTags = 0;
+		Timing timing = timeIt(
+		    options, [&] { doc.setText(corpus.text); return 0; },
+		    [&] { return matchRoundTrips(doc, syntax, openTags); });
+		timing.scenario = "match_round_trip";
+		timing.corpus = corpus.name;
+		timing.param = "open_tags";
+		timing.paramValue = openTags;
+		timing.bytes = corpus.text.size();
+		if (timing.count != openTags) {
+			std::fprintf(stderr, "%d of %d opening tags in %s came back from their partners\n", timing.count,
+			    openTags, corpus.name.c_str());
+			allMatched = allMatched && !mustMatch;
+		}
+		timings.push_back(std::move(timing));
+	};
+	for (PageTemplate const &page : pageTemplates)
+		roundTrips(templatePages(page, options.scale), page.braced ? TagLexer::tsBraces : TagLexer::tsHtml, true);
+	if (!options.pagesDir.empty()) {
+		for (auto &&page : loadPages(options.pagesDir))
+			roundTrips(page.first, page.second, false);
+	}
+
+	for (Corpus const *corpus : { &corpora[0], &corpora[2] }) {
+		const std::pair<const char *, std::pair<TagLexer::TagSyntax, bool>> lexers[] = {
+			{ "lex_tags", { TagLexer::tsHtml, true } },
+			{ "lex_tags", { TagLexer::tsBraces, true } },
+			{ "lex_tags_unquoted", { TagLexer::tsHtml, false } },
+		};
+		for (auto &&lexer : lexers) {
+			const TagLexer::TagSyntax syntax = lexer.second.first;
+			const bool quoteAware = lexer.second.second;
+			Timing timing = timeIt(
+			    options, [&] { doc.setText(corpus->text); return 0; },
+			    [&] { return lexTags(doc, syntax, quoteAware); });
+			timing.scenario = lexer.first;
+			timing.corpus = corpus->name;
+			timing.param = "braces";
+			timing.paramValue = syntax;
+			timing.bytes = corpus->text.size();
+			timings.push_back(std::move(timing));
+		}
+	}
+
+	// Check the balance of every tag in one pass, in the corpora and a page as long as large-file mode starts at,
+	// then in one whose every line is misnested; a wrong count of unbalanced tags fails the run
+	{
+		std::vector<TagPair> pairs;
+		const Corpus tricky = trickyMarkup(options.scale, false, pairs);
+		const Corpus sized = sizedHtml(defaultLargeFileThresholds.minBytes * options.scale);
+		const Corpus misnested = misnestedMarkup(options.scale);
+		const std::pair<Corpus const *, int> balanceCases[] = {
+			{ &corpora[0], 0 },
+			{ &corpora[1], 0 },
+			{ &corpora[2], 0 },
+			{ &corpora[3], 0 },
+			{ &tricky, 0 },
+			{ &sized, 0 },
+			{ &misnested, misnestedPerLine * 1000 * options.scale },
+		};
+		for (auto &&balanceCase : balanceCases) {
+			Corpus const &corpus = *balanceCase.first;
+			const TagBalance::Dialect dialect = (&corpus == &corpora[3]) ? TagBalance::dlXml : TagBalance::dlHtml;
+			Timing timing = timeIt(
+			    options, [&] { doc.setText(corpus.text); return 0; },
+			    [&] {
+				    const TagBalance::Report report = TagBalance::check(documentSource(doc), dialect);
+				    return static_cast<int>(report.problems.size() + report.unreported);
+			    });
+			timing.scenario = "check_tag_balance";
+			timing.corpus = corpus.name;
+			timing.param = "xml";
+			timing.paramValue = dialect;
+			timing.bytes = corpus.text.size();
+			if (timing.count != balanceCase.second) {
+				std::fprintf(stderr, "check_tag_balance found %d unbalanced tags in %s, not %d\n", timing.count,
+				    corpus.name.c_str(), balanceCase.second);
+				allMatched = false;
+			}
+			timings.push_back(std::move(timing));
+		}
+	}
+
+	// Encode and decode text with a growing share of non-ASCII characters
+	for (int density : { 0, 1, 10, 50 }) {
+		Random rng{ 0x5EED0000ULL + static_cast<uint64_t>(density) };
+		const std::string plain = mixedText(256 * 1024 * static_cast<size_t>(options.scale), density, rng);
+		std::string entities = plain, escapes = plain;
+		Entities::encodeText(entities, html);
+		Unicode::encodeText(escapes, unicodePrefix);
+
+		const std::pair<const char *, std::pair<std::string const *, std::function<int(std::string &)>>> cases[] = {
+			{ "entity_encode", { &plain, [&](std::string &text) { return Entities::encodeText(text, html); } } },
+			{ "entity_decode", { &entities, [&](std::string &text) { return Entities::decodeText(text, html); } } },
+			{ "unicode_encode",
+			    { &plain, [&](std::string &text) { return Unicode::encodeText(text, unicodePrefix); } } },
+			{ "unicode_decode",
+			    { &escapes, [&](std::string &text) { return Unicode::decodeText(text, unicodePrefix); } } },
+		};
+		for (auto &&testCase : cases) {
+			std::string const &input = *testCase.second.first;
+			auto const &transform = testCase.second.second;
+			Timing timing = timeIt(
+			    options, [&] { doc.setText(input); return 0; }, [&] { return transformDocument(doc, transform); });
+			timing.scenario = testCase.first;
+			timing.corpus = "mixed_text";
+			timing.param = "non_ascii_percent";
+			timing.paramValue = density;
+			timing.bytes = input.size();
+			timing.wholeDocument = true;
+			timings.push_back(std::move(timing));
+		}
+	}
+
+	// Transcode between UTF-8 and wide text, as the text objects do for every read and write, at every share of
+	// non-ASCII characters; each rate is of the UTF-8 bytes, so both ways compare
+	for (int density : { 0, 10, 50, 100 }) {
+		Random rng{ 0x7C0DE000ULL + static_cast<uint64_t>(density) };
+		const std::string text = mixedText(4 * 1024 * 1024 * static_cast<size_t>(options.scale), density, rng);
+		std::wstring wide;
+		std::string bytes;
+		TextConv::Utf8::toWide(text.data(), text.size(), wide);
+		auto transcodeTiming = [&](Timing timing, const char *scenario) {
+			timing.scenario = scenario;
+			timing.corpus = "mixed_text";
+			timing.param = "non_ascii_percent";
+			timing.paramValue = density;
+			timing.bytes = text.size();
+			timings.push_back(std::move(timing));
+		};
+		std::wstring decoded;
+		transcodeTiming(timeIt(
+				    options, [] { return 0; },
+				    [&] { return TextConv::Utf8::toWide(text.data(), text.size(), decoded) ? 1 : 0; }),
+		    "utf8_to_wide");
+		transcodeTiming(timeIt(
+				    options, [] { return 0; },
+				    [&] { return TextConv::Utf8::fromWide(wide.data(), wide.size(), bytes) ? 1 : 0; }),
+		    "utf8_from_wide");
+	}
+	// Check the transcoder against a decoder that reads a byte at a time, on strings that are well-formed, and
+	// strings that aren't; any disagreement fails the run
+	{
+		const int cases = 200000 * options.scale;
+		Random rng{ 0xF022 };
+		Timing timing = timeIt(options, [] { return 0; }, [&] { return cases - fuzzTranscoding(cases, rng); });
+		timing.scenario = "utf8_round_trip_fuzz";
+		timing.corpus = "random_text";
+		timing.param = "cases";
+		timing.paramValue = cases;
+		timing.bytes = 0;
+		if (timing.count != cases) {
+			std::fprintf(stderr, "utf8_round_trip_fuzz failed %d of %d cases\n", cases - timing.count, cases);
+			allMatched = false;
+		}
+		timings.push_back(std::move(timing));
+	}
+	{
+		Corpus const &corpus = corpora[3];
+		Timing timing = timeIt(
+		    options, [&] { doc.setText(corpus.text); return 0; },
+		    [&] { return transformDocument(doc, [&](std::string &text) { return Entities::decodeText(text, xml); }); });
+		timing.scenario = "entity_decode";
+		timing.corpus = corpus.name;
+		timing.param = "non_ascii_percent";
+		timing.paramValue = 0;
+		timing.bytes = corpus.text.size();
+		timing.wholeDocument = true;
+		timings.push_back(std::move(timing));
+	}
+
+	// Decode a slice at a time, cut where large-file mode cuts them, in text dense with surrogate pairs and
+	// references that lack their semicolon; any difference from decoding in one pass fails the run
+	{
+		Random rng{ 0x511CE };
+		std::string escapes = mixedText(64 * 1024 * static_cast<size_t>(options.scale), 50, rng);
+		Unicode::encodeText(escapes, unicodePrefix);
+		const Corpus escaped[] = { { "surrogate_escapes", surrogateEscapes(64 * 1024, rng) },
+			{ "mixed_text", escapes } };
+		const Corpus referenced[] = { { "surrogate_references", surrogateReferences(64 * 1024, rng) } };
+		const std::string prefix = unicodePrefix;
+		auto decodeEscapes = [&](std::string &text) { return Unicode::decodeText(text, prefix); };
+		auto decodeReferences = [&](std::string &text) { return Entities::decodeText(text, html); };
+		const SliceCuts::Tokens escapeTokens{ prefix.substr(0, 1),
+			[&](std::string_view text, size_t cut) { return Unicode::splitsEscape(text, cut, prefix); } };
+		const SliceCuts::Tokens referenceTokens{ "&",
+			[&](std::string_view text, size_t cut) { return Entities::splitsReference(text, cut, html); } };
+
+		auto slicedDecode = [&](Corpus const &corpus, SliceCuts::Tokens const &tokens,
+					std::function<int(std::string &)> const &decode) {
+			std::string whole = corpus.text;
+			const int expected = decode(whole);
+			// A slice of 0 bytes is the whole document, in one pass
+			for (Sci_Position sliceBytes : { 61, 97, 4096, 0 }) {
+				Timing timing = timeIt(
+				    options, [&] { doc.setText(corpus.text); return 0; },
+				    [&] {
+					    return sliceBytes > 0 ? transformSliced(doc, sliceBytes, tokens, decode)
+								  : transformDocument(doc, decode);
+				    });
+				timing.scenario = "sliced_decode";
+				timing.corpus = corpus.name;
+				timing.param = "slice_bytes";
+				timing.paramValue = static_cast<long long>(sliceBytes);
+				timing.bytes = corpus.text.size();
+				if (timing.count != expected || textRange(doc, 0, doc.length()) != whole) {
+					std::fprintf(stderr, "sliced_decode made %d replacements in %s, %lld bytes at a time, not %d, "
+							     "or decoded differently\n",
+					    timing.count, corpus.name.c_str(), static_cast<long long>(sliceBytes), expected);
+					allMatched = false;
+				}
+				timings.push_back(std::move(timing));
+			}
+		};
+		for (Corpus const &corpus : escaped)
+			slicedDecode(corpus, escapeTokens, decodeEscapes);
+		for (Corpus const &corpus : referenced)
+			slicedDecode(corpus, referenceTokens, decodeReferences);
+	}
+
+	// Decode each reference with an edit of its own, as decoding many selections does: once with every SCN_MODIFIED
+	// notification sent, and once masked as SciBulkEdit masks them. The count is the notifications a listener got;
+	// in the editor, each of them would also go to Notepad++ and to every plugin
+	{
+		Corpus const &corpus = corpora[3];
+		std::string decoded = corpus.text;
+		Entities::decodeText(decoded, xml);
+		int notifications = 0;
+		doc.onNotify([&notifications](SCNotification const &) { ++notifications; });
+		for (bool bulkEdit : { false, true }) {
+			Timing timing = timeIt(
+			    options, [&] { doc.setText(corpus.text); notifications = 0; return 0; },
+			    [&] {
+				    decodeEachReference(doc, xml, bulkEdit ? SC_MOD_NONE : SC_MODEVENTMASKALL);
+				    return notifications;
+			    });
+			timing.scenario = "bulk_edit_notifications";
+			timing.corpus = corpus.name;
+			timing.param = "bulk_edit";
+			timing.paramValue = bulkEdit ? 1 : 0;
+			timing.bytes = corpus.text.size();
+			if (textRange(doc, 0, doc.length()) != decoded) {
+				std::fprintf(stderr, "bulk_edit_notifications decoded %s differently\n", corpus.name.c_str());
+				allMatched = false;
+			}
+			timings.push_back(std::move(timing));
+		}
+		doc.onNotify(nullptr);
+	}
+
+	// Compare tag names and file paths without regard to case, then as sameText did before, copying both strings
+	// and lowercasing them with the global locale, for comparison. The count is the pairs found the same; the
+	// locale only folds ASCII, so it finds fewer
+	{
+		const std::pair<std::string, std::string> names[] = { { "div", "DIV" }, { "textarea", "TextArea" },
+			{ "blockquote", "BLOCKQUOTE" }, { "span", "spam" }, { "figcaption", "FigCaption" },
+			{ "svg:foreignObject", "SVG:FOREIGNOBJECT" }, { "tbody", "thead" }, { "a", "A" } };
+		const std::pair<std::wstring, std::wstring> paths[] = {
+			{ L"C:\\Program Files\\Notepad++\\plugins\\Config\\HTMLTag\\HTMLTag_ru.ini",
+			    L"c:\\program files\\notepad++\\plugins\\config\\htmltag\\htmltag_ru.ini" },
+			{ L"D:\\\u041F\u0440\u043E\u0435\u043A\u0442\u044B\\index.html",
+			    L"d:\\\u041F\u0420\u041E\u0415\u041A\u0422\u042B\\INDEX.HTML" },
+			{ L"C:\\Users\\\u0396\u03C9\u03B7\\site\\index.htm",
+			    L"C:\\USERS\\\u0396\u03A9\u0397\\SITE\\INDEX.HTM" },
+			{ L"E:\\sites\\shop\\templates\\product.html", L"E:\\sites\\shop\\templates\\produce.html" } };
+		const int repeats = 20000 * options.scale;
+		auto compareAll = [&](auto const &pairs, auto const &same, const char *scenario, const char *corpus) {
+			size_t bytes = 0;
+			for (auto &&pair : pairs)
+				bytes += pair.first.size() * sizeof(pair.first[0]);
+			Timing timing = timeIt(
+			    options, [] { return 0; },
+			    [&] {
+				    int matched = 0;
+				    for (int i = 0; i < repeats; ++i) {
+					    for (auto &&pair : pairs)
+						    matched += same(pair.first, pair.second) ? 1 : 0;
+				    }
+				    return matched / repeats;
+			    });
+			timing.scenario = scenario;
+			timing.corpus = corpus;
+			timing.param = "repeats";
+			timing.paramValue = repeats;
+			timing.bytes = bytes * static_cast<size_t>(repeats);
+			timings.push_back(std::move(timing));
+		};
+		auto sameName = [](std::string const &lhs, std::string const &rhs) { return TextConv::sameText(lhs, rhs); };
+		auto samePath = [](std::wstring const &lhs, std::wstring const &rhs) { return TextConv::sameText(lhs, rhs); };
+		compareAll(names, sameName, "same_text", "tag_names");
+		compareAll(names, sameTextLocale<std::string>, "same_text_locale", "tag_names");
+		compareAll(paths, samePath, "same_text", "file_paths");
+		compareAll(paths, sameTextLocale<std::wstring>, "same_text_locale", "file_paths");
+	}
+
+	// Build the HTML entity list, then look up every name and code point in it, and as many keys it doesn't hold;
+	// then the same over std::unordered_map, as HashedStringList was, for comparison. The count is the keys found
+	{
+		std::vector<std::string> keys;
+		for (auto &&pair : htmlPairs) {
+			keys.push_back(pair.first);
+			keys.push_back(pair.first + "_");
+		}
+		auto listTiming = [&](Timing timing, const char *scenario) {
+			timing.scenario = scenario;
+			timing.corpus = "html5_entities";
+			timing.param = "pairs";
+			timing.paramValue = static_cast<long long>(htmlPairs.size());
+			timing.bytes = 0;
+			for (auto &&pair : htmlPairs)
+				timing.bytes += pair.first.size() + pair.second.size();
+			timings.push_back(std::move(timing));
+		};
+		listTiming(timeIt(
+			       options, [] { return 0; },
+			       [&] { return static_cast<int>(loadEntities(htmlPairs).size()); }),
+		    "hashed_list_build");
+		listTiming(timeIt(
+			       options, [] { return 0; },
+			       [&] {
+				       MapStringList list;
+				       for (auto &&pair : htmlPairs)
+					       list.addPair(pair.first, pair.second);
+				       return static_cast<int>(list._strings.size());
+			       }),
+		    "hashed_list_build_map");
+
+		MapStringList mapList;
+		for (auto &&pair : htmlPairs)
+			mapList.addPair(pair.first, pair.second);
+		auto lookUpAll = [&keys](auto const &list) {
+			int found = 0;
+			for (std::string const &key : keys)
+				found += list[key].empty() ? 0 : 1;
+			return found;
+		};
+		listTiming(timeIt(options, [] { return 0; }, [&] { return lookUpAll(html); }), "hashed_list_lookup");
+		listTiming(timeIt(options, [] { return 0; }, [&] { return lookUpAll(mapList); }), "hashed_list_lookup_map");
+	}
+
+	// Read a document one character at a time, with a message for each, as tag matching once did: straight from
+	// the document, then through each transport the plugin can attach to an editor window, to cost each message.
+	// The count is the tags opened; SendMessage, the plugin's default, needs a window, and isn't timed
+	{
+		Corpus const &corpus = corpora[0];
+		doc.setText(corpus.text);
+		const Sci_Position length = doc.length();
+		auto forward = [&doc](unsigned msg, uptr_t wParam, sptr_t lParam) { return doc.send(msg, wParam, lParam); };
+		const std::vector<std::pair<const char *, std::shared_ptr<Transport>>> transports{
+			{ "message_call", nullptr },
+			{ "message_direct", std::make_shared<DirectTransport>(directStatus, reinterpret_cast<sptr_t>(&doc)) },
+			{ "message_callback", std::make_shared<CallbackTransport>(forward) },
+		};
+		for (auto &&transport : transports) {
+			Transport *const via = transport.second.get();
+			Timing timing = timeIt(
+			    options, [] { return 0; },
+			    [&] {
+				    int opened = 0;
+				    for (Sci_Position pos = 0; pos < length; ++pos) {
+					    const sptr_t ch = via ? via->send(SCI_GETCHARAT, static_cast<uptr_t>(pos), 0)
+								  : doc.send(SCI_GETCHARAT, static_cast<uptr_t>(pos), 0);
+					    opened += (ch == '<') ? 1 : 0;
+				    }
+				    return opened;
+			    });
+			timing.scenario = transport.first;
+			timing.corpus = corpus.name;
+			timing.param = "messages";
+			timing.paramValue = static_cast<long long>(length);
+			timing.bytes = static_cast<size_t>(length);
+			timings.push_back(std::move(timing));
+		}
+	}
+
+	// What each large-file threshold lets through: the slowest tag match before large-file mode, the scan that
+	// replaces it, the longest edit that blocks the window, and the biggest copy made without asking
+	{
+		LargeFileThresholds const &limits = options.thresholds;
+		auto atThreshold = [&](Timing timing, const char *scenario, const char *corpus, const char *param,
+				       Sci_Position bytes) {
+			timing.scenario = scenario;
+			timing.corpus = corpus;
+			timing.param = param;
+			timing.paramValue = static_cast<long long>(bytes);
+			timing.bytes = static_cast<size_t>(bytes);
+			timings.push_back(std::move(timing));
+		};
+		if (limits.minBytes > 0) {
+			const Corpus corpus = sizedHtml(limits.minBytes);
+			const Sci_Position caret = tagOpening(corpus.text, "<body", 0);
+			atThreshold(timeIt(
+					options, [&] { doc.setText(corpus.text); return 0; },
+					[&] { return findMatchingTag(doc, caret) >= 0 ? 1 : 0; }),
+			    "find_matching_tag", corpus.name.c_str(), "min_bytes", limits.minBytes);
+			if (limits.scanWindowBytes > 0) {
+				// The partner is out of reach, so the whole window is scanned
+				atThreshold(timeIt(
+						options, [&] { doc.setText(corpus.text); return 0; },
+						[&] { return findMatchingTag(doc, caret, limits.scanWindowBytes) >= 0 ? 1 : 0; }),
+				    "find_matching_tag", corpus.name.c_str(), "scan_window_bytes", limits.scanWindowBytes);
+			}
+		}
+		auto wholeEncode = [&](const char *param, Sci_Position bytes) {
+			Random rng{ 0x7E57 };
+			const std::string plain = mixedText(static_cast<size_t>(bytes), 10, rng);
+			auto encode = [&](std::string &text) { return Entities::encodeText(text, html); };
+			Timing timing = timeIt(
+			    options, [&] { doc.setText(plain); return 0; }, [&] { return transformDocument(doc, encode); });
+			timing.wholeDocument = true;
+			atThreshold(std::move(timing), "entity_encode", "mixed_text", param, bytes);
+		};
+		if (limits.slicedEditBytes > 0)
+			wholeEncode("sliced_edit_bytes", limits.slicedEditBytes);
+		if (limits.confirmCopyBytes > 0)
+			wholeEncode("confirm_copy_bytes", limits.confirmCopyBytes);
+	}
+
+	// Keystroke latency of decoding each token as it's typed, one character at a time; the codecs are the
+	// plugin's, but not the batching and idle timer of its live decoding, which need the editor
+	{
+		const std::string typed = corpora[3].text.substr(0, 32 * 1024);
+		Latency latency = typeAndDecode(doc, typed, ' ', [&](std::string &text) { return Entities::decodeText(text, xml); });
+		latency.scenario = "typed_entity_decode";
+		latency.corpus = corpora[3].name;
+		latencies.push_back(std::move(latency));
+
+		Random rng{ 0x11FE };
+		std::string escapes = mixedText(32 * 1024, 10, rng);
+		Unicode::encodeText(escapes, unicodePrefix);
+		latency = typeAndDecode(
+		    doc, escapes, ' ', [&](std::string &text) { return Unicode::decodeText(text, unicodePrefix); });
+		latency.scenario = "typed_unicode_decode";
+		latency.corpus = "mixed_text";
+		latencies.push_back(std::move(latency));
+	}
+
+	std::FILE *out = options.outFile.empty() ? stdout : std::fopen(options.outFile.c_str(), "w");
+	if (!out) {
+		std::fprintf(stderr, "Can't write to %s\n", options.outFile.c_str());
+		return EXIT_FAILURE;
+	}
+	writeJson(out, options, corpora, timings, latencies);
+	if (out != stdout)
+		std::fclose(out);
+	const bool fastEnough = checkBalanceThroughput(options, timings);
+	return (checkPeaks(options, timings) && fastEnough && allMatched) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+/// One long page of sibling sections, each with a few paragraphs of inline markup
+Corpus flatHtml(int scale) {
+	Random rng{ 0xF1A7 };
+	std::string html = "<!DOCTYPE html>\n<html>\n<head><title>Flat</title></head>\n<body>\n";
+	for (int i = 0; i < 2000 * scale; ++i) {
+		html += "<section id=\"s" + std::to_string(i) + "\">\n";
+		for (size_t p = 0, n = 1 + rng.below(3); p < n; ++p) {
+			html += "\t<p class=\"c" + std::to_string(rng.below(10)) + "\">Lorem <b>ipsum</b> dolor sit amet, ";
+			html += "<a href=\"#s" + std::to_string(rng.below(2000)) + "\">consectetur</a><br>adipiscing elit.</p>\n";
+		}
+		html += "</section>\n";
+	}
+	html += "</body>\n</html>\n";
+	return Corpus{ "flat_html", html };
+}
+// --------------------------------------------------------------------------------------
+/// Nested divs, each with a little text and a void element before the next level
+Corpus deepDom(int depth) {
+	std::string html = "<html><body>\n";
+	for (int i = 0; i < depth; ++i)
+		html += std::string(static_cast<size_t>(i % 40), ' ') + "<div class=\"d" + std::to_string(i) + "\">text<img src=\"x.png\">\n";
+	for (int i = depth - 1; i >= 0; --i)
+		html += std::string(static_cast<size_t>(i % 40), ' ') + "</div>\n";
+	html += "</body></html>\n";
+	return Corpus{ "deep_dom", html };
+}
+// --------------------------------------------------------------------------------------
+/// A page squeezed onto a single line, as served by most sites
+Corpus minifiedPage(int scale) {
+	Random rng{ 0x4D1F };
+	std::string html = "<html><head><script>var a=1<2&&3>2;</script></head><body>";
+	for (int i = 0; i < 3000 * scale; ++i) {
+		html += "<div><span class=\"x" + std::to_string(rng.below(50)) + "\">item " + std::to_string(i) +
+			"</span><ul><li>a</li><li>b</li></ul><?php echo $i; ?></div>";
+	}
+	html += "</body></html>";
+	return Corpus{ "minified_page", html };
+}
+// --------------------------------------------------------------------------------------
+/// XML where most text nodes carry named or numeric character references
+Corpus entityXml(int scale) {
+	Random rng{ 0xE7 };
+	const char *refs[] = { "&amp;", "&lt;", "&gt;", "&quot;", "&apos;", "&#233;", "&#x20AC;", "&#128512;" };
+	std::string xml = "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<catalog>\n";
+	for (int i = 0; i < 4000 * scale; ++i) {
+		xml += "  <item id=\"" + std::to_string(i) + "\">";
+		for (size_t r = 0, n = 2 + rng.below(6); r < n; ++r) {
+			xml += "word";
+			xml += refs[rng.below(sizeof(refs) / sizeof(refs[0]))];
+			xml += ' ';
+		}
+		xml += "</item>\n";
+	}
+	xml += "</catalog>\n";
+	return Corpus{ "entity_xml", xml };
+}
+// --------------------------------------------------------------------------------------
+/// A page of sibling sections, cut off at about @p bytes, inside a body that spans all of it
+Corpus sizedHtml(Sci_Position bytes) {
+	const std::string closing = "</body>\n</html>\n";
+	std::string html = "<html>\n<body>\n";
+	html.reserve(static_cast<size_t>(bytes) + 256);
+	for (int i = 0; html.size() + closing.size() < static_cast<size_t>(bytes); ++i) {
+		html += "<section id=\"s" + std::to_string(i) + "\">\n\t<p>Lorem <b>ipsum</b> dolor sit amet, ";
+		html += "<a href=\"#s" + std::to_string(i) + "\">consectetur</a><br>adipiscing elit.</p>\n</section>\n";
+	}
+	html += closing;
+	return Corpus{ "sized_html", html };
+}
+// --------------------------------------------------------------------------------------
+/// A paragraph around an image whose @c data: URI holds an SVG path of about @p bytes, with quotes and '>'
+/// in the URI, as editors and exporters inline it
+Corpus hugeAttribute(Sci_Position bytes) {
+	Random rng{ 0x5F6 };
+	std::string html = "<p><img alt=\"chart\" src=\"data:image/svg+xml;utf8,<svg xmlns='http://www.w3.org/2000/svg'>"
+			   "<path d='M0 0";
+	html.reserve(static_cast<size_t>(bytes) + 256);
+	while (html.size() < static_cast<size_t>(bytes))
+		html += " L" + std::to_string(rng.below(1000)) + ' ' + std::to_string(rng.below(1000));
+	html += "'/></svg>\" width=\"640\"/></p>\n";
+	return Corpus{ "huge_attribute", html };
+}
+// --------------------------------------------------------------------------------------
+/// The tricky cases, and the braced ones too if @p braced, @p scale times over, one to a line; adds the position
+/// of every case's tags to @p pairs
+Corpus trickyMarkup(int scale, bool braced, std::vector<TagPair> &pairs) {
+	std::vector<const char *> cases{ std::begin(trickyCases), std::end(trickyCases) };
+	if (braced)
+		cases.insert(cases.end(), std::begin(bracedCases), std::end(bracedCases));
+
+	std::string html;
+	for (int i = 0; i < 100 * scale; ++i) {
+		for (const char *markup : cases) {
+			const auto open = static_cast<Sci_Position>(html.size());
+			html += markup;
+			pairs.push_back(TagPair{ open, static_cast<Sci_Position>(html.size() - std::strlen("</div>")) });
+			html += '\n';
+		}
+	}
+	return Corpus{ braced ? "braced_markup" : "tricky_markup", html };
+}
+// --------------------------------------------------------------------------------------
+/// Lists of paragraphs, each line with an <i> closed after the <b> around it
+Corpus misnestedMarkup(int scale) {
+	std::string html = "<html><body>\n<ul>\n";
+	for (int i = 0; i < 1000 * scale; ++i)
+		html += "<li><p>Item <b>" + std::to_string(i) + " <i>is</b> misnested</i>\n";
+	html += "</ul>\n</body></html>\n";
+	return Corpus{ "misnested_markup", html };
+}
+// --------------------------------------------------------------------------------------
+/// The template over and over, as in a listing page built from it
+Corpus templatePages(PageTemplate const &page, int scale) {
+	std::string html;
+	for (int i = 0; i < 20 * scale; ++i)
+		html += page.text;
+	return Corpus{ page.name, html };
+}
+// --------------------------------------------------------------------------------------
+/// Reads every file under @p dir, in sorted order; Razor, JSX and TSX files are read with braces tracked
+std::vector<std::pair<Corpus, TagLexer::TagSyntax>> loadPages(std::string const &dir) {
+	std::vector<fs::path> paths;
+	std::error_code error;
+	for (fs::recursive_directory_iterator entry{ dir, fs::directory_options::skip_permission_denied, error }, end;
+	     !error && entry != end; entry.increment(error)) {
+		if (entry->is_regular_file(error))
+			paths.push_back(entry->path());
+	}
+	if (error)
+		std::fprintf(stderr, "Can't read all of %s\n", dir.c_str());
+	std::sort(paths.begin(), paths.end());
+
+	std::vector<std::pair<Corpus, TagLexer::TagSyntax>> pages;
+	for (fs::path const &path : paths) {
+		std::ifstream ifs(path, std::ios::in | std::ios::binary);
+		std::string text{ std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>() };
+		const std::string extension = path.extension().string();
+		const bool braced =
+		    extension == ".cshtml" || extension == ".razor" || extension == ".jsx" || extension == ".tsx";
+		pages.emplace_back(Corpus{ fs::relative(path, dir, error).generic_string(), std::move(text) },
+		    braced ? TagLexer::tsBraces : TagLexer::tsHtml);
+	}
+	return pages;
+}
+// --------------------------------------------------------------------------------------
+/// Escaped emoji, each a pair of surrogate escapes, between escaped accents and a few words
+std::string surrogateEscapes(size_t length, Random &rng) {
+	static const char *const tokens[] = { "\\uD83D\\uDE00", "\\uD83D\\uDE00", "\\u00E9", "word", " " };
+	std::string text;
+	while (text.size() < length)
+		text += tokens[rng.below(sizeof(tokens) / sizeof(tokens[0]))];
+	return text;
+}
+// --------------------------------------------------------------------------------------
+/// Emoji as pairs of surrogate references, hex and decimal, and named references with and without semicolons
+std::string surrogateReferences(size_t length, Random &rng) {
+	static const char *const tokens[] = { "&#xD83D;&#xDE00;", "&#55357;&#56832;", "&#55357&#56832;", "&amp",
+		"&lt;", "&CounterClockwiseContourIntegral;", "word", " " };
+	std::string text;
+	while (text.size() < length)
+		text += tokens[rng.below(sizeof(tokens) / sizeof(tokens[0]))];
+	return text;
+}
+// --------------------------------------------------------------------------------------
+/// Words of ASCII text, with roughly @p nonAsciiPercent of the characters drawn from Latin-1, Greek, CJK or emoji
+std::string mixedText(size_t length, int nonAsciiPercent, Random &rng) {
+	static const char *const others[] = { "\xC3\xA9", "\xC3\xBC", "\xCE\xB1", "\xCE\xA9", "\xE2\x82\xAC",
+		"\xE4\xB8\xAD", "\xF0\x9F\x98\x80" };
+	std::string text;
+	text.reserve(length + 4);
+	while (text.size() < length) {
+		if (static_cast<int>(rng.below(100)) < nonAsciiPercent)
+			text += others[rng.below(sizeof(others) / sizeof(others[0]))];
+		else if (rng.below(6) == 0)
+			text += (rng.below(12) == 0) ? '\n' : ' ';
+		else
+			text += static_cast<char>('a' + rng.below(26));
+	}
+	return text;
+}
+// --------------------------------------------------------------------------------------
+/// Transcodes @p cases random strings to wide text and back, and random wide strings to UTF-8 and back; some are
+/// ill-formed, with a byte changed, cut short, or an unpaired surrogate. Returns how many the transcoder read
+/// differently from @c decodeStrictly, or didn't give back as they were
+int fuzzTranscoding(int cases, Random &rng) {
+	// Bytes that start, continue or can never be part of a sequence, or start an overlong or surrogate one
+	static const unsigned char oddBytes[] = { 0x80, 0xBF, 0xC0, 0xC1, 0xC2, 0xE0, 0xED, 0xEF, 0xF0, 0xF4, 0xF5, 0xFF };
+	static const char32_t ranges[] = { 0x80, 0x800, 0x10000, 0x110000 };
+	std::string text, bytes;
+	std::wstring wide, units;
+	std::u32string expected, actual;
+	int failures = 0;
+	for (int i = 0; i < cases; ++i) {
+		// Long enough to cross a few 16-byte blocks, with runs of ASCII between the rest
+		text.clear();
+		const size_t length = rng.below(80);
+		while (text.size() < length) {
+			if (rng.below(3) == 0)
+				text.append(rng.below(20), static_cast<char>('a' + rng.below(26)));
+			else
+				TextConv::appendCodePoint(text, static_cast<char32_t>(rng.below(ranges[rng.below(4)])));
+		}
+		if (!text.empty() && rng.below(3) == 0) {
+			const size_t at = rng.below(text.size());
+			switch (rng.below(3)) {
+				case 0:
+					text[at] = static_cast<char>(oddBytes[rng.below(sizeof(oddBytes))]);
+					break;
+				case 1:
+					text.resize(at);
+					break;
+				default:
+					text.insert(at, 1, static_cast<char>(oddBytes[rng.below(sizeof(oddBytes))]));
+					break;
+			}
+		}
+
+		const bool wellFormed = decodeStrictly(text, expected);
+		bool agrees = TextConv::Utf8::toWide(text.data(), text.size(), wide) == wellFormed;
+		if (agrees && wellFormed) {
+			actual.clear();
+			for (size_t pos = 0; pos < wide.size();)
+				actual += TextConv::nextCodePoint(wide, pos);
+			agrees = actual == expected && TextConv::Utf8::fromWide(wide.data(), wide.size(), bytes) && bytes == text;
+		}
+
+		// Wide text, which may hold surrogates that pair with nothing
+		units.clear();
+		for (size_t n = rng.below(40); units.size() < n;) {
+			const size_t kind = rng.below(8);
+			if (kind == 0)
+				units += static_cast<wchar_t>(0xD800 + rng.below(0x800));
+			else
+				TextConv::appendCodePoint(units, static_cast<char32_t>(rng.below(ranges[kind % 4])));
+		}
+		// Any code point may be a surrogate, and a high one may have landed just before a low one
+		bool unpaired = false;
+		for (size_t pos = 0; pos < units.size();) {
+			const char32_t ch = TextConv::nextCodePoint(units, pos);
+			unpaired = unpaired || (ch >= 0xD800 && ch <= 0xDFFF);
+		}
+		const bool encoded = TextConv::Utf8::fromWide(units.data(), units.size(), bytes);
+		agrees = agrees && encoded != unpaired;
+		if (agrees && encoded)
+			agrees = TextConv::Utf8::toWide(bytes.data(), bytes.size(), wide) && wide == units;
+		failures += agrees ? 0 : 1;
+	}
+	return failures;
+}
+// --------------------------------------------------------------------------------------
+/// Decodes @p text a byte at a time, by the table of well-formed sequences in the Unicode Standard, section 3.9;
+/// returns @c false if it's ill-formed
+bool decodeStrictly(std::string const &text, std::u32string &codePoints) {
+	codePoints.clear();
+	for (size_t i = 0; i < text.size();) {
+		const auto lead = static_cast<unsigned char>(text[i]);
+		size_t length = 1;
+		char32_t codePoint = lead;
+		// The range of the second byte, which rules out overlong forms, surrogates, and code points past U+10FFFF
+		unsigned char low = 0x80, high = 0xBF;
+		if (lead >= 0xC2 && lead <= 0xDF) {
+			length = 2;
+			codePoint = lead & 0x1F;
+		} else if (lead >= 0xE0 && lead <= 0xEF) {
+			length = 3;
+			codePoint = lead & 0x0F;
+			low = (lead == 0xE0) ? 0xA0 : 0x80;
+			high = (lead == 0xED) ? 0x9F : 0xBF;
+		} else if (lead >= 0xF0 && lead <= 0xF4) {
+			length = 4;
+			codePoint = lead & 0x07;
+			low = (lead == 0xF0) ? 0x90 : 0x80;
+			high = (lead == 0xF4) ? 0x8F : 0xBF;
+		} else if (lead >= 0x80) {
+			return false;
+		}
+		if (i + length > text.size())
+			return false;
+		for (size_t k = 1; k < length; ++k) {
+			const auto ch = static_cast<unsigned char>(text[i + k]);
+			if (ch < (k == 1 ? low : 0x80) || ch > (k == 1 ? high : 0xBF))
+				return false;
+			codePoint = (codePoint << 6) | (ch & 0x3F);
+		}
+		codePoints += codePoint;
+		i += length;
+	}
+	return true;
+}
+// --------------------------------------------------------------------------------------
+/// Reads one section of the plugin's entity list, in file order, as pairs mapping names to code points and back
+std::vector<Entities::EntityList::Pair_T> loadEntityPairs(std::string const &iniFile, const char *section) {
+	std::ifstream ifs(iniFile, std::ios::in | std::ios::binary);
+	std::vector<Entities::EntityList::Pair_T> pairs;
+	const std::string header = std::string("[") + section + "]";
+	bool inSection = false;
+
+	for (std::string line; std::getline(ifs, line);) {
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+		if (line.empty() || line[0] == ';')
+			continue;
+		if (line[0] == '[') {
+			inSection = (line == header);
+			continue;
+		}
+		const size_t sep = line.find('=');
+		if (!inSection || sep == std::string::npos)
+			continue;
+		const int codePoint = std::atoi(line.c_str() + sep + 1);
+		if (codePoint > 0) {
+			pairs.emplace_back(line.substr(0, sep), std::to_string(codePoint));
+			pairs.emplace_back(std::to_string(codePoint), line.substr(0, sep));
+		}
+	}
+
+	return pairs;
+}
+// --------------------------------------------------------------------------------------
+/// Builds a list from @p pairs the way the plugin does, so the last name listed for a code point wins
+Entities::EntityList loadEntities(std::vector<Entities::EntityList::Pair_T> pairs) {
+	return Entities::EntityList{ std::move(pairs) };
+}
+// --------------------------------------------------------------------------------------
+Timing timeIt(BenchOptions const &options, std::function<int()> const &setUp, std::function<int()> const &run) {
+	Timing timing{};
+	for (int i = 0; i < options.iterations; ++i) {
+		setUp();
+		AllocationStats::Scope memory;
+		const auto started = std::chrono::steady_clock::now();
+		timing.count = run();
+		const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - started;
+		timing.samplesMs.push_back(elapsed.count());
+		timing.memory = memory.usage();
+	}
+	return timing;
+}
+// --------------------------------------------------------------------------------------
+/// Reads @p doc the way the plugin reads the editor's, through range pointers
+TagSource documentSource(SciMemoryDocument &doc) {
+	return TagSource{ [&doc](unsigned msg, uptr_t wParam, sptr_t lParam) { return doc.send(msg, wParam, lParam); } };
+}
+// --------------------------------------------------------------------------------------
+/// Finds the partner of the tag at @p caret the way @c TagFinder::findMatchingTag does, through @c TagMatcher;
+/// returns the partner's position, or -1.
+/// A @p window limits the searches to that many bytes either side of the caret, as in large-file mode
+Sci_Position findMatchingTag(
+    SciMemoryDocument &doc, Sci_Position caret, Sci_Position window, TagLexer::TagSyntax syntax) {
+	const TagMatcher::Bounds bounds = (window > 0)
+	    ? TagMatcher::Bounds{ (std::max)(Sci_Position(0), caret - window), (std::min)(doc.length(), caret + window) }
+	    : TagMatcher::Bounds{ 0, INVALID_POSITION };
+	TagMatcher::Match match;
+	// With nothing selected, the search begins just past the caret
+	if (!TagMatcher::findMatchingTag(documentSource(doc), caret + 1, bounds, match, TagBalance::dlHtml, syntax))
+		return -1;
+	return match.partner.startPos;
+}
+// --------------------------------------------------------------------------------------
+/// Reads every tag in the document, in one pass, returning the number read. Without @p quoteAware, each tag ends
+/// at the first '>', as tags did before the lexer tracked quotes, for comparison
+int lexTags(SciMemoryDocument &doc, TagLexer::TagSyntax syntax, bool quoteAware) {
+	const TagSource source = documentSource(doc);
+	const std::string_view text = source.view(0, source.length());
+	TagLexer::Tag tag;
+	int tags = 0;
+	for (size_t pos = text.find('<'); pos != std::string_view::npos; pos = text.find('<', pos + 1)) {
+		if (!quoteAware) {
+			pos = text.find('>', pos);
+			tags += (pos != std::string_view::npos) ? 1 : 0;
+		} else if (TagLexer::readTag(source, static_cast<Sci_Position>(pos), -1, tag, syntax)) {
+			pos = static_cast<size_t>(tag.endPos) - 1;
+			++tags;
+		}
+		if (pos == std::string_view::npos)
+			break;
+	}
+	return tags;
+}
+// --------------------------------------------------------------------------------------
+/// Matches each opening tag in @p doc forwards, then its partner backwards, and counts the opening tags in
+/// @p openTags; returns how many came back to the tag they began at
+int matchRoundTrips(SciMemoryDocument &doc, TagLexer::TagSyntax syntax, int &openTags) {
+	const TagSource source = documentSource(doc);
+	const std::string_view text = source.view(0, source.length());
+	TagLexer::Tag tag;
+	int matched = 0;
+	openTags = 0;
+	for (size_t pos = text.find('<'); pos != std::string_view::npos; pos = text.find('<', pos)) {
+		const auto start = static_cast<Sci_Position>(pos);
+		if (!TagLexer::readTag(source, start, -1, tag, syntax)) {
+			++pos;
+			continue;
+		}
+		pos = static_cast<size_t>(tag.endPos);
+		if (tag.name.empty() || tag.isEndTag || tag.isSelfClosing || TagBalance::isVoidElement(tag.name))
+			continue;
+		++openTags;
+		const Sci_Position partner = findMatchingTag(doc, start, 0, syntax);
+		if (partner > start && findMatchingTag(doc, partner, 0, syntax) == start) {
+			++matched;
+			// A script's text is not markup
+			if (tag.name == "script" || tag.name == "style")
+				pos = static_cast<size_t>(partner);
+		}
+	}
+	return matched;
+}
+// --------------------------------------------------------------------------------------
+/// Returns the position of the @p nth occurrence of @p needle in @p text
+Sci_Position tagOpening(std::string const &text, const char *needle, size_t nth) {
+	size_t pos = text.find(needle);
+	for (; nth > 0 && pos != std::string::npos; --nth)
+		pos = text.find(needle, pos + 1);
+	return pos == std::string::npos ? 0 : static_cast<Sci_Position>(pos);
+}
+// --------------------------------------------------------------------------------------
+std::string textRange(SciMemoryDocument &doc, Sci_Position start, Sci_Position end) {
+	std::string text(static_cast<size_t>(end - start) + 1, '\0');
+	Sci_TextRangeFull tr{ { start, end }, &text[0] };
+	text.resize(static_cast<size_t>(doc.send(SCI_GETTEXTRANGEFULL, 0, reinterpret_cast<sptr_t>(&tr))));
+	return text;
+}
+// --------------------------------------------------------------------------------------
+/// Runs @p transform over the whole document, the same way @c SciTextRange::transformText does for UTF-8
+int transformDocument(SciMemoryDocument &doc, std::function<int(std::string &)> const &transform) {
+	std::string text = textRange(doc, 0, doc.length());
+	const int result = transform(text);
+	if (result > 0) {
+		doc.send(SCI_SETTARGETRANGE, 0, doc.length());
+		doc.send(SCI_REPLACETARGETMINIMAL, text.size(), reinterpret_cast<sptr_t>(text.c_str()));
+	}
+	return result;
+}
+// --------------------------------------------------------------------------------------
+/// Runs @p transform over the document a slice of about @p sliceBytes at a time, cut where
+/// @c SlicedReplacement cuts them, rewriting each the way @c transformDocument does
+int transformSliced(SciMemoryDocument &doc, Sci_Position sliceBytes, SliceCuts::Tokens const &tokens,
+    std::function<int(std::string &)> const &transform) {
+	auto send = [&doc](unsigned msg, uptr_t wParam, sptr_t lParam) { return doc.send(msg, wParam, lParam); };
+	int result = 0;
+	for (Sci_Position pos = 0; pos < doc.length();) {
+		const Sci_Position cut = SliceCuts::chunkEnd(send, pos, pos + sliceBytes, tokens);
+		std::string text = textRange(doc, pos, cut);
+		const int replaced = transform(text);
+		if (replaced > 0) {
+			doc.send(SCI_SETTARGETRANGE, static_cast<uptr_t>(pos), cut);
+			doc.send(SCI_REPLACETARGETMINIMAL, text.size(), reinterpret_cast<sptr_t>(text.c_str()));
+		}
+		result += replaced;
+		pos += static_cast<Sci_Position>(text.size());
+	}
+	return result;
+}
+// --------------------------------------------------------------------------------------
+/// Decodes each character reference in @p doc with an edit of its own, back to front, inside one undo action
+/// and with the modification event mask set to @p eventMask, as @c SciBulkEdit does
+int decodeEachReference(SciMemoryDocument &doc, Entities::EntityList const &entities, int eventMask) {
+	const std::string text = textRange(doc, 0, doc.length());
+	std::vector<std::pair<size_t, size_t>> references;
+	for (size_t amp = text.find('&'); amp != std::string::npos; amp = text.find('&', amp + 1)) {
+		const size_t semicolon = text.find(';', amp);
+		if (semicolon != std::string::npos && semicolon - amp < 12)
+			references.emplace_back(amp, semicolon + 1);
+	}
+
+	const sptr_t outerMask = doc.send(SCI_GETMODEVENTMASK);
+	doc.send(SCI_BEGINUNDOACTION);
+	doc.send(SCI_SETMODEVENTMASK, static_cast<uptr_t>(eventMask));
+	int replaced = 0;
+	for (auto ref = references.rbegin(); ref != references.rend(); ++ref) {
+		std::string token = text.substr(ref->first, ref->second - ref->first);
+		if (Entities::decodeText(token, entities) == 0)
+			continue;
+		doc.send(SCI_SETTARGETRANGE, ref->first, static_cast<sptr_t>(ref->second));
+		doc.send(SCI_REPLACETARGET, token.size(), reinterpret_cast<sptr_t>(token.c_str()));
+		++replaced;
+	}
+	doc.send(SCI_SETMODEVENTMASK, static_cast<uptr_t>(outerMask));
+	doc.send(SCI_ENDUNDOACTION);
+	return replaced;
+}
+// --------------------------------------------------------------------------------------
+/// Compares the way @c TextConv::sameText once did, copying and lowercasing both strings; by @c char and @c wchar_t,
+/// which, unlike the @c uint8_t and @c wint_t it took, have a @c ctype facet in every standard library
+template <typename Str_T>
+bool sameTextLocale(Str_T lhs, Str_T rhs) {
+	auto tolower_l = [](typename Str_T::value_type c) { return std::tolower(c, std::locale()); };
+	std::transform(lhs.begin(), lhs.end(), lhs.begin(), tolower_l);
+	std::transform(rhs.begin(), rhs.end(), rhs.begin(), tolower_l);
+	return lhs == rhs;
+}
+// --------------------------------------------------------------------------------------
+/// Answers for the @c SciMemoryDocument at @p ptr, as Scintilla's direct status function does for its instance
+sptr_t directStatus(sptr_t ptr, unsigned msg, uptr_t wParam, sptr_t lParam, int * /*status*/) {
+	return reinterpret_cast<SciMemoryDocument *>(ptr)->send(msg, wParam, lParam);
+}
+// --------------------------------------------------------------------------------------
+/// Types @p input one character at a time; after each @p trigger, decodes the token behind it with @p decoder,
+/// and records how long the keystroke took
+Latency typeAndDecode(SciMemoryDocument &doc, std::string const &input, char trigger,
+    std::function<int(std::string &)> const &decoder) {
+	Latency latency{};
+	doc.setText("");
+	latency.samplesUs.reserve(input.size());
+
+	for (size_t i = 0; i < input.size();) {
+		size_t charLen = 1;
+		while (i + charLen < input.size() && (static_cast<unsigned char>(input[i + charLen]) & 0xC0) == 0x80)
+			++charLen;
+
+		const auto started = std::chrono::steady_clock::now();
+		doc.send(SCI_ADDTEXT, charLen, reinterpret_cast<sptr_t>(input.data() + i));
+		if (input[i] == trigger || input[i] == '\n') {
+			const Sci_Position caret = doc.send(SCI_GETCURRENTPOS) - 1;
+			Sci_Position anchor = caret - 1;
+			for (; anchor >= 0; --anchor) {
+				const auto ch = static_cast<int>(doc.send(SCI_GETCHARAT, static_cast<uptr_t>(anchor)));
+				if (ch >= 0 && ch <= 0x20)
+					break;
+			}
+			if (anchor + 1 < caret) {
+				doc.send(SCI_SETSEL, static_cast<uptr_t>(anchor + 1), caret);
+				std::string token(static_cast<size_t>(caret - anchor), '\0');
+				token.resize(static_cast<size_t>(doc.send(SCI_GETSELTEXT, 0, reinterpret_cast<sptr_t>(&token[0]))));
+				if (decoder(token) > 0)
+					doc.send(SCI_REPLACESEL, 0, reinterpret_cast<sptr_t>(token.c_str()));
+				doc.send(SCI_GOTOPOS, static_cast<uptr_t>(doc.length()));
+			}
+		}
+		const std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - started;
+		latency.samplesUs.push_back(elapsed.count());
+		i += charLen;
+	}
+	return latency;
+}
+// --------------------------------------------------------------------------------------
+double percentile(std::vector<double> samples, double fraction) {
+	if (samples.empty())
+		return 0.0;
+	std::sort(samples.begin(), samples.end());
+	const auto index = static_cast<size_t>(fraction * static_cast<double>(samples.size() - 1) + 0.5);
+	return samples[(std::min)(index, samples.size() - 1)];
+}
+// --------------------------------------------------------------------------------------
+/// Reads the thresholds from the @c [LARGE_FILES] section of the plugin's options.ini, keeping the defaults
+/// for any that are missing
+bool loadThresholds(std::string const &iniFile, LargeFileThresholds &thresholds) {
+	std::ifstream ifs(iniFile, std::ios::in | std::ios::binary);
+	if (!ifs)
+		return false;
+
+	const std::pair<const char *, Sci_Position *> keys[] = {
+		{ "MIN_BYTES", &thresholds.minBytes },
+		{ "SCAN_WINDOW_BYTES", &thresholds.scanWindowBytes },
+		{ "SLICED_EDIT_BYTES", &thresholds.slicedEditBytes },
+		{ "CONFIRM_COPY_BYTES", &thresholds.confirmCopyBytes },
+	};
+	bool inSection = false;
+	for (std::string line; std::getline(ifs, line);) {
+		if (!line.empty() && line.back() == '\r')
+			line.pop_back();
+		if (!line.empty() && line[0] == '[') {
+			inSection = (line == "[LARGE_FILES]");
+			continue;
+		}
+		const size_t sep = line.find('=');
+		if (!inSection || sep == std::string::npos)
+			continue;
+		for (auto &&key : keys) {
+			if (line.compare(0, sep, key.first) == 0)
+				*key.second = static_cast<Sci_Position>(std::atoll(line.c_str() + sep + 1));
+		}
+	}
+	return true;
+}
+// --------------------------------------------------------------------------------------
+void writeJson(std::FILE *out, BenchOptions const &options, std::vector<Corpus> const &corpora,
+    std::vector<Timing> const &timings, std::vector<Latency> const &latencies) {
+	std::fprintf(out, "{\n  \"benchmark\": \"htmltag_bench\",\n  \"scale\": %d,\n  \"iterations\": %d,\n",
+	    options.scale, options.iterations);
+
+	std::fprintf(out, "  \"corpora\": [\n");
+	for (size_t i = 0; i < corpora.size(); ++i) {
+		const auto lines = std::count(corpora[i].text.begin(), corpora[i].text.end(), '\n') + 1;
+		std::fprintf(out, "    { \"name\": \"%s\", \"bytes\": %zu, \"lines\": %lld }%s\n", corpora[i].name.c_str(),
+		    corpora[i].text.size(), static_cast<long long>(lines), (i + 1 < corpora.size()) ? "," : "");
+	}
+
+	std::fprintf(out, "  ],\n  \"timings\": [\n");
+	for (size_t i = 0; i < timings.size(); ++i) {
+		Timing const &t = timings[i];
+		const double minMs = percentile(t.samplesMs, 0.0), medianMs = percentile(t.samplesMs, 0.5);
+		const double mbPerSec = medianMs > 0 ? (static_cast<double>(t.bytes) / (1024.0 * 1024.0)) / (medianMs / 1000.0) : 0;
+		std::fprintf(out,
+		    "    { \"scenario\": \"%s\", \"corpus\": \"%s\", \"%s\": %lld, \"bytes\": %zu, \"count\": %d, "
+		    "\"min_ms\": %.3f, \"median_ms\": %.3f, \"mb_per_s\": %.1f, \"peak_bytes\": %llu, "
+		    "\"allocations\": %llu }%s\n",
+		    t.scenario.c_str(), t.corpus.c_str(), t.param.c_str(), t.paramValue, t.bytes, t.count, minMs,
+		    medianMs, mbPerSec, static_cast<unsigned long long>(t.memory.peakBytes),
+		    static_cast<unsigned long long>(t.memory.allocations), (i + 1 < timings.size()) ? "," : "");
+	}
+
+	std::fprintf(out, "  ],\n  \"latencies\": [\n");
+	for (size_t i = 0; i < latencies.size(); ++i) {
+		Latency const &l = latencies[i];
+		std::fprintf(out,
+		    "    { \"scenario\": \"%s\", \"corpus\": \"%s\", \"keystrokes\": %zu, \"p50_us\": %.2f, \"p95_us\": %.2f, "
+		    "\"p99_us\": %.2f, \"max_us\": %.2f }%s\n",
+		    l.scenario.c_str(), l.corpus.c_str(), l.samplesUs.size(), percentile(l.samplesUs, 0.5),
+		    percentile(l.samplesUs, 0.95), percentile(l.samplesUs, 0.99), percentile(l.samplesUs, 1.0),
+		    (i + 1 < latencies.size()) ? "," : "");
+	}
+	std::fprintf(out, "  ]\n}\n");
+}
+// --------------------------------------------------------------------------------------
+/// Reports every whole-document transform that needed more memory than @c BenchOptions::maxPeakRatio allows
+bool checkPeaks(BenchOptions const &options, std::vector<Timing> const &timings) {
+	if (options.maxPeakRatio <= 0)
+		return true;
+	bool passed = true;
+	for (Timing const &t : timings) {
+		const double ratio = t.bytes ? static_cast<double>(t.memory.peakBytes) / static_cast<double>(t.bytes) : 0;
+		if (t.wholeDocument && ratio > options.maxPeakRatio) {
+			std::fprintf(stderr, "%s (%s, %s=%lld) peaked at %.2f times the document's size, above %.2f\n",
+			    t.scenario.c_str(), t.corpus.c_str(), t.param.c_str(), t.paramValue, ratio, options.maxPeakRatio);
+			passed = false;
+		}
+	}
+	return passed;
+}
+// --------------------------------------------------------------------------------------
+/// Reports every corpus whose tag balance was checked more slowly than @c BenchOptions::minBalanceMbPerSec
+/// allows, even in its fastest iteration
+bool checkBalanceThroughput(BenchOptions const &options, std::vector<Timing> const &timings) {
+	if (options.minBalanceMbPerSec <= 0)
+		return true;
+	bool passed = true;
+	for (Timing const &t : timings) {
+		const double minMs = percentile(t.samplesMs, 0.0);
+		const double mbPerSec = minMs > 0 ? (static_cast<double>(t.bytes) / (1024.0 * 1024.0)) / (minMs / 1000.0) : 0;
+		if (t.scenario == "check_tag_balance" && mbPerSec < options.minBalanceMbPerSec) {
+			std::fprintf(stderr, "check_tag_balance read %s at %.1f MiB/s, below %.1f\n", t.corpus.c_str(), mbPerSec,
+			    options.minBalanceMbPerSec);
+			passed = false;
+		}
+	}
+	return passed;
+}
+// --------------------------------------------------------------------------------------
+bool parseArgs(int argc, char **argv, BenchOptions &options) {
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		const bool hasValue = (i + 1 < argc);
+		if (arg == "--entities" && hasValue) {
+			options.entitiesIni = argv[++i];
+		} else if (arg == "--out" && hasValue) {
+			options.outFile = argv[++i];
+		} else if (arg == "--pages" && hasValue) {
+			options.pagesDir = argv[++i];
+		} else if (arg == "--scale" && hasValue) {
+			options.scale = (std::max)(1, std::atoi(argv[++i]));
+		} else if (arg == "--iterations" && hasValue) {
+			options.iterations = (std::max)(1, std::atoi(argv[++i]));
+		} else if (arg == "--max-peak-ratio" && hasValue) {
+			options.maxPeakRatio = std::atof(argv[++i]);
+		} else if (arg == "--min-balance-mb-per-s" && hasValue) {
+			options.minBalanceMbPerSec = std::atof(argv[++i]);
+		} else if (arg == "--options" && hasValue) {
+			if (!loadThresholds(argv[++i], options.thresholds)) {
+				std::fprintf(stderr, "Can't read %s\n", argv[i]);
+				return false;
+			}
+		} else {
+			std::fprintf(stderr,
+			    "Usage: %s [--entities <HTMLTag-entities.ini>] [--out <results.json>] [--scale N] [--iterations N] "
+			    "[--max-peak-ratio R] [--min-balance-mb-per-s R] [--options <options.ini>] [--pages <dir>]\n",
+			    argv[0]);
+			return false;
+		}
+	}
+	return true;
+}
+}
@@ -0,0 +1,156 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+#include "SciMemoryDocument.h"
+#include "SciMessageTrace.h"
+
+using namespace SciTextObjects;
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+struct ReplayOptions {
+	std::vector<std::string> traceFiles;
+	std::string outFile;
+	int iterations = 5;
+};
+
+struct ReplayResult {
+	std::string file;
+	SciMessageTrace trace;
+	SciTraceReplay outcome;
+	std::vector<double> samplesMs;
+	/// The most frequent messages, by count
+	std::vector<std::pair<unsigned, size_t>> busiest;
+};
+
+ReplayResult replayFile(std::string const &file, int iterations);
+double percentile(std::vector<double> samples, double fraction);
+void writeJson(std::FILE *out, ReplayOptions const &options, std::vector<ReplayResult> const &results);
+bool parseArgs(int argc, char **argv, ReplayOptions &options);
+
+constexpr size_t busiestCount = 5;
+}
+
+int main(int argc, char **argv) {
+	ReplayOptions options;
+	if (!parseArgs(argc, argv, options))
+		return EXIT_FAILURE;
+
+	std::vector<ReplayResult> results;
+	for (std::string const &file : options.traceFiles) {
+		results.push_back(replayFile(file, options.iterations));
+		if (results.back().samplesMs.empty()) {
+			std::fprintf(stderr, "Not a message trace: %s\n", file.c_str());
+			return EXIT_FAILURE;
+		}
+	}
+
+	std::FILE *out = stdout;
+	if (!options.outFile.empty() && !(out = std::fopen(options.outFile.c_str(), "w"))) {
+		std::fprintf(stderr, "Cannot write to %s\n", options.outFile.c_str());
+		return EXIT_FAILURE;
+	}
+	writeJson(out, options, results);
+	if (out != stdout)
+		std::fclose(out);
+	return EXIT_SUCCESS;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+ReplayResult replayFile(std::string const &file, int iterations) {
+	ReplayResult result{ file, SciMessageTrace{}, SciTraceReplay{ 0, 0, -1 }, {}, {} };
+	std::ifstream ifs(file, std::ios::in | std::ios::binary);
+	if (!ifs || !result.trace.load(ifs))
+		return result;
+
+	std::map<unsigned, size_t> counts;
+	for (SciTraceRecord const &record : result.trace.records())
+		++counts[record.msg];
+	result.busiest.assign(counts.begin(), counts.end());
+	std::sort(result.busiest.begin(), result.busiest.end(), [](auto const &a, auto const &b) {
+		return a.second > b.second || (a.second == b.second && a.first < b.first);
+	});
+	result.busiest.resize((std::min)(result.busiest.size(), busiestCount));
+
+	for (int i = 0; i < iterations; ++i) {
+		SciMemoryDocument doc;
+		auto send = [&doc](unsigned msg, uptr_t wParam, sptr_t lParam) { return doc.send(msg, wParam, lParam); };
+		result.trace.prepare(send);
+		const auto started = std::chrono::steady_clock::now();
+		result.outcome = result.trace.replay(send);
+		const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - started;
+		result.samplesMs.push_back(elapsed.count());
+	}
+	return result;
+}
+// --------------------------------------------------------------------------------------
+double percentile(std::vector<double> samples, double fraction) {
+	if (samples.empty())
+		return 0.0;
+	std::sort(samples.begin(), samples.end());
+	const auto index = static_cast<size_t>(fraction * static_cast<double>(samples.size() - 1) + 0.5);
+	return samples[(std::min)(index, samples.size() - 1)];
+}
+// --------------------------------------------------------------------------------------
+void writeJson(std::FILE *out, ReplayOptions const &options, std::vector<ReplayResult> const &results) {
+	std::fprintf(out, "{\n  \"benchmark\": \"htmltag_replay\",\n  \"iterations\": %d,\n  \"traces\": [\n",
+	    options.iterations);
+	for (size_t i = 0; i < results.size(); ++i) {
+		ReplayResult const &r = results[i];
+		std::string file;
+		for (char ch : r.file) {
+			if (ch == '"' || ch == '\\')
+				file += '\\';
+			file += ch;
+		}
+		std::fprintf(out,
+		    "    { \"file\": \"%s\", \"command\": \"%s\", \"anonymized\": %s, \"bytes\": %zu, \"messages\": %zu, "
+		    "\"payload_bytes\": %llu, \"mismatches\": %zu, \"first_mismatch\": %lld, \"recorded_ms\": %.3f, "
+		    "\"min_ms\": %.3f, \"median_ms\": %.3f,\n      \"busiest\": [",
+		    file.c_str(), r.trace.command().c_str(), r.trace.anonymized() ? "true" : "false", r.trace.text().size(),
+		    r.outcome.messages, static_cast<unsigned long long>(r.trace.payloadBytes()), r.outcome.mismatches,
+		    static_cast<long long>(r.outcome.firstMismatch), static_cast<double>(r.trace.elapsedNs()) / 1e6,
+		    percentile(r.samplesMs, 0.0), percentile(r.samplesMs, 0.5));
+		for (size_t j = 0; j < r.busiest.size(); ++j)
+			std::fprintf(out, "%s{ \"msg\": %u, \"count\": %zu }", j ? ", " : " ", r.busiest[j].first,
+			    r.busiest[j].second);
+		std::fprintf(out, " ] }%s\n", (i + 1 < results.size()) ? "," : "");
+	}
+	std::fprintf(out, "  ]\n}\n");
+}
+// --------------------------------------------------------------------------------------
+bool parseArgs(int argc, char **argv, ReplayOptions &options) {
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		const bool hasValue = (i + 1 < argc);
+		if (arg == "--out" && hasValue) {
+			options.outFile = argv[++i];
+		} else if (arg == "--iterations" && hasValue) {
+			options.iterations = (std::max)(1, std::atoi(argv[++i]));
+		} else if (!arg.empty() && arg[0] != '-') {
+			options.traceFiles.push_back(arg);
+		} else {
+			options.traceFiles.clear();
+			break;
+		}
+	}
+	if (options.traceFiles.empty()) {
+		std::fprintf(stderr, "Usage: %s [--out <results.json>] [--iterations N] <file.trace>...\n", argv[0]);
+		return false;
+	}
+	return true;
+}
+}
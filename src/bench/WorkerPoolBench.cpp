@@ -0,0 +1,199 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include "WorkerPool.h"
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+using Clock = std::chrono::steady_clock;
+
+struct PoolOptions {
+	std::string outFile;
+	unsigned threads = 0;
+	int iterations = 200;
+	/// Fails the run when a job takes longer than this to notice it was cancelled
+	double maxCancelUs = 0;
+	/// Fails the run when the busiest worker runs more than this many times the tasks of the idlest
+	double maxImbalance = 0;
+};
+
+struct Fairness {
+	std::vector<WorkerStats> workers;
+	size_t tasks;
+	double elapsedMs;
+	double imbalance;
+};
+
+std::vector<double> cancelLatencies(WorkerPool &pool, int iterations);
+Fairness fanOut(WorkerPool &pool, size_t parents, size_t children);
+uint64_t spin(uint64_t seed, int rounds) noexcept;
+double percentile(std::vector<double> samples, double fraction);
+bool parseArgs(int argc, char **argv, PoolOptions &options);
+
+/// Keeps the optimizer from discarding the busy work
+std::atomic<uint64_t> sink{ 0 };
+}
+
+int main(int argc, char **argv) {
+	PoolOptions options;
+	if (!parseArgs(argc, argv, options))
+		return EXIT_FAILURE;
+
+	std::atomic<size_t> notified{ 0 };
+	WorkerPool pool{ options.threads, [&notified] { ++notified; } };
+	const std::vector<double> latencies = cancelLatencies(pool, options.iterations);
+	const size_t callbacks = pool.runPosted();
+	const Fairness fairness = fanOut(pool, 64, 256);
+
+	std::FILE *out = options.outFile.empty() ? stdout : std::fopen(options.outFile.c_str(), "w");
+	if (!out) {
+		std::fprintf(stderr, "Can't write to %s\n", options.outFile.c_str());
+		return EXIT_FAILURE;
+	}
+	std::fprintf(out,
+	    "{\n  \"benchmark\": \"htmltag_pool_bench\",\n  \"threads\": %zu,\n"
+	    "  \"cancellation\": { \"jobs\": %zu, \"callbacks\": %zu, \"p50_us\": %.2f, \"p99_us\": %.2f, "
+	    "\"max_us\": %.2f },\n"
+	    "  \"fan_out\": { \"tasks\": %zu, \"elapsed_ms\": %.3f, \"imbalance\": %.2f,\n    \"workers\": [",
+	    pool.threadCount(), latencies.size(), callbacks, percentile(latencies, 0.5), percentile(latencies, 0.99),
+	    percentile(latencies, 1.0), fairness.tasks, fairness.elapsedMs, fairness.imbalance);
+	for (size_t i = 0; i < fairness.workers.size(); ++i) {
+		std::fprintf(out, "%s{ \"executed\": %llu, \"stolen\": %llu }", i ? ", " : " ",
+		    static_cast<unsigned long long>(fairness.workers[i].executed),
+		    static_cast<unsigned long long>(fairness.workers[i].stolen));
+	}
+	std::fprintf(out, " ] }\n}\n");
+	if (out != stdout)
+		std::fclose(out);
+
+	bool passed = true;
+	if (options.maxCancelUs > 0 && percentile(latencies, 1.0) > options.maxCancelUs) {
+		std::fprintf(
+		    stderr, "A job took %.2f us to stop, above %.2f\n", percentile(latencies, 1.0), options.maxCancelUs);
+		passed = false;
+	}
+	if (options.maxImbalance > 0 && fairness.imbalance > options.maxImbalance) {
+		std::fprintf(stderr, "Workers ran up to %.2f times as many tasks as each other, above %.2f\n",
+		    fairness.imbalance, options.maxImbalance);
+		passed = false;
+	}
+	if (callbacks != latencies.size()) {
+		std::fprintf(stderr, "%zu of %zu jobs reported completion\n", callbacks, latencies.size());
+		passed = false;
+	}
+	return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+/// Starts jobs that poll their token between small slices of work, and times how long each takes to
+/// return once cancelled
+std::vector<double> cancelLatencies(WorkerPool &pool, int iterations) {
+	std::vector<double> samples;
+	for (int i = 0; i < iterations; ++i) {
+		std::atomic<bool> started{ false };
+		std::atomic<Clock::rep> stopped{ 0 };
+		CancellationToken token = pool.run(WorkerJob{
+		    [&](CancellationToken const &cancel, WorkerProgress &progress) {
+			    started = true;
+			    for (size_t slice = 0; !cancel.cancelled(); ++slice) {
+				    sink += spin(slice, 64);
+				    progress.report(slice, 0);
+			    }
+			    stopped = Clock::now().time_since_epoch().count();
+		    },
+		    nullptr, [](bool) {} });
+		while (!started)
+			std::this_thread::yield();
+		const Clock::time_point cancelled = Clock::now();
+		token.cancel();
+		pool.wait();
+		const std::chrono::duration<double, std::micro> latency =
+		    Clock::time_point{ Clock::duration{ stopped.load() } } - cancelled;
+		samples.push_back(latency.count());
+	}
+	return samples;
+}
+// --------------------------------------------------------------------------------------
+/// Submits @p parents tasks from outside the pool, each of which submits @p children of uneven cost
+/// to its own worker, so the others only get them by stealing
+Fairness fanOut(WorkerPool &pool, size_t parents, size_t children) {
+	const std::vector<WorkerStats> before = pool.stats();
+	const Clock::time_point started = Clock::now();
+	for (size_t p = 0; p < parents; ++p) {
+		pool.submit([&pool, p, children] {
+			for (size_t c = 0; c < children; ++c) {
+				const int rounds = 200 + static_cast<int>(((p * 31 + c * 17) % 13) * 100);
+				pool.submit([c, rounds] { sink += spin(c, rounds); });
+			}
+		});
+	}
+	pool.wait();
+	const std::chrono::duration<double, std::milli> elapsed = Clock::now() - started;
+
+	Fairness result{ pool.stats(), parents * (children + 1), elapsed.count(), 0 };
+	uint64_t least = UINT64_MAX, most = 0;
+	for (size_t i = 0; i < result.workers.size(); ++i) {
+		result.workers[i].executed -= before[i].executed;
+		result.workers[i].stolen -= before[i].stolen;
+		least = (std::min)(least, result.workers[i].executed);
+		most = (std::max)(most, result.workers[i].executed);
+	}
+	result.imbalance = static_cast<double>(most) / static_cast<double>((std::max)(least, uint64_t{ 1 }));
+	return result;
+}
+// --------------------------------------------------------------------------------------
+uint64_t spin(uint64_t seed, int rounds) noexcept {
+	uint64_t state = seed | 1;
+	for (int i = 0; i < rounds; ++i) {
+		state ^= state << 13;
+		state ^= state >> 7;
+		state ^= state << 17;
+	}
+	return state;
+}
+// --------------------------------------------------------------------------------------
+double percentile(std::vector<double> samples, double fraction) {
+	if (samples.empty())
+		return 0.0;
+	std::sort(samples.begin(), samples.end());
+	const auto index = static_cast<size_t>(fraction * static_cast<double>(samples.size() - 1) + 0.5);
+	return samples[(std::min)(index, samples.size() - 1)];
+}
+// --------------------------------------------------------------------------------------
+bool parseArgs(int argc, char **argv, PoolOptions &options) {
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		const bool hasValue = (i + 1 < argc);
+		if (arg == "--out" && hasValue) {
+			options.outFile = argv[++i];
+		} else if (arg == "--threads" && hasValue) {
+			options.threads = static_cast<unsigned>((std::max)(0, std::atoi(argv[++i])));
+		} else if (arg == "--iterations" && hasValue) {
+			options.iterations = (std::max)(1, std::atoi(argv[++i]));
+		} else if (arg == "--max-cancel-us" && hasValue) {
+			options.maxCancelUs = std::atof(argv[++i]);
+		} else if (arg == "--max-imbalance" && hasValue) {
+			options.maxImbalance = std::atof(argv[++i]);
+		} else {
+			std::fprintf(stderr,
+			    "Usage: %s [--out <results.json>] [--threads N] [--iterations N] [--max-cancel-us T] "
+			    "[--max-imbalance R]\n",
+			    argv[0]);
+			return false;
+		}
+	}
+	return true;
+}
+}
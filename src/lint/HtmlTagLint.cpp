@@ -0,0 +1,330 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "TagBalance.h"
+#include "WorkerPool.h"
+
+using namespace HtmlTag;
+namespace fs = std::filesystem;
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+using Clock = std::chrono::steady_clock;
+
+enum DialectChoice { dcByExtension, dcHtml, dcXml };
+
+enum ExitCode { ecBalanced = 0, ecUnbalanced = 1, ecFailed = 2 };
+
+struct LintOptions {
+	std::vector<std::string> paths;
+	/// What a directory is searched for; files named on the command line are always checked
+	std::vector<std::string> extensions{ ".htm", ".html", ".xhtml", ".shtml", ".xml", ".svg", ".xsl", ".xslt",
+		".cshtml", ".razor", ".jsx", ".tsx", ".vue", ".php" };
+	DialectChoice dialect = dcByExtension;
+	bool braces = false;
+	bool quiet = false;
+	unsigned threads = 0;
+};
+
+/// A file's text, mapped read-only into memory for as long as this lives
+class MappedFile final {
+
+public:
+	explicit MappedFile(fs::path const &path);
+	~MappedFile();
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	bool valid() const noexcept { return _valid; }
+	std::string_view text() const noexcept { return { _data, _size }; }
+
+private:
+	const char *_data = nullptr;
+	size_t _size = 0;
+	bool _valid = false;
+};
+
+struct LintFile {
+	fs::path path;
+	uintmax_t size;
+	/// The diagnostics, ready to print
+	std::string output;
+	size_t problems;
+	size_t tags;
+	bool failed;
+};
+
+void lintFile(LintFile &file, LintOptions const &options);
+void appendDiagnostic(std::string &output, std::string const &path, size_t line, size_t column, const char *format,
+    std::string const &name);
+bool collectFiles(LintOptions const &options, std::vector<LintFile> &files);
+bool hasExtension(fs::path const &path, std::vector<std::string> const &extensions);
+std::string lowercase(std::string text);
+bool parseArgs(int argc, char **argv, LintOptions &options);
+}
+
+int main(int argc, char **argv) {
+	LintOptions options;
+	if (!parseArgs(argc, argv, options))
+		return ecFailed;
+
+	std::vector<LintFile> files;
+	bool passed = collectFiles(options, files);
+
+	// Each worker takes the newest task from its own queue, so submitting the smallest files first starts the
+	// largest ones first, and no core is left with one big file at the end
+	std::vector<LintFile *> bySize;
+	for (LintFile &file : files)
+		bySize.push_back(&file);
+	std::stable_sort(
+	    bySize.begin(), bySize.end(), [](LintFile const *a, LintFile const *b) { return a->size < b->size; });
+
+	const Clock::time_point started = Clock::now();
+	WorkerPool pool{ options.threads ? options.threads : (std::max)(std::thread::hardware_concurrency(), 1U) };
+	for (LintFile *file : bySize)
+		pool.submit([file, &options] { lintFile(*file, options); });
+	pool.wait();
+	const std::chrono::duration<double> elapsed = Clock::now() - started;
+
+	size_t problems = 0, faultyFiles = 0, tags = 0;
+	uintmax_t bytes = 0;
+	for (LintFile const &file : files) {
+		if (file.failed) {
+			std::fprintf(stderr, "%s: error: can't read the file\n", file.path.string().c_str());
+			passed = false;
+			continue;
+		}
+		if (!options.quiet)
+			std::fputs(file.output.c_str(), stdout);
+		problems += file.problems;
+		faultyFiles += (file.problems ? 1 : 0);
+		tags += file.tags;
+		bytes += file.size;
+	}
+	std::fflush(stdout);
+
+	const double seconds = (std::max)(elapsed.count(), 1e-9);
+	std::fprintf(stderr,
+	    "htmltag-lint: %zu problem(s) in %zu of %zu file(s), %zu tags, %.1f MB in %.3f s "
+	    "(%.0f files/s, %.1f MB/s, %zu threads)\n",
+	    problems, faultyFiles, files.size(), tags, static_cast<double>(bytes) / 1e6, seconds,
+	    static_cast<double>(files.size()) / seconds, static_cast<double>(bytes) / 1e6 / seconds, pool.threadCount());
+
+	if (!passed)
+		return ecFailed;
+	return problems ? ecUnbalanced : ecBalanced;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+// --------------------------------------------------------------------------------------
+// MappedFile
+// --------------------------------------------------------------------------------------
+#ifdef _WIN32
+MappedFile::MappedFile(fs::path const &path) {
+	HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING,
+	    FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return;
+	LARGE_INTEGER size;
+	if (GetFileSizeEx(file, &size)) {
+		_size = static_cast<size_t>(size.QuadPart);
+		_valid = (_size == 0);
+		// The view keeps the mapping open after both handles are closed
+		HANDLE mapping = _size ? CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+		if (mapping) {
+			_data = static_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+			_valid = (_data != nullptr);
+			CloseHandle(mapping);
+		}
+	}
+	CloseHandle(file);
+}
+
+MappedFile::~MappedFile() {
+	if (_data)
+		UnmapViewOfFile(_data);
+}
+#else
+MappedFile::MappedFile(fs::path const &path) {
+	const int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+		return;
+	struct stat info;
+	if (fstat(fd, &info) == 0) {
+		_size = static_cast<size_t>(info.st_size);
+		_valid = (_size == 0);
+		// The mapping outlives the descriptor
+		void *data = _size ? mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+		if (data != MAP_FAILED) {
+			madvise(data, _size, MADV_SEQUENTIAL);
+			_data = static_cast<const char *>(data);
+			_valid = true;
+		}
+	}
+	close(fd);
+}
+
+MappedFile::~MappedFile() {
+	if (_data)
+		munmap(const_cast<char *>(_data), _size);
+}
+#endif
+// --------------------------------------------------------------------------------------
+/// Runs on a worker thread, with a source of its own; diagnostics are sorted by position, so lines are
+/// counted in one pass
+void lintFile(LintFile &file, LintOptions const &options) {
+	try {
+		MappedFile mapped{ file.path };
+		if (!mapped.valid()) {
+			file.failed = true;
+			return;
+		}
+		const std::string_view text = mapped.text();
+		file.size = text.size();
+
+		TagBalance::Dialect dialect = (options.dialect == dcXml) ? TagBalance::dlXml : TagBalance::dlHtml;
+		// JSX closes any element with "/>", as XML does
+		if (options.dialect == dcByExtension &&
+		    hasExtension(file.path, { ".xml", ".xhtml", ".svg", ".xsl", ".xslt", ".rss", ".atom", ".jsx", ".tsx" }))
+			dialect = TagBalance::dlXml;
+		const bool braces = options.braces || hasExtension(file.path, { ".jsx", ".tsx", ".cshtml", ".razor" });
+
+		const TagBalance::Report report =
+		    TagBalance::check(TagSource{ text }, dialect, braces ? TagLexer::tsBraces : TagLexer::tsHtml);
+		file.tags = report.tags;
+		file.problems = report.problems.size() + report.unreported;
+
+		const std::string path = file.path.string();
+		size_t line = 1;
+		size_t lineStart = 0, counted = 0;
+		for (TagBalance::Problem const &problem : report.problems) {
+			const auto pos = static_cast<size_t>(problem.startPos);
+			for (const char *next = text.data() + counted, *end = text.data() + pos;
+			     (next = static_cast<const char *>(std::memchr(next, '\n', end - next))) != nullptr; ++next) {
+				++line;
+				lineStart = static_cast<size_t>(next - text.data()) + 1;
+			}
+			counted = pos;
+			const char *format = (problem.kind == TagBalance::pkUnclosed)     ? "unclosed <%s>"
+			                     : (problem.kind == TagBalance::pkMisnested) ? "misnested <%s>"
+			                                                                  : "stray </%s>";
+			appendDiagnostic(file.output, path, line, pos - lineStart + 1, format, problem.name);
+		}
+		if (report.unreported) {
+			file.output += path + ": note: " + std::to_string(report.unreported) + " more problem(s) not shown\n";
+		}
+	} catch (...) {
+		file.failed = true;
+	}
+}
+// --------------------------------------------------------------------------------------
+/// Writes one line in the form compilers use, so that editors and CI logs can link to it; columns count bytes
+void appendDiagnostic(std::string &output, std::string const &path, size_t line, size_t column, const char *format,
+    std::string const &name) {
+	char message[TagLexer::maxNameLength + 32];
+	std::snprintf(message, sizeof(message), format, name.c_str());
+	output += path + ':' + std::to_string(line) + ':' + std::to_string(column) + ": error: " + message + '\n';
+}
+// --------------------------------------------------------------------------------------
+/// Lists the files named in @c options, searching directories for the extensions it names, in sorted order
+bool collectFiles(LintOptions const &options, std::vector<LintFile> &files) {
+	bool listed = true;
+	for (std::string const &arg : options.paths) {
+		std::error_code error;
+		const fs::path path{ arg };
+		if (!fs::is_directory(path, error)) {
+			files.push_back(LintFile{ path, fs::file_size(path, error), {}, 0, 0, false });
+			continue;
+		}
+		std::vector<LintFile> found;
+		for (fs::recursive_directory_iterator entry{ path, fs::directory_options::skip_permission_denied, error }, end;
+		     !error && entry != end; entry.increment(error)) {
+			std::error_code unknownSize;
+			if (entry->is_regular_file(error) && hasExtension(entry->path(), options.extensions))
+				found.push_back(LintFile{ entry->path(), entry->file_size(unknownSize), {}, 0, 0, false });
+		}
+		if (error) {
+			std::fprintf(stderr, "%s: error: %s\n", arg.c_str(), error.message().c_str());
+			listed = false;
+		}
+		std::sort(found.begin(), found.end(), [](LintFile const &a, LintFile const &b) { return a.path < b.path; });
+		std::move(found.begin(), found.end(), std::back_inserter(files));
+	}
+	return listed;
+}
+// --------------------------------------------------------------------------------------
+bool hasExtension(fs::path const &path, std::vector<std::string> const &extensions) {
+	const std::string extension = lowercase(path.extension().string());
+	return std::find(extensions.begin(), extensions.end(), extension) != extensions.end();
+}
+// --------------------------------------------------------------------------------------
+std::string lowercase(std::string text) {
+	std::transform(text.begin(), text.end(), text.begin(),
+	    [](char c) { return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c; });
+	return text;
+}
+// --------------------------------------------------------------------------------------
+bool parseArgs(int argc, char **argv, LintOptions &options) {
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		const bool hasValue = (i + 1 < argc);
+		if (arg == "--threads" && hasValue) {
+			options.threads = static_cast<unsigned>((std::max)(0, std::atoi(argv[++i])));
+		} else if (arg == "--ext" && hasValue) {
+			options.extensions.clear();
+			const std::string list = lowercase(argv[++i]);
+			for (size_t start = 0, comma; start < list.size(); start = comma + 1) {
+				comma = (std::min)(list.find(',', start), list.size());
+				const std::string extension = list.substr(start, comma - start);
+				if (!extension.empty())
+					options.extensions.push_back(extension[0] == '.' ? extension : '.' + extension);
+			}
+		} else if (arg == "--html") {
+			options.dialect = dcHtml;
+		} else if (arg == "--xml") {
+			options.dialect = dcXml;
+		} else if (arg == "--braces") {
+			options.braces = true;
+		} else if (arg == "--quiet") {
+			options.quiet = true;
+		} else if (arg.empty() || arg[0] == '-') {
+			options.paths.clear();
+			break;
+		} else {
+			options.paths.push_back(arg);
+		}
+	}
+	if (options.paths.empty()) {
+		std::fprintf(stderr,
+		    "Usage: %s [--threads N] [--ext .html,.xml,...] [--html | --xml] [--braces] [--quiet] "
+		    "<file or directory>...\n"
+		    "Exits with 1 if any tag is unbalanced, or 2 if a file can't be read\n",
+		    argv[0]);
+		return false;
+	}
+	return true;
+}
+}
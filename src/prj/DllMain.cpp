@@ -61,8 +61,8 @@ PLUGINEXPORT void beNotified(SCNotification *notifyCode) {
 	plugin.beNotified(notifyCode);
 }
 
-PLUGINEXPORT LRESULT messageProc(UINT /*message*/, WPARAM /*wParam*/, LPARAM /*lParam*/) {
-	return TRUE;
+PLUGINEXPORT LRESULT messageProc(UINT message, WPARAM wParam, LPARAM lParam) {
+	return plugin.messageProc(message, wParam, lParam);
 }
 
 PLUGINEXPORT BOOL isUnicode() {
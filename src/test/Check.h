@@ -0,0 +1,34 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#ifndef HTMLTAG_TEST_CHECK_H
+#define HTMLTAG_TEST_CHECK_H
+
+#include <cstdio>
+#include <cstdlib>
+
+namespace HtmlTagTest {
+/// Checks that failed so far
+inline int failures = 0;
+
+/// @brief Reports @p what on stderr unless it @p passed.
+inline bool check(bool passed, const char *what) {
+	if (!passed) {
+		++failures;
+		std::fprintf(stderr, "FAILED: %s\n", what);
+	}
+	return passed;
+}
+
+/// @brief The exit code for CTest: success only if every check passed.
+inline int exitCode() {
+	if (failures > 0)
+		std::fprintf(stderr, "%d check(s) failed\n", failures);
+	return (failures > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+}
+#endif // ~HTMLTAG_TEST_CHECK_H
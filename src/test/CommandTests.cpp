@@ -0,0 +1,102 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#include "TagFinder.h"
+#include "Unicode.h"
+#include "Check.h"
+#include "TestPlugin.h"
+
+using namespace HtmlTag;
+using namespace HtmlTagTest;
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+/// @brief Shows @p text in the main view, with @p anchor to @p caret selected.
+void open(std::string const &text, Sci_Position anchor = 0, Sci_Position caret = 0);
+std::string selectedText();
+bool selected(Sci_Position start, Sci_Position end);
+
+void testFindMatchingTag();
+void testDecodeEntities();
+void testDecodeUnicode();
+}
+
+// --------------------------------------------------------------------------------------
+int main() {
+	startPlugin();
+	testFindMatchingTag();
+	testDecodeEntities();
+	testDecodeUnicode();
+	return exitCode();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+void testFindMatchingTag() {
+	open("<div><p>text</p></div>");
+	TagFinder::findMatchingTag(soNone);
+	check(selected(16, 22), "findMatchingTag goes to the closing tag");
+
+	open("<div><p>text</p></div>");
+	TagFinder::findMatchingTag(soTags | soContents);
+	check(selected(0, 22), "findMatchingTag selects both tags and what's between them");
+
+	open("<div><p> text </p></div>", 5, 5);
+	TagFinder::findMatchingTag(soContents);
+	check(selectedText() == "text", "findMatchingTag selects the contents, without the spaces around them");
+
+	open("<div><span>text</div>", 5, 5);
+	TagFinder::findMatchingTag(soTags);
+	check(selected(5, 11), "findMatchingTag selects a tag with no match");
+}
+// --------------------------------------------------------------------------------------
+void testDecodeEntities() {
+	open("a &amp; b &lt;c&gt; &eacute;", 0, 29);
+	check(Entities::decode() == 4, "Entities::decode counts the references in the selection");
+	check(document().text() == "a & b <c> \xC3\xA9", "Entities::decode replaces named references");
+
+	open("&#38;&#x3C; &hellip;", 0, 0);
+	check(Entities::decode(Entities::ersDocument) == 3, "Entities::decode counts the references in the document");
+	check(document().text() == "&< \xE2\x80\xA6", "Entities::decode replaces numeric references");
+	document().send(SCI_UNDO);
+	check(document().text() == "&#38;&#x3C; &hellip;", "Entities::decode is undone in one step");
+
+	open("&lt;b&gt; and &lt;i&gt;", 0, 10);
+	document().send(SCI_ADDSELECTION, 23, 14);
+	check(Entities::decode() == 4, "Entities::decode replaces in every selection");
+	check(document().text() == "<b> and <i>", "Entities::decode keeps the text between selections");
+	document().send(SCI_UNDO);
+	check(document().text() == "&lt;b&gt; and &lt;i&gt;", "Entities::decode of every selection is undone in one step");
+}
+// --------------------------------------------------------------------------------------
+void testDecodeUnicode() {
+	open(R"(caf\u00e9 \u2026)", 0, 16);
+	check(Unicode::decode() == 2, "Unicode::decode counts the escapes in the selection");
+	check(document().text() == "caf\xC3\xA9 \xE2\x80\xA6", "Unicode::decode replaces escapes");
+
+	open(R"(\ud83d\ude00)", 0, 0);
+	check(Unicode::decode(Entities::ersDocument) == 1, "Unicode::decode reads a surrogate pair as one character");
+	check(document().text() == "\xF0\x9F\x98\x80", "Unicode::decode writes a surrogate pair as one character");
+}
+// --------------------------------------------------------------------------------------
+void open(std::string const &text, Sci_Position anchor, Sci_Position caret) {
+	document().setText(text);
+	document().send(SCI_EMPTYUNDOBUFFER);
+	document().send(SCI_SETSEL, anchor, caret);
+}
+// --------------------------------------------------------------------------------------
+std::string selectedText() {
+	const std::string text = document().text();
+	const auto start = static_cast<size_t>(document().send(SCI_GETSELECTIONSTART));
+	const auto end = static_cast<size_t>(document().send(SCI_GETSELECTIONEND));
+	return text.substr(start, end - start);
+}
+// --------------------------------------------------------------------------------------
+bool selected(Sci_Position start, Sci_Position end) {
+	return document().send(SCI_GETSELECTIONSTART) == start && document().send(SCI_GETSELECTIONEND) == end;
+}
+}
@@ -0,0 +1,128 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#include "SliceScheduler.h"
+#include "Check.h"
+
+using namespace std::chrono_literals;
+using namespace HtmlTagTest;
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+/// The results of a job that takes @p stepTime by the fake clock for each of its @p steps
+struct FakeJob {
+	FakeJob(int steps, std::chrono::microseconds stepTime);
+	SlicedJob job();
+
+	int steps;
+	std::chrono::microseconds stepTime;
+	int stepsRun = 0;
+	int completions = 0;
+	bool cancelled = false;
+	/// Called by the step with its number, from 1
+	std::function<void(int)> onStep;
+	/// The answer to give the scheduler after each slice
+	bool keepGoing = true;
+};
+
+void testBudget();
+void testSlowSteps();
+void testCancelFromStep();
+void testCancelFromYield();
+
+SliceScheduler::Clock::time_point fakeNow{};
+const SliceScheduler::Now fakeClock = [] { return fakeNow; };
+}
+
+// --------------------------------------------------------------------------------------
+int main() {
+	testBudget();
+	testSlowSteps();
+	testCancelFromStep();
+	testCancelFromYield();
+	return exitCode();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+void testBudget() {
+	SliceScheduler scheduler{ 8ms, fakeClock };
+	FakeJob fake{ 10, 3ms };
+	scheduler.start(fake.job());
+	check(scheduler.runSlice(), "runSlice asks for another slice while there's work left");
+	check(fake.stepsRun == 3, "runSlice stops at the first step that ends past the budget");
+	const auto longest = static_cast<uint64_t>(std::chrono::nanoseconds{ 9ms }.count());
+	check(scheduler.stats().longest == longest, "stats record the longest slice");
+
+	while (scheduler.runSlice()) {
+	}
+	check(fake.stepsRun == 10, "runSlice runs every step in the end");
+	check(scheduler.stats().slices == 4, "runSlice fits as many steps as the budget allows into each slice");
+	check(fake.completions == 1 && !fake.cancelled, "a finished job completes once, not cancelled");
+	check(!scheduler.running(), "a finished job is no longer running");
+}
+// --------------------------------------------------------------------------------------
+void testSlowSteps() {
+	SliceScheduler scheduler{ 8ms, fakeClock };
+	FakeJob fake{ 3, 20ms };
+	scheduler.start(fake.job());
+	scheduler.runSlice();
+	check(fake.stepsRun == 1, "runSlice runs one step even when it takes more than the budget");
+	while (scheduler.runSlice()) {
+	}
+	check(scheduler.stats().slices == 3 && fake.stepsRun == 3, "runSlice runs one slow step per slice");
+	check(fake.completions == 1 && !fake.cancelled, "a job of slow steps completes once, not cancelled");
+}
+// --------------------------------------------------------------------------------------
+void testCancelFromStep() {
+	SliceScheduler scheduler{ 8ms, fakeClock };
+	FakeJob fake{ 10, 1ms };
+	fake.onStep = [&scheduler](int step) {
+		if (step == 2)
+			scheduler.cancel();
+	};
+	scheduler.start(fake.job());
+	check(!scheduler.runSlice(), "runSlice asks for no more slices once a step cancels");
+	check(fake.stepsRun == 2, "no step runs after the one that cancels");
+	check(fake.completions == 1 && fake.cancelled, "a job cancelled by its step completes once, cancelled");
+	check(!scheduler.running(), "a cancelled job is no longer running");
+	check(!scheduler.runSlice() && fake.stepsRun == 2, "runSlice does nothing after a cancel");
+}
+// --------------------------------------------------------------------------------------
+void testCancelFromYield() {
+	SliceScheduler scheduler{ 8ms, fakeClock };
+	FakeJob fake{ 10, 3ms };
+	fake.keepGoing = false;
+	scheduler.start(fake.job());
+	check(!scheduler.runSlice(), "runSlice asks for no more slices once the yield says to stop");
+	check(fake.stepsRun == 3, "the yield comes after a full slice");
+	check(fake.completions == 1 && fake.cancelled, "a job the yield stops completes once, cancelled");
+
+	FakeJob last{ 2, 3ms };
+	last.keepGoing = false;
+	scheduler.start(last.job());
+	check(!scheduler.runSlice(), "runSlice asks for no more slices once the job is done");
+	check(last.completions == 1 && !last.cancelled, "the yield isn't asked about a job with nothing left to do");
+}
+// --------------------------------------------------------------------------------------
+FakeJob::FakeJob(int steps_, std::chrono::microseconds stepTime_) : steps(steps_), stepTime(stepTime_) {}
+// --------------------------------------------------------------------------------------
+SlicedJob FakeJob::job() {
+	auto step = [this] {
+		fakeNow += stepTime;
+		++stepsRun;
+		if (onStep)
+			onStep(stepsRun);
+		return stepsRun < steps;
+	};
+	auto completed = [this](bool wasCancelled) {
+		++completions;
+		cancelled = wasCancelled;
+	};
+	return SlicedJob{ step, [this] { return keepGoing; }, completed };
+}
+}
@@ -0,0 +1,93 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#include <memory>
+#include "SciMemoryDocument.h"
+#include "SciTextObjects.h"
+#include "Check.h"
+
+using namespace SciTextObjects;
+using namespace HtmlTagTest;
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+/// @brief Routes the messages for @p hWnd to @p doc.
+void attach(HWND hWnd, SciMemoryDocument &doc);
+
+void testSharing();
+void testStale();
+void testSpareBuffers();
+
+/// Handles no real window will ever have; only their addresses matter
+char firstView, secondView;
+const HWND firstHandle = reinterpret_cast<HWND>(&firstView), secondHandle = reinterpret_cast<HWND>(&secondView);
+/// Longer than any string kept in place, so its buffer is on the heap
+const std::string firstText = "<html><body><p>Every snapshot of this text is the same</p></body></html>";
+const std::string secondText = "<html><body><p>A different text, in a different document</p></body></html>";
+
+SciMemoryDocument firstDocument{ firstText }, secondDocument{ secondText };
+}
+
+// --------------------------------------------------------------------------------------
+int main() {
+	attach(firstHandle, firstDocument);
+	attach(secondHandle, secondDocument);
+	testSharing();
+	testStale();
+	testSpareBuffers();
+	return exitCode();
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+void testSharing() {
+	SciActiveDocument first{ firstHandle }, second{ secondHandle };
+	SciSnapshotPtr snapshot = first.snapshot();
+	check(snapshot->text() == firstText, "snapshot copies the text");
+	check(first.snapshot() == snapshot, "snapshot is shared while nothing has changed");
+	check(second.snapshot() != snapshot, "snapshot is not shared between documents");
+	check(second.snapshot()->text() == secondText, "snapshot copies the text of its own document");
+}
+// --------------------------------------------------------------------------------------
+void testStale() {
+	SciActiveDocument first{ firstHandle }, second{ secondHandle };
+	SciSnapshotPtr firstSnapshot = first.snapshot(), secondSnapshot = second.snapshot();
+	check(!firstSnapshot->stale() && !secondSnapshot->stale(), "snapshot is current when taken");
+
+	// What the plugin does for an edit to the second document; the version covers every document
+	SciActiveDocument::invalidateText();
+	check(firstSnapshot->stale(), "an edit to any document makes every snapshot stale");
+	check(secondSnapshot->stale(), "an edit makes the edited document's snapshot stale");
+	SciSnapshotPtr retaken = first.snapshot();
+	check(retaken != firstSnapshot && !retaken->stale(), "a stale snapshot is not shared");
+	check(!firstSnapshot->matches(first), "a stale snapshot no longer matches, though its document is unchanged");
+}
+// --------------------------------------------------------------------------------------
+void testSpareBuffers() {
+	SciActiveDocument first{ firstHandle }, second{ secondHandle };
+	SciSnapshotPtr snapshot = first.snapshot();
+	const char *buffer = snapshot->text().data();
+	SciActiveDocument::invalidateText();
+	snapshot.reset();
+
+	snapshot = second.snapshot();
+	check(snapshot->text().data() != buffer, "a spare buffer is not lent to another document");
+	snapshot = first.snapshot();
+	check(snapshot->text().data() == buffer, "a spare buffer is reused for the next snapshot of its document");
+	check(snapshot->text() == firstText, "a reused buffer holds the new copy");
+
+	SciSnapshotPtr held = first.snapshot();
+	SciActiveDocument::invalidateText();
+	snapshot = first.snapshot();
+	check(snapshot->text().data() != held->text().data(), "a buffer is not reused while its snapshot is held");
+}
+// --------------------------------------------------------------------------------------
+void attach(HWND hWnd, SciMemoryDocument &doc) {
+	auto callback = [&doc](unsigned msg, uptr_t wParam, sptr_t lParam) { return doc.send(msg, wParam, lParam); };
+	SciMessageTransport::attach(hWnd, std::make_shared<SciCallbackTransport>(callback));
+}
+}
@@ -0,0 +1,150 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#include <memory>
+#include "HtmlTag.h"
+#include "TestPlugin.h"
+
+using namespace HtmlTag;
+using namespace SciTextObjects;
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+sptr_t answerNpp(unsigned msg, uptr_t wParam, sptr_t lParam);
+void attach(HWND hWnd, SciCallbackTransport::Callback callback);
+void attach(HWND hWnd, SciMemoryDocument &doc);
+
+/// Handles no real window will ever have; only their addresses matter
+char nppWindow, mainView, subView;
+const NppData nppData{ reinterpret_cast<HWND>(&nppWindow), reinterpret_cast<HWND>(&mainView),
+	reinterpret_cast<HWND>(&subView) };
+constexpr uintptr_t activeBufferId = 1;
+/// Notepad++ 8.6.1, new enough for every API level
+constexpr sptr_t nppVersion = (8 << 16) | 61;
+
+/// The references @c Entities::decode knows, by name and by code point
+constexpr std::pair<const char *, int> entities[] = { { "quot", 34 }, { "amp", 38 }, { "lt", 60 }, { "gt", 62 },
+	{ "nbsp", 160 }, { "copy", 169 }, { "eacute", 233 }, { "hellip", 8230 } };
+
+SciMemoryDocument mainDocument, subDocument;
+bool started = false;
+}
+
+namespace HtmlTag {
+HtmlTagPlugin plugin;
+}
+
+// --------------------------------------------------------------------------------------
+// HtmlTagTest
+// --------------------------------------------------------------------------------------
+void HtmlTagTest::startPlugin() {
+	if (started)
+		return;
+	started = true;
+	// Before the plugin asks for them, so its views and the application pick them up
+	attach(nppData._nppHandle, answerNpp);
+	attach(nppData._scintillaMainHandle, mainDocument);
+	attach(nppData._scintillaSecondHandle, subDocument);
+	plugin.setInfo(&nppData);
+}
+// --------------------------------------------------------------------------------------
+SciMemoryDocument &HtmlTagTest::document() {
+	return mainDocument;
+}
+
+// --------------------------------------------------------------------------------------
+// HtmlTag::HtmlTagPlugin, as much as the commands need
+// --------------------------------------------------------------------------------------
+void HtmlTagPlugin::setInfo(const NppData *data) {
+	PluginBase::setInfo(data);
+	options = PluginOptions{};
+	options.unicodePrefix = R"(\u)";
+	options.largeFiles = defaultLargeFileThresholds;
+}
+// --------------------------------------------------------------------------------------
+void HtmlTagPlugin::beNotified(SCNotification * /*scn*/) {
+}
+// --------------------------------------------------------------------------------------
+EntityList const &HtmlTagPlugin::getEntities(uintptr_t bufferId) {
+	EntityList &list = _entityMap[documentLangType(bufferId) == L_XML ? "XML" : "HTML 5"];
+	if (!list) {
+		std::vector<EntityList::Pair_T> pairs;
+		for (auto &&entity : ::entities) {
+			pairs.emplace_back(entity.first, std::to_string(entity.second));
+			pairs.emplace_back(std::to_string(entity.second), entity.first);
+		}
+		list = EntityList{ std::move(pairs) };
+	}
+	return list;
+}
+// --------------------------------------------------------------------------------------
+const wchar_t *HtmlTagPlugin::getMessage(std::wstring const &key) {
+	return _menuTitles[key].c_str();
+}
+// --------------------------------------------------------------------------------------
+std::wstring HtmlTagPlugin::formatMessage(std::wstring const &key, std::initializer_list<std::wstring> args) {
+	std::wstring msg = getMessage(key);
+	wchar_t argId[] = L"%1";
+	for (auto &&arg : args) {
+		size_t argPos = msg.find(argId);
+		if (argPos != std::wstring::npos)
+			msg.replace(argPos, 2, arg);
+		++argId[1];
+	}
+	return msg;
+}
+// --------------------------------------------------------------------------------------
+size_t HtmlTagPlugin::forEachBuffer(BufferAction const &action) {
+	return editor().forEachBuffer(action);
+}
+// --------------------------------------------------------------------------------------
+bool HtmlTagPlugin::largeFileMode() {
+	return options.largeFiles.isLarge(editor().activeDocument().length());
+}
+// --------------------------------------------------------------------------------------
+bool HtmlTagPlugin::confirmCopy(Sci_Position length) {
+	return !options.largeFiles.needsConfirmation(length);
+}
+// --------------------------------------------------------------------------------------
+MenuTitles::MenuTitles() : HashedStringList<std::wstring>() {
+	addStrings({
+	    L"msg_replaced=%1 replacement(s) in %2 ms",
+	    L"msg_scan_bounded=No match within %1 KB of the caret (large file mode)",
+	});
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////
+namespace {
+sptr_t answerNpp(unsigned msg, uptr_t /*wParam*/, sptr_t lParam) {
+	switch (msg) {
+		case NPPM_GETNPPVERSION:
+			return nppVersion;
+		case NPPM_GETCURRENTSCINTILLA:
+			*reinterpret_cast<int *>(lParam) = MAIN_VIEW;
+			return TRUE;
+		case NPPM_GETCURRENTVIEW:
+			return MAIN_VIEW;
+		case NPPM_GETCURRENTBUFFERID:
+			return static_cast<sptr_t>(activeBufferId);
+		case NPPM_GETCURRENTLANGTYPE:
+			*reinterpret_cast<int *>(lParam) = L_HTML;
+			return TRUE;
+		case NPPM_GETBUFFERLANGTYPE:
+			return L_HTML;
+		default:
+			return 0;
+	}
+}
+// --------------------------------------------------------------------------------------
+void attach(HWND hWnd, SciCallbackTransport::Callback callback) {
+	SciMessageTransport::attach(hWnd, std::make_shared<SciCallbackTransport>(std::move(callback)));
+}
+// --------------------------------------------------------------------------------------
+void attach(HWND hWnd, SciMemoryDocument &doc) {
+	attach(hWnd, [&doc](unsigned msg, uptr_t wParam, sptr_t lParam) { return doc.send(msg, wParam, lParam); });
+}
+}
@@ -0,0 +1,23 @@
+/*
+  This Source Code Form is subject to the terms of the Mozilla Public
+  License, v. 2.0. If a copy of the MPL was not distributed with this file,
+  You can obtain one at https://mozilla.org/MPL/2.0/.
+
+  Copyright (c) 2024 Robert Di Pardo <dipardo.r@gmail.com>
+*/
+#ifndef HTMLTAG_TEST_PLUGIN_H
+#define HTMLTAG_TEST_PLUGIN_H
+
+#include "SciMemoryDocument.h"
+
+/// @brief A headless Notepad++ for the plugin's commands to run in: the main view shows one HTML buffer, held
+/// by a @c SciMemoryDocument, and every message reaches it through a @c SciCallbackTransport.
+///
+/// Stands in for HtmlTag.cpp, so the options are the defaults and the entities a handful of common ones.
+namespace HtmlTagTest {
+/// @brief Starts the plugin, once; until then, commands have no editor to talk to.
+void startPlugin();
+/// The buffer showing in the main view
+SciTextObjects::SciMemoryDocument &document();
+}
+#endif // ~HTMLTAG_TEST_PLUGIN_H